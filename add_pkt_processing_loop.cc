@@ -14,6 +14,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "clang_utility_functions.h"
+#include "packet_processing_code_handler.h"
 
 using namespace clang;
 using namespace clang::ast_matchers;
@@ -22,31 +23,6 @@ using namespace clang::tooling;
 
 static llvm::cl::OptionCategory AddPktProcessingLoop("Add stylized packet-processing loop to packet processing function body");
 
-class PacketProcessingCodeHandler : public MatchFinder::MatchCallback {
- public:
-  /// Constructor: Pass Refactoring tool as argument
-  PacketProcessingCodeHandler(Replacements & t_replace) : Replace(t_replace) {}
-
-  /// Callback whenever there's a match
-  virtual void run(const MatchFinder::MatchResult &Result) override {
-    const FunctionDecl *function_decl_expr = Result.Nodes.getNodeAs<clang::FunctionDecl>("packetProcessingCode");
-    assert(function_decl_expr != nullptr);
-
-    /// Find location just after opening brace of function body
-    auto start_loc = Lexer::getLocForEndOfToken(function_decl_expr->getBody()->getLocStart(), 0, *Result.SourceManager, Result.Context->getLangOpts());
-    Replacement rep_start(*(Result.SourceManager), start_loc, 0, "\n while(1) {\n");
-    Replace.insert(rep_start);
-
-    /// Find location just before closing brace of function body
-    auto end_loc = Lexer::GetBeginningOfToken(function_decl_expr->getBody()->getLocEnd(), *Result.SourceManager, Result.Context->getLangOpts());
-    Replacement rep_end(*(Result.SourceManager), end_loc, 0, "\n }\n");
-    Replace.insert(rep_end);
-  }
-
- private:
-  Replacements & Replace;
-};
-
 int main(int argc, const char **argv) {
   CommonOptionsParser op(argc, argv, AddPktProcessingLoop);
   RefactoringTool Tool(op.getCompilations(), op.getSourcePathList());
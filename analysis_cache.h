@@ -0,0 +1,256 @@
+#ifndef ANALYSIS_CACHE_H_
+#define ANALYSIS_CACHE_H_
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "graph.h"
+#include "dominator_utility.h"
+#include "fingerprint.h"
+#include "graph_serialization.h"
+#include "instrumentation.h"
+
+namespace analysis_cache {
+
+static const char kMagic[8] = {'J', 'H', 'C', 'A', 'C', 'H', 'E', '1'};
+
+}  // namespace analysis_cache
+
+/// Analysis result serialized for the cache: varints and length-prefixed strings
+class BlobWriter {
+ public:
+  void u64(const uint64_t value) { graph_serialization::append_varint(blob_, value); }
+
+  void string(const std::string & value) {
+    u64(value.size());
+    blob_ += value;
+  }
+
+  const std::string & blob() const { return blob_; }
+
+ private:
+  std::string blob_ = {};
+};
+
+/// Read back what BlobWriter wrote, throwing std::runtime_error if blob runs out
+class BlobReader {
+ public:
+  explicit BlobReader(const std::string & t_blob) : blob_(t_blob), position_(0) {}
+
+  uint64_t u64() {
+    uint64_t ret = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      if (position_ == blob_.size() or shift > 63) throw std::runtime_error("BlobReader: truncated blob\n");
+      const auto byte = static_cast<unsigned char>(blob_[position_++]);
+      ret |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) return ret;
+    }
+  }
+
+  std::string string() {
+    const auto size = u64();
+    if (size > blob_.size() - position_) throw std::runtime_error("BlobReader: truncated blob\n");
+    const auto begin = position_;
+    position_ += size;
+    return blob_.substr(begin, size);
+  }
+
+  /// Check that all of blob was read
+  void finish() const {
+    if (position_ != blob_.size()) throw std::runtime_error("BlobReader: trailing bytes\n");
+  }
+
+ private:
+  const std::string & blob_;
+  size_t position_;
+};
+
+/// Write graph's edges, given a number for each node
+template <class NodeType>
+void write_edges(BlobWriter & out, const Graph<NodeType> & graph, const std::map<NodeType, uint64_t> & numbers) {
+  out.u64(graph.num_edges());
+  for (const auto & node : graph.succ_map()) {
+    for (const auto & succ : node.second) {
+      out.u64(numbers.at(node.first));
+      out.u64(numbers.at(succ));
+    }
+  }
+}
+
+/// Add the edges write_edges wrote to graph, whose nodes are nodes in the same numbering
+template <class NodeType>
+void read_edges(BlobReader & in, Graph<NodeType> & graph, const std::vector<NodeType> & nodes) {
+  const auto num_edges = in.u64();
+  for (uint64_t i = 0; i < num_edges; i++) {
+    const auto from = in.u64();
+    const auto to = in.u64();
+    if (from >= nodes.size() or to >= nodes.size()) throw std::runtime_error("read_edges: node out of range\n");
+    graph.add_edge(nodes.at(from), nodes.at(to));
+  }
+}
+
+/// On-disk cache of analysis results, content-addressed: a result is stored
+/// under the fingerprint of what it was computed from, and reused whenever
+/// that fingerprint comes up again, in this run or a later one.
+/// Entries are files <dir>/<kind>-<fingerprint>, written to a temporary file
+/// and renamed into place, so concurrent writers (transform_driver -j,
+/// compile_server's forked children) never see half an entry.
+/// An entry that doesn't read back whole is a miss.
+class AnalysisCache {
+ public:
+  /// Cache in dir, created if it doesn't exist
+  explicit AnalysisCache(const std::string & t_dir) : dir_(t_dir), hits_(0), misses_(0), temp_count_(0) {
+    if (mkdir(dir_.c_str(), 0777) != 0 and errno != EEXIST) {
+      throw std::runtime_error("AnalysisCache: can't create " + dir_ + "\n");
+    }
+  }
+
+  AnalysisCache(const AnalysisCache &) = delete;
+  AnalysisCache & operator=(const AnalysisCache &) = delete;
+
+  /// Look up the kind of result, e.g., "dominators", computed from key, into blob
+  bool lookup(const std::string & kind, const Fingerprint & key, std::string & blob) {
+    const bool hit = read_entry(path(kind, key), key, blob);
+    (hit ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    PhaseTimer::count(hit ? "cache_hits" : "cache_misses", 1);
+    return hit;
+  }
+
+  /// Store blob as the kind of result computed from key; the cache is best-effort,
+  /// so failing to write is not an error, and returns false
+  bool store(const std::string & kind, const Fingerprint & key, const std::string & blob) {
+    const auto file_name = path(kind, key);
+    const auto temp_name = file_name + ".tmp." + std::to_string(getpid()) + "." +
+                           std::to_string(temp_count_.fetch_add(1, std::memory_order_relaxed));
+    {
+      std::ofstream out(temp_name, std::ios::binary);
+      out.write(analysis_cache::kMagic, sizeof(analysis_cache::kMagic));
+      graph_serialization::write_u64(out, key.high);
+      graph_serialization::write_u64(out, key.low);
+      graph_serialization::write_u64(out, blob.size());
+      out.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+      if (out.flush()) {
+        out.close();
+        if (std::rename(temp_name.c_str(), file_name.c_str()) == 0) return true;
+      }
+    }
+    std::remove(temp_name.c_str());
+    return false;
+  }
+
+  const std::string & dir() const { return dir_; }
+  uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+  /// Cache the analysis passes use, nullptr if they don't cache
+  static AnalysisCache * current() { return instance().get(); }
+
+  /// Have the analysis passes cache their results in dir from now on, "" to stop caching
+  static void open(const std::string & dir) { instance().reset(dir.empty() ? nullptr : new AnalysisCache(dir)); }
+
+ private:
+  std::string path(const std::string & kind, const Fingerprint & key) const { return dir_ + "/" + kind + "-" + key.hex(); }
+
+  /// Read the blob of file_name, checking its header
+  static bool read_entry(const std::string & file_name, const Fingerprint & key, std::string & blob) {
+    std::ifstream in(file_name, std::ios::binary);
+    if (not in) return false;
+    const std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const size_t header_size = sizeof(analysis_cache::kMagic) + 3 * sizeof(uint64_t);
+    if (contents.size() < header_size or
+        contents.compare(0, sizeof(analysis_cache::kMagic), analysis_cache::kMagic, sizeof(analysis_cache::kMagic)) != 0) {
+      return false;
+    }
+    const auto * header = reinterpret_cast<const unsigned char *>(contents.data()) + sizeof(analysis_cache::kMagic);
+    if (graph_serialization::read_u64(header) != key.high or graph_serialization::read_u64(header + 8) != key.low or
+        graph_serialization::read_u64(header + 16) != contents.size() - header_size) {
+      return false;
+    }
+    blob = contents.substr(header_size);
+    return true;
+  }
+
+  static std::unique_ptr<AnalysisCache> & instance() {
+    static std::unique_ptr<AnalysisCache> cache;
+    return cache;
+  }
+
+  std::string dir_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+
+  /// Numbers this process's temporary files
+  std::atomic<uint64_t> temp_count_;
+};
+
+/// Dominators of graph from start, reusing the immediate dominators cached
+/// for a graph with the same fingerprint (see graph_fingerprint) and start node;
+/// the dominator tree and frontiers are rebuilt from them in linear time.
+/// Nodes are matched up by label, so graphs of different nodes with the same labels
+/// share results, e.g., CFGs of the same shape with blocks labelled by position.
+/// Nothing is cached if cache is nullptr or labels aren't unique.
+template <class NodeType>
+std::unique_ptr<DominatorUtility<NodeType>> cached_dominator_utility(AnalysisCache * cache,
+                                                                     const Graph<NodeType> & graph,
+                                                                     const NodeType & start,
+                                                                     const std::function<std::string(const NodeType &)> & label = {}) {
+  typedef std::unique_ptr<DominatorUtility<NodeType>> Result;
+  if (cache == nullptr) return Result(new DominatorUtility<NodeType>(graph, start));
+
+  // Nodes numbered in label order, which is the same in every run, unlike the order of pointers
+  std::vector<std::pair<std::string, NodeType>> labelled;
+  for (const auto & node : graph.node_set()) labelled.emplace_back(fingerprint_label(graph, label, node), node);
+  std::sort(labelled.begin(), labelled.end());
+  const auto same_label = [] (const std::pair<std::string, NodeType> & a, const std::pair<std::string, NodeType> & b)
+                          { return a.first == b.first; };
+  if (std::adjacent_find(labelled.begin(), labelled.end(), same_label) != labelled.end()) {
+    return Result(new DominatorUtility<NodeType>(graph, start));
+  }
+
+  const auto key = FingerprintBuilder().add_fingerprint(graph_fingerprint(graph, label))
+                                       .add_string(fingerprint_label(graph, label, start)).finish();
+  std::string blob;
+  if (cache->lookup("dominators", key, blob)) {
+    try {
+      BlobReader in(blob);
+      std::map<NodeType, NodeType> idoms;
+      const auto num_idoms = in.u64();
+      for (uint64_t i = 0; i < num_idoms; i++) {
+        const auto node = in.u64();
+        const auto idom = in.u64();
+        idoms.emplace(labelled.at(node).second, labelled.at(idom).second);
+      }
+      in.finish();
+      return Result(new DominatorUtility<NodeType>(graph, start, idoms));
+    } catch (const std::exception &) {
+      // Not a result for this graph after all, recompute it
+    }
+  }
+
+  Result ret(new DominatorUtility<NodeType>(graph, start));
+  std::map<NodeType, uint64_t> numbers;
+  for (size_t i = 0; i < labelled.size(); i++) numbers.emplace(labelled.at(i).second, i);
+  BlobWriter out;
+  out.u64(ret->immediate_dominators().size());
+  for (const auto & idom : ret->immediate_dominators()) {
+    out.u64(numbers.at(idom.first));
+    out.u64(numbers.at(idom.second));
+  }
+  cache->store("dominators", key, out.blob());
+  return ret;
+}
+
+#endif  // ANALYSIS_CACHE_H_
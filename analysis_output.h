@@ -0,0 +1,167 @@
+#ifndef ANALYSIS_OUTPUT_H_
+#define ANALYSIS_OUTPUT_H_
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+/// How much the analysis passes write about what they compute
+enum class Verbosity : unsigned {
+  /// Nothing
+  kSilent = 0,
+
+  /// One line per function and pass
+  kSummary = 1,
+
+  /// Final results: program dependence graphs, guards and predicate registers, dead blocks
+  kResults = 2,
+
+  /// Every intermediate graph and path condition
+  kTrace = 3
+};
+
+/// Stream buffer writing to a FILE in large chunks, instead of a call into stdio per insertion
+class ChunkedFileBuffer : public std::streambuf {
+ public:
+  /// Buffer for file, which the caller keeps open and closes
+  explicit ChunkedFileBuffer(std::FILE * t_file) : file_(t_file), buffer_(kChunkSize) {
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+  }
+
+  ChunkedFileBuffer(const ChunkedFileBuffer &) = delete;
+  ChunkedFileBuffer & operator=(const ChunkedFileBuffer &) = delete;
+
+  ~ChunkedFileBuffer() { sync(); }
+
+ protected:
+  int_type overflow(const int_type c) override {
+    if (not write_buffer()) return traits_type::eof();
+    if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+
+  /// Chunks at least as large as the buffer bypass it
+  std::streamsize xsputn(const char * data, const std::streamsize size) override {
+    if (size < epptr() - pptr()) {
+      traits_type::copy(pptr(), data, static_cast<size_t>(size));
+      pbump(static_cast<int>(size));
+      return size;
+    }
+    if (not write_buffer()) return 0;
+    if (size < static_cast<std::streamsize>(buffer_.size())) return xsputn(data, size);
+    return static_cast<std::streamsize>(std::fwrite(data, 1, static_cast<size_t>(size), file_));
+  }
+
+  int sync() override { return write_buffer() and std::fflush(file_) == 0 ? 0 : -1; }
+
+ private:
+  /// Hand buffered characters to the file and empty the buffer
+  bool write_buffer() {
+    const auto size = static_cast<size_t>(pptr() - pbase());
+    const bool written = std::fwrite(pbase(), 1, size, file_) == size;
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    return written;
+  }
+
+  static const size_t kChunkSize = 64 * 1024;
+
+  std::FILE * file_;
+  std::vector<char> buffer_;
+};
+
+/// Process-wide verbosity and destination of the analysis passes' output.
+/// Passes test enabled() before formatting anything, so at lower verbosities
+/// graphs and conditions are never printed, not just discarded.
+class AnalysisOutput {
+ public:
+  static void set_verbosity(const Verbosity verbosity) { level() = verbosity; }
+  static Verbosity verbosity() { return level(); }
+
+  /// Whether output at level is wanted
+  static bool enabled(const Verbosity wanted) {
+    return wanted != Verbosity::kSilent and static_cast<unsigned>(wanted) <= static_cast<unsigned>(level());
+  }
+
+  /// Write to file_name from now on, "" or "-" for stdout
+  static void open(const std::string & file_name) {
+    auto & destination = state();
+    destination.stream.reset();
+    destination.buffer.reset();
+    destination.file.reset();
+    if (not file_name.empty() and file_name != "-") {
+      destination.file.reset(std::fopen(file_name.c_str(), "w"));
+      if (not destination.file) throw std::runtime_error("AnalysisOutput: can't write " + file_name + "\n");
+    }
+    destination.buffer.reset(new ChunkedFileBuffer(destination.file ? destination.file.get() : stdout));
+    destination.stream.reset(new std::ostream(destination.buffer.get()));
+  }
+
+  /// Stream to write output to, after checking enabled()
+  static std::ostream & stream() {
+    if (not state().stream) open("");
+    return *state().stream;
+  }
+
+  /// Directory to save each function's program dependence graph in, binary and DOT,
+  /// "" not to save them
+  static void set_graph_dir(const std::string & dir) { graph_directory() = dir; }
+  static const std::string & graph_dir() { return graph_directory(); }
+
+  /// Write out everything buffered, e.g., when a pass is done with a function
+  static void flush() {
+    if (state().stream) state().stream->flush();
+  }
+
+ private:
+  struct FileCloser {
+    void operator()(std::FILE * file) const { std::fclose(file); }
+  };
+
+  /// Destroyed stream first, then its buffer, then the file
+  struct Destination {
+    std::unique_ptr<std::FILE, FileCloser> file = nullptr;
+    std::unique_ptr<ChunkedFileBuffer> buffer = nullptr;
+    std::unique_ptr<std::ostream> stream = nullptr;
+
+    ~Destination() {
+      if (stream) stream->flush();
+    }
+  };
+
+  static Verbosity & level() {
+    static Verbosity verbosity = Verbosity::kSummary;
+    return verbosity;
+  }
+
+  static std::string & graph_directory() {
+    static std::string dir;
+    return dir;
+  }
+
+  static Destination & state() {
+    static Destination destination;
+    return destination;
+  }
+};
+
+/// Node printer that formats each node at most once, so printing a graph
+/// costs one call of printer per node rather than per edge.
+/// Copies share the cache, e.g., the printers of graphs built from one another.
+template <class NodeType>
+std::function<std::string(const NodeType)> memoized_printer(const std::function<std::string(const NodeType)> & printer) {
+  const auto cache = std::make_shared<std::map<NodeType, std::string>>();
+  return [cache, printer] (const NodeType node) {
+    auto it = cache->find(node);
+    if (it == cache->end()) it = cache->emplace(node, printer(node)).first;
+    return it->second;
+  };
+}
+
+#endif  // ANALYSIS_OUTPUT_H_
@@ -0,0 +1,85 @@
+#include <memory>
+#include <stdexcept>
+#include "clang/CodeGen/CodeGenAction.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/UnifyFunctionExitNodes.h"
+#include "instr_prog_deps.h"
+#include "bounded_loop_unroll.h"
+#include "if_conversion.h"
+#include "pipeline_simulation.h"
+#include "atomic_state_lowering.h"
+#include "analysis_pipeline.h"
+
+/// Code generation action that runs our passes on the module
+/// as soon as it's generated, instead of writing it out:
+/// the analysis pipeline, or only what lowering shared state needs,
+/// printing the lowered module to ir.
+/// The tool deletes the action when it's done, so failures
+/// are reported through a flag owned by the caller.
+class AnalyzeLLVMAction : public clang::EmitLLVMOnlyAction {
+ public:
+  /// Run the analysis pipeline, simulating as simulation says, or with ir, lower shared state into it
+  AnalyzeLLVMAction(bool & t_failed, const SimulationOptions & t_simulation, std::string * t_ir = nullptr)
+    : failed_(t_failed), simulation_(t_simulation), ir_(t_ir) {}
+
+ protected:
+  void EndSourceFileAction() override {
+    clang::EmitLLVMOnlyAction::EndSourceFileAction();
+    std::unique_ptr<llvm::Module> module(takeModule());
+    if (not module) return;
+
+    llvm::legacy::PassManager pass_manager;
+    pass_manager.add(llvm::createPromoteMemoryToRegisterPass());
+    pass_manager.add(llvm::createUnifyFunctionExitNodesPass());
+    if (ir_ == nullptr) {
+      pass_manager.add(new InstrProgDeps());
+      pass_manager.add(new BoundedLoopUnroll());
+      pass_manager.add(new IfConversion());
+      pass_manager.add(new PipelineSimulation(simulation_));
+    }
+    pass_manager.add(new AtomicStateLowering());
+    try {
+      pass_manager.run(*module);
+      if (ir_ != nullptr) {
+        llvm::raw_string_ostream out(*ir_);
+        module->print(out, nullptr);
+      }
+    } catch (const std::exception & e) {
+      llvm::errs() << "Analysis pipeline failed on " << getCurrentFile() << ": " << e.what();
+      failed_ = true;
+    }
+  }
+
+ private:
+  /// Set if a pass threw
+  bool & failed_;
+
+  /// What PipelineSimulation simulates
+  SimulationOptions simulation_;
+
+  /// Where to print the lowered module, nullptr to run the analysis pipeline
+  std::string * ir_;
+};
+
+bool run_analysis_pipeline(const std::string & file_name,
+                           const std::string & source,
+                           const std::vector<std::string> & args,
+                           const SimulationOptions & simulation) {
+  // runToolOnCodeWithArgs takes ownership of the action
+  bool failed = false;
+  const bool compiled = clang::tooling::runToolOnCodeWithArgs(new AnalyzeLLVMAction(failed, simulation), source, args, file_name);
+  return compiled and not failed;
+}
+
+bool lower_shared_state(const std::string & file_name,
+                        const std::string & source,
+                        const std::vector<std::string> & args,
+                        std::string & ir) {
+  bool failed = false;
+  const bool compiled = clang::tooling::runToolOnCodeWithArgs(new AnalyzeLLVMAction(failed, SimulationOptions(), &ir), source, args, file_name);
+  return compiled and not failed;
+}
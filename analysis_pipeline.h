@@ -0,0 +1,33 @@
+#ifndef ANALYSIS_PIPELINE_H_
+#define ANALYSIS_PIPELINE_H_
+
+#include <string>
+#include <vector>
+#include "pipeline_simulator.h"
+
+/// Compile source to LLVM IR in memory, as if it were the contents of file_name,
+/// and hand the module straight to a PassManager running
+/// mem2reg, UnifyFunctionExitNodes, InstrProgDeps, BoundedLoopUnroll, IfConversion,
+/// PipelineSimulation and AtomicStateLowering.
+/// source is a packet program as written, not the output of the source transforms:
+/// add_pkt_processing_loop's loop never exits, and InstrProgDeps needs a return
+/// and IfConversion rejects loops that BoundedLoopUnroll can't remove.
+/// args are extra compiler flags, and simulation says what PipelineSimulation simulates.
+/// No processes are forked and no files written.
+/// Returns false if source fails to compile or a pass rejects it.
+bool run_analysis_pipeline(const std::string & file_name,
+                           const std::string & source,
+                           const std::vector<std::string> & args,
+                           const SimulationOptions & simulation = SimulationOptions());
+
+/// Compile source, a program transformed with shards, to LLVM IR in memory
+/// and make its updates of state shared between shards safe with AtomicStateLowering,
+/// after mem2reg and UnifyFunctionExitNodes. The lowered module is printed to ir,
+/// as LLVM assembly, to compile and link with the runtime instead of the transformed C.
+/// Returns false if source fails to compile or the pass rejects it.
+bool lower_shared_state(const std::string & file_name,
+                        const std::string & source,
+                        const std::vector<std::string> & args,
+                        std::string & ir);
+
+#endif  // ANALYSIS_PIPELINE_H_
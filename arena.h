@@ -0,0 +1,117 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+/// Bump-pointer arena: allocations are never freed individually,
+/// release() frees everything allocated so far in one go.
+class Arena {
+ public:
+  Arena() {}
+
+  /// Delete copy constructor and copy assignment, blocks are owned by exactly one arena
+  Arena(const Arena &) = delete;
+  Arena & operator=(const Arena &) = delete;
+
+  /// Allocate bytes aligned to alignment from the current block,
+  /// starting a new block if it doesn't fit. Blocks come from new[],
+  /// so they are suitably aligned for any fundamental type.
+  void * allocate(const size_t bytes, const size_t alignment) {
+    auto aligned = (offset_ + alignment - 1) & ~(alignment - 1);
+    if (blocks_.empty() or aligned + bytes > block_size_) {
+      // Oversized requests get a block of their own
+      block_size_ = bytes > kBlockSize ? bytes : kBlockSize;
+      blocks_.emplace_back(new char[block_size_]);
+      aligned = 0;
+    }
+    offset_ = aligned + bytes;
+    bytes_allocated_ += bytes;
+    return blocks_.back().get() + aligned;
+  }
+
+  /// Free all blocks at once
+  void release() {
+    blocks_.clear();
+    offset_ = 0;
+    block_size_ = 0;
+    bytes_allocated_ = 0;
+  }
+
+  /// Total bytes handed out since the last release
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+  /// Arena that ArenaAllocators constructed on this thread allocate from,
+  /// nullptr means they fall back to the heap
+  static Arena * & current() {
+    static thread_local Arena * current_arena = nullptr;
+    return current_arena;
+  }
+
+ private:
+  /// Default block size
+  static const size_t kBlockSize = 64 * 1024;
+
+  /// Blocks allocated so far, the last one is the current one
+  std::vector<std::unique_ptr<char[]>> blocks_ = {};
+
+  /// Offset of the first free byte and size of the current block
+  size_t offset_ = 0;
+  size_t block_size_ = 0;
+
+  /// Bytes handed out since the last release
+  size_t bytes_allocated_ = 0;
+};
+
+/// RAII helper to make an arena current for the enclosing scope
+class ArenaScope {
+ public:
+  explicit ArenaScope(Arena & arena) : previous_(Arena::current()) { Arena::current() = &arena; }
+  ~ArenaScope() { Arena::current() = previous_; }
+
+  /// Delete copy constructor and copy assignment to shut up effc++
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope & operator=(const ArenaScope &) = delete;
+
+ private:
+  Arena * previous_;
+};
+
+/// Standard allocator that draws from the arena current
+/// at the time of its construction, or from the heap if there was none.
+/// Containers copy into the arena current at the time of the copy.
+template <class T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  ArenaAllocator() : arena_(Arena::current()) {}
+  ArenaAllocator(const ArenaAllocator &) = default;
+  ArenaAllocator & operator=(const ArenaAllocator &) = default;
+  template <class U> ArenaAllocator(const ArenaAllocator<U> & other) : arena_(other.arena()) {}
+
+  T * allocate(const size_t n) {
+    return static_cast<T *>(arena_ != nullptr ? arena_->allocate(n * sizeof(T), alignof(T))
+                                              : ::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T * p, const size_t) {
+    if (arena_ == nullptr) ::operator delete(p);
+  }
+
+  ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+
+  Arena * arena() const { return arena_; }
+
+  friend bool operator==(const ArenaAllocator & a, const ArenaAllocator & b) { return a.arena_ == b.arena_; }
+  friend bool operator!=(const ArenaAllocator & a, const ArenaAllocator & b) { return a.arena_ != b.arena_; }
+
+ private:
+  Arena * arena_;
+};
+
+#endif  // ARENA_H_
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <set>
+#include <vector>
+#include "llvm/Analysis/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "utility_functions.h"
+#include "analysis_output.h"
+#include "instr_prog_deps.h"
+#include "atomic_state_lowering.h"
+
+using namespace llvm;
+
+/// Replicas get a cache line each, so that shards don't false-share them
+static const uint64_t kCacheLineBytes = 64;
+
+/// Whether value is computed from instruction within instruction's basic block
+static bool depends_on(const Value * value, const Instruction * instruction) {
+  if (value == instruction) return true;
+  const auto * user = dyn_cast<Instruction>(value);
+  if (user == nullptr or user->getParent() != instruction->getParent() or isa<PHINode>(user)) return false;
+  return std::any_of(user->op_begin(), user->op_end(), [instruction] (const Use & operand)
+                     { return depends_on(operand.get(), instruction); });
+}
+
+/// Whether func returns, which InstrProgDeps needs;
+/// add_pkt_processing_loop's loop, e.g., never exits
+static bool returns(const Function & func) {
+  return std::any_of(func.begin(), func.end(), [] (const BasicBlock & bb) { return isa<ReturnInst>(bb.getTerminator()); });
+}
+
+/// Calls of the runtime's jayhawk_lock() and jayhawk_unlock() in func,
+/// e.g., the source-level lock around bursts touching shared state
+static std::vector<CallInst *> lock_calls(Function & func) {
+  std::vector<CallInst *> ret;
+  for (auto & bb : func) {
+    for (auto & instr : bb) {
+      auto * call = dyn_cast<CallInst>(&instr);
+      const auto * callee = call == nullptr ? nullptr : call->getCalledFunction();
+      if (callee != nullptr and (callee->getName() == "jayhawk_lock" or callee->getName() == "jayhawk_unlock")) ret.emplace_back(call);
+    }
+  }
+  return ret;
+}
+
+/// Blocks of the bodies of func's loops, found from the back edges:
+/// everything that reaches a back edge's source without going through its target
+static std::set<const BasicBlock *> loop_blocks(const Function & func) {
+  SmallVector<std::pair<const BasicBlock *, const BasicBlock *>, 8> back_edges;
+  FindFunctionBackedges(func, back_edges);
+  std::set<const BasicBlock *> ret;
+  for (const auto & back_edge : back_edges) {
+    std::set<const BasicBlock *> body = {back_edge.second};
+    std::vector<const BasicBlock *> work_list = {back_edge.first};
+    while (not work_list.empty()) {
+      const auto * bb = work_list.back();
+      work_list.pop_back();
+      if (not body.insert(bb).second) continue;
+      for (auto pred = pred_begin(bb); pred != pred_end(bb); ++pred) work_list.emplace_back(*pred);
+    }
+    ret.insert(body.begin(), body.end());
+  }
+  return ret;
+}
+
+bool AtomicStateLowering::runOnModule(Module & module) {
+  replicated_.clear();
+
+  // Modules generated with -shards have a thread-local shard id and a shard count
+  shard_id_ = module.getGlobalVariable("shard__id", true);
+  if (shard_id_ != nullptr and not shard_id_->isThreadLocal()) shard_id_ = nullptr;
+  num_shards_ = 0;
+  const auto * num_shards = module.getGlobalVariable("jayhawk_num_shards");
+  if (num_shards != nullptr and num_shards->hasInitializer()) {
+    if (const auto * value = dyn_cast<ConstantInt>(num_shards->getInitializer())) num_shards_ = value->getZExtValue();
+  }
+
+  // Classify everything before changing anything, replicas need to see every update of a global
+  ModuleUpdates updates;
+  for (auto & func : module) {
+    if (func.isDeclaration()) continue;
+    if (returns(func)) {
+      updates.emplace_back(&func, find_updates(func));
+    } else if (AnalysisOutput::enabled(Verbosity::kSummary)) {
+      AnalysisOutput::stream() << "AtomicStateLowering: " << func.getName().str() << " never returns, left as is\n";
+    }
+  }
+  pick_replicas(module, updates);
+
+  bool modified = false;
+  for (auto & function_updates : updates) {
+    auto & func = *function_updates.first;
+    const auto & func_updates = function_updates.second;
+    if (func_updates.empty()) continue;
+    modified = true;
+
+    // One update that needs the lock serializes the whole function,
+    // unless the source already holds the lock around everything it does with shared state
+    const auto source_lock = lock_calls(func);
+    if (std::any_of(func_updates.begin(), func_updates.end(), [] (const StateUpdate & update)
+                    { return update.lowering == Lowering::kLock; })) {
+      if (AnalysisOutput::enabled(Verbosity::kSummary)) {
+        AnalysisOutput::stream() << "AtomicStateLowering: " << func.getName().str()
+                                 << (source_lock.empty() ? " locks shared state\n" : " keeps its lock\n");
+      }
+      if (source_lock.empty()) lower_lock(func);
+      continue;
+    }
+
+    // Every update is safe without the lock now, so the source's lock only costs contention
+    for (auto * call : source_lock) call->eraseFromParent();
+    if (not source_lock.empty() and AnalysisOutput::enabled(Verbosity::kSummary)) {
+      AnalysisOutput::stream() << "AtomicStateLowering: " << func.getName().str() << " no longer needs its lock\n";
+    }
+
+    for (const auto & update : func_updates) {
+      switch (update.lowering) {
+        case Lowering::kAtomicAccess:   lower_atomic_access(update); break;
+        case Lowering::kReplica:        lower_replica(update, replicated_.at(const_cast<GlobalVariable *>(accessed_global(update.load))).replicas); break;
+        case Lowering::kAtomicRmw:      lower_atomic_rmw(update); break;
+        case Lowering::kCompareAndSwap: lower_compare_and_swap(update); break;
+        case Lowering::kLock:           llvm_unreachable("Locked functions aren't lowered update by update");
+      }
+    }
+  }
+
+  if (not replicated_.empty()) create_merge_function(module);
+  return modified;
+}
+
+std::vector<AtomicStateLowering::StateUpdate> AtomicStateLowering::find_updates(Function & func) {
+  // Control dependences around a loop put the whole loop body in one SCC,
+  // so in loop bodies an update is what data and memory dependences alone tie together.
+  // Those SCCs are subsets of the PDG's, so each instruction is in exactly one component.
+  const auto & deps = getAnalysis<InstrProgDeps>(func);
+  const auto in_loops = loop_blocks(func);
+  const auto in_loop = [&in_loops] (const Instruction * instr) { return in_loops.find(instr->getParent()) != in_loops.end(); };
+  std::vector<std::vector<const Instruction *>> components;
+  for (const auto & component : deps.pdg().strongly_connected_components()) {
+    if (std::none_of(component.begin(), component.end(), in_loop)) components.emplace_back(component);
+  }
+  if (not in_loops.empty()) {
+    for (const auto & component : (deps.iddg() + deps.imdg()).strongly_connected_components()) {
+      if (std::any_of(component.begin(), component.end(), in_loop)) components.emplace_back(component);
+    }
+  }
+
+  std::vector<StateUpdate> ret;
+  for (const auto & component : components) {
+    // The PDG holds const pointers into func, which this pass may modify
+    std::vector<LoadInst *> loads;
+    std::vector<StoreInst *> stores;
+    for (const auto * instr : component) {
+      if (not is_shared(instr)) continue;
+      if (isa<LoadInst>(instr)) loads.emplace_back(cast<LoadInst>(const_cast<Instruction *>(instr)));
+      else stores.emplace_back(cast<StoreInst>(const_cast<Instruction *>(instr)));
+    }
+    if (loads.empty() and stores.empty()) continue;
+
+    StateUpdate update = {Lowering::kLock, loads.empty() ? nullptr : loads.front(),
+                          stores.empty() ? nullptr : stores.front(), AtomicRMWInst::Xchg, nullptr};
+    if (loads.size() + stores.size() == 1) {
+      // Lone load or store, there's no other access of this global in the function
+      auto * type = update.load != nullptr ? update.load->getType() : update.store->getValueOperand()->getType();
+      if (type->isIntegerTy() or type->isPointerTy()) update.lowering = Lowering::kAtomicAccess;
+    } else if (loads.size() == 1 and stores.size() == 1) {
+      update = classify_update(loads.front(), stores.front());
+    }
+    if (AnalysisOutput::enabled(Verbosity::kResults)) {
+      AnalysisOutput::stream() << "AtomicStateLowering: " << func.getName().str() << ": "
+                               << accessed_global(update.load != nullptr ? static_cast<Instruction *>(update.load) : update.store)->getName().str()
+                               << (update.lowering == Lowering::kAtomicAccess   ? " atomic access\n" :
+                                   update.lowering == Lowering::kAtomicRmw      ? " atomicrmw\n" :
+                                   update.lowering == Lowering::kCompareAndSwap ? " compare-and-swap loop\n" : " needs the lock\n");
+    }
+    ret.emplace_back(update);
+  }
+  return ret;
+}
+
+AtomicStateLowering::StateUpdate AtomicStateLowering::classify_update(LoadInst * load, StoreInst * store) const {
+  StateUpdate ret = {Lowering::kLock, load, store, AtomicRMWInst::Xchg, nullptr};
+
+  // Same address: the same pointer, or two identical getelementptrs
+  const auto * load_pointer  = load->getPointerOperand();
+  const auto * store_pointer = store->getPointerOperand();
+  const bool same_address = load_pointer == store_pointer or
+                            (isa<Instruction>(load_pointer) and isa<Instruction>(store_pointer) and
+                             cast<Instruction>(load_pointer)->isIdenticalTo(cast<Instruction>(store_pointer)));
+  if (not same_address or not load->getType()->isIntegerTy() or
+      load->getParent() != store->getParent() or load->isVolatile() or store->isVolatile()) {
+    return ret;
+  }
+
+  // The load must come first, and nothing in between may write memory
+  // for the update to be retried in a compare-and-swap loop
+  bool writes_between = false;
+  auto it = BasicBlock::iterator(load);
+  for (++it; it != load->getParent()->end() and &*it != store; ++it) {
+    writes_between = writes_between or it->mayWriteToMemory();
+  }
+  if (it == load->getParent()->end()) return ret;
+
+  // g = g op x, possibly computed in a wider type: trunc(op(ext(g), x))
+  auto * value = store->getValueOperand();
+  if (isa<TruncInst>(value) and value->hasOneUse()) value = cast<TruncInst>(value)->getOperand(0);
+  auto * binary_op = dyn_cast<BinaryOperator>(value);
+  if (binary_op != nullptr and binary_op->hasOneUse() and load->hasOneUse()) {
+    static const std::map<Instruction::BinaryOps, AtomicRMWInst::BinOp> rmw_ops = {
+      {Instruction::Add, AtomicRMWInst::Add}, {Instruction::Sub, AtomicRMWInst::Sub},
+      {Instruction::And, AtomicRMWInst::And}, {Instruction::Or, AtomicRMWInst::Or},
+      {Instruction::Xor, AtomicRMWInst::Xor}};
+    const auto rmw_op = rmw_ops.find(binary_op->getOpcode());
+    // x - g isn't g op x
+    const unsigned num_positions = binary_op->isCommutative() ? 2 : 1;
+    for (unsigned i = 0; rmw_op != rmw_ops.end() and i < num_positions; i++) {
+      const Value * state = binary_op->getOperand(i);
+      if ((isa<ZExtInst>(state) or isa<SExtInst>(state)) and state->hasOneUse()) state = cast<CastInst>(state)->getOperand(0);
+      auto * operand = binary_op->getOperand(1 - i);
+      if (state == load and not depends_on(operand, load)) {
+        ret.lowering = Lowering::kAtomicRmw;
+        ret.op = rmw_op->second;
+        ret.operand = operand;
+        return ret;
+      }
+    }
+  }
+
+  if (not writes_between) ret.lowering = Lowering::kCompareAndSwap;
+  return ret;
+}
+
+bool AtomicStateLowering::is_shared(const Instruction * instruction) const {
+  const auto * global = accessed_global(instruction);
+  if (global == nullptr or global->isConstant() or global->isThreadLocal()) return false;
+
+  // Per-flow state of -shards is indexed by the shard id, so each shard has its own
+  const auto * pointer = isa<LoadInst>(instruction) ? cast<LoadInst>(instruction)->getPointerOperand()
+                                                    : cast<StoreInst>(instruction)->getPointerOperand();
+  while (const auto * gep = dyn_cast<GEPOperator>(pointer->stripPointerCasts())) {
+    for (auto index = gep->idx_begin(); index != gep->idx_end(); ++index) {
+      const Value * value = index->get();
+      if (isa<CastInst>(value)) value = cast<CastInst>(value)->getOperand(0);
+      if (shard_id_ != nullptr and isa<LoadInst>(value) and cast<LoadInst>(value)->getPointerOperand() == shard_id_) return false;
+    }
+    pointer = gep->getPointerOperand();
+  }
+  return true;
+}
+
+void AtomicStateLowering::pick_replicas(Module & module, ModuleUpdates & updates) {
+  if (shard_id_ == nullptr or num_shards_ == 0) return;
+
+  // Updates of each scalar global by atomicrmw, and the merge operation they agree on
+  std::map<GlobalVariable *, std::vector<StateUpdate *>> candidates;
+  std::map<GlobalVariable *, Instruction::BinaryOps> merge_ops;
+  std::set<GlobalVariable *> disqualified;
+  std::set<const Value *> covered;
+  for (auto & function_updates : updates) {
+    for (auto & update : function_updates.second) {
+      auto * global = const_cast<GlobalVariable *>(accessed_global(update.load != nullptr ? static_cast<Instruction *>(update.load) : update.store));
+      const auto merge_op = update.op == AtomicRMWInst::Add or update.op == AtomicRMWInst::Sub ? Instruction::Add :
+                            update.op == AtomicRMWInst::And ? Instruction::And :
+                            update.op == AtomicRMWInst::Or  ? Instruction::Or : Instruction::Xor;
+      if (update.lowering != Lowering::kAtomicRmw or update.load->getPointerOperand() != global or
+          (merge_ops.find(global) != merge_ops.end() and merge_ops.at(global) != merge_op)) {
+        disqualified.insert(global);
+        continue;
+      }
+      merge_ops[global] = merge_op;
+      candidates[global].emplace_back(&update);
+      covered.insert(update.load);
+      covered.insert(update.store);
+    }
+  }
+
+  // In module order, so that replicas and the merge function come out the same every time
+  for (auto & global_variable : module.getGlobalList()) {
+    auto * global = &global_variable;
+    if (candidates.find(global) == candidates.end()) continue;
+    // Any other use, e.g., a read in a function that was locked, or taking its address, rules it out
+    if (disqualified.find(global) != disqualified.end() or
+        std::any_of(global->user_begin(), global->user_end(), [&covered] (const User * user)
+                    { return covered.find(user) == covered.end(); })) {
+      continue;
+    }
+
+    const auto op = merge_ops.at(global);
+    auto * type = global->getType()->getElementType();
+    auto * identity = op == Instruction::And ? Constant::getAllOnesValue(type) : Constant::getNullValue(type);
+    auto * replicas = create_replicas(global, identity);
+    replicated_[global] = Replicated{replicas, op, identity};
+    for (auto * update : candidates.at(global)) update->lowering = Lowering::kReplica;
+    if (AnalysisOutput::enabled(Verbosity::kSummary)) {
+      AnalysisOutput::stream() << "AtomicStateLowering: " << global->getName().str() << " replicated across " << num_shards_ << " shards\n";
+    }
+  }
+}
+
+void AtomicStateLowering::lower_atomic_access(const StateUpdate & update) const {
+  // Packets are independent, so relaxed ordering suffices
+  if (update.load != nullptr) update.load->setAtomic(Monotonic);
+  else update.store->setAtomic(Monotonic);
+}
+
+void AtomicStateLowering::lower_replica(const StateUpdate & update, GlobalVariable * replicas) const {
+  auto & context = update.load->getContext();
+  auto * shard = new LoadInst(shard_id_, "shard", update.load);
+  auto * index = CastInst::CreateZExtOrBitCast(shard, Type::getInt64Ty(context), "shard.index", update.load);
+  std::vector<Value *> indices = {ConstantInt::get(Type::getInt64Ty(context), 0), index,
+                                  ConstantInt::get(Type::getInt32Ty(context), 0)};
+  auto * replica = GetElementPtrInst::CreateInBounds(replicas, indices, "replica", update.load);
+
+  // The shard owns its replica, plain loads and stores will do
+  update.load->setOperand(update.load->getPointerOperandIndex(), replica);
+  update.store->setOperand(update.store->getPointerOperandIndex(), replica);
+}
+
+void AtomicStateLowering::lower_atomic_rmw(const StateUpdate & update) const {
+  auto * operand = update.operand;
+  if (operand->getType() != update.load->getType()) {
+    operand = CastInst::CreateTruncOrBitCast(operand, update.load->getType(), "", update.store);
+  }
+  new AtomicRMWInst(update.op, update.load->getPointerOperand(), operand, Monotonic, CrossThread, update.store);
+
+  // The load, the operation and any extension and truncation feed only the store
+  auto * value = update.store->getValueOperand();
+  update.store->eraseFromParent();
+  RecursivelyDeleteTriviallyDeadInstructions(value);
+}
+
+void AtomicStateLowering::lower_compare_and_swap(const StateUpdate & update) const {
+  auto * load  = update.load;
+  auto * store = update.store;
+  auto * pointer = load->getPointerOperand();
+
+  // before: ...            loop: old = phi [initial, before], [seen, loop]
+  //         initial = g          ... new = f(old) ...
+  //         br loop              {seen, success} = cmpxchg g, old, new
+  //                              br success, exit, loop
+  auto * before = load->getParent();
+  auto * loop = before->splitBasicBlock(load, "cas.loop");
+  auto * exit = loop->splitBasicBlock(std::next(BasicBlock::iterator(store)), "cas.exit");
+
+  auto * initial = new LoadInst(pointer, load->getName() + ".initial", false, load->getAlignment(), before->getTerminator());
+  initial->setAtomic(Monotonic);
+  auto * old = PHINode::Create(load->getType(), 2, load->getName() + ".old", load);
+  load->replaceAllUsesWith(old);
+
+  auto * cmpxchg = new AtomicCmpXchgInst(pointer, old, store->getValueOperand(), Monotonic, Monotonic, CrossThread, store);
+  auto * seen = ExtractValueInst::Create(cmpxchg, 0, "cas.seen", store);
+  auto * success = ExtractValueInst::Create(cmpxchg, 1, "cas.success", store);
+  old->addIncoming(initial, before);
+  old->addIncoming(seen, loop);
+
+  loop->getTerminator()->eraseFromParent();
+  BranchInst::Create(exit, loop, success, loop);
+  store->eraseFromParent();
+  load->eraseFromParent();
+}
+
+void AtomicStateLowering::lower_lock(Function & func) const {
+  auto & context = func.getContext();
+  auto * module = func.getParent();
+  auto * lock   = module->getOrInsertFunction("jayhawk_lock", Type::getVoidTy(context), nullptr);
+  auto * unlock = module->getOrInsertFunction("jayhawk_unlock", Type::getVoidTy(context), nullptr);
+
+  // UnifyFunctionExitNodes leaves one return, but don't rely on it
+  CallInst::Create(lock, "", &*func.getEntryBlock().getFirstInsertionPt());
+  for (auto & bb : func) {
+    if (isa<ReturnInst>(bb.getTerminator())) CallInst::Create(unlock, "", bb.getTerminator());
+  }
+}
+
+GlobalVariable * AtomicStateLowering::create_replicas(GlobalVariable * global, Constant * identity) const {
+  auto & context = global->getContext();
+  auto * type = global->getType()->getElementType();
+  const uint64_t bytes = std::max<uint64_t>(1, type->getPrimitiveSizeInBits() / 8);
+  auto * padding = ArrayType::get(Type::getInt8Ty(context), bytes < kCacheLineBytes ? kCacheLineBytes - bytes : 0);
+
+  std::vector<Type *> members = {type, padding};
+  auto * slot_type = StructType::get(context, members);
+  std::vector<Constant *> slot_members = {identity, ConstantAggregateZero::get(padding)};
+  auto * slot = ConstantStruct::get(slot_type, slot_members);
+  auto * array_type = ArrayType::get(slot_type, num_shards_);
+  std::vector<Constant *> slots(num_shards_, slot);
+
+  auto * replicas = new GlobalVariable(*global->getParent(), array_type, false, GlobalValue::InternalLinkage,
+                                       ConstantArray::get(array_type, slots), global->getName() + ".replicas");
+  replicas->setAlignment(kCacheLineBytes);
+  return replicas;
+}
+
+void AtomicStateLowering::create_merge_function(Module & module) const {
+  auto & context = module.getContext();
+  auto * func = Function::Create(FunctionType::get(Type::getVoidTy(context), false), GlobalValue::ExternalLinkage,
+                                 "jayhawk_merge_state", &module);
+  auto * ret = ReturnInst::Create(context, BasicBlock::Create(context, "entry", func));
+
+  // Fold every replica into its global and reset it, with the shards stopped
+  for (auto & global_variable : module.getGlobalList()) {
+    auto * global = &global_variable;
+    if (replicated_.find(global) == replicated_.end()) continue;
+    const auto & replicated = *replicated_.find(global);
+    Value * merged = new LoadInst(global, global->getName() + ".merged", ret);
+    for (uint64_t shard = 0; shard < num_shards_; shard++) {
+      std::vector<Value *> indices = {ConstantInt::get(Type::getInt64Ty(context), 0),
+                                      ConstantInt::get(Type::getInt64Ty(context), shard),
+                                      ConstantInt::get(Type::getInt32Ty(context), 0)};
+      auto * replica = GetElementPtrInst::CreateInBounds(replicated.second.replicas, indices, "replica", ret);
+      merged = BinaryOperator::Create(replicated.second.op, merged, new LoadInst(replica, "", ret), "", ret);
+      new StoreInst(replicated.second.identity, replica, ret);
+    }
+    new StoreInst(merged, global, ret);
+  }
+}
+
+void AtomicStateLowering::getAnalysisUsage(AnalysisUsage & AU) const {
+  AU.addRequired<InstrProgDeps>();
+}
+
+char AtomicStateLowering::ID = 0;
+static RegisterPass<AtomicStateLowering> X("atomic_state_lowering", "Lower updates of shared state to atomics, per-shard replicas or a lock", false, false);
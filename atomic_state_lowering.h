@@ -0,0 +1,105 @@
+#ifndef ATOMIC_STATE_LOWERING_H_
+#define ATOMIC_STATE_LOWERING_H_
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include "llvm/Pass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Instructions.h"
+
+/// LLVM pass to make updates of state shared across packets, i.e., global variables,
+/// safe when several threads run the packet-processing code at once,
+/// e.g., the shards of transform_driver -shards.
+/// Every strongly connected component of InstrProgDeps' PDG that loads and stores
+/// a global is one state update; in loop bodies, which control dependences tie into
+/// one component, it's a component of the data and memory dependences alone.
+/// Each update is lowered to the cheapest safe form:
+/// 1. A replica per shard, merged by jayhawk_merge_state(), for commutative aggregates:
+///    globals only ever updated by g = g op x with one of add/sub, and, or, xor,
+///    and never otherwise read, in modules generated with -shards.
+/// 2. An atomicrmw, i.e., std::atomic's fetch_add and friends, for g = g op x.
+/// 3. A compare-and-swap loop for any other update of one address within one basic block
+///    that doesn't write memory between its load and its store.
+/// 4. Otherwise, jayhawk_lock() at the start of the function and jayhawk_unlock() at its end,
+///    unless the function already calls them, e.g., around bursts touching shared state.
+///    A function whose updates all have cheaper forms drops such calls instead.
+/// Global loads and stores outside updates become relaxed atomic loads and stores.
+/// Functions that never return, which InstrProgDeps can't analyze, are left as they are.
+/// Run after IfConversion: compare-and-swap loops are loops.
+struct AtomicStateLowering : public llvm::ModulePass {
+ public:
+  static char ID;
+  AtomicStateLowering() : llvm::ModulePass(ID) {}
+
+  /// Delete copy constructor and copy assignment, passes aren't copied
+  AtomicStateLowering(const AtomicStateLowering &) = delete;
+  AtomicStateLowering & operator=(const AtomicStateLowering &) = delete;
+
+  /// Classify updates in every function, then lower them
+  bool runOnModule(llvm::Module & module) override;
+
+  /// State updates come from the SCCs of InstrProgDeps' PDG
+  void getAnalysisUsage(llvm::AnalysisUsage & AU) const override;
+
+ private:
+  /// How an access or update of shared state is lowered
+  enum class Lowering { kAtomicAccess, kReplica, kAtomicRmw, kCompareAndSwap, kLock };
+
+  /// An access of shared state: a lone load or store, or a load and a store of one address,
+  /// with the value stored computed as op(load, operand) for kAtomicRmw
+  struct StateUpdate {
+    Lowering lowering;
+    llvm::LoadInst * load;
+    llvm::StoreInst * store;
+    llvm::AtomicRMWInst::BinOp op;
+    llvm::Value * operand;
+  };
+
+  /// State updates of each function, in module order
+  typedef std::vector<std::pair<llvm::Function *, std::vector<StateUpdate>>> ModuleUpdates;
+
+  /// Find the state updates of one function in the SCCs of its PDG
+  std::vector<StateUpdate> find_updates(llvm::Function & func);
+
+  /// Classify a load and a store of the same shared global
+  StateUpdate classify_update(llvm::LoadInst * load, llvm::StoreInst * store) const;
+
+  /// Whether instruction accesses a global that other threads may access too
+  bool is_shared(const llvm::Instruction * instruction) const;
+
+  /// Promote updates of globals that can be replicated from kAtomicRmw to kReplica
+  /// and create their replicas
+  void pick_replicas(llvm::Module & module, ModuleUpdates & updates);
+
+  /// Lower one update
+  void lower_atomic_access(const StateUpdate & update) const;
+  void lower_replica(const StateUpdate & update, llvm::GlobalVariable * replicas) const;
+  void lower_atomic_rmw(const StateUpdate & update) const;
+  void lower_compare_and_swap(const StateUpdate & update) const;
+
+  /// Bracket func with jayhawk_lock() and jayhawk_unlock()
+  void lower_lock(llvm::Function & func) const;
+
+  /// Per-shard copies of a global, one cache line each, initialized to identity
+  llvm::GlobalVariable * create_replicas(llvm::GlobalVariable * global, llvm::Constant * identity) const;
+
+  /// Generate jayhawk_merge_state(), which folds every replica into its global and resets it
+  void create_merge_function(llvm::Module & module) const;
+
+  /// Thread-local shard id and number of shards of a module generated with -shards,
+  /// nullptr and 0 otherwise
+  llvm::GlobalVariable * shard_id_ = nullptr;
+  uint64_t num_shards_ = 0;
+
+  /// Replicated globals: replicas, operation to merge with and identity
+  struct Replicated {
+    llvm::GlobalVariable * replicas;
+    llvm::Instruction::BinaryOps op;
+    llvm::Constant * identity;
+  };
+  std::map<llvm::GlobalVariable *, Replicated> replicated_ = {};
+};
+
+#endif  // ATOMIC_STATE_LOWERING_H_
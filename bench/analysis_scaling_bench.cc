@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "graph.cc"
+#include "dominator_utility.cc"
+#include "cfg_generators.h"
+
+/// Wall-clock scaling of the dominator, control dependence and strongly connected
+/// component analyses on the cfg_generators shapes: best of three times at n and 8n,
+/// and their ratio, which is 8 for linear analyses and 64 for quadratic ones.
+/// make check asserts sub-quadratic growth on comparison counts instead, which don't
+/// depend on the machine (tests/analysis_scaling.cc).
+/// Usage: analysis_scaling_bench [n]
+
+/// Results of analyses go here, so that they can't be optimized away
+static volatile size_t sink = 0;
+
+/// Best of three wall-clock times of analysis on cfg, in seconds
+static double time_analysis(const SyntheticCfg & cfg, const std::function<size_t(const SyntheticCfg &)> & analysis) {
+  double best = 0;
+  for (int run = 0; run < 3; run++) {
+    const auto start = std::chrono::steady_clock::now();
+    sink = sink + analysis(cfg);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = (run == 0) ? elapsed.count() : std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+/// Dominator tree and dominance frontiers
+static size_t dominators(const SyntheticCfg & cfg) {
+  const DominatorUtility<int> dominator_utility(cfg.graph, cfg.entry);
+  return dominator_utility.dominance_frontier().size() + dominator_utility.dominator_tree().node_set().size();
+}
+
+/// Control dependence graph, as in InstrProgDeps: post-dominance frontiers
+/// of a CFG with an entry node branching to the entry and the exit
+static size_t control_dependences(const SyntheticCfg & cfg) {
+  auto augmented = cfg.graph;
+  const int entry = static_cast<int>(augmented.node_set().size());
+  augmented.add_node(entry);
+  augmented.add_edge(entry, cfg.entry);
+  augmented.add_edge(entry, cfg.exit);
+  Graph<int> cdg = augmented.copy_and_clear();
+  for (const auto & y : DominatorUtility<int>(augmented.transpose(), cfg.exit).dominance_frontier()) {
+    for (const auto & x : y.second) cdg.add_edge(x, y.first);
+  }
+  return cdg.node_set().size();
+}
+
+/// Strongly connected components, as for the PDG
+static size_t components(const SyntheticCfg & cfg) { return cfg.graph.strongly_connected_components().size(); }
+
+int main(int argc, const char ** argv) {
+  const int n = argc > 1 ? std::stoi(argv[1]) : 1000;
+  const std::vector<std::pair<std::string, std::function<SyntheticCfg(int)>>> shapes = {
+    {"if_else_ladder", if_else_ladder},
+    {"diamond_chain", diamond_chain},
+    {"switch_fanout", switch_fanout},
+    {"irreducible_regions", irreducible_regions},
+    {"loop_nest", loop_nest},
+    {"random_reducible_cfg", [] (const int size) { return random_reducible_cfg(size, 1); }}};
+  const std::vector<std::pair<std::string, std::function<size_t(const SyntheticCfg &)>>> analyses = {
+    {"dominators", dominators},
+    {"control_dependences", control_dependences},
+    {"components", components}};
+
+  for (const auto & analysis : analyses) {
+    for (const auto & shape : shapes) {
+      const auto small = time_analysis(shape.second(n), analysis.second);
+      const auto large = time_analysis(shape.second(8 * n), analysis.second);
+      std::cout << analysis.first << " " << shape.first << ": n=" << n << " " << small * 1e3 << " ms, n=" << 8 * n
+                << " " << large * 1e3 << " ms, ratio " << large / std::max(small, 1e-9) << "\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include <chrono>
+#include <random>
+#include <string>
+#include <iostream>
+#include "guard_evaluator.h"
+
+/// Time batch evaluation of a random guard against evaluating it one packet at a time
+/// Usage: guard_evaluator_bench [num_packets] [num_clauses] [literals_per_clause]
+int main(int argc, const char ** argv) {
+  const size_t num_packets = argc > 1 ? std::stoul(argv[1]) : 1 << 20;
+  const size_t num_clauses = argc > 2 ? std::stoul(argv[2]) : 4;
+  const size_t num_literals = argc > 3 ? std::stoul(argv[3]) : 4;
+  const size_t num_conditions = 16;
+  const int repetitions = 20;
+
+  std::mt19937 generator(42);
+  std::vector<std::string> conditions;
+  for (size_t i = 0; i < num_conditions; i++) conditions.emplace_back("%cond" + std::to_string(i));
+
+  Dnf guard;
+  for (size_t i = 0; i < num_clauses; i++) {
+    std::vector<Atom> atoms;
+    for (size_t j = 0; j < num_literals; j++) atoms.emplace_back(conditions.at(generator() % num_conditions), generator() % 2 == 1);
+    guard += Conjunction(atoms);
+  }
+
+  ConditionBatch batch(conditions, num_packets);
+  for (size_t column = 0; column < num_conditions; column++) {
+    for (size_t packet = 0; packet < num_packets; packet++) batch.set(column, packet, generator() % 2 == 1);
+  }
+  const GuardEvaluator evaluator(guard, conditions);
+
+  // Batch evaluation
+  std::vector<uint64_t> masks;
+  const auto batch_start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++) evaluator.evaluate(batch, masks);
+  const std::chrono::duration<double, std::nano> batch_time = std::chrono::steady_clock::now() - batch_start;
+
+  // One packet at a time
+  size_t matches = 0;
+  const auto scalar_start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    for (size_t packet = 0; packet < num_packets; packet++) matches += evaluator.evaluate(batch, packet);
+  }
+  const std::chrono::duration<double, std::nano> scalar_time = std::chrono::steady_clock::now() - scalar_start;
+
+  size_t batch_matches = 0;
+  for (const auto & word : masks) batch_matches += static_cast<size_t>(__builtin_popcountll(word));
+  if (batch_matches * repetitions != matches) {
+    std::cerr << "Batch and per-packet evaluation disagree\n";
+    return 1;
+  }
+
+  const double packets = static_cast<double>(num_packets) * repetitions;
+#ifdef __AVX2__
+  std::cout << "guard_evaluator (AVX2): ";
+#else
+  std::cout << "guard_evaluator (64-bit words): ";
+#endif
+  std::cout << num_clauses << " clauses x " << num_literals << " literals, " << num_packets << " packets\n";
+  std::cout << "  batch:      " << batch_time.count() / packets << " ns/packet, "
+            << packets / batch_time.count() * 1e9 << " packets/sec\n";
+  std::cout << "  per packet: " << scalar_time.count() / packets << " ns/packet, "
+            << packets / scalar_time.count() * 1e9 << " packets/sec\n";
+  return 0;
+}
@@ -0,0 +1,332 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "graph.cc"
+#include "dominator_utility.cc"
+#include "set_idioms.h"
+#include "boolean_algebra.h"
+#include "instrumentation.h"
+#include "graph_serialization.h"
+
+/// Microbenchmarks of Graph, set_idioms, DominatorUtility and boolean_algebra
+/// on synthetic inputs of 10 to 100k nodes, reporting ns/op, heap allocations
+/// and bytes per op and peak RSS, optionally as JSON to compare versions.
+/// Usage: microbenchmarks [-json FILE] [-filter SUBSTRING] [-max_nodes N] [-min_time SECONDS]
+
+/// Heap allocations and bytes allocated by this process, counted by the operator new below
+static size_t num_allocations = 0;
+static size_t bytes_allocated = 0;
+
+/// Not inlined, so that the compiler doesn't see malloc() paired with operator delete
+__attribute__((noinline)) void * operator new(const size_t size) {
+  num_allocations++;
+  bytes_allocated += size;
+  void * ret = std::malloc(size == 0 ? 1 : size);
+  if (ret == nullptr) throw std::bad_alloc();
+  return ret;
+}
+
+__attribute__((noinline)) void operator delete(void * pointer) noexcept { std::free(pointer); }
+__attribute__((noinline)) void operator delete(void * pointer, size_t) noexcept { std::free(pointer); }
+
+/// Results of benchmarked operations go here, so that they can't be optimized away
+static volatile size_t sink = 0;
+
+/// One timed run of a benchmark: untimed preparation, if any,
+/// and the operations to time, which return how many calls of the benchmarked operation they made
+struct TimedCase {
+  std::function<void()> prepare;
+  std::function<size_t()> run;
+};
+
+/// A benchmark: builds the case for an input of a given number of nodes.
+/// max_nodes keeps benchmarks that scale badly off the largest inputs.
+struct Microbenchmark {
+  std::string name;
+  size_t max_nodes;
+  std::function<TimedCase(size_t)> make_case;
+};
+
+/// Result of one benchmark on one input size
+struct Measurement {
+  std::string name;
+  size_t nodes;
+  size_t iterations;
+  size_t ops;
+  double ns_per_op;
+  double allocations_per_op;
+  double bytes_per_op;
+  long peak_rss_kb;
+};
+
+/// Random graph on nodes 0..n-1: a path through all of them, so that every node
+/// is reachable from 0, plus as many random forward and backward edges again.
+/// Edges of avoid are left out, so that the union with avoid has no duplicate edges.
+static Graph<int> random_graph(const size_t n, const unsigned seed, const Graph<int> * avoid = nullptr) {
+  std::mt19937 generator(seed);
+  Graph<int> graph;
+  const auto add_edge = [&graph, avoid] (const int from, const int to) {
+    if (from != to and not graph.exists_edge(from, to) and (avoid == nullptr or not avoid->exists_edge(from, to))) {
+      graph.add_edge(from, to);
+    }
+  };
+  for (size_t i = 0; i < n; i++) graph.add_node(static_cast<int>(i));
+  for (size_t i = 0; i + 1 < n; i++) add_edge(static_cast<int>(i), static_cast<int>(i + 1));
+  for (size_t i = 0; i + 1 < n; i++) add_edge(static_cast<int>(generator() % n), static_cast<int>(generator() % n));
+  return graph;
+}
+
+/// Edges of random_graph(n, seed), for timing add_edge alone
+static std::vector<std::pair<int, int>> random_edges(const size_t n, const unsigned seed) {
+  std::vector<std::pair<int, int>> ret;
+  const auto graph = random_graph(n, seed);
+  for (const auto & node : graph.succ_map()) {
+    for (const auto & neighbor : node.second) ret.emplace_back(node.first, neighbor);
+  }
+  return ret;
+}
+
+/// Control flow graph of n nodes: a chain of if-then-else diamonds from node 0
+static Graph<int> diamond_cfg(const size_t n) {
+  Graph<int> graph;
+  for (size_t i = 0; i < n; i++) graph.add_node(static_cast<int>(i));
+  for (size_t head = 0; head + 3 < n; head += 3) {
+    const auto h = static_cast<int>(head);
+    graph.add_edge(h, h + 1);
+    graph.add_edge(h, h + 2);
+    graph.add_edge(h + 1, h + 3);
+    graph.add_edge(h + 2, h + 3);
+  }
+  for (size_t i = (n - 1) / 3 * 3; i + 1 < n; i++) graph.add_edge(static_cast<int>(i), static_cast<int>(i + 1));
+  return graph;
+}
+
+/// Set of n random ints from [0, 2n), so that two such sets overlap by about half
+static std::set<int> random_set(const size_t n, const unsigned seed) {
+  std::mt19937 generator(seed);
+  std::set<int> ret;
+  while (ret.size() < n) ret.emplace(static_cast<int>(generator() % (2 * n)));
+  return ret;
+}
+
+/// Dnf of n clauses of 3 atoms each over 32 variables, without constants
+static Dnf random_dnf(const size_t n, const unsigned seed) {
+  std::mt19937 generator(seed);
+  Dnf ret;
+  for (size_t i = 0; i < n; i++) {
+    std::vector<Atom> atoms;
+    for (int j = 0; j < 3; j++) atoms.emplace_back("%v" + std::to_string(generator() % 32), generator() % 2 == 1);
+    ret += Conjunction(atoms);
+  }
+  return ret;
+}
+
+static std::vector<Microbenchmark> all_benchmarks() {
+  std::vector<Microbenchmark> ret;
+  const size_t all = SIZE_MAX;
+
+  ret.push_back({"graph/add_edge", all, [] (const size_t n) {
+    auto edges = std::make_shared<std::vector<std::pair<int, int>>>(random_edges(n, 1));
+    auto graph = std::make_shared<Graph<int>>();
+    return TimedCase{[graph, n] () {
+                       *graph = Graph<int>();
+                       for (size_t i = 0; i < n; i++) graph->add_node(static_cast<int>(i));
+                     },
+                     [graph, edges] () {
+                       for (const auto & edge : *edges) graph->add_edge(edge.first, edge.second);
+                       return edges->size();
+                     }};
+  }});
+
+  ret.push_back({"graph/transpose", all, [] (const size_t n) {
+    auto graph = std::make_shared<Graph<int>>(random_graph(n, 1));
+    return TimedCase{{}, [graph] () { sink = graph->transpose().node_set().size(); return size_t(1); }};
+  }});
+
+  ret.push_back({"graph/union", all, [] (const size_t n) {
+    auto a = std::make_shared<Graph<int>>(random_graph(n, 1));
+    auto b = std::make_shared<Graph<int>>(random_graph(n, 2, a.get()));
+    return TimedCase{{}, [a, b] () { sink = (*a + *b).node_set().size(); return size_t(1); }};
+  }});
+
+  // Textual dump against the binary format, which downstream tools load without parsing
+  ret.push_back({"graph/print_text", all, [] (const size_t n) {
+    auto graph = std::make_shared<Graph<int>>(random_graph(n, 1));
+    return TimedCase{{}, [graph] () {
+      std::ostringstream out;
+      out << *graph;
+      sink = out.str().size();
+      return size_t(1);
+    }};
+  }});
+
+  ret.push_back({"graph/write_binary", all, [] (const size_t n) {
+    auto graph = std::make_shared<Graph<int>>(random_graph(n, 1));
+    return TimedCase{{}, [graph] () {
+      std::ostringstream out;
+      write_binary(*graph, out);
+      sink = out.str().size();
+      return size_t(1);
+    }};
+  }});
+
+  ret.push_back({"graph/view_successors", all, [] (const size_t n) {
+    const std::string file_name = "/tmp/microbenchmarks_" + std::to_string(getpid()) + ".jhg";
+    save_binary(random_graph(n, 1), file_name);
+    auto view = std::make_shared<GraphView>(file_name);
+    std::remove(file_name.c_str());
+    return TimedCase{{}, [view] () {
+      size_t edges = 0;
+      for (uint64_t i = 0; i < view->num_nodes(); i++) view->for_each_successor(i, [&edges] (const uint64_t) { edges++; });
+      sink = edges;
+      return size_t(1);
+    }};
+  }});
+
+  ret.push_back({"set_idioms/union", all, [] (const size_t n) {
+    auto a = std::make_shared<std::set<int>>(random_set(n, 1));
+    auto b = std::make_shared<std::set<int>>(random_set(n, 2));
+    return TimedCase{{}, [a, b] () { sink = (*a + *b).size(); return size_t(1); }};
+  }});
+
+  ret.push_back({"set_idioms/difference", all, [] (const size_t n) {
+    auto a = std::make_shared<std::set<int>>(random_set(n, 1));
+    auto b = std::make_shared<std::set<int>>(random_set(n, 2));
+    return TimedCase{{}, [a, b] () { sink = (*a - *b).size(); return size_t(1); }};
+  }});
+
+  ret.push_back({"set_idioms/intersection", all, [] (const size_t n) {
+    auto a = std::make_shared<std::set<int>>(random_set(n, 1));
+    auto b = std::make_shared<std::set<int>>(random_set(n, 2));
+    return TimedCase{{}, [a, b] () { sink = (*a * *b).size(); return size_t(1); }};
+  }});
+
+  ret.push_back({"dominator_utility/construct_with_frontiers", all, [] (const size_t n) {
+    auto cfg = std::make_shared<Graph<int>>(diamond_cfg(n));
+    return TimedCase{{}, [cfg] () {
+      const DominatorUtility<int> dominators(*cfg, 0);
+      sink = dominators.dominance_frontier().size();
+      return size_t(1);
+    }};
+  }});
+
+  ret.push_back({"dnf/and_conjunction", all, [] (const size_t n) {
+    auto dnf = std::make_shared<Dnf>(random_dnf(n, 1));
+    auto conjunction = std::make_shared<Conjunction>(Atom("%w", true));
+    return TimedCase{{}, [dnf, conjunction] () { sink = (*dnf * *conjunction).clauses().size(); return size_t(1); }};
+  }});
+
+  ret.push_back({"dnf/or", all, [] (const size_t n) {
+    auto a = std::make_shared<Dnf>(random_dnf(n, 1));
+    auto b = std::make_shared<Dnf>(random_dnf(n, 2));
+    return TimedCase{{}, [a, b] () { sink = (*a + *b).clauses().size(); return size_t(1); }};
+  }});
+
+  // Clauses without constants stay as they are, so simplifying in place repeats the same work
+  ret.push_back({"dnf/simplify", all, [] (const size_t n) {
+    auto dnf = std::make_shared<Dnf>(random_dnf(n, 1));
+    return TimedCase{{}, [dnf] () { dnf->simplify(); sink = dnf->clauses().size(); return size_t(1); }};
+  }});
+
+  return ret;
+}
+
+/// Run a case until min_seconds have been timed, at least once
+static Measurement measure(const Microbenchmark & benchmark, const size_t nodes, const double min_seconds) {
+  const auto timed_case = benchmark.make_case(nodes);
+  reset_peak_rss();
+  const auto start_allocations = num_allocations;
+  const auto start_bytes = bytes_allocated;
+  std::chrono::duration<double, std::nano> elapsed(0);
+  size_t iterations = 0;
+  size_t ops = 0;
+  size_t untimed_allocations = 0;
+  size_t untimed_bytes = 0;
+  while (iterations == 0 or elapsed.count() < min_seconds * 1e9) {
+    if (timed_case.prepare) {
+      const auto allocations_before = num_allocations;
+      const auto bytes_before = bytes_allocated;
+      timed_case.prepare();
+      untimed_allocations += num_allocations - allocations_before;
+      untimed_bytes += bytes_allocated - bytes_before;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    ops += timed_case.run();
+    elapsed += std::chrono::steady_clock::now() - start;
+    iterations++;
+  }
+
+  const double num_ops = static_cast<double>(std::max<size_t>(ops, 1));
+  return Measurement{benchmark.name, nodes, iterations, ops, elapsed.count() / num_ops,
+                     static_cast<double>(num_allocations - start_allocations - untimed_allocations) / num_ops,
+                     static_cast<double>(bytes_allocated - start_bytes - untimed_bytes) / num_ops,
+                     peak_rss_kb()};
+}
+
+static std::string to_json(const std::vector<Measurement> & measurements) {
+  std::ostringstream out;
+  out << "{\n  \"benchmarks\": [";
+  for (size_t i = 0; i < measurements.size(); i++) {
+    const auto & m = measurements.at(i);
+    out << (i == 0 ? "\n" : ",\n")
+        << "    {\"name\": \"" << m.name << "\", \"nodes\": " << m.nodes << ", \"iterations\": " << m.iterations
+        << ", \"ops\": " << m.ops << ", \"ns_per_op\": " << m.ns_per_op << ", \"allocations_per_op\": " << m.allocations_per_op
+        << ", \"bytes_per_op\": " << m.bytes_per_op << ", \"peak_rss_kb\": " << m.peak_rss_kb << "}";
+  }
+  out << "\n  ]\n}\n";
+  return out.str();
+}
+
+int main(int argc, const char ** argv) {
+  std::string json_file = "";
+  std::string filter = "";
+  size_t max_nodes = 100000;
+  double min_seconds = 0.1;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 == argc) {
+      std::cerr << "Usage: " << argv[0] << " [-json FILE] [-filter SUBSTRING] [-max_nodes N] [-min_time SECONDS]\n";
+      return EXIT_FAILURE;
+    }
+    const std::string value = argv[++i];
+    if (arg == "-json") json_file = value;
+    else if (arg == "-filter") filter = value;
+    else if (arg == "-max_nodes") max_nodes = std::stoul(value);
+    else if (arg == "-min_time") min_seconds = std::stod(value);
+    else {
+      std::cerr << "Unknown option " << arg << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<Measurement> measurements;
+  for (const auto & benchmark : all_benchmarks()) {
+    if (benchmark.name.find(filter) == std::string::npos) continue;
+    for (size_t nodes = 10; nodes <= std::min(max_nodes, benchmark.max_nodes); nodes *= 10) {
+      measurements.emplace_back(measure(benchmark, nodes, min_seconds));
+      const auto & m = measurements.back();
+      std::cout << m.name << " n=" << m.nodes << ": " << m.ns_per_op << " ns/op, "
+                << m.allocations_per_op << " allocations/op, " << m.bytes_per_op << " bytes/op, "
+                << "peak RSS " << m.peak_rss_kb << " kB\n";
+    }
+  }
+
+  if (not json_file.empty()) {
+    std::ofstream out(json_file);
+    out << to_json(measurements);
+    if (not out) {
+      std::cerr << "Could not write " << json_file << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -1,31 +1,61 @@
 #ifndef BOOLEAN_ALGEBRA_H_
 #define BOOLEAN_ALGEBRA_H_
 
+#include <cassert>
+#include <cstdint>
 #include <algorithm>
 #include <ostream>
 #include <vector>
 #include <string>
+#include <map>
+#include <set>
+#include <tuple>
+#include <mutex>
+#include "arena.h"
+
+/// Variable name stored once for the life of the process: Atoms point to it,
+/// so that copying atoms and clauses never allocates outside the arena
+inline const std::string * intern_var_name(const std::string & name) {
+  static std::mutex mutex;
+  static std::set<std::string> names;
+  std::lock_guard<std::mutex> lock(mutex);
+  return &*names.insert(name).first;
+}
 
 // Single atom: Variable or negated variable
 class Atom {
  public:
-  Atom(const std::string & t_name, const bool t_pristine) : var_name_(t_name), pristine_(t_pristine), is_literal_(false), value_(false) {}
+  Atom(const std::string & t_name, const bool t_pristine) : Atom(intern_var_name(t_name), t_pristine) {}
   static Atom make_literal(const bool & t_value) {
-    Atom ret = Atom("LITERAL" + std::to_string(t_value), true);
+    static const std::string * const kNames[2] = {intern_var_name("LITERAL0"), intern_var_name("LITERAL1")};
+    Atom ret = Atom(kNames[t_value], true);
     ret.is_literal_ = true;
     ret.value_ = t_value;
     return ret;
   }
   friend std::ostream & operator<< (std::ostream & out, const Atom & atom) {
-    out << (atom.pristine_ ? atom.var_name_ : ("~" + atom.var_name_));
+    out << (atom.pristine_ ? "" : "~") << *atom.var_name_;
     return out;
   };
 
   /// Check if it's a literal and if so, check if its value matches t_val
   bool is_literal(const bool t_val) const { return is_literal_ ? value_ == t_val : false; }
 
+  /// Check if it's a literal at all
+  bool is_literal() const { return is_literal_; }
+
+  /// Accessors
+  const std::string & var_name() const { return *var_name_; }
+  bool pristine() const { return pristine_; }
+
  private:
-  std::string var_name_;
+  friend class Dnf;
+
+  /// Atom of a name already interned, e.g., another atom's
+  Atom(const std::string * t_name, const bool t_pristine) : var_name_(t_name), pristine_(t_pristine), is_literal_(false), value_(false) {}
+
+  /// Interned, see intern_var_name
+  const std::string * var_name_;
   bool pristine_;
   bool is_literal_;
   bool value_;
@@ -43,6 +73,12 @@ class Conjunction {
 
   explicit Conjunction(const Atom & t_atom) { atoms_.emplace_back(t_atom); }
 
+  /// Construct Conjunction from a non-empty vector of atoms
+  explicit Conjunction(const std::vector<Atom> & t_atoms) : atoms_(t_atoms.begin(), t_atoms.end()) { assert(not atoms_.empty()); }
+
+  /// Accessor for atoms
+  const auto & atoms() const { return atoms_; }
+
   /// Simplify Conjunction by constant folding
   void simplify() {
     // Remove true atoms.
@@ -67,13 +103,21 @@ class Conjunction {
     }
   }
 
-  /// AND of two conjunctions, just concatenate vectors
-  Conjunction operator*(const Conjunction & t_conjunction) const {
-    auto ret(*this);
-    for (const auto & atom : t_conjunction.atoms_) {
-      ret.atoms_.emplace_back(atom);
-    }
-    return ret;
+  /// In-place AND of two conjunctions, just concatenate vectors
+  Conjunction & operator*=(const Conjunction & t_conjunction) {
+    atoms_.insert(atoms_.end(), t_conjunction.atoms_.begin(), t_conjunction.atoms_.end());
+    return *this;
+  }
+
+  /// AND of two conjunctions, copying *this
+  Conjunction operator*(const Conjunction & t_conjunction) const & {
+    Conjunction ret(*this);
+    return std::move(ret *= t_conjunction);
+  }
+
+  /// AND of two conjunctions, reusing *this if it's a temporary
+  Conjunction operator*(const Conjunction & t_conjunction) && {
+    return std::move(*this *= t_conjunction);
   }
 
   friend std::ostream & operator<< (std::ostream & out, const Conjunction & clause) {
@@ -91,7 +135,7 @@ class Conjunction {
   };
 
  private:
-  std::vector<Atom> atoms_ = {};
+  std::vector<Atom, ArenaAllocator<Atom>> atoms_ = {};
 };
 
 /// Disjunctive normal form for Boolean expressions
@@ -126,32 +170,113 @@ class Dnf {
     }
   }
 
+  /// Two-level minimization of the Dnf after constant folding:
+  /// drops contradictory, duplicate and subsumed clauses and
+  /// merges complementary ones, i.e., (a and b) or (a and ~b) is a.
+  /// Exact (Quine-McCluskey, with Petrick's method to pick the fewest primes)
+  /// up to kMaxExactVariables variables, unless Petrick's method outgrows
+  /// kMaxPetrickProducts, when the primes are picked greedily instead;
+  /// Espresso-style expand and irredundant heuristics beyond kMaxExactVariables.
+  void minimize() {
+    simplify();
+    if (is_literal()) return;
+
+    std::vector<const std::string *> var_names;
+    auto cover = to_cover(var_names);
+    cover = (var_names.size() <= kMaxExactVariables) ? quine_mccluskey(cover, var_names.size())
+                                                     : espresso(cover);
+
+    // Translate cubes back into clauses
+    clauses_.clear();
+    for (const auto & cube : cover) {
+      std::vector<Atom> atoms;
+      for (size_t i = 0; i < cube.size(); i++) {
+        if (cube.at(i) != kDontCare) atoms.push_back(Atom(var_names.at(i), cube.at(i) == kPositive));
+      }
+      clauses_.emplace_back(atoms.empty() ? Conjunction(Atom::make_literal(true)) : Conjunction(atoms));
+    }
+    simplify();
+  }
+
+  /// Check if some assignment to the atoms makes the Dnf true,
+  /// i.e., some clause doesn't contain both an atom and its negation
+  bool is_satisfiable() const {
+    auto folded(*this);
+    folded.simplify();
+    if (folded.is_literal()) return folded.is_literal(true);
+    std::vector<const std::string *> var_names;
+    return not folded.to_cover(var_names).empty();
+  }
+
+  /// Check if every assignment to the atoms makes the Dnf true.
+  /// This is a DPLL-style search: split on an atom appearing
+  /// both negated and not negated until no such atom remains.
+  bool is_tautology() const {
+    auto folded(*this);
+    folded.simplify();
+    if (folded.is_literal()) return folded.is_literal(true);
+    std::vector<const std::string *> var_names;
+    return cover_is_tautology(folded.to_cover(var_names));
+  }
+
+  /// Check if Dnf has been folded down to a single literal
+  bool is_literal() const {
+    return clauses_.size() == 1 and clauses_.front().atoms().size() == 1 and clauses_.front().atoms().front().is_literal();
+  }
+
+  /// Check if Dnf has been folded down to a single literal with value t_val
+  bool is_literal(const bool t_val) const { return is_literal() and clauses_.front().is_literal(t_val); }
+
+  /// Accessor for clauses
+  const auto & clauses() const { return clauses_; }
+
   /// OR of Dnf with a Conjunction, just append to vector
-  Dnf operator+(const Conjunction & t_conjunction) const {
-    auto ret(*this);
-    ret.clauses_.emplace_back(t_conjunction);
-    return ret;
+  Dnf & operator+=(const Conjunction & t_conjunction) {
+    clauses_.emplace_back(t_conjunction);
+    return *this;
+  }
+
+  /// OR of Dnf with a temporary Conjunction, moving it in
+  Dnf & operator+=(Conjunction && t_conjunction) {
+    clauses_.emplace_back(std::move(t_conjunction));
+    return *this;
   }
 
   /// OR of 2 Dnfs, just concatenate vectors
-  Dnf operator+(const Dnf & t_dnf) const {
-    auto ret(*this);
-    for (const auto & clause : t_dnf.clauses_) {
-      ret.clauses_.emplace_back(clause);
+  Dnf & operator+=(const Dnf & t_dnf) {
+    clauses_.insert(clauses_.end(), t_dnf.clauses_.begin(), t_dnf.clauses_.end());
+    return *this;
+  }
+
+  /// OR of 2 Dnfs, moving clauses out of a temporary
+  Dnf & operator+=(Dnf && t_dnf) {
+    if (clauses_.empty()) {
+      clauses_ = std::move(t_dnf.clauses_);
+    } else {
+      clauses_.insert(clauses_.end(), std::make_move_iterator(t_dnf.clauses_.begin()),
+                                      std::make_move_iterator(t_dnf.clauses_.end()));
     }
-    return ret;
+    return *this;
   }
 
   /// Use the fact that AND distributes over ORs,
   /// and AND each clause in turn
-  Dnf operator*(const Conjunction & t_conjunction) const {
-    auto ret(*this);
-    for (auto & clause : ret.clauses_) {
-      clause = clause * t_conjunction;
+  Dnf & operator*=(const Conjunction & t_conjunction) {
+    for (auto & clause : clauses_) {
+      clause *= t_conjunction;
     }
-    return ret;
+    return *this;
   }
 
+  /// Copying versions of the above for lvalues,
+  /// and versions that reuse *this for temporaries
+  template <class T>
+  Dnf operator+(T && t_operand) const & { Dnf ret(*this); return std::move(ret += std::forward<T>(t_operand)); }
+  template <class T>
+  Dnf operator+(T && t_operand) && { return std::move(*this += std::forward<T>(t_operand)); }
+  Dnf operator*(const Conjunction & t_conjunction) const & { Dnf ret(*this); return std::move(ret *= t_conjunction); }
+  Dnf operator*(const Conjunction & t_conjunction) && { return std::move(*this *= t_conjunction); }
+
   friend std::ostream & operator<< (std::ostream & out, const Dnf & dnf) {
     if (dnf.clauses_.empty()) {
       return out;
@@ -167,7 +292,287 @@ class Dnf {
   };
 
  private:
-  std::vector<Conjunction> clauses_ = {};
+  /// A cube is a conjunction over all variables in a Dnf, in Espresso's
+  /// positional notation: one of kPositive, kNegative or kDontCare per variable
+  typedef std::vector<char> Cube;
+  enum : char { kPositive = '1', kNegative = '0', kDontCare = '-' };
+
+  /// Largest number of variables for which we run exact minimization,
+  /// Quine-McCluskey enumerates all 2^n minterms
+  static const size_t kMaxExactVariables = 8;
+
+  /// Largest number of partial products Petrick's method keeps
+  /// before falling back to picking primes greedily
+  static const size_t kMaxPetrickProducts = 4096;
+
+  /// Translate constant-folded clauses into cubes, dropping contradictory ones.
+  /// Variables are numbered in order of first appearance in var_names, so that
+  /// translating back lists atoms in the same order as before.
+  /// Names are interned, so variables are told apart by address.
+  std::vector<Cube> to_cover(std::vector<const std::string *> & var_names) const {
+    std::map<const std::string *, size_t> var_index;
+    for (const auto & clause : clauses_) {
+      for (const auto & atom : clause.atoms()) {
+        if (var_index.emplace(atom.var_name_, var_names.size()).second) var_names.emplace_back(atom.var_name_);
+      }
+    }
+
+    std::vector<Cube> cover;
+    for (const auto & clause : clauses_) {
+      Cube cube(var_names.size(), kDontCare);
+      bool contradictory = false;
+      for (const auto & atom : clause.atoms()) {
+        const char value = atom.pristine() ? kPositive : kNegative;
+        auto & position = cube.at(var_index.at(atom.var_name_));
+        if (position != kDontCare and position != value) contradictory = true;
+        position = value;
+      }
+      if (not contradictory) cover.emplace_back(cube);
+    }
+    return cover;
+  }
+
+  /// Check if cube a contains cube b, i.e., every minterm of b is in a
+  static bool contains(const Cube & a, const Cube & b) {
+    for (size_t i = 0; i < a.size(); i++) {
+      if (a.at(i) != kDontCare and a.at(i) != b.at(i)) return false;
+    }
+    return true;
+  }
+
+  /// Cofactor of a cover with respect to a cube: drop cubes that
+  /// conflict with it and free up variables that it specifies
+  static std::vector<Cube> cofactor(const std::vector<Cube> & cover, const Cube & c) {
+    std::vector<Cube> ret;
+    for (const auto & cube : cover) {
+      Cube cofactored(cube);
+      bool conflicts = false;
+      for (size_t i = 0; i < c.size(); i++) {
+        if (c.at(i) == kDontCare) continue;
+        if (cube.at(i) != kDontCare and cube.at(i) != c.at(i)) conflicts = true;
+        cofactored.at(i) = kDontCare;
+      }
+      if (not conflicts) ret.emplace_back(cofactored);
+    }
+    return ret;
+  }
+
+  /// Tautology check by unate recursion: split on a binate variable
+  /// until the cover is unate, at which point it's a tautology
+  /// iff it contains the universal cube
+  static bool cover_is_tautology(const std::vector<Cube> & cover) {
+    if (cover.empty()) return false;
+    const size_t num_vars = cover.front().size();
+    if (std::find(cover.begin(), cover.end(), Cube(num_vars, kDontCare)) != cover.end()) return true;
+
+    for (size_t i = 0; i < num_vars; i++) {
+      const bool has_positive = std::any_of(cover.begin(), cover.end(), [i] (const Cube & cube) { return cube.at(i) == kPositive; });
+      const bool has_negative = std::any_of(cover.begin(), cover.end(), [i] (const Cube & cube) { return cube.at(i) == kNegative; });
+      if (has_positive and has_negative) {
+        Cube split(num_vars, kDontCare);
+        split.at(i) = kPositive;
+        if (not cover_is_tautology(cofactor(cover, split))) return false;
+        split.at(i) = kNegative;
+        return cover_is_tautology(cofactor(cover, split));
+      }
+    }
+    return false;
+  }
+
+  /// Remove duplicate cubes and cubes contained in some other single cube
+  static std::vector<Cube> remove_contained(std::vector<Cube> cover) {
+    std::sort(cover.begin(), cover.end());
+    cover.erase(std::unique(cover.begin(), cover.end()), cover.end());
+    std::vector<Cube> ret;
+    for (size_t i = 0; i < cover.size(); i++) {
+      bool contained = false;
+      for (size_t j = 0; j < cover.size(); j++) {
+        if (i != j and contains(cover.at(j), cover.at(i))) contained = true;
+      }
+      if (not contained) ret.emplace_back(cover.at(i));
+    }
+    return ret;
+  }
+
+  /// Exact minimization: generate all prime implicants from the minterms,
+  /// pick the essential ones and cover the rest with the fewest primes,
+  /// then the fewest literals, by Petrick's method
+  static std::vector<Cube> quine_mccluskey(const std::vector<Cube> & cover, const size_t num_vars) {
+    // An implicant is a (value, mask) pair, set bits in mask are don't cares
+    typedef std::pair<uint32_t, uint32_t> Implicant;
+    const uint32_t num_minterms = 1u << num_vars;
+
+    // Enumerate on-set
+    std::vector<uint32_t> minterms;
+    for (uint32_t m = 0; m < num_minterms; m++) {
+      for (const auto & cube : cover) {
+        bool covered = true;
+        for (size_t i = 0; i < num_vars; i++) {
+          const char bit = ((m >> i) & 1u) ? kPositive : kNegative;
+          if (cube.at(i) != kDontCare and cube.at(i) != bit) covered = false;
+        }
+        if (covered) { minterms.emplace_back(m); break; }
+      }
+    }
+
+    // Repeatedly combine implicants that differ in exactly one bit,
+    // implicants that never combine are prime
+    std::set<Implicant> current;
+    for (const auto & m : minterms) current.emplace(m, 0);
+    std::set<Implicant> primes;
+    while (not current.empty()) {
+      std::set<Implicant> next;
+      std::set<Implicant> combined;
+      for (const auto & a : current) {
+        for (const auto & b : current) {
+          const uint32_t diff = a.first ^ b.first;
+          if (a.second == b.second and a.first < b.first and (diff & (diff - 1)) == 0) {
+            next.emplace(a.first & ~diff, a.second | diff);
+            combined.emplace(a);
+            combined.emplace(b);
+          }
+        }
+      }
+      for (const auto & implicant : current) {
+        if (combined.find(implicant) == combined.end()) primes.emplace(implicant);
+      }
+      current = next;
+    }
+
+    // Cover minterms: essential primes first
+    auto covers = [] (const Implicant & p, const uint32_t m) { return (m & ~p.second) == p.first; };
+    std::set<uint32_t> uncovered(minterms.begin(), minterms.end());
+    std::vector<Implicant> chosen;
+    for (const auto & m : minterms) {
+      std::vector<Implicant> candidates;
+      std::copy_if(primes.begin(), primes.end(), std::back_inserter(candidates),
+                   [&covers, m] (const Implicant & p) { return covers(p, m); });
+      if (candidates.size() == 1 and std::find(chosen.begin(), chosen.end(), candidates.front()) == chosen.end()) {
+        chosen.emplace_back(candidates.front());
+      }
+    }
+    for (const auto & p : chosen) {
+      for (auto it = uncovered.begin(); it != uncovered.end();) it = covers(p, *it) ? uncovered.erase(it) : std::next(it);
+    }
+
+    // Petrick's method: the primes covering each uncovered minterm form a sum,
+    // multiplying out the product of these sums gives every irredundant choice
+    // of primes as a set, here a bitmask over the candidate primes
+    std::vector<Implicant> candidates;
+    for (const auto & p : primes) {
+      if (std::any_of(uncovered.begin(), uncovered.end(), [&covers, &p] (const uint32_t m) { return covers(p, m); })) {
+        candidates.emplace_back(p);
+      }
+    }
+    if (not uncovered.empty() and candidates.size() <= 64) {
+      std::vector<uint64_t> products = {0};
+      for (const auto & m : uncovered) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+          if (covers(candidates.at(i), m)) sum |= uint64_t(1) << i;
+        }
+        std::vector<uint64_t> next;
+        for (const auto & product : products) {
+          if ((product & sum) != 0) {
+            next.emplace_back(product);
+            continue;
+          }
+          for (uint64_t rest = sum; rest != 0; rest &= rest - 1) next.emplace_back(product | (rest & (~rest + 1)));
+        }
+        products = absorb(next);
+        if (products.size() > kMaxPetrickProducts) break;
+      }
+      if (products.size() <= kMaxPetrickProducts) {
+        // Fewest primes, then fewest literals, i.e., fewest cleared mask bits
+        const auto cost = [&candidates, num_vars] (const uint64_t product) {
+          size_t literals = 0;
+          for (size_t i = 0; i < candidates.size(); i++) {
+            if ((product >> i) & 1u) literals += num_vars - static_cast<size_t>(__builtin_popcount(candidates.at(i).second));
+          }
+          return std::make_tuple(__builtin_popcountll(product), literals, product);
+        };
+        const auto best = *std::min_element(products.begin(), products.end(),
+                                            [&cost] (const uint64_t a, const uint64_t b) { return cost(a) < cost(b); });
+        for (size_t i = 0; i < candidates.size(); i++) {
+          if ((best >> i) & 1u) chosen.emplace_back(candidates.at(i));
+        }
+        uncovered.clear();
+      }
+    }
+
+    // Fallback: the prime covering the most uncovered minterms, preferring fewer literals
+    while (not uncovered.empty()) {
+      const Implicant * best = nullptr;
+      size_t best_count = 0;
+      for (const auto & p : primes) {
+        const auto count = static_cast<size_t>(std::count_if(uncovered.begin(), uncovered.end(),
+                                                             [&covers, &p] (const uint32_t m) { return covers(p, m); }));
+        if (count > best_count or (count == best_count and count > 0 and __builtin_popcount(p.second) > __builtin_popcount(best->second))) {
+          best = &p;
+          best_count = count;
+        }
+      }
+      assert(best != nullptr);
+      chosen.emplace_back(*best);
+      for (auto it = uncovered.begin(); it != uncovered.end();) it = covers(*best, *it) ? uncovered.erase(it) : std::next(it);
+    }
+
+    // Translate back into cubes
+    std::vector<Cube> ret;
+    for (const auto & p : chosen) {
+      Cube cube(num_vars, kDontCare);
+      for (size_t i = 0; i < num_vars; i++) {
+        if (not ((p.second >> i) & 1u)) cube.at(i) = ((p.first >> i) & 1u) ? kPositive : kNegative;
+      }
+      ret.emplace_back(cube);
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+  }
+
+  /// Drop products that contain another one, as sets of primes:
+  /// they cover nothing more and cost more
+  static std::vector<uint64_t> absorb(std::vector<uint64_t> products) {
+    std::sort(products.begin(), products.end(), [] (const uint64_t a, const uint64_t b)
+              { return __builtin_popcountll(a) != __builtin_popcountll(b) ? __builtin_popcountll(a) < __builtin_popcountll(b) : a < b; });
+    products.erase(std::unique(products.begin(), products.end()), products.end());
+    std::vector<uint64_t> ret;
+    for (const auto & product : products) {
+      if (std::none_of(ret.begin(), ret.end(), [product] (const uint64_t kept) { return (kept & product) == kept; })) {
+        ret.emplace_back(product);
+      }
+    }
+    return ret;
+  }
+
+  /// Heuristic minimization in the style of Espresso:
+  /// expand each cube into a prime against the cover,
+  /// then drop cubes that the rest of the cover already contains
+  static std::vector<Cube> espresso(std::vector<Cube> cover) {
+    cover = remove_contained(cover);
+
+    // Expand: raise a literal whenever the larger cube stays inside the cover
+    for (auto & cube : cover) {
+      for (size_t i = 0; i < cube.size(); i++) {
+        if (cube.at(i) == kDontCare) continue;
+        Cube raised(cube);
+        raised.at(i) = kDontCare;
+        if (cover_is_tautology(cofactor(cover, raised))) cube = raised;
+      }
+    }
+    cover = remove_contained(cover);
+
+    // Irredundant: drop cubes covered by the remaining ones
+    for (size_t i = 0; i < cover.size();) {
+      std::vector<Cube> rest(cover);
+      rest.erase(rest.begin() + static_cast<std::ptrdiff_t>(i));
+      if (cover_is_tautology(cofactor(rest, cover.at(i)))) cover = rest;
+      else i++;
+    }
+    return cover;
+  }
+
+  std::vector<Conjunction, ArenaAllocator<Conjunction>> clauses_ = {};
 };
 
 #endif  // BOOLEAN_ALGEBRA_H_
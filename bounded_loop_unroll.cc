@@ -0,0 +1,101 @@
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/UnrollLoop.h"
+#include "bounded_loop_unroll.h"
+
+using namespace llvm;
+
+static cl::opt<unsigned> UnrollBound("unroll_bound", cl::init(16),
+                                     cl::desc("Maximum number of iterations to unroll a loop into"));
+
+bool BoundedLoopUnroll::runOnLoop(Loop * loop, LPPassManager & lpm) {
+  auto & loop_info = getAnalysis<LoopInfo>();
+  auto & scalar_evolution = getAnalysis<ScalarEvolution>();
+
+  if (loop->getLoopLatch() == nullptr or loop->getExitBlock() == nullptr) {
+    errs() << "BoundedLoopUnroll: loop at " << loop->getHeader()->getName()
+           << " needs a single latch and a single exit block, leaving it alone\n";
+    return false;
+  }
+
+  // Statically bounded loop: unroll completely
+  auto * exiting_block = loop->getExitingBlock();
+  const unsigned trip_count = exiting_block != nullptr ? scalar_evolution.getSmallConstantTripCount(loop, exiting_block) : 0;
+  if (trip_count > UnrollBound) {
+    // Cutting the loop short would silently drop iterations every packet runs
+    errs() << "BoundedLoopUnroll: loop at " << loop->getHeader()->getName() << " has trip count " << trip_count
+           << ", more than -unroll_bound " << UnrollBound << ", leaving it alone\n";
+    return false;
+  }
+  if (trip_count != 0) {
+    errs() << "BoundedLoopUnroll: fully unrolling loop at " << loop->getHeader()->getName()
+           << " with trip count " << trip_count << "\n";
+    return UnrollLoop(loop, trip_count, trip_count, false,
+                      scalar_evolution.getSmallConstantTripMultiple(loop, exiting_block),
+                      &loop_info, this, &lpm);
+  }
+
+  // Trip count unknown: unroll to the bound, keeping every exit test,
+  // and cut the remaining back edge into a residual guard
+  errs() << "BoundedLoopUnroll: unrolling loop at " << loop->getHeader()->getName()
+         << " to bound " << UnrollBound << " with a residual guard\n";
+  if (not UnrollLoop(loop, UnrollBound, 0, false, 1, &loop_info, this, &lpm)) {
+    return false;
+  }
+  scalar_evolution.forgetLoop(loop);
+  auto * residual = add_residual_guard(loop);
+
+  // The loop is gone, update LoopInfo and the dominator tree
+  lpm.deleteLoopFromQueue(loop);
+  if (auto * dom_tree_pass = getAnalysisIfAvailable<DominatorTreeWrapperPass>()) {
+    dom_tree_pass->getDomTree().recalculate(*residual->getParent());
+  }
+  return true;
+}
+
+BasicBlock * BoundedLoopUnroll::add_residual_guard(Loop * loop) const {
+  auto * header = loop->getHeader();
+  auto * latch  = loop->getLoopLatch();
+  auto * exit   = loop->getExitBlock();
+  assert(latch != nullptr and exit != nullptr);
+
+  auto * residual = BasicBlock::Create(header->getContext(), "unroll.residual", header->getParent(), exit);
+  BranchInst::Create(exit, residual);
+
+  // Header no longer has the latch as a predecessor
+  header->removePredecessor(latch);
+  auto * latch_terminator = latch->getTerminator();
+  for (unsigned int i = 0; i < latch_terminator->getNumSuccessors(); i++) {
+    if (latch_terminator->getSuccessor(i) == header) {
+      latch_terminator->setSuccessor(i, residual);
+    }
+  }
+
+  // Values leaving the loop past the bound are undef
+  for (auto it = exit->begin(); isa<PHINode>(it); ++it) {
+    auto * phi = cast<PHINode>(it);
+    phi->addIncoming(UndefValue::get(phi->getType()), residual);
+  }
+  return residual;
+}
+
+void BoundedLoopUnroll::getAnalysisUsage(AnalysisUsage & AU) const {
+  AU.addRequired<LoopInfo>();
+  AU.addPreserved<LoopInfo>();
+  AU.addRequiredID(LoopSimplifyID);
+  AU.addPreservedID(LoopSimplifyID);
+  AU.addRequiredID(LCSSAID);
+  AU.addPreservedID(LCSSAID);
+  AU.addRequired<ScalarEvolution>();
+  AU.addPreserved<ScalarEvolution>();
+  AU.addPreserved<DominatorTreeWrapperPass>();
+}
+
+char BoundedLoopUnroll::ID = 0;
+static RegisterPass<BoundedLoopUnroll> X("bounded_loop_unroll", "Unroll loops up to a bound so that IfConversion can handle them", false, false);
@@ -0,0 +1,34 @@
+#ifndef BOUNDED_LOOP_UNROLL_H_
+#define BOUNDED_LOOP_UNROLL_H_
+
+#include "llvm/Pass.h"
+#include "llvm/Analysis/LoopPass.h"
+
+/// LLVM pass to get rid of loops ahead of IfConversion, which only
+/// accepts acyclic function bodies. Loops with a statically known trip count
+/// of at most unroll_bound are unrolled completely; loops with a larger known
+/// trip count are left alone, with a diagnostic, as every packet would run
+/// past the bound. Loops with an unknown trip count are
+/// unrolled unroll_bound times and their remaining back edge is redirected
+/// to a residual block ("unroll.residual") that falls through to the loop exit.
+/// Its path condition is the residual guard: the packet needed more than
+/// unroll_bound iterations and the values leaving the loop along it are undef.
+struct BoundedLoopUnroll : public llvm::LoopPass {
+ public:
+  static char ID;
+  BoundedLoopUnroll() : llvm::LoopPass(ID) {}
+
+  /// Unroll one loop, LPPassManager visits inner loops first
+  bool runOnLoop(llvm::Loop * loop, llvm::LPPassManager & lpm) override;
+
+  /// Unrolling needs loops in simplified and LCSSA form
+  /// and trip counts from ScalarEvolution
+  void getAnalysisUsage(llvm::AnalysisUsage & AU) const override;
+
+ private:
+  /// Redirect back edge of the (already unrolled) loop to a residual block
+  /// between its latch and its unique exit block, returns the residual block
+  llvm::BasicBlock * add_residual_guard(llvm::Loop * loop) const;
+};
+
+#endif  // BOUNDED_LOOP_UNROLL_H_
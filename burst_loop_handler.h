@@ -0,0 +1,196 @@
+#ifndef BURST_LOOP_HANDLER_H_
+#define BURST_LOOP_HANDLER_H_
+
+#include <sstream>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include "clang/Lex/Lexer.h"
+#include "clang/AST/AST.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Tooling/Refactoring.h"
+#include "member_expr_handler.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+
+/// Batched alternative to FunctionDeclHandler followed by PacketProcessingCodeHandler:
+/// each iteration of the packet-processing loop handles a burst of packets.
+/// The loop fetches each burst from jayhawk_next_burst() (see jayhawk_runtime.h)
+/// into the burst buffer, which holds pointers to packets in the runtime's buffers,
+/// and ends with the input. Parsed fields are gathered from the packets into
+/// struct-of-arrays locals, the body runs as a loop over the burst, which the compiler
+/// can vectorize once the body is branch-free, and written fields are scattered
+/// back into the packets, in place, so there is nothing else to drain.
+/// Packets are still processed in order, so state carried across packets behaves as before.
+///
+/// For the harness function, if any, jayhawk_entry() is generated to call it.
+///
+/// With shards, the harness function instead runs once per shard, on its own core,
+/// each instance fetching the packets the runtime steered to it by flow hash.
+/// jayhawk_flow_shard() is generated to compute the shard of a packet by hashing
+/// the shard expression, or the flow key fields if there's no per-flow state,
+/// and jayhawk_shard_entry() to run one shard. Bodies touching shared state
+/// (see StateVarHandler) hold the runtime's lock for each burst.
+class BurstLoopHandler : public MatchFinder::MatchCallback {
+ public:
+  /// Constructor: Pass Refactoring tool, the handler that collected
+  /// the field accesses, configured with the same burst size, the burst size,
+  /// the name of the function to drive from jayhawk_runtime.h, if any,
+  /// and for sharding: the number of shards (0 for none), the flow key fields,
+  /// the shard expression (see StateVarHandler) and whether the harness function touches shared state
+  BurstLoopHandler(Replacements & t_replace, const MemberExprHandler & t_member_expr_handler,
+                   const unsigned t_burst_size, const std::string & t_harness_function = "",
+                   const unsigned t_num_shards = 0, const std::vector<std::string> & t_flow_key = {},
+                   const std::string & t_shard_expression = "", const bool t_shared_state = false)
+    : Replace(t_replace), member_expr_handler_(t_member_expr_handler),
+      burst_size_(t_burst_size), harness_function_(t_harness_function),
+      num_shards_(t_num_shards), flow_key_(t_flow_key), shard_expression_(t_shard_expression),
+      shared_state_(t_shared_state) {}
+
+  /// Thread-local variable holding the id of the shard a thread runs
+  static std::string shard_id() { return "shard__id"; }
+
+  /// Callback whenever there's a match
+  virtual void run(const MatchFinder::MatchResult &Result) override {
+    const FunctionDecl *function_decl_expr = Result.Nodes.getNodeAs<clang::FunctionDecl>("packetProcessingCode");
+    assert(function_decl_expr != nullptr);
+    if (not function_decl_expr->isThisDeclarationADefinition()) return;
+    const auto function_name = function_decl_expr->getNameAsString();
+    const bool harness = (function_name == harness_function_);
+    const auto buffers = member_expr_handler_.burst_buffers(function_name);
+    if (buffers.size() > 1) {
+      throw std::logic_error("Function " + function_name + " must access fields of at most one packet struct to run in bursts\n");
+    }
+    if (not runtime_included_) {
+      add_at_file_start(Result, "#include \"jayhawk_runtime.h\"\n");
+      runtime_included_ = true;
+    }
+
+    // The burst can be cut short by the end of the input
+    const auto index = MemberExprHandler::burst_index();
+    const auto loop_header = "for (unsigned " + index + " = 0; " + index + " < pkt__n; " + index + "++) {\n";
+
+    // Burst buffer, filled from the runtime, then per burst: struct-of-arrays locals,
+    // gather, and the start of the body loop. A function that accesses no fields still
+    // runs once per packet, so it gets a buffer of untyped packet pointers.
+    const auto buffer = buffers.empty() ? std::string("pkt__burst") : buffers.begin()->first;
+    std::string start_text = "\n";
+    start_text += buffers.empty() ? "void * pkt__burst[" + std::to_string(burst_size_) + "];\n" : buffers.begin()->second;
+    const auto fetch = harness and num_shards_ > 0 ? "jayhawk_next_shard_burst(" + shard_id() + ", " : std::string("jayhawk_next_burst(");
+    start_text += "unsigned pkt__n;\n while ((pkt__n = " + fetch + "(void **) " + buffer + ", " + std::to_string(burst_size_) +
+                  ", " + std::to_string(member_expr_handler_.packet_wire_bytes(function_name)) + ")) > 0) {\n";
+    const auto decls = member_expr_handler_.get_decls();
+    if (decls.find(function_name) != decls.end()) {
+      for (const auto & decl : decls.at(function_name)) start_text += "  " + decl;
+    }
+    const auto gather = member_expr_handler_.gather(function_name, index);
+    if (not gather.empty()) start_text += "  " + loop_header + gather + "  }\n";
+    const bool serialize = harness and num_shards_ > 0 and shared_state_;
+    if (serialize) start_text += "  jayhawk_lock();\n";
+    start_text += "  " + loop_header;
+
+    /// Find location just after opening brace of function body
+    auto start_loc = Lexer::getLocForEndOfToken(function_decl_expr->getBody()->getLocStart(), 0, *Result.SourceManager, Result.Context->getLangOpts());
+    Replace.insert(Replacement(*(Result.SourceManager), start_loc, 0, start_text));
+
+    // End of the body loop, scatter, end of the packet-processing loop
+    std::string end_text = "\n  }\n";
+    if (serialize) end_text += "  jayhawk_unlock();\n";
+    const auto scatter = member_expr_handler_.scatter(function_name, index);
+    if (not scatter.empty()) end_text += "  " + loop_header + scatter + "  }\n";
+    end_text += " }\n";
+
+    /// Find location just before closing brace of function body
+    auto end_loc = Lexer::GetBeginningOfToken(function_decl_expr->getBody()->getLocEnd(), *Result.SourceManager, Result.Context->getLangOpts());
+    Replace.insert(Replacement(*(Result.SourceManager), end_loc, 0, end_text));
+
+    if (harness and num_shards_ > 0) add_shard_entry(Result, function_decl_expr);
+    else if (harness) add_harness_entry(Result, function_decl_expr);
+  }
+
+ private:
+  /// Include the runtime interface and define jayhawk_entry() after the harness function,
+  /// calling it with zero-initialized arguments: its parameters stand for the packet,
+  /// which now comes from the runtime
+  void add_harness_entry(const MatchFinder::MatchResult & Result, const FunctionDecl * function_decl) {
+    add_after_function(Result, function_decl, "\n\nvoid jayhawk_entry(void) {\n" + call(function_decl) + "}\n");
+  }
+
+  /// Same for sharding: the thread-local shard id, the flow hash and the per-shard entry point
+  void add_shard_entry(const MatchFinder::MatchResult & Result, const FunctionDecl * function_decl) {
+    add_at_file_start(Result, "static __thread unsigned " + shard_id() + ";\n");
+
+    // The packet is parsed into a struct by the name the shard expression uses for it
+    const auto function_name = function_decl->getNameAsString();
+    const auto packet_type = member_expr_handler_.packet_type(function_name);
+    const auto packet_base = member_expr_handler_.packet_base(function_name);
+    std::string entry = "\n\nconst unsigned jayhawk_num_shards = " + std::to_string(num_shards_) + ";\n"
+                        "const unsigned long jayhawk_packet_size = " +
+                        std::to_string(member_expr_handler_.packet_wire_bytes(function_name)) + ";\n"
+                        "\nunsigned jayhawk_flow_shard(const void * packet) {\n"
+                        "  " + packet_type + " " + packet_base + " = {0};\n";
+    std::istringstream parse(member_expr_handler_.parse_packet(function_name, "(const unsigned char *) packet", packet_base));
+    for (std::string line; std::getline(parse, line);) entry += "  " + line + "\n";
+    entry += "  unsigned hash = JAYHAWK_HASH_SEED;\n";
+    if (not shard_expression_.empty()) {
+      entry += "  hash = jayhawk_hash(hash, (unsigned long long) (" + shard_expression_ + "));\n";
+    } else {
+      for (const auto & field : flow_key_) entry += "  hash = jayhawk_hash(hash, (unsigned long long) " + packet_base + "." + field + ");\n";
+    }
+    entry += "  return hash % jayhawk_num_shards;\n}\n"
+             "\nvoid jayhawk_shard_entry(unsigned shard) {\n"
+             "  " + shard_id() + " = shard;\n" + call(function_decl) + "}\n";
+    add_after_function(Result, function_decl, entry);
+  }
+
+  /// Statements calling function_decl with zero-initialized arguments
+  static std::string call(const FunctionDecl * function_decl) {
+    std::string ret;
+    std::string args;
+    for (unsigned i = 0; i < function_decl->getNumParams(); i++) {
+      const auto arg = "arg" + std::to_string(i);
+      ret += "  " + function_decl->getParamDecl(i)->getType().getAsString() + " " + arg + " = {0};\n";
+      args += (i == 0 ? "" : ", ") + arg;
+    }
+    return ret + "  " + function_decl->getNameAsString() + "(" + args + ");\n";
+  }
+
+  void add_at_file_start(const MatchFinder::MatchResult & Result, const std::string & text) {
+    auto & source_manager = *Result.SourceManager;
+    const auto file_start = source_manager.getLocForStartOfFile(source_manager.getMainFileID());
+    Replace.insert(Replacement(source_manager, file_start, 0, text));
+  }
+
+  void add_after_function(const MatchFinder::MatchResult & Result, const FunctionDecl * function_decl, const std::string & text) {
+    auto after_function = Lexer::getLocForEndOfToken(function_decl->getBody()->getLocEnd(), 0, *Result.SourceManager, Result.Context->getLangOpts());
+    Replace.insert(Replacement(*Result.SourceManager, after_function, 0, text));
+  }
+
+  Replacements & Replace;
+  const MemberExprHandler & member_expr_handler_;
+  unsigned burst_size_;
+
+  /// Function to drive from the runtime, empty if none
+  std::string harness_function_;
+
+  /// Number of shards, 0 if not sharding
+  unsigned num_shards_;
+
+  /// Packet fields hashed to pick a shard if there is no shard expression
+  std::vector<std::string> flow_key_;
+
+  /// Expression of the packet hashed to pick a shard
+  std::string shard_expression_;
+
+  /// Whether the harness function touches state shared between shards
+  bool shared_state_;
+
+  /// Whether the runtime interface has been included
+  bool runtime_included_ = false;
+};
+
+#endif  // BURST_LOOP_HANDLER_H_
@@ -0,0 +1,270 @@
+#ifndef CFG_GENERATORS_H_
+#define CFG_GENERATORS_H_
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include "graph.h"
+
+/// Synthetic control flow shapes for stress testing the analyses on programs
+/// far larger than the textbook examples, each both as a Graph<int>
+/// and as a C packet program in the style of tests/packet.c:
+/// a Packet struct with int fields x, y and z, and void func(Packet p).
+/// Graph's member templates are defined in graph.cc, which users include.
+
+/// A synthetic control flow graph: nodes 0 to num_nodes - 1,
+/// entered at entry, left at exit, which has no successors.
+/// Every node is reachable from entry and reaches exit.
+struct SyntheticCfg {
+  Graph<int> graph;
+  int entry;
+  int exit;
+};
+
+namespace cfg_generators {
+
+/// Graph of num_nodes nodes and the given edges
+inline SyntheticCfg make_cfg(const int num_nodes, const std::vector<std::pair<int, int>> & edges, const int exit) {
+  SyntheticCfg ret = {Graph<int>(), 0, exit};
+  for (int i = 0; i < num_nodes; i++) ret.graph.add_node(i);
+  for (const auto & edge : edges) ret.graph.add_edge(edge.first, edge.second);
+  return ret;
+}
+
+/// Program with body as the body of func
+inline std::string make_program(const std::string & body) {
+  return "typedef struct Packet {\n  int x;\n  int y;\n  int z;\n} Packet;\n\nvoid func(Packet p) {\n" + body + "}\n";
+}
+
+inline void check_size(const int size, const int minimum) {
+  if (size < minimum) throw std::invalid_argument("cfg_generators: size must be at least " + std::to_string(minimum) + "\n");
+}
+
+}  // namespace cfg_generators
+
+/// if ... else if ... else ladder of num_conditions conditions:
+/// a chain of tests, each with its own body, all bodies joining at the exit
+inline SyntheticCfg if_else_ladder(const int num_conditions) {
+  cfg_generators::check_size(num_conditions, 1);
+  // Tests are 0..n-1, bodies n..2n, the last one the final else, and the exit 2n+1
+  const int n = num_conditions;
+  std::vector<std::pair<int, int>> edges;
+  for (int i = 0; i < n; i++) {
+    edges.emplace_back(i, n + i);
+    edges.emplace_back(i, i + 1 < n ? i + 1 : 2 * n);
+  }
+  for (int body = n; body <= 2 * n; body++) edges.emplace_back(body, 2 * n + 1);
+  return cfg_generators::make_cfg(2 * n + 2, edges, 2 * n + 1);
+}
+
+inline std::string if_else_ladder_program(const int num_conditions) {
+  cfg_generators::check_size(num_conditions, 1);
+  std::string body = "  ";
+  for (int i = 0; i < num_conditions; i++) {
+    body += "if (p.x == " + std::to_string(i) + ") {\n    p.y = " + std::to_string(i) + ";\n  } else ";
+  }
+  return cfg_generators::make_program(body + "{\n    p.y = -1;\n  }\n");
+}
+
+/// num_diamonds if-then-else diamonds one after the other
+inline SyntheticCfg diamond_chain(const int num_diamonds) {
+  cfg_generators::check_size(num_diamonds, 1);
+  // Diamond i: head 3i, branches 3i+1 and 3i+2, joining at the next head
+  std::vector<std::pair<int, int>> edges;
+  for (int i = 0; i < num_diamonds; i++) {
+    const int head = 3 * i;
+    edges.insert(edges.end(), {{head, head + 1}, {head, head + 2}, {head + 1, head + 3}, {head + 2, head + 3}});
+  }
+  return cfg_generators::make_cfg(3 * num_diamonds + 1, edges, 3 * num_diamonds);
+}
+
+inline std::string diamond_chain_program(const int num_diamonds) {
+  cfg_generators::check_size(num_diamonds, 1);
+  std::string body;
+  for (int i = 0; i < num_diamonds; i++) {
+    const auto k = std::to_string(i);
+    body += "  if (p.x > " + k + ") {\n    p.y = p.y + " + k + ";\n  } else {\n    p.y = p.y - " + k + ";\n  }\n";
+  }
+  return cfg_generators::make_program(body);
+}
+
+/// switch with num_cases cases and a default, all breaking to the exit
+inline SyntheticCfg switch_fanout(const int num_cases) {
+  cfg_generators::check_size(num_cases, 1);
+  // Head 0, cases 1..n, default n+1, exit n+2
+  std::vector<std::pair<int, int>> edges;
+  for (int i = 1; i <= num_cases + 1; i++) {
+    edges.emplace_back(0, i);
+    edges.emplace_back(i, num_cases + 2);
+  }
+  return cfg_generators::make_cfg(num_cases + 3, edges, num_cases + 2);
+}
+
+inline std::string switch_fanout_program(const int num_cases) {
+  cfg_generators::check_size(num_cases, 1);
+  std::string body = "  switch (p.x) {\n";
+  for (int i = 0; i < num_cases; i++) {
+    body += "    case " + std::to_string(i) + ":\n      p.y = " + std::to_string(i) + ";\n      break;\n";
+  }
+  return cfg_generators::make_program(body + "    default:\n      p.y = -1;\n  }\n");
+}
+
+/// num_regions irreducible regions one after the other: each is a cycle
+/// of two nodes, both entered from the region's head, so neither dominates the other
+inline SyntheticCfg irreducible_regions(const int num_regions) {
+  cfg_generators::check_size(num_regions, 1);
+  // Region i: head 3i, cycle 3i+1 <-> 3i+2, left from 3i+1 to the next head
+  std::vector<std::pair<int, int>> edges;
+  for (int i = 0; i < num_regions; i++) {
+    const int head = 3 * i;
+    edges.insert(edges.end(), {{head, head + 1}, {head, head + 2}, {head + 1, head + 2}, {head + 2, head + 1}, {head + 1, head + 3}});
+  }
+  return cfg_generators::make_cfg(3 * num_regions + 1, edges, 3 * num_regions);
+}
+
+inline std::string irreducible_regions_program(const int num_regions) {
+  cfg_generators::check_size(num_regions, 1);
+  std::string body;
+  for (int i = 0; i < num_regions; i++) {
+    const auto k = std::to_string(i);
+    body += "  if (p.x > " + k + ") goto a" + k + ";\n"
+            "b" + k + ":\n  p.y = p.y + 1;\n  if (p.y > " + k + ") goto t" + k + ";\n"
+            "a" + k + ":\n  p.z = p.z + p.y;\n  if (p.z < 1000) goto b" + k + ";\n"
+            "t" + k + ":\n  ;\n";
+  }
+  return cfg_generators::make_program(body);
+}
+
+/// depth while loops nested in each other, the innermost one around a body
+inline SyntheticCfg loop_nest(const int depth) {
+  cfg_generators::check_size(depth, 1);
+  // Entry 0, headers 1..d, body d+1, exit d+2.
+  // Header i enters loop i+1, whose header goes back to header i when it's done.
+  std::vector<std::pair<int, int>> edges = {{0, 1}, {1, depth + 2}, {depth, depth + 1}, {depth + 1, depth}};
+  for (int i = 1; i < depth; i++) {
+    edges.emplace_back(i, i + 1);
+    edges.emplace_back(i + 1, i);
+  }
+  return cfg_generators::make_cfg(depth + 3, edges, depth + 2);
+}
+
+/// Loop bounds are constants, so BoundedLoopUnroll can unroll them
+inline std::string loop_nest_program(const int depth, const int trip_count = 2) {
+  cfg_generators::check_size(depth, 1);
+  std::string decls = "  int i0";
+  for (int i = 1; i < depth; i++) decls += ", i" + std::to_string(i);
+  std::string body = decls + ";\n";
+  for (int i = 0; i < depth; i++) {
+    const auto var = "i" + std::to_string(i);
+    body += std::string(static_cast<size_t>(2 * i + 2), ' ') + "for (" + var + " = 0; " + var + " < " +
+            std::to_string(trip_count) + "; " + var + "++) {\n";
+  }
+  body += std::string(static_cast<size_t>(2 * depth + 2), ' ') + "p.y = p.y + p.x;\n";
+  for (int i = depth - 1; i >= 0; i--) body += std::string(static_cast<size_t>(2 * i + 2), ' ') + "}\n";
+  return cfg_generators::make_program(body);
+}
+
+/// Random reducible CFG of at least num_nodes nodes, grown from a single edge
+/// entry -> exit by replacing random edges with structured control flow:
+/// a statement in sequence, an if-then, an if-then-else or a while loop.
+/// Replacing an edge with any of these keeps the graph reducible.
+inline SyntheticCfg random_reducible_cfg(const int num_nodes, const unsigned seed) {
+  cfg_generators::check_size(num_nodes, 2);
+  std::mt19937 generator(seed);
+  std::vector<std::pair<int, int>> edges = {{0, 1}};
+  int next_node = 2;
+  while (next_node < num_nodes) {
+    const auto index = generator() % edges.size();
+    const auto from = edges.at(index).first;
+    const auto to = edges.at(index).second;
+    const int a = next_node++;
+    switch (generator() % 4) {
+      case 0:
+        // Sequence: from -> a -> to
+        edges.at(index) = {from, a};
+        edges.emplace_back(a, to);
+        break;
+      case 1:
+        // If-then: from -> a -> to, and from -> to
+        edges.emplace_back(from, a);
+        edges.emplace_back(a, to);
+        break;
+      case 2: {
+        // If-then-else: from -> a -> to, from -> b -> to
+        const int b = next_node++;
+        edges.at(index) = {from, a};
+        edges.insert(edges.end(), {{a, to}, {from, b}, {b, to}});
+        break;
+      }
+      default: {
+        // While loop: from -> header a, a <-> body b, a -> to
+        const int b = next_node++;
+        edges.at(index) = {from, a};
+        edges.insert(edges.end(), {{a, b}, {b, a}, {a, to}});
+        break;
+      }
+    }
+  }
+  // If-thens can repeat an edge from -> to
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+  return cfg_generators::make_cfg(next_node, edges, 1);
+}
+
+/// Random structured packet program of about num_statements statements,
+/// nested at most max_depth deep: assignments, if-thens, if-then-elses
+/// and loops with constant bounds
+inline std::string random_program(const int num_statements, const unsigned seed, const int max_depth = 6) {
+  cfg_generators::check_size(num_statements, 1);
+  std::mt19937 generator(seed);
+  const std::vector<std::string> fields = {"p.x", "p.y", "p.z"};
+  const auto field = [&generator, &fields] () { return fields.at(generator() % fields.size()); };
+
+  // Statements left to generate, and loop counters used
+  int budget = num_statements;
+  int num_counters = 0;
+  std::function<std::string(int)> block = [&] (const int depth) {
+    const std::string indent(static_cast<size_t>(2 * depth + 2), ' ');
+    std::string ret;
+    const int length = 1 + static_cast<int>(generator() % 4);
+    for (int i = 0; i < length and budget > 0; i++) {
+      budget--;
+      // One random draw per statement, so the program only depends on the seed,
+      // not on the order the compiler evaluates operands in
+      const auto kind = depth + 1 < max_depth ? generator() % 4 : 0;
+      const auto lhs = field();
+      const auto rhs = field();
+      const auto constant = std::to_string(generator() % 100);
+      if (kind == 0) {
+        ret += indent + lhs + " = " + rhs + " + " + constant + ";\n";
+        continue;
+      }
+      if (kind == 3) {
+        const auto var = "i" + std::to_string(num_counters++);
+        ret += indent + "for (" + var + " = 0; " + var + " < 2; " + var + "++) {\n";
+      } else {
+        ret += indent + "if (" + lhs + " > " + constant + ") {\n";
+      }
+      ret += block(depth + 1);
+      if (kind == 2) {
+        ret += indent + "} else {\n";
+        ret += block(depth + 1);
+      }
+      ret += indent + "}\n";
+    }
+    // Blocks are never empty
+    return ret.empty() ? indent + "p.z = p.z + 1;\n" : ret;
+  };
+
+  std::string body;
+  while (budget > 0) body += block(0);
+  std::string decls;
+  for (int i = 0; i < num_counters; i++) decls += (i == 0 ? "  int i0" : ", i" + std::to_string(i));
+  return cfg_generators::make_program((num_counters > 0 ? decls + ";\n" : "") + body);
+}
+
+#endif  // CFG_GENERATORS_H_
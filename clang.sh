@@ -20,5 +20,6 @@ g++ --std=c++14 -isystem /usr/lib/llvm-3.5/include/ $@ \
 	-lclangStaticAnalyzerCore \
 	-lclangSerialization \
 	-lclangTooling \
+	-lclangCodeGen \
 	-Wl,--end-group \
 	`llvm-config --ldflags --libs --system-libs`
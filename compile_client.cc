@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "compile_protocol.h"
+
+/// Client for compile_server. Deliberately free of LLVM and clang,
+/// so starting it costs next to nothing.
+static void usage(const std::string & program) {
+  std::cerr << "Usage: " << program << " [-socket PATH] [-analyze] FILE [-- COMPILER FLAGS...]\n";
+}
+
+int main(int argc, const char **argv) {
+  std::string socket_path = "/tmp/jayhawk.sock";
+  CompileRequest request;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "-socket" and i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if (arg == "-analyze") {
+      request.analyze = true;
+    } else if (arg == "--") {
+      request.args.assign(argv + i + 1, argv + argc);
+      break;
+    } else if (request.file_name.empty() and arg.front() != '-') {
+      request.file_name = arg;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (request.file_name.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::ifstream file(request.file_name);
+  if (not file.good()) {
+    std::cerr << "Cannot read " << request.file_name << "\n";
+    return 1;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  request.source = contents.str();
+
+  const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  if (connection < 0 or connect(connection, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+    perror(("compile_client: cannot connect to " + socket_path).c_str());
+    return 1;
+  }
+
+  try {
+    write_request(connection, request);
+    shutdown(connection, SHUT_WR);
+    auto response = read_all(connection);
+    int status = 1;
+    if (not split_response(response, status)) {
+      std::cout << response;
+      std::cerr << "compile_client: server closed the connection without a status\n";
+      return 1;
+    }
+    std::cout << response;
+    return status;
+  } catch (const std::exception & e) {
+    std::cerr << e.what();
+    return 1;
+  }
+}
@@ -0,0 +1,99 @@
+#include <cerrno>
+#include <string>
+#include <stdexcept>
+#include <unistd.h>
+#include "compile_protocol.h"
+
+/// Marker in front of the exit status at the very end of a response
+static const std::string status_marker = "\n#jayhawk-status ";
+
+/// Upper bound on a field's length, anything larger is garbage on the socket
+static const size_t max_field_length = 1 << 28;
+
+/// Write all of data to fd, retrying short writes and interrupted calls
+static void write_bytes(const int fd, const std::string & data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const auto ret = write(fd, data.data() + written, data.size() - written);
+    if (ret < 0 and errno == EINTR) continue;
+    if (ret <= 0) throw std::runtime_error("compile_protocol: write failed\n");
+    written += static_cast<size_t>(ret);
+  }
+}
+
+/// Read exactly length bytes from fd
+static std::string read_bytes(const int fd, const size_t length) {
+  std::string ret(length, '\0');
+  size_t done = 0;
+  while (done < length) {
+    const auto count = read(fd, &ret[done], length - done);
+    if (count < 0 and errno == EINTR) continue;
+    if (count <= 0) throw std::runtime_error("compile_protocol: connection closed in the middle of a request\n");
+    done += static_cast<size_t>(count);
+  }
+  return ret;
+}
+
+static void write_field(const int fd, const std::string & field) {
+  write_bytes(fd, std::to_string(field.size()) + "\n" + field);
+}
+
+static std::string read_field(const int fd) {
+  // Lengths are a handful of digits, so reading them a byte at a time is fine
+  size_t length = 0;
+  for (std::string digit = read_bytes(fd, 1); digit != "\n"; digit = read_bytes(fd, 1)) {
+    if (digit.front() < '0' or digit.front() > '9' or length > max_field_length) {
+      throw std::runtime_error("compile_protocol: malformed field length\n");
+    }
+    length = length * 10 + static_cast<size_t>(digit.front() - '0');
+  }
+  if (length > max_field_length) throw std::runtime_error("compile_protocol: field too long\n");
+  return read_bytes(fd, length);
+}
+
+void write_request(const int fd, const CompileRequest & request) {
+  write_field(fd, request.file_name);
+  write_field(fd, request.analyze ? "1" : "0");
+  write_field(fd, std::to_string(request.args.size()));
+  for (const auto & arg : request.args) write_field(fd, arg);
+  write_field(fd, request.source);
+}
+
+CompileRequest read_request(const int fd) {
+  CompileRequest request;
+  request.file_name = read_field(fd);
+  request.analyze = (read_field(fd) == "1");
+  const auto num_args = read_field(fd);
+  if (num_args.empty() or num_args.find_first_not_of("0123456789") != std::string::npos or num_args.size() > 6) {
+    throw std::runtime_error("compile_protocol: malformed argument count\n");
+  }
+  for (size_t i = 0; i < std::stoul(num_args); i++) request.args.emplace_back(read_field(fd));
+  request.source = read_field(fd);
+  return request;
+}
+
+void write_status(const int fd, const int status) {
+  write_bytes(fd, status_marker + std::to_string(status) + "\n");
+}
+
+std::string read_all(const int fd) {
+  std::string ret;
+  char buffer[4096];
+  for (;;) {
+    const auto count = read(fd, buffer, sizeof(buffer));
+    if (count < 0 and errno == EINTR) continue;
+    if (count < 0) throw std::runtime_error("compile_protocol: read failed\n");
+    if (count == 0) return ret;
+    ret.append(buffer, static_cast<size_t>(count));
+  }
+}
+
+bool split_response(std::string & response, int & status) {
+  const auto pos = response.rfind(status_marker);
+  if (pos == std::string::npos or response.back() != '\n') return false;
+  const auto digits = response.substr(pos + status_marker.size(), response.size() - 1 - pos - status_marker.size());
+  if (digits.empty() or digits.find_first_not_of("-0123456789") != std::string::npos) return false;
+  status = std::stoi(digits);
+  response.erase(pos);
+  return true;
+}
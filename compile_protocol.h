@@ -0,0 +1,46 @@
+#ifndef COMPILE_PROTOCOL_H_
+#define COMPILE_PROTOCOL_H_
+
+#include <string>
+#include <vector>
+
+/// Wire format between compile_client and compile_server.
+/// A request is a sequence of fields, each one written as its length
+/// in decimal, a newline and then that many bytes, so sources and flags
+/// can contain anything. The response is whatever the request printed,
+/// streamed as is, followed by a status trailer written by write_status().
+
+/// One compile request: a source buffer and the options to compile it with
+struct CompileRequest {
+  /// Name the source is compiled as, used in diagnostics and to pick the language
+  std::string file_name = "";
+
+  /// Run the analysis passes on the source as written instead of printing it transformed
+  bool analyze = false;
+
+  /// Extra compiler flags
+  std::vector<std::string> args = {};
+
+  /// Contents of file_name
+  std::string source = "";
+};
+
+/// Write request to fd, throws std::runtime_error if the write fails
+void write_request(const int fd, const CompileRequest & request);
+
+/// Read one request from fd, throws std::runtime_error
+/// if fd is closed early or the request is malformed
+CompileRequest read_request(const int fd);
+
+/// Append the trailer carrying the request's exit status to the response on fd
+void write_status(const int fd, const int status);
+
+/// Read everything up to end of file from fd
+std::string read_all(const int fd);
+
+/// Strip the status trailer off a complete response and return the status through status.
+/// Returns false and leaves response untouched if there is no trailer,
+/// which means the server died while handling the request.
+bool split_response(std::string & response, int & status);
+
+#endif  // COMPILE_PROTOCOL_H_
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "analysis_cache.h"
+#include "analysis_output.h"
+#include "analysis_pipeline.h"
+#include "compile_protocol.h"
+#include "source_transforms.h"
+
+static llvm::cl::opt<std::string> SocketPath("socket", llvm::cl::init("/tmp/jayhawk.sock"),
+                                             llvm::cl::desc("Unix-domain socket to listen on"));
+
+static llvm::cl::opt<unsigned> AnalysisVerbosity("verbosity", llvm::cl::init(static_cast<unsigned>(Verbosity::kSummary)),
+                                                 llvm::cl::desc("What analyses print: 0 nothing, 1 a line per function, "
+                                                                "2 results, 3 every intermediate graph and condition"));
+
+static llvm::cl::opt<std::string> AnalysisCacheDir("analysis_cache_dir", llvm::cl::init(""),
+                                                   llvm::cl::desc("Reuse analysis results of functions whose bodies "
+                                                                  "haven't changed, cached in this directory"));
+
+static llvm::cl::opt<std::string> SimulationTrace("simulation_trace", llvm::cl::init(""),
+                                                  llvm::cl::desc("Replay this pcap trace through the pipeline simulation of analyze requests "
+                                                                 "at its timestamps instead of back-to-back packets"));
+
+static llvm::cl::opt<double> ClockHz("clock_hz", llvm::cl::init(1e9),
+                                     llvm::cl::desc("Clock of the simulated pipeline, which turns trace timestamps into cycles"));
+
+static llvm::cl::opt<std::string> LatencyModel("latency_model", llvm::cl::init(""),
+                                               llvm::cl::desc("Cycles per operation of the simulated pipeline, e.g., multiply=4,state=2 "
+                                                              "(operations: match, alu, multiply, divide, state)"));
+
+/// What the pipeline simulation of analyze requests simulates, from the options above
+static SimulationOptions simulation;
+
+/// Small packet program used to warm up the compiler before the first request
+static const std::string warm_up_source =
+  "#include <stdint.h>\n"
+  "struct Packet { int a; int b; };\n"
+  "int x = 0;\n"
+  "void func(struct Packet p) { if (p.a > 0) { p.b = x; x = x + 1; } }\n";
+
+/// Transform request.source and print it,
+/// or analyze the source as written if the request asks for it.
+/// Returns the request's exit status.
+static int handle_request(const CompileRequest & request) {
+  if (request.analyze) return run_analysis_pipeline(request.file_name, request.source, request.args, simulation) ? 0 : 1;
+  std::unique_ptr<clang::ASTUnit> ast_unit(clang::tooling::buildASTFromCodeWithArgs(request.source, request.args,
+                                                                                    request.file_name));
+  if (not ast_unit or ast_unit->getDiagnostics().hasErrorOccurred()) {
+    llvm::errs() << "Could not parse " << request.file_name << "\n";
+    return 1;
+  }
+  llvm::outs() << transform_translation_unit(*ast_unit);
+  return 0;
+}
+
+/// Run one request through everything a real request touches,
+/// so that lazily initialized state (pass registry, target info, builtin headers
+/// in the page cache) is set up once here and inherited by every child
+static void warm_up() {
+  // Throw away whatever the passes print
+  const int saved_stdout = dup(STDOUT_FILENO);
+  const int dev_null = open("/dev/null", O_WRONLY);
+  dup2(dev_null, STDOUT_FILENO);
+  close(dev_null);
+
+  CompileRequest request;
+  request.file_name = "warm_up.c";
+  request.source = warm_up_source;
+  handle_request(request);
+  request.analyze = true;
+  handle_request(request);
+
+  llvm::outs().flush();
+  AnalysisOutput::flush();
+  std::cout.flush();
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(saved_stdout);
+}
+
+/// Serve a single connection in a freshly forked child:
+/// everything the request prints goes straight to the client,
+/// followed by the status trailer
+static int serve(const int connection) {
+  CompileRequest request;
+  try {
+    request = read_request(connection);
+  } catch (const std::exception & e) {
+    std::cerr << e.what();
+    return 1;
+  }
+
+  dup2(connection, STDOUT_FILENO);
+  dup2(connection, STDERR_FILENO);
+  int status = 1;
+  try {
+    status = handle_request(request);
+  } catch (const std::exception & e) {
+    llvm::errs() << "Request for " << request.file_name << " failed: " << e.what();
+  }
+  llvm::outs().flush();
+  llvm::errs().flush();
+  AnalysisOutput::flush();
+  std::cout.flush();
+  std::cerr.flush();
+
+  try {
+    write_status(connection, status);
+  } catch (const std::exception &) {
+    // Client went away, nothing left to tell it
+  }
+  return status;
+}
+
+int main(int argc, const char **argv) {
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Serve packet program transforms and analyses over a Unix-domain socket\n");
+  AnalysisOutput::set_verbosity(static_cast<Verbosity>(std::min(AnalysisVerbosity.getValue(), 3u)));
+  try {
+    simulation.model = StageLatencyModel::parse(LatencyModel);
+  } catch (const std::exception & e) {
+    llvm::errs() << "-latency_model: " << e.what();
+    return 1;
+  }
+  simulation.trace_file = SimulationTrace;
+  simulation.clock_hz = ClockHz;
+
+  // Children are reaped automatically and never become zombies
+  signal(SIGCHLD, SIG_IGN);
+
+  warm_up();
+
+  // Opened after warming up, so that the warm-up program's results don't land in the cache.
+  // Children inherit it, and see each other's results on disk.
+  try {
+    AnalysisCache::open(AnalysisCacheDir);
+  } catch (const std::exception & e) {
+    llvm::errs() << e.what();
+    return 1;
+  }
+
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (SocketPath.size() >= sizeof(address.sun_path)) {
+    llvm::errs() << "Socket path " << SocketPath << " is too long\n";
+    return 1;
+  }
+  strncpy(address.sun_path, SocketPath.c_str(), sizeof(address.sun_path) - 1);
+  unlink(SocketPath.c_str());
+  if (listener < 0 or
+      bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 or
+      listen(listener, SOMAXCONN) != 0) {
+    perror(("compile_server: cannot listen on " + SocketPath).c_str());
+    return 1;
+  }
+  llvm::errs() << "compile_server: listening on " << SocketPath << "\n";
+
+  for (;;) {
+    const int connection = accept(listener, nullptr, nullptr);
+    if (connection < 0) {
+      if (errno == EINTR) continue;
+      perror("compile_server: accept");
+      return 1;
+    }
+
+    // Each request runs in its own child, a copy-on-write snapshot of the warm server:
+    // whatever it allocates or leaks, including global LLVMContext state, vanishes when it exits,
+    // and requests don't wait on each other
+    const pid_t pid = fork();
+    if (pid == 0) {
+      close(listener);
+      _exit(serve(connection));
+    }
+    if (pid < 0) perror("compile_server: fork");
+    close(connection);
+  }
+}
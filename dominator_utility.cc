@@ -1,51 +1,117 @@
 #include <iostream>
+#include <utility>
+#include <algorithm>
 #include "dominator_utility.h"
+#include "instrumentation.h"
 
 template <class NodeType>
 DominatorUtility<NodeType>::DominatorUtility(const Graph<NodeType> & t_graph,
                                              const NodeType & t_start_node)
     : graph_(t_graph),
       start_node_(t_start_node),
-      dominators_(construct_dominators(graph_, start_node_)),
-      dominator_tree_(construct_dom_tree(graph_, start_node_, dominators_)),
-      dominance_frontier_(construct_dom_frontiers(graph_, dominator_tree_, dominators_)) {}
+      idoms_(timed_phase("dominators", [this] () { return construct_idoms(graph_, start_node_); })),
+      dominator_tree_(timed_phase("dominator tree", [this] () { return construct_dom_tree(graph_, start_node_, idoms_); })),
+      dominance_frontier_(timed_phase("frontiers", [this] () { return construct_dom_frontiers(graph_, start_node_, idoms_); })) {}
 
 template <class NodeType>
-auto DominatorUtility<NodeType>::construct_dominators(const Graph<NodeType> & t_graph,
-                                                      const NodeType & t_start_node) {
-  NodeSetMap dominators;
-  dominators[t_start_node] = {t_start_node};
-  for (const auto & node : (t_graph.node_set() - std::set<NodeType>{t_start_node})) {
-    dominators[node] = t_graph.node_set();
+DominatorUtility<NodeType>::DominatorUtility(const Graph<NodeType> & t_graph,
+                                             const NodeType & t_start_node,
+                                             const std::map<NodeType, NodeType> & t_idoms)
+    : graph_(t_graph),
+      start_node_(t_start_node),
+      idoms_(t_idoms),
+      dominator_tree_(timed_phase("dominator tree", [this] () { return construct_dom_tree(graph_, start_node_, idoms_); })),
+      dominance_frontier_(timed_phase("frontiers", [this] () { return construct_dom_frontiers(graph_, start_node_, idoms_); })) {}
+
+template <class NodeType>
+auto DominatorUtility<NodeType>::construct_idoms(const Graph<NodeType> & t_graph,
+                                                 const NodeType & t_start_node) {
+  // Number nodes in DFS preorder, recording each node's DFS tree parent.
+  // The DFS uses an explicit stack of (node, next successor to visit),
+  // so that deep graphs don't overflow the call stack.
+  std::vector<NodeType> vertex = {t_start_node};
+  std::map<NodeType, size_t> number = {{t_start_node, 0}};
+  std::vector<size_t> parent = {0};
+  std::vector<std::pair<size_t, size_t>> stack = {{0, 0}};
+  while (not stack.empty()) {
+    const auto & succs = t_graph.succ_map().at(vertex.at(stack.back().first));
+    if (stack.back().second == succs.size()) {
+      stack.pop_back();
+      continue;
+    }
+    const auto & succ = succs.at(stack.back().second++);
+    if (number.emplace(succ, vertex.size()).second) {
+      parent.emplace_back(stack.back().first);
+      stack.emplace_back(vertex.size(), 0);
+      vertex.emplace_back(succ);
+    }
   }
 
-  NodeSetMap prev_dominators;
-  while (dominators != prev_dominators) {
-    // Save old dominators
-    prev_dominators = dominators;
+  // Semidominators, the forest linked so far with its path-compressed labels,
+  // and buckets of nodes whose semidominator is a given node
+  const size_t num_nodes = vertex.size();
+  const size_t kUnlinked = num_nodes;
+  std::vector<size_t> semi(num_nodes);
+  std::vector<size_t> label(num_nodes);
+  std::vector<size_t> ancestor(num_nodes, kUnlinked);
+  std::vector<size_t> idom(num_nodes, 0);
+  std::vector<std::vector<size_t>> bucket(num_nodes);
+  for (size_t i = 0; i < num_nodes; i++) semi.at(i) = label.at(i) = i;
 
-    // Run dataflow equations
-    for (const auto & node : (t_graph.node_set() - std::set<NodeType>{t_start_node})) {
-      std::set<NodeType> pred_intersection = t_graph.node_set();
-      for (const auto & pred : t_graph.pred_map().at(node)) {
-        pred_intersection = pred_intersection * dominators.at(pred);
-      }
-      dominators.at(node) = std::set<NodeType>{node} + pred_intersection;
+  // Node with the smallest semidominator on the forest path up from v,
+  // compressing the path on the way, without recursion
+  std::vector<size_t> path;
+  const auto eval = [&] (const size_t v) {
+    if (ancestor.at(v) == kUnlinked) return v;
+    for (auto x = v; ancestor.at(ancestor.at(x)) != kUnlinked; x = ancestor.at(x)) path.emplace_back(x);
+    for (auto it = path.rbegin(); it != path.rend(); it++) {
+      const auto up = ancestor.at(*it);
+      if (semi.at(label.at(up)) < semi.at(label.at(*it))) label.at(*it) = label.at(up);
+      ancestor.at(*it) = ancestor.at(up);
+    }
+    path.clear();
+    return label.at(v);
+  };
+
+  for (size_t w = num_nodes; w-- > 1;) {
+    for (const auto & pred : t_graph.pred_map().at(vertex.at(w))) {
+      // Skip unreachable predecessors
+      const auto it = number.find(pred);
+      if (it == number.end()) continue;
+      semi.at(w) = std::min(semi.at(w), semi.at(eval(it->second)));
+    }
+    bucket.at(semi.at(w)).emplace_back(w);
+    ancestor.at(w) = parent.at(w);
+
+    // Nodes semidominated by w's parent: their idom is either the parent,
+    // or deferred to be the idom of the node with the smallest semidominator above them
+    for (const auto & v : bucket.at(parent.at(w))) {
+      const auto u = eval(v);
+      idom.at(v) = semi.at(u) < semi.at(v) ? u : parent.at(w);
     }
+    bucket.at(parent.at(w)).clear();
+  }
+  for (size_t w = 1; w < num_nodes; w++) {
+    if (idom.at(w) != semi.at(w)) idom.at(w) = idom.at(idom.at(w));
   }
-  return dominators;
+
+  std::map<NodeType, NodeType> idoms;
+  for (size_t i = 0; i < num_nodes; i++) idoms.emplace(vertex.at(i), vertex.at(idom.at(i)));
+  return idoms;
 }
 
 template <class NodeType>
 auto DominatorUtility<NodeType>::construct_dom_tree(const Graph<NodeType> & t_graph,
                                                     const NodeType & t_start_node,
-                                                    const NodeSetMap & t_dominators) {
-  // Initialize dominator_tree_ based on graph
-  auto dominator_tree = t_graph.copy_and_clear();
+                                                    const std::map<NodeType, NodeType> & t_idoms) {
+  // Initialize dominator_tree_ with the nodes reachable from the start node, which are those with an idom
+  std::set<NodeType> reachable;
+  for (const auto & node : t_idoms) reachable.insert(reachable.end(), node.first);
+  auto dominator_tree = t_graph.copy_nodes(reachable);
 
   // Connect idom(n) to n
-  for (const auto & node : t_graph.node_set() - std::set<NodeType>{t_start_node}) {
-    dominator_tree.add_edge(get_idom(node, t_dominators), node);
+  for (const auto & node : t_idoms) {
+    if (node.first != t_start_node) dominator_tree.add_edge(node.second, node.first);
   }
 
   return dominator_tree;
@@ -53,77 +119,40 @@ auto DominatorUtility<NodeType>::construct_dom_tree(const Graph<NodeType> & t_gr
 
 template <class NodeType>
 auto DominatorUtility<NodeType>::construct_dom_frontiers(const Graph<NodeType> & t_graph,
-                                                         const Graph<NodeType> & t_dom_tree,
-                                                         const NodeSetMap & t_dominators) {
-  NodeSetMap dominance_frontier; 
-  for (const auto & node : t_graph.node_set()) {
-    dominance_frontier[node] = dom_frontier_helper(node, t_graph, t_dom_tree, t_dominators);
-  }
-  return dominance_frontier;
-}
+                                                         const NodeType & t_start_node,
+                                                         const std::map<NodeType, NodeType> & t_idoms) {
+  NodeSetMap dominance_frontier;
+  for (const auto & node : t_graph.node_set()) dominance_frontier[node] = {};
 
-template <class NodeType>
-typename DominatorUtility<NodeType>::NodeSet DominatorUtility<NodeType>::dom_frontier_helper(const NodeType & node,
-                                                                                             const Graph<NodeType> & t_graph,
-                                                                                             const Graph<NodeType> & t_dom_tree,
-                                                                                             const NodeSetMap & t_dominators) {
-  NodeSet S;
-  for (const auto & y : t_graph.succ_map().at(node)) {
-    assert(t_dom_tree.pred_map().at(y).size() == 1);
-    if (t_dom_tree.pred_map().at(y).front() != node) {
-      S = S + std::set<NodeType>{y};
-    }
-  }
+  for (const auto & join : t_idoms) {
+    const auto & node = join.first;
+    for (const auto & pred : t_graph.pred_map().at(node)) {
+      if (t_idoms.find(pred) == t_idoms.end()) continue;
 
-  for (const auto & child : t_dom_tree.succ_map().at(node)) {
-    const auto frontier_child = dom_frontier_helper(child, t_graph, t_dom_tree, t_dominators);
-    for (const auto & w : frontier_child) {
-      // if: w's set of dominators does not contain node
-      // if: w is node
-      if ((t_dominators.at(w).find(node) == t_dominators.at(w).end()) or
-          (node == w)) {
-        S = S + std::set<NodeType>{w};
+      // The start node has no strict dominators, so walks from its predecessors go all the way up
+      auto runner = pred;
+      while (node == t_start_node or runner != join.second) {
+        if (not dominance_frontier.at(runner).insert(node).second) break;
+        if (runner == t_start_node) break;
+        runner = t_idoms.at(runner);
       }
     }
   }
-  // If we get here, the results were not memoized to begin with
-  return S;
+  return dominance_frontier;
 }
 
 template <class NodeType>
 void DominatorUtility<NodeType>::print_dominators() const {
-  for (const auto & node : dominators_) {
+  for (const auto & node : idoms_) {
+    // Dominators of a node are the path from it up the dominator tree
+    std::set<NodeType> dominators = {node.first};
+    for (auto dominator = node.first; dominator != start_node_; dominator = idoms_.at(dominator)) {
+      dominators.insert(idoms_.at(dominator));
+    }
     std::cout << node.first << " dominated by ";
-    for (const auto & dom_node : node.second) {
+    for (const auto & dom_node : dominators) {
       std::cout << dom_node << " ";
     }
     std::cout << "\n";
   }
 }
-
-template <class NodeType>
-auto DominatorUtility<NodeType>::get_idom(const NodeType & node, const NodeSetMap & dominators) {
-  // Naive implementation of Page 380 of Appel's book
-
-  std::vector<NodeType> idoms;
-  // 2. (from page 380) idom must dominate node
-  for (const auto & idom_candidate : dominators.at(node)) {
-    if (idom_candidate == node) {
-      // 1. (from page 380) idom can't be node itself
-      continue;
-    } else {
-      // 3. idom should not dominate some other dominator of node
-      bool dominates_other = false;
-      for (const auto & other_doms : dominators.at(node) - std::set<NodeType>{idom_candidate, node}) {
-        if (dominators.at(other_doms).find(idom_candidate) != dominators.at(other_doms).end()) {
-          dominates_other = true;
-          break;
-        }
-      }
-      if (dominates_other == false) idoms.emplace_back(idom_candidate);
-    }
-  }
-  // There has to be exactly one idom (Page 380 of Appel's book)
-  assert(idoms.size() == 1);
-  return idoms.front();
-}
@@ -1,6 +1,9 @@
 #ifndef DOMINATOR_UTILITY_H_
 #define DOMINATOR_UTILITY_H_
 
+#include <map>
+#include <set>
+#include <vector>
 #include "graph.h"
 
 /// Utility class to compute dominator tree and dominance frontiers
@@ -9,8 +12,7 @@ template <class NodeType>
 class DominatorUtility {
  public:
   /// Map from a node to set of nodes
-  /// Used both to store the set of ALL dominators for a node and
-  /// the dominance frontier for each node
+  /// Used to store the dominance frontier for each node
   typedef std::map<NodeType, std::set<NodeType>> NodeSetMap;
 
   /// Convenience typedef for set of nodes
@@ -25,43 +27,52 @@ class DominatorUtility {
   /// Constructor for DominatorUtility from Graph object and start node
   DominatorUtility(const Graph<NodeType> & t_graph, const NodeType & t_start_node);
 
-  /// Return dominator tree
+  /// Constructor from immediate dominators computed earlier, e.g., cached
+  /// (see cached_dominator_utility), building only the tree and frontiers
+  DominatorUtility(const Graph<NodeType> & t_graph, const NodeType & t_start_node,
+                   const std::map<NodeType, NodeType> & t_idoms);
+
+  /// Return dominator tree, whose nodes are the nodes reachable from the start node:
+  /// unreachable nodes have no dominators, so they're left out, as they are from the idoms
   auto dominator_tree() const { return dominator_tree_; };
 
-  /// Return dominance frontier for all nodes
+  /// Return dominance frontier for all nodes, empty for unreachable ones
   auto dominance_frontier() const { return dominance_frontier_; };
 
+  /// Immediate dominator of node, which must be reachable from the start node;
+  /// the start node is its own immediate dominator
+  const NodeType & immediate_dominator(const NodeType & node) const { return idoms_.at(node); }
+
+  /// Immediate dominators of all nodes reachable from the start node
+  const std::map<NodeType, NodeType> & immediate_dominators() const { return idoms_; }
+
   /// Routine to print out dominators
   void print_dominators() const;
 
  private:
-  /// Compute dominators for each node using naive dataflow equations
-  /// (Algorithm 430: Immediate Predominators in a Directed Graph)
-  /// http://en.wikipedia.org/wiki/Dominator_%28graph_theory%29#Algorithms
-  static auto construct_dominators(const Graph<NodeType> & t_graph,
-                                   const NodeType & t_start_node);
-
-  /// Construct dom tree use dominators and get_idom
-  /// Dom tree connects every node to its idom
+  /// Compute the immediate dominator of every node reachable from t_start_node,
+  /// which is its own immediate dominator, using the simple version of
+  /// Lengauer and Tarjan, "A Fast Algorithm for Finding Dominators in a Flowgraph",
+  /// which runs in O(E log N) even on graphs where iterative algorithms go quadratic.
+  /// Dominator sets are never materialized: they are the paths up the dominator tree.
+  static auto construct_idoms(const Graph<NodeType> & t_graph,
+                              const NodeType & t_start_node);
+
+  /// Construct dom tree from idoms
+  /// Dom tree connects every node with an idom to it
   static auto construct_dom_tree(const Graph<NodeType> & t_graph,
                                  const NodeType & t_start_node,
-                                 const NodeSetMap & t_dominators);
-
-  /// Get immediate dominator for each node
-  /// Naive implementation from Page 380 of Appel's book
-  static auto get_idom(const NodeType & node, const NodeSetMap & dominators);
-
-  /// Helper to compute dominance frontier for one node (Page 406 of Appel's book)
-  static NodeSet dom_frontier_helper(const NodeType & node,
-                                     const Graph<NodeType> & t_graph,
-                                     const Graph<NodeType> & t_dom_tree,
-                                     const NodeSetMap & t_dominators);
-
-  /// Compute dominance frontiers for all nodes by calling
-  /// dom_frontier_helper on each node
+                                 const std::map<NodeType, NodeType> & t_idoms);
+
+  /// Compute dominance frontiers for all nodes (Cooper, Harvey and Kennedy,
+  /// "A Simple, Fast Dominance Algorithm"):
+  /// a join node is in the frontier of every node on the dominator tree path
+  /// from each of its predecessors up to, but excluding, its idom.
+  /// A walk stops early at a node that already has the join node in its frontier,
+  /// the rest of the path has it too, so the work is linear in the size of the frontiers.
   static auto construct_dom_frontiers(const Graph<NodeType> & t_graph,
-                                      const Graph<NodeType> & t_dom_tree,
-                                      const NodeSetMap & t_dominators);
+                                      const NodeType & t_start_node,
+                                      const std::map<NodeType, NodeType> & t_idoms);
 
   /// Underlying graph for which we are computing dominator tree
   const Graph<NodeType> graph_;
@@ -69,8 +80,8 @@ class DominatorUtility {
   /// Start node for computing dominator tree
   const NodeType start_node_;
 
-  /// Set of dominators for each node in the graph
-  const NodeSetMap dominators_; 
+  /// Immediate dominator of each node reachable from the start node
+  const std::map<NodeType, NodeType> idoms_;
 
   /// Dominator Tree itself
   const Graph<NodeType> dominator_tree_;
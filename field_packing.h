@@ -0,0 +1,181 @@
+#ifndef FIELD_PACKING_H_
+#define FIELD_PACKING_H_
+
+#include <cctype>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+/// A packet field to be placed in PHV containers
+struct PacketField {
+  /// Name as written in the program, e.g., p.x
+  std::string name;
+
+  /// Width on the wire: the declared width, or the bit field's width
+  unsigned width;
+
+  /// Functions that access the field, fields with the same users are co-accessed
+  std::set<std::string> users;
+
+  /// Bit offset of the field in the packet on the wire, see jayhawk_load_field()
+  unsigned wire_offset = 0;
+};
+
+/// Placement of (part of) a field: width bits starting at bit offset of container
+struct FieldSlot {
+  std::string name;
+  size_t container;
+  unsigned offset;
+  unsigned width;
+};
+
+/// Packing of packet fields into 8, 16 and 32-bit PHV containers.
+/// Fields are grouped by the set of functions that access them, so that
+/// co-accessed fields share containers, and each group is packed first-fit
+/// decreasing into 32-bit containers, which are then shrunk to the smallest
+/// container size that holds their contents.
+/// Fields wider than 32 bits are split across whole 32-bit containers.
+class FieldLayout {
+ public:
+  /// Largest container size
+  enum : unsigned { kMaxContainerBits = 32 };
+
+  explicit FieldLayout(const std::vector<PacketField> & fields) {
+    // Group fields by their users, widest first within a group
+    std::map<std::set<std::string>, std::vector<PacketField>> groups;
+    for (const auto & field : fields) {
+      if (field.width == 0) throw std::invalid_argument("FieldLayout: field " + field.name + " has zero width\n");
+      groups[field.users].emplace_back(field);
+      fields_.emplace(field.name, field);
+    }
+
+    for (auto & group : groups) {
+      auto & members = group.second;
+      std::stable_sort(members.begin(), members.end(), [] (const PacketField & a, const PacketField & b)
+                       { return a.width > b.width; });
+
+      // Containers of this group and the bits used in each
+      std::vector<size_t> open;
+      for (const auto & field : members) {
+        unsigned remaining = field.width;
+
+        // Whole containers for the part of wide fields beyond a multiple of 32 bits
+        while (remaining > kMaxContainerBits) {
+          used_bits_.emplace_back(kMaxContainerBits);
+          slots_.emplace_back(FieldSlot{field.name, used_bits_.size() - 1, 0, kMaxContainerBits});
+          remaining -= kMaxContainerBits;
+        }
+
+        // First fit among this group's containers
+        const auto it = std::find_if(open.begin(), open.end(), [this, remaining] (const size_t container)
+                                     { return used_bits_.at(container) + remaining <= kMaxContainerBits; });
+        size_t container;
+        if (it != open.end()) {
+          container = *it;
+        } else {
+          used_bits_.emplace_back(0);
+          container = used_bits_.size() - 1;
+          open.emplace_back(container);
+        }
+        slots_.emplace_back(FieldSlot{field.name, container, used_bits_.at(container), remaining});
+        used_bits_.at(container) += remaining;
+      }
+    }
+  }
+
+  /// Size in bits of each container: 8, 16 or 32
+  std::vector<unsigned> container_sizes() const {
+    std::vector<unsigned> ret;
+    for (const auto used : used_bits_) ret.emplace_back(used <= 8 ? 8 : used <= 16 ? 16 : 32);
+    return ret;
+  }
+
+  /// Placement of every field, wide fields have several slots, least significant first
+  const std::vector<FieldSlot> & slots() const { return slots_; }
+
+  /// Total container bits, i.e., PHV space, used by the layout
+  unsigned total_bits() const {
+    unsigned ret = 0;
+    for (const auto size : container_sizes()) ret += size;
+    return ret;
+  }
+
+  /// Emit the packed header as a C struct with one member per container,
+  /// a get/set accessor pair per field, or per slot for split fields,
+  /// and parse_<struct_name>() and deparse_<struct_name>(), which move
+  /// every field between its place on the wire and its containers
+  std::string emit_c(const std::string & struct_name) const {
+    const auto sizes = container_sizes();
+    std::string ret = "#include <stdint.h>\n#include \"jayhawk_runtime.h\"\n\nstruct " + struct_name + " {\n";
+    for (size_t i = 0; i < sizes.size(); i++) {
+      ret += "  uint" + std::to_string(sizes.at(i)) + "_t c" + std::to_string(i) + ";\n";
+    }
+    ret += "};\n";
+
+    // Fields split across containers get one accessor pair per slot
+    std::map<std::string, unsigned> num_slots;
+    for (const auto & slot : slots_) num_slots[slot.name]++;
+    std::map<std::string, unsigned> slot_index;
+    // Bits of each field in the slots so far, which are its least significant ones
+    std::map<std::string, unsigned> low_bits;
+    std::string parse;
+    std::string deparse;
+    for (const auto & slot : slots_) {
+      auto accessor = identifier(slot.name);
+      if (num_slots.at(slot.name) > 1) accessor += "_" + std::to_string(slot_index[slot.name]++);
+
+      // Wire order is most significant byte first, so the least significant slot comes last
+      const auto & field = fields_.at(slot.name);
+      const auto wire_offset = std::to_string(field.wire_offset + field.width - low_bits[slot.name] - slot.width);
+      const auto wire_width = std::to_string(slot.width);
+      low_bits[slot.name] += slot.width;
+      parse += "  set_" + accessor + "(h, (uint32_t) jayhawk_load_field(packet, " + wire_offset + ", " + wire_width + "));\n";
+      deparse += "  jayhawk_store_field(packet, " + wire_offset + ", " + wire_width + ", get_" + accessor + "(h));\n";
+
+      const auto member = "h->c" + std::to_string(slot.container);
+      const auto mask = "0x" + to_hex(slot.width == 32 ? 0xffffffffu : (1u << slot.width) - 1) + "u";
+      const auto offset = std::to_string(slot.offset);
+      ret += "\nstatic inline uint32_t get_" + accessor + "(const struct " + struct_name + " * h) {\n"
+             "  return (uint32_t)(" + member + " >> " + offset + ") & " + mask + ";\n}\n";
+      ret += "\nstatic inline void set_" + accessor + "(struct " + struct_name + " * h, uint32_t v) {\n"
+             "  " + member + " = (" + member + " & ~(" + mask + " << " + offset + ")) | ((v & " + mask + ") << " + offset + ");\n}\n";
+    }
+    ret += "\nstatic inline void parse_" + struct_name + "(struct " + struct_name + " * h, const unsigned char * packet) {\n" +
+           parse + "}\n";
+    ret += "\nstatic inline void deparse_" + struct_name + "(const struct " + struct_name + " * h, unsigned char * packet) {\n" +
+           deparse + "}\n";
+    return ret;
+  }
+
+ private:
+  /// C identifier for a field name, e.g., p.x becomes p_x
+  static std::string identifier(const std::string & name) {
+    std::string ret = name;
+    for (auto & c : ret) if (not (std::isalnum(static_cast<unsigned char>(c)) or c == '_')) c = '_';
+    return ret;
+  }
+
+  static std::string to_hex(unsigned value) {
+    static const char digits[] = "0123456789abcdef";
+    std::string ret;
+    do {
+      ret.insert(ret.begin(), digits[value % 16]);
+      value /= 16;
+    } while (value != 0);
+    return ret;
+  }
+
+  /// Bits used in each container
+  std::vector<unsigned> used_bits_ = {};
+
+  /// Placement of every field
+  std::vector<FieldSlot> slots_ = {};
+
+  /// Fields by name
+  std::map<std::string, PacketField> fields_ = {};
+};
+
+#endif  // FIELD_PACKING_H_
@@ -0,0 +1,124 @@
+#ifndef FINGERPRINT_H_
+#define FINGERPRINT_H_
+
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "graph.h"
+
+/// 128-bit fingerprint of some content, e.g., a graph or a function body,
+/// equal for equal content in every run and on every platform, unlike std::hash
+struct Fingerprint {
+  uint64_t high = 0;
+  uint64_t low = 0;
+
+  bool operator==(const Fingerprint & other) const { return high == other.high and low == other.low; }
+  bool operator!=(const Fingerprint & other) const { return not (*this == other); }
+  bool operator<(const Fingerprint & other) const {
+    return high != other.high ? high < other.high : low < other.low;
+  }
+
+  /// 32 hex digits, e.g., for file names
+  std::string hex() const {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string ret(32, '0');
+    for (int i = 0; i < 16; i++) {
+      ret.at(static_cast<size_t>(15 - i)) = kDigits[(high >> (4 * i)) & 0xf];
+      ret.at(static_cast<size_t>(31 - i)) = kDigits[(low >> (4 * i)) & 0xf];
+    }
+    return ret;
+  }
+};
+
+/// Hash a sequence of strings, integers and other fingerprints into a Fingerprint.
+/// Two 64-bit lanes with unrelated mixing, FNV-1a and a rotate-multiply,
+/// each finished with the splitmix64 finalizer. Strings are length-suffixed,
+/// so that "ab" then "c" and "a" then "bc" hash differently.
+class FingerprintBuilder {
+ public:
+  FingerprintBuilder & add_string(const std::string & data) {
+    for (const auto c : data) add_byte(static_cast<unsigned char>(c));
+    return add_u64(data.size());
+  }
+
+  FingerprintBuilder & add_u64(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+      add_byte(static_cast<unsigned char>(value & 0xff));
+      value >>= 8;
+    }
+    return *this;
+  }
+
+  /// Fold in the fingerprint of a part, e.g., a node's children in a Merkle tree
+  FingerprintBuilder & add_fingerprint(const Fingerprint & part) { return add_u64(part.high).add_u64(part.low); }
+
+  Fingerprint finish() const { return {mix(fnv_), mix(rotate_)}; }
+
+ private:
+  void add_byte(const unsigned char byte) {
+    fnv_ = (fnv_ ^ byte) * 1099511628211ull;
+    rotate_ = (((rotate_ << 23) | (rotate_ >> 41)) ^ byte) * 0x9e3779b97f4a7c15ull;
+  }
+
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  uint64_t fnv_ = 14695981039346656037ull;
+  uint64_t rotate_ = 0x243f6a8885a308d3ull;
+};
+
+/// Label of node used for fingerprinting: label(node) if given,
+/// else the node as graph prints it
+template <class NodeType>
+std::string fingerprint_label(const Graph<NodeType> & graph,
+                              const std::function<std::string(const NodeType &)> & label,
+                              const NodeType & node) {
+  if (label) return label(node);
+  std::ostringstream out;
+  graph.print_node(out, node);
+  return out.str();
+}
+
+/// Merkle-style structural fingerprint of graph: each node hashes its label
+/// and the sorted hashes of its successors' labels, and the graph hashes
+/// the sorted hashes of its nodes. Node values only matter through their labels,
+/// so graphs of pointers fingerprint alike across runs, and isomorphic graphs
+/// with the same labels fingerprint alike. When labels are unique, equal
+/// fingerprints mean equal labelled graphs, bar a 128-bit collision;
+/// graphs with repeated labels may collide and shouldn't be used as cache keys.
+template <class NodeType>
+Fingerprint graph_fingerprint(const Graph<NodeType> & graph,
+                              const std::function<std::string(const NodeType &)> & label = {}) {
+  std::map<NodeType, Fingerprint> leaves;
+  for (const auto & node : graph.node_set()) {
+    leaves.emplace(node, FingerprintBuilder().add_string(fingerprint_label(graph, label, node)).finish());
+  }
+
+  std::vector<Fingerprint> nodes;
+  nodes.reserve(leaves.size());
+  std::vector<Fingerprint> succs;
+  for (const auto & node : graph.succ_map()) {
+    succs.clear();
+    for (const auto & succ : node.second) succs.emplace_back(leaves.at(succ));
+    std::sort(succs.begin(), succs.end());
+    FingerprintBuilder builder;
+    builder.add_fingerprint(leaves.at(node.first)).add_u64(succs.size());
+    for (const auto & succ : succs) builder.add_fingerprint(succ);
+    nodes.emplace_back(builder.finish());
+  }
+  std::sort(nodes.begin(), nodes.end());
+
+  FingerprintBuilder ret;
+  ret.add_u64(nodes.size()).add_u64(graph.num_edges());
+  for (const auto & node : nodes) ret.add_fingerprint(node);
+  return ret.finish();
+}
+
+#endif  // FINGERPRINT_H_
@@ -2,6 +2,7 @@
 #define FUNCTION_DECL_HANDLER_H_
 
 #include <string>
+#include <map>
 #include <set>
 #include "clang/Lex/Lexer.h"
 #include "clang/AST/AST.h"
@@ -22,17 +23,21 @@ using namespace clang::tooling;
 
 class FunctionDeclHandler : public MatchFinder::MatchCallback {
  public:
-  /// Constructor: Pass Refactoring tool as argument
-  FunctionDeclHandler(Replacements & t_replace, const std::set<std::string> & t_decl_strings) : Replace(t_replace), decl_strings_(t_decl_strings) {}
+  /// Constructor: Pass Refactoring tool and declarations keyed by function name as argument
+  FunctionDeclHandler(Replacements & t_replace, const std::map<std::string, std::set<std::string>> & t_decl_strings) : Replace(t_replace), decl_strings_(t_decl_strings) {}
 
   /// Callback whenever there's a match
   virtual void run(const MatchFinder::MatchResult &Result) override {
     const FunctionDecl *function_decl_expr = Result.Nodes.getNodeAs<clang::FunctionDecl>("functionDecl");
     assert(function_decl_expr != nullptr);
 
-    // Concatenate all declarations
+    // Only definitions of functions that access fields need declarations
+    const auto it = decl_strings_.find(function_decl_expr->getNameAsString());
+    if (not function_decl_expr->isThisDeclarationADefinition() or it == decl_strings_.end()) return;
+
+    // Concatenate this function's declarations
     std::string all_decls = "\n";
-    for (const auto & decl : decl_strings_)
+    for (const auto & decl : it->second)
       all_decls += "  " + decl;
 
     // Now, create replacement text
@@ -46,7 +51,7 @@ class FunctionDeclHandler : public MatchFinder::MatchCallback {
 
  private:
   Replacements & Replace;
-  const std::set<std::string> decl_strings_;
+  const std::map<std::string, std::set<std::string>> decl_strings_;
 };
 
 #endif  // FUNCTION_DECL_HANDLER_H_
@@ -2,6 +2,7 @@
 #include <cassert>
 #include <stdexcept>
 #include <algorithm>
+#include <utility>
 #include "graph.h"
 #include "set_idioms.h"
 
@@ -26,19 +27,20 @@ void Graph<NodeType>::add_edge(const NodeType & from_node, const NodeType & to_n
     throw std::logic_error("to_node doesn't exist in node_set_\n");
   }
 
-  // If edge already exists, return
-  if (std::find(succ_map_.at(from_node).begin(), succ_map_.at(from_node).end(), to_node) != succ_map_.at(from_node).end()) {
-    assert(std::find(pred_map_.at(to_node).begin(), pred_map_.at(to_node).end(), from_node) != pred_map_.at(to_node).end());
-    std::cout << "Warning: edge already exists, ignoring add_edge command\n";
+  // Keep these lists sorted to ensure the equality comparison works:
+  // binary search for the edge, and insert it in place if it's new
+  auto & succs = succ_map_.at(from_node);
+  auto & preds = pred_map_.at(to_node);
+  const auto succ_it = std::lower_bound(succs.begin(), succs.end(), to_node);
+
+  // If edge already exists, return: that's expected, e.g., for an edge in both operands of operator+
+  if (succ_it != succs.end() and *succ_it == to_node) {
+    assert(std::binary_search(preds.begin(), preds.end(), from_node));
     return;
   }
 
-  succ_map_.at(from_node).emplace_back(to_node);
-  pred_map_.at(to_node).emplace_back(from_node);
-
-  // Keep these lists sorted to ensure the equality comparison works
-  std::sort(succ_map_.at(from_node).begin(), succ_map_.at(from_node).end());
-  std::sort(pred_map_.at(to_node).begin(), pred_map_.at(to_node).end());
+  succs.insert(succ_it, to_node);
+  preds.insert(std::lower_bound(preds.begin(), preds.end(), from_node), from_node);
 }
 
 template <class NodeType>
@@ -91,3 +93,79 @@ Graph<NodeType> Graph<NodeType>::copy_and_clear() const {
   }
   return copy;
 }
+
+template <class NodeType>
+Graph<NodeType> Graph<NodeType>::copy_nodes(const std::set<NodeType> & nodes) const {
+  Graph copy;
+  copy.node_printer_ = node_printer_;
+  for (const auto & node : nodes) {
+    if (node_set_.find(node) == node_set_.end()) {
+      throw std::logic_error("Trying to copy node that doesn't exist in node_set_\n");
+    }
+    copy.add_node(node);
+  }
+  return copy;
+}
+
+template <class NodeType>
+std::vector<std::vector<NodeType>> Graph<NodeType>::strongly_connected_components() const {
+  // Tarjan's algorithm with an explicit DFS stack, so that long dependence chains don't overflow the call stack
+  std::vector<std::vector<NodeType>> components;
+  std::map<NodeType, size_t> index;
+  std::map<NodeType, size_t> low_link;
+  std::set<NodeType> on_stack;
+  std::vector<NodeType> tarjan_stack;
+
+  // DFS frame: node and position of the next successor to visit
+  std::vector<std::pair<NodeType, size_t>> dfs_stack;
+  for (const auto & root : node_set_) {
+    if (index.find(root) != index.end()) continue;
+    dfs_stack.emplace_back(root, 0);
+    while (not dfs_stack.empty()) {
+      const auto node = dfs_stack.back().first;
+      auto & next_succ = dfs_stack.back().second;
+
+      // First visit
+      if (next_succ == 0) {
+        const size_t next_index = index.size();
+        index[node] = next_index;
+        low_link[node] = next_index;
+        tarjan_stack.emplace_back(node);
+        on_stack.insert(node);
+      }
+
+      // Descend into the next unvisited successor
+      const auto & succs = succ_map_.at(node);
+      bool descended = false;
+      while (next_succ < succs.size()) {
+        const auto & succ = succs.at(next_succ++);
+        if (index.find(succ) == index.end()) {
+          dfs_stack.emplace_back(succ, 0);
+          descended = true;
+          break;
+        } else if (on_stack.find(succ) != on_stack.end()) {
+          low_link.at(node) = std::min(low_link.at(node), index.at(succ));
+        }
+      }
+      if (descended) continue;
+
+      // All successors done: node is the root of a component if nothing below reaches above it
+      if (low_link.at(node) == index.at(node)) {
+        std::vector<NodeType> component;
+        while (component.empty() or component.back() != node) {
+          component.emplace_back(tarjan_stack.back());
+          tarjan_stack.pop_back();
+          on_stack.erase(component.back());
+        }
+        std::sort(component.begin(), component.end());
+        components.emplace_back(std::move(component));
+      }
+      dfs_stack.pop_back();
+      if (not dfs_stack.empty()) {
+        const auto & parent = dfs_stack.back().first;
+        low_link.at(parent) = std::min(low_link.at(parent), low_link.at(node));
+      }
+    }
+  }
+  return components;
+}
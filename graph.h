@@ -21,7 +21,8 @@ class Graph {
   /// Add node alone to existing graph, check that node doesn't already exist
   void add_node(const NodeType & node);
 
-  /// Add edge to existing graph, check that both from_node and to_node exist
+  /// Add edge to existing graph, check that both from_node and to_node exist;
+  /// adding an edge that's already there does nothing
   void add_edge(const NodeType & from_node, const NodeType & to_node);
 
   /// Find the graph transpose G', i.e. for every edge u-->v in G,
@@ -33,17 +34,23 @@ class Graph {
   /// Copy over graph and clear out all edges
   Graph<NodeType> copy_and_clear() const;
 
+  /// Copy over only the given nodes, which must be in graph, without any edges
+  Graph<NodeType> copy_nodes(const std::set<NodeType> & nodes) const;
+
+  /// Strongly connected components, using Tarjan's algorithm.
+  /// Components come out in reverse topological order of the condensation,
+  /// i.e., a component comes before every component with an edge into it.
+  /// Nodes without a cycle through them are singleton components.
+  std::vector<std::vector<NodeType>> strongly_connected_components() const;
+
   /// Print graph to stream
   friend std::ostream & operator<< (std::ostream & out, const Graph<NodeType> & graph) {
     for (const auto & node : graph.succ_map_) {
-      if (graph.node_printer_) out << graph.node_printer_(node.first);
-      else out << node.first;
-
+      graph.print_node(out, node.first);
       out << " ---> ";
       for (const auto & neighbor : node.second) {
         out << " { ";
-        if (graph.node_printer_) out << graph.node_printer_(neighbor);
-        else out << neighbor;
+        graph.print_node(out, neighbor);
         out << " } ";
       }
       out << "\n";
@@ -51,6 +58,12 @@ class Graph {
     return out;
   }
 
+  /// Print node to stream the way operator<< does: through the node printer if there is one
+  void print_node(std::ostream & out, const NodeType & node) const {
+    if (node_printer_) out << node_printer_(node);
+    else out << node;
+  }
+
   /// Used for unit tests that check expected graph output
   bool operator==(const Graph<NodeType> & b) const;
 
@@ -63,10 +76,17 @@ class Graph {
   const auto & succ_map() const { return succ_map_; }
   const auto & pred_map() const { return pred_map_; }
 
-  /// Check if an edge exists from a to b
+  /// Number of edges
+  size_t num_edges() const {
+    size_t ret = 0;
+    for (const auto & node : succ_map_) ret += node.second.size();
+    return ret;
+  }
+
+  /// Check if an edge exists from a to b, edge lists are sorted
   bool exists_edge(const NodeType & a, const NodeType & b) const {
-    return (std::find(succ_map_.at(a).begin(), succ_map_.at(a).end(), b) != succ_map_.at(a).end() and
-            std::find(pred_map_.at(b).begin(), pred_map_.at(b).end(), a) != pred_map_.at(b).end());
+    return (std::binary_search(succ_map_.at(a).begin(), succ_map_.at(a).end(), b) and
+            std::binary_search(pred_map_.at(b).begin(), pred_map_.at(b).end(), a));
   }
 
  private:
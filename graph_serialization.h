@@ -0,0 +1,280 @@
+#ifndef GRAPH_SERIALIZATION_H_
+#define GRAPH_SERIALIZATION_H_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "graph.h"
+
+/// Binary and DOT serialization of Graph, so that downstream tools
+/// (stage mapper, visualizer) needn't reparse the textual operator<< dump.
+///
+/// Binary format, all integers little-endian:
+///   magic           8 bytes "JHGRAPH1"
+///   num_nodes       uint64
+///   num_edges       uint64
+///   row_offsets     uint64[num_nodes + 1], byte offsets into the edge stream
+///   label_offsets   uint64[num_nodes + 1], byte offsets into the label blob
+///   label blob      node labels back to back, as operator<< prints nodes
+///   edge stream     per node, its successors' indices as LEB128 varints,
+///                   the first one as is, the rest as gaps to the previous one
+/// Nodes are numbered in node_set() order, in which successor lists are sorted,
+/// so gaps are positive and mostly small. The fixed-width offset tables
+/// give random access to any node's label and successors without parsing the file.
+namespace graph_serialization {
+
+static const char kMagic[8] = {'J', 'H', 'G', 'R', 'A', 'P', 'H', '1'};
+
+inline void write_u64(std::ostream & out, uint64_t value) {
+  char bytes[8];
+  for (auto & byte : bytes) {
+    byte = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+  out.write(bytes, sizeof(bytes));
+}
+
+inline uint64_t read_u64(const unsigned char * bytes) {
+  uint64_t ret = 0;
+  for (int i = 7; i >= 0; i--) ret = (ret << 8) | bytes[i];
+  return ret;
+}
+
+inline void append_varint(std::string & out, uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+/// Number of node in graph, given the graph's nodes in node_set() order
+template <class NodeType>
+uint64_t index_of(const std::vector<NodeType> & nodes, const NodeType & node) {
+  return static_cast<uint64_t>(std::lower_bound(nodes.begin(), nodes.end(), node) - nodes.begin());
+}
+
+/// Node label in DOT's double-quoted string syntax
+inline void write_dot_string(std::ostream & out, const std::string & label) {
+  out << '"';
+  for (const auto c : label) {
+    if (c == '"' or c == '\\') out << '\\' << c;
+    else if (c == '\n') out << "\\n";
+    else out << c;
+  }
+  out << '"';
+}
+
+}  // namespace graph_serialization
+
+/// Write graph in the binary format above
+template <class NodeType>
+void write_binary(const Graph<NodeType> & graph, std::ostream & out) {
+  using namespace graph_serialization;
+  const std::vector<NodeType> nodes(graph.node_set().begin(), graph.node_set().end());
+
+  // Labels and edges are built in memory first, for their offset tables
+  std::string labels;
+  std::string edges;
+  std::vector<uint64_t> label_offsets = {0};
+  std::vector<uint64_t> row_offsets = {0};
+  std::ostringstream label;
+  for (const auto & node : graph.node_set()) {
+    label.str("");
+    graph.print_node(label, node);
+    labels += label.str();
+    label_offsets.emplace_back(labels.size());
+
+    uint64_t previous = 0;
+    for (const auto & succ : graph.succ_map().at(node)) {
+      const auto succ_index = index_of(nodes, succ);
+      append_varint(edges, succ_index - previous);
+      previous = succ_index;
+    }
+    row_offsets.emplace_back(edges.size());
+  }
+
+  out.write(kMagic, sizeof(kMagic));
+  write_u64(out, graph.node_set().size());
+  write_u64(out, graph.num_edges());
+  for (const auto offset : row_offsets) write_u64(out, offset);
+  for (const auto offset : label_offsets) write_u64(out, offset);
+  out.write(labels.data(), static_cast<std::streamsize>(labels.size()));
+  out.write(edges.data(), static_cast<std::streamsize>(edges.size()));
+}
+
+/// Write graph to file_name in the binary format above
+template <class NodeType>
+void save_binary(const Graph<NodeType> & graph, const std::string & file_name) {
+  std::ofstream out(file_name, std::ios::binary);
+  write_binary(graph, out);
+  if (not out) throw std::runtime_error("save_binary: can't write " + file_name + "\n");
+}
+
+/// Write graph in Graphviz DOT syntax, streaming: each node's label
+/// is formatted once, edges refer to nodes by index
+template <class NodeType>
+void write_dot(const Graph<NodeType> & graph, std::ostream & out, const std::string & name = "G") {
+  const std::vector<NodeType> nodes(graph.node_set().begin(), graph.node_set().end());
+  std::ostringstream label;
+  out << "digraph ";
+  graph_serialization::write_dot_string(out, name);
+  out << " {\n";
+  for (size_t i = 0; i < nodes.size(); i++) {
+    label.str("");
+    graph.print_node(label, nodes.at(i));
+    out << "  n" << i << " [label=";
+    graph_serialization::write_dot_string(out, label.str());
+    out << "];\n";
+  }
+  for (size_t i = 0; i < nodes.size(); i++) {
+    for (const auto & succ : graph.succ_map().at(nodes.at(i))) {
+      out << "  n" << i << " -> n" << graph_serialization::index_of(nodes, succ) << ";\n";
+    }
+  }
+  out << "}\n";
+}
+
+/// Read-only view of a graph file in the binary format above, memory-mapped:
+/// opening it only checks the header and offset tables, labels and successor lists
+/// are read straight from the mapping when asked for
+class GraphView {
+ public:
+  explicit GraphView(const std::string & file_name) : data_(nullptr), size_(0), num_nodes_(0), num_edges_(0),
+                                                      labels_(nullptr), edges_(nullptr) {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("GraphView: can't open " + file_name + "\n");
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+      close(fd);
+      throw std::runtime_error("GraphView: can't stat " + file_name + "\n");
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    void * mapping = size_ == 0 ? MAP_FAILED : mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) throw std::runtime_error("GraphView: can't map " + file_name + "\n");
+    data_ = static_cast<const unsigned char *>(mapping);
+    try {
+      check();
+    } catch (...) {
+      munmap(const_cast<unsigned char *>(data_), size_);
+      throw;
+    }
+  }
+
+  /// The view owns the mapping
+  GraphView(const GraphView &) = delete;
+  GraphView & operator=(const GraphView &) = delete;
+
+  ~GraphView() { munmap(const_cast<unsigned char *>(data_), size_); }
+
+  uint64_t num_nodes() const { return num_nodes_; }
+  uint64_t num_edges() const { return num_edges_; }
+
+  /// Label of node number node, in node_set() order of the graph written
+  std::string label(const uint64_t node) const {
+    const auto begin = label_offset(node);
+    return std::string(reinterpret_cast<const char *>(labels_ + begin), label_offset(node + 1) - begin);
+  }
+
+  /// Call function on the number of each successor of node number node, in increasing order
+  template <class Function>
+  void for_each_successor(const uint64_t node, const Function & function) const {
+    const auto * position = edges_ + row_offset(node);
+    const auto * end = edges_ + row_offset(node + 1);
+    uint64_t succ = 0;
+    while (position != end) {
+      uint64_t gap = 0;
+      for (unsigned shift = 0;; shift += 7) {
+        if (position == end or shift > 63) throw std::runtime_error("GraphView: truncated successor list\n");
+        const auto byte = *position++;
+        gap |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) break;
+      }
+      succ += gap;
+      if (succ >= num_nodes_) throw std::runtime_error("GraphView: successor out of range\n");
+      function(succ);
+    }
+  }
+
+  /// Successor numbers of node number node, in increasing order
+  std::vector<uint64_t> successors(const uint64_t node) const {
+    std::vector<uint64_t> ret;
+    for_each_successor(node, [&ret] (const uint64_t succ) { ret.emplace_back(succ); });
+    return ret;
+  }
+
+  /// Rebuild the Graph, turning labels back into nodes with parse
+  /// and printing nodes with node_printer
+  template <class NodeType>
+  Graph<NodeType> to_graph(const std::function<NodeType(const std::string &)> & parse,
+                           const std::function<std::string(const NodeType)> & node_printer = {}) const {
+    Graph<NodeType> ret(node_printer);
+    std::vector<NodeType> nodes;
+    nodes.reserve(num_nodes_);
+    for (uint64_t i = 0; i < num_nodes_; i++) {
+      nodes.emplace_back(parse(label(i)));
+      ret.add_node(nodes.back());
+    }
+    for (uint64_t i = 0; i < num_nodes_; i++) {
+      for_each_successor(i, [&ret, &nodes, i] (const uint64_t succ)
+                         { ret.add_edge(nodes.at(i), nodes.at(succ)); });
+    }
+    return ret;
+  }
+
+ private:
+  static const uint64_t kHeaderSize = sizeof(graph_serialization::kMagic) + 2 * sizeof(uint64_t);
+
+  uint64_t u64_at(const uint64_t offset) const { return graph_serialization::read_u64(data_ + offset); }
+  uint64_t row_offset(const uint64_t node) const { return u64_at(kHeaderSize + 8 * node); }
+  uint64_t label_offset(const uint64_t node) const { return u64_at(kHeaderSize + 8 * (num_nodes_ + 1 + node)); }
+
+  /// Check the header and that the offset tables are increasing and stay within the file
+  void check() {
+    if (size_ < kHeaderSize or std::memcmp(data_, graph_serialization::kMagic, sizeof(graph_serialization::kMagic)) != 0) {
+      throw std::runtime_error("GraphView: not a graph file\n");
+    }
+    num_nodes_ = u64_at(sizeof(graph_serialization::kMagic));
+    num_edges_ = u64_at(sizeof(graph_serialization::kMagic) + 8);
+    if (num_nodes_ > (size_ - kHeaderSize) / 16) throw std::runtime_error("GraphView: truncated offset tables\n");
+    const uint64_t tables_end = kHeaderSize + 16 * (num_nodes_ + 1);
+    if (tables_end > size_) throw std::runtime_error("GraphView: truncated offset tables\n");
+    const auto check_table = [this] (const std::function<uint64_t(uint64_t)> & offset, const uint64_t limit) {
+      if (offset(0) != 0) throw std::runtime_error("GraphView: corrupt offset table\n");
+      for (uint64_t i = 0; i < num_nodes_; i++) {
+        if (offset(i + 1) < offset(i) or offset(i + 1) > limit) throw std::runtime_error("GraphView: corrupt offset table\n");
+      }
+    };
+    check_table([this] (const uint64_t node) { return label_offset(node); }, size_ - tables_end);
+    const uint64_t labels_size = label_offset(num_nodes_);
+    check_table([this] (const uint64_t node) { return row_offset(node); }, size_ - tables_end - labels_size);
+    if (tables_end + labels_size + row_offset(num_nodes_) != size_) throw std::runtime_error("GraphView: trailing bytes\n");
+    labels_ = data_ + tables_end;
+    edges_ = labels_ + labels_size;
+  }
+
+  /// Mapped file and its size
+  const unsigned char * data_;
+  size_t size_;
+
+  uint64_t num_nodes_;
+  uint64_t num_edges_;
+
+  /// Label blob and edge stream within the mapping
+  const unsigned char * labels_;
+  const unsigned char * edges_;
+};
+
+#endif  // GRAPH_SERIALIZATION_H_
@@ -0,0 +1,178 @@
+#ifndef GUARD_EVALUATOR_H_
+#define GUARD_EVALUATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "boolean_algebra.h"
+
+/// Struct-of-arrays batch of condition bits for a number of packets:
+/// one bit vector per condition, bit i of which is that condition for packet i.
+/// Bit vectors are padded to a multiple of 256 bits, padding bits are zero.
+class ConditionBatch {
+ public:
+  /// Words of 64 bits in one 256-bit vector
+  static const size_t kWordsPerVector = 4;
+
+  ConditionBatch(const std::vector<std::string> & t_conditions, const size_t t_num_packets)
+    : conditions_(t_conditions),
+      num_packets_(t_num_packets),
+      num_words_((t_num_packets + 255) / 256 * kWordsPerVector),
+      bits_(t_conditions.size(), std::vector<uint64_t>(num_words_, 0)) {}
+
+  /// Set value of condition column for packet
+  void set(const size_t column, const size_t packet, const bool value) {
+    auto & word = bits_.at(column).at(packet / 64);
+    const uint64_t bit = uint64_t(1) << (packet % 64);
+    word = value ? (word | bit) : (word & ~bit);
+  }
+
+  /// Get value of condition column for packet
+  bool get(const size_t column, const size_t packet) const {
+    return (bits_.at(column).at(packet / 64) >> (packet % 64)) & 1;
+  }
+
+  /// Accessors
+  const auto & conditions() const { return conditions_; }
+  size_t num_packets() const { return num_packets_; }
+  size_t num_words() const { return num_words_; }
+  const uint64_t * column(const size_t t_column) const { return bits_.at(t_column).data(); }
+
+ private:
+  /// Condition names, in column order
+  std::vector<std::string> conditions_;
+
+  /// Number of packets in the batch
+  size_t num_packets_;
+
+  /// Number of 64-bit words per column, a multiple of kWordsPerVector
+  size_t num_words_;
+
+  /// One bit vector per column
+  std::vector<std::vector<uint64_t>> bits_;
+};
+
+/// Guard expression compiled against the columns of a ConditionBatch.
+/// evaluate() computes the guard for all packets in a batch with bitwise ops,
+/// 256 packets at a time: one AND (or ANDNOT for negated atoms)
+/// per literal and one OR per clause.
+class GuardEvaluator {
+ public:
+  /// Compile guard, looking up each atom among the batch's condition names
+  GuardEvaluator(const Dnf & guard, const std::vector<std::string> & conditions) {
+    if (guard.is_literal()) {
+      constant_ = true;
+      value_ = guard.is_literal(true);
+      return;
+    }
+    for (const auto & clause : guard.clauses()) {
+      std::vector<Literal> literals;
+      for (const auto & atom : clause.atoms()) {
+        const auto it = std::find(conditions.begin(), conditions.end(), atom.var_name());
+        if (atom.is_literal() or it == conditions.end()) {
+          throw std::logic_error("GuardEvaluator: no condition column for atom " + atom.var_name() + "\n");
+        }
+        literals.emplace_back(Literal{static_cast<size_t>(it - conditions.begin()), atom.pristine()});
+      }
+      clauses_.emplace_back(literals);
+    }
+  }
+
+  /// Evaluate guard on every packet in batch, bit i of masks is the guard for packet i
+  void evaluate(const ConditionBatch & batch, std::vector<uint64_t> & masks) const {
+    masks.assign(batch.num_words(), 0);
+    if (constant_) {
+      if (value_) fill_ones(batch, masks);
+      return;
+    }
+
+#ifdef __AVX2__
+    for (size_t w = 0; w < batch.num_words(); w += ConditionBatch::kWordsPerVector) {
+      __m256i acc = _mm256_setzero_si256();
+      for (const auto & clause : clauses_) {
+        __m256i conj = _mm256_set1_epi64x(-1);
+        for (const auto & literal : clause) {
+          const __m256i bits = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(batch.column(literal.column) + w));
+          conj = literal.pristine ? _mm256_and_si256(conj, bits) : _mm256_andnot_si256(bits, conj);
+        }
+        acc = _mm256_or_si256(acc, conj);
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(masks.data() + w), acc);
+    }
+#else
+    // Same computation on 64-bit words, which compilers can vectorize
+    for (size_t w = 0; w < batch.num_words(); w += ConditionBatch::kWordsPerVector) {
+      uint64_t acc[ConditionBatch::kWordsPerVector] = {0};
+      for (const auto & clause : clauses_) {
+        uint64_t conj[ConditionBatch::kWordsPerVector] = {~uint64_t(0), ~uint64_t(0), ~uint64_t(0), ~uint64_t(0)};
+        for (const auto & literal : clause) {
+          const uint64_t * bits = batch.column(literal.column) + w;
+          for (size_t i = 0; i < ConditionBatch::kWordsPerVector; i++) {
+            conj[i] &= literal.pristine ? bits[i] : ~bits[i];
+          }
+        }
+        for (size_t i = 0; i < ConditionBatch::kWordsPerVector; i++) acc[i] |= conj[i];
+      }
+      std::copy(acc, acc + ConditionBatch::kWordsPerVector, masks.data() + w);
+    }
+#endif
+
+    // Negated atoms set padding bits, clear them
+    clear_padding(batch, masks);
+  }
+
+  /// Whether evaluate() uses AVX2, i.e., whether this was compiled with -mavx2
+  static bool uses_avx2() {
+#ifdef __AVX2__
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /// Evaluate guard on a single packet, one literal at a time
+  bool evaluate(const ConditionBatch & batch, const size_t packet) const {
+    if (constant_) return value_;
+    return std::any_of(clauses_.begin(), clauses_.end(), [&batch, packet] (const std::vector<Literal> & clause)
+                       { return std::all_of(clause.begin(), clause.end(), [&batch, packet] (const Literal & literal)
+                                            { return batch.get(literal.column, packet) == literal.pristine; }); });
+  }
+
+ private:
+  /// Column of an atom in the batch and whether the atom is negated
+  struct Literal {
+    size_t column;
+    bool pristine;
+  };
+
+  /// Set bits for all packets in the batch
+  static void fill_ones(const ConditionBatch & batch, std::vector<uint64_t> & masks) {
+    std::fill(masks.begin(), masks.end(), ~uint64_t(0));
+    clear_padding(batch, masks);
+  }
+
+  /// Clear bits past the last packet in the batch
+  static void clear_padding(const ConditionBatch & batch, std::vector<uint64_t> & masks) {
+    const size_t full_words = batch.num_packets() / 64;
+    if (batch.num_packets() % 64 != 0) {
+      masks.at(full_words) &= (uint64_t(1) << (batch.num_packets() % 64)) - 1;
+      std::fill(masks.begin() + static_cast<std::ptrdiff_t>(full_words + 1), masks.end(), 0);
+    } else {
+      std::fill(masks.begin() + static_cast<std::ptrdiff_t>(full_words), masks.end(), 0);
+    }
+  }
+
+  /// Clauses of the compiled guard, as vectors of literals
+  std::vector<std::vector<Literal>> clauses_ = {};
+
+  /// Whether the guard is a constant, and if so, its value
+  bool constant_ = false;
+  bool value_ = false;
+};
+
+#endif  // GUARD_EVALUATOR_H_
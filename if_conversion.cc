@@ -1,49 +1,229 @@
-#include <iostream>
 #include "llvm/IR/Instructions.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/CFG.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include "utility_functions.h"
 #include "if_conversion.h"
+#include "instrumentation.h"
+#include "analysis_output.h"
+#include "analysis_cache.h"
 
 using namespace llvm;
 
+/// Count the clauses and atoms of expr in the running phase
+static void count_dnf(const IfConversion::BoolExpr & expr) {
+  if (not Instrumentation::enabled()) return;
+  PhaseTimer::count("clauses", expr.clauses().size());
+  for (const auto & clause : expr.clauses()) PhaseTimer::count("atoms", clause.atoms().size());
+}
+
+/// Kind of IfConversion results in the analysis cache, bump when the results change
+static const std::string kCacheKind = "if_conversion.1";
+
+/// Atoms in the analysis cache: a literal's value, or a variable's polarity and name
+enum : uint64_t { kFalseAtom = 0, kTrueAtom = 1, kVariable = 2, kNegatedVariable = 3 };
+
+static void write_dnf(BlobWriter & out, const IfConversion::BoolExpr & expr) {
+  out.u64(expr.clauses().size());
+  for (const auto & clause : expr.clauses()) {
+    out.u64(clause.atoms().size());
+    for (const auto & atom : clause.atoms()) {
+      if (atom.is_literal()) {
+        out.u64(atom.is_literal(true) ? kTrueAtom : kFalseAtom);
+      } else {
+        out.u64(atom.pristine() ? kVariable : kNegatedVariable);
+        out.string(atom.var_name());
+      }
+    }
+  }
+}
+
+static IfConversion::BoolExpr read_dnf(BlobReader & in) {
+  IfConversion::BoolExpr ret;
+  const auto num_clauses = in.u64();
+  for (uint64_t i = 0; i < num_clauses; i++) {
+    std::vector<Atom> atoms;
+    const auto num_atoms = in.u64();
+    if (num_atoms == 0) throw std::runtime_error("read_dnf: empty clause\n");
+    for (uint64_t j = 0; j < num_atoms; j++) {
+      const auto kind = in.u64();
+      if (kind == kFalseAtom or kind == kTrueAtom) atoms.emplace_back(Atom::make_literal(kind == kTrueAtom));
+      else if (kind == kVariable or kind == kNegatedVariable) atoms.emplace_back(in.string(), kind == kVariable);
+      else throw std::runtime_error("read_dnf: bad atom\n");
+    }
+    ret += Conjunction(atoms);
+  }
+  return ret;
+}
+
+std::string IfConversion::save_states(const Function & func) const {
+  std::map<const BasicBlock *, uint64_t> numbers;
+  for (const auto & bb : func) numbers.emplace(&bb, numbers.size());
+  BlobWriter out;
+  out.u64(in_states_.size());
+  for (const auto & state : in_states_) {
+    out.u64(numbers.at(state.first));
+    write_dnf(out, state.second);
+    const auto & edges = out_states_.at(state.first);
+    out.u64(edges.size());
+    for (const auto & edge : edges) {
+      out.u64(numbers.at(edge.first));
+      write_dnf(out, edge.second);
+    }
+  }
+  return out.blob();
+}
+
+bool IfConversion::load_states(const Function & func, const std::string & blob) {
+  PhaseTimer timer("cache load");
+  std::vector<const BasicBlock *> blocks;
+  for (const auto & bb : func) blocks.emplace_back(&bb);
+  try {
+    BlobReader in(blob);
+    const auto num_states = in.u64();
+    for (uint64_t i = 0; i < num_states; i++) {
+      const auto * bb = blocks.at(in.u64());
+      in_states_[bb] = read_dnf(in);
+      BranchConditions edges;
+      const auto num_edges = in.u64();
+      for (uint64_t j = 0; j < num_edges; j++) {
+        const auto * succ = blocks.at(in.u64());
+        edges.emplace_back(succ, read_dnf(in));
+      }
+      out_states_[bb] = std::move(edges);
+    }
+    in.finish();
+  } catch (const std::exception &) {
+    out_states_.clear();
+    in_states_.clear();
+    return false;
+  }
+  return true;
+}
+
 bool IfConversion::runOnFunction(Function & func) {
-  errs() << "IfConversion: ";
-  errs().write_escaped(func.getName()) << '\n';
-  for(auto instr = inst_begin(func); instr != inst_end(func); ++instr) {
-    instr->print(errs());
-    errs() << "\n";
+  // All clause storage for this function comes from arena_
+  releaseMemory();
+  ArenaScope arena_scope(arena_);
+  PhaseTimer timer("IfConversion", Instrumentation::enabled() ? func.getName().str() : std::string());
+
+  if (AnalysisOutput::enabled(Verbosity::kTrace)) {
+    auto & out = AnalysisOutput::stream();
+    out << "IfConversion: " << func.getName().str() << '\n';
+    for(auto instr = inst_begin(func); instr != inst_end(func); ++instr) {
+      out << instr_printer(&*instr) << "\n";
+    }
   }
 
   // Check that there are no back edges
   SmallVector<std::pair<const BasicBlock *, const BasicBlock *>, 100> result;
   FindFunctionBackedges(func, result);
   if (result.size() > 0) {
-    throw std::invalid_argument("Supplied function body has a loop\n");
+    throw std::invalid_argument("Supplied function body has a loop, run -bounded_loop_unroll first\n");
   }
 
-  // Now propagate path conditions in topologically sorted order
-  // Reverse Post Order Traversal gets us topological sort
-  ReversePostOrderTraversal<const Function*> rpot(&func);
-  for (ReversePostOrderTraversal<const Function *>::rpo_iterator it = rpot.begin(); it != rpot.end(); ++it) {
-    const auto * current_bb = *it;
+  // Unreachable blocks are valid IR, but reverse post order never visits them,
+  // so they'd have no path conditions
+  const bool removed_unreachable = removeUnreachableBlocks(func);
 
-    /// Get "out" vectors of all predecessors
-    std::vector<BranchConditions> out_preds;
-    for (const_pred_iterator pi = pred_begin(current_bb); pi != pred_end(current_bb); ++pi) {
-      out_preds.emplace_back(out_states_.at(*pi));
+  // Reuse the path conditions of a function with the same body if there are any
+  auto * cache = AnalysisCache::current();
+  const auto key = cache != nullptr ? timed_phase("fingerprint", [&func] () { return function_fingerprint(func); })
+                                    : Fingerprint();
+  std::string blob;
+  const bool cached = cache != nullptr and cache->lookup(kCacheKind, key, blob) and load_states(func, blob);
+
+  if (not cached) {
+    // Now propagate path conditions in topologically sorted order
+    // Reverse Post Order Traversal gets us topological sort
+    ReversePostOrderTraversal<const Function*> rpot(&func);
+    for (ReversePostOrderTraversal<const Function *>::rpo_iterator it = rpot.begin(); it != rpot.end(); ++it) {
+      const auto * current_bb = *it;
+
+      /// Get "out" vectors of all predecessors, without copying them
+      std::vector<const BranchConditions *> out_preds;
+      for (const_pred_iterator pi = pred_begin(current_bb); pi != pred_end(current_bb); ++pi) {
+        out_preds.emplace_back(&out_states_.at(*pi));
+      }
+
+      {
+        PhaseTimer join_timer("join");
+        in_states_[current_bb] = join_fn(current_bb, out_preds);
+        count_dnf(in_states_.at(current_bb));
+      }
+      PhaseTimer transfer_timer("transfer");
+      out_states_[current_bb] = transfer_fn(current_bb, in_states_.at(current_bb));
+      for (const auto & edge : out_states_.at(current_bb)) count_dnf(edge.second);
     }
+    if (cache != nullptr) cache->store(kCacheKind, key, save_states(func));
+  }
+
+  const bool modified = timed_phase("dead blocks", [this, &func] () { return remove_dead_blocks(func); }) or removed_unreachable;
+  timed_phase("guards", [this, &func] () { emit_guards(func); });
+  PhaseTimer::count("arena_bytes", arena_.bytes_allocated());
 
-    in_states_[current_bb]  = join_fn(current_bb, out_preds);
-    out_states_[current_bb] = transfer_fn(current_bb, in_states_.at(current_bb));
+  if (AnalysisOutput::enabled(Verbosity::kSummary)) {
+    AnalysisOutput::stream() << "IfConversion: " << func.getName().str() << ": " << in_states_.size() << " live blocks, "
+                             << predicate_dag_.num_operations() << " predicate operations"
+                             << (cached ? ", cached" : "") << "\n";
+  }
+  if (AnalysisOutput::enabled(Verbosity::kResults)) {
+    auto & out = AnalysisOutput::stream();
+    out << "Predicate registers (" << predicate_dag_.num_operations() << " operations)\n" << predicate_dag_;
+    for (const auto & bb : func) {
+      out << bb_printer(&bb) << " guarded by p" << guard_registers_.at(&bb) << "\n";
+    }
+  }
+  AnalysisOutput::flush();
+  return modified;
+}
+
+void IfConversion::emit_guards(const Function & func) {
+  for (const auto & bb : func) {
+    guard_registers_[&bb] = predicate_dag_.add_guard(in_states_.at(&bb));
+  }
+}
+
+bool IfConversion::remove_dead_blocks(Function & func) {
+  // Fold conditional branches with one unsatisfiable edge
+  // into unconditional branches to the other successor
+  bool modified = false;
+  for (auto & bb : func) {
+    auto * branch = dyn_cast<BranchInst>(bb.getTerminator());
+    if (branch == nullptr or not branch->isConditional() or in_states_.at(&bb).is_literal(false)) continue;
+    const auto & out_state = out_states_.at(&bb);
+    assert(out_state.size() == 2);
+    for (unsigned int i = 0; i < 2; i++) {
+      if (out_state.at(i).second.is_literal(false)) {
+        auto * live_successor = branch->getSuccessor(1 - i);
+        branch->getSuccessor(i)->removePredecessor(&bb);
+        BranchInst::Create(live_successor, branch);
+        branch->eraseFromParent();
+        modified = true;
+        break;
+      }
+    }
   }
 
-  return false;
+  // Blocks whose path condition is unsatisfiable are now unreachable
+  for (auto it = in_states_.begin(); it != in_states_.end();) {
+    if (it->second.is_literal(false)) {
+      if (AnalysisOutput::enabled(Verbosity::kResults)) {
+        AnalysisOutput::stream() << "Removing dead block " << bb_printer(it->first) << "\n";
+      }
+      out_states_.erase(it->first);
+      it = in_states_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return removeUnreachableBlocks(func) or modified;
 }
 
 IfConversion::BranchConditions IfConversion::transfer_fn(const BasicBlock * bb, const BoolExpr & in) const {
   const auto * terminator_inst = bb->getTerminator();
-  std::cout << "Incoming edge " << in << "\n";
+  const bool trace = AnalysisOutput::enabled(Verbosity::kTrace);
+  if (trace) AnalysisOutput::stream() << "Incoming edge " << in << "\n";
 
   if (isa<BranchInst>(terminator_inst)) {
     const auto * branch = dyn_cast<BranchInst>(terminator_inst);
@@ -51,26 +231,34 @@ IfConversion::BranchConditions IfConversion::transfer_fn(const BasicBlock * bb,
       assert(branch->getNumSuccessors() == 2);
 
       // TODO: 0 and 1 are assumed to point to true and false respectively
-      auto true_condition = in * Conjunction(Atom(value_printer(branch->getCondition()), true));
-      true_condition.simplify();
-      const auto true_edge  = std::make_pair(branch->getSuccessor(0), true_condition);
+      const auto condition = value_printer(branch->getCondition());
+      auto true_condition = in * Conjunction(Atom(condition, true));
+      fold_constant_guard(true_condition);
+
+      auto false_condition = in * Conjunction(Atom(condition, false));
+      fold_constant_guard(false_condition);
 
-      auto false_condition = in * Conjunction(Atom(value_printer(branch->getCondition()), false));
-      false_condition.simplify();
-      const auto false_edge = std::make_pair(branch->getSuccessor(1), false_condition);
+      // Move conditions into the edges instead of copying them
+      BranchConditions ret;
+      ret.reserve(2);
+      ret.emplace_back(branch->getSuccessor(0), std::move(true_condition));
+      ret.emplace_back(branch->getSuccessor(1), std::move(false_condition));
 
-      std::cout << "true_edge is " << true_edge.second << "\n";
-      std::cout << "false_edge is " << false_edge.second << "\n";
-      return {true_edge, false_edge};
+      if (trace) {
+        AnalysisOutput::stream() << "true_edge is " << ret.at(0).second << "\n"
+                                 << "false_edge is " << ret.at(1).second << "\n";
+      }
+      return ret;
     } else {
       assert(branch->getNumSuccessors() == 1);
-      const auto single_outgoing_edge = std::make_pair(branch->getSuccessor(0), in);
+      BranchConditions ret;
+      ret.emplace_back(branch->getSuccessor(0), in);
 
-      std::cout << "single_outgoing_edge is " << single_outgoing_edge.second << "\n";
-      return {single_outgoing_edge};
+      if (trace) AnalysisOutput::stream() << "single_outgoing_edge is " << ret.front().second << "\n";
+      return ret;
     }
   } else if (isa<ReturnInst>(bb->getTerminator())) {
-    std::cout << "Within a return instruction\n";
+    if (trace) AnalysisOutput::stream() << "Within a return instruction\n";
     return BranchConditions();
   } else {
     throw std::logic_error("Some other kind of branch\n");
@@ -79,25 +267,46 @@ IfConversion::BranchConditions IfConversion::transfer_fn(const BasicBlock * bb,
 }
 
 IfConversion::BoolExpr IfConversion::join_fn(const BasicBlock * bb,
-                                             const std::vector<BranchConditions> & outp) const {
+                                             const std::vector<const BranchConditions *> & outp) const {
   BoolExpr in;
   if (outp.empty()) {
-    in = in + Conjunction(Atom::make_literal(true));
+    in += Conjunction(Atom::make_literal(true));
     in.simplify();
     return in;
   } else {
-    for (const auto & br_conds : outp) {
-      for (const auto & br_edge : br_conds) {
+    for (const auto * br_conds : outp) {
+      for (const auto & br_edge : *br_conds) {
         // If edge points to this basic block, add its condition to a list of or operands
         if (br_edge.first == bb) {
-          in = in + br_edge.second;
+          in += br_edge.second;
         }
       }
     }
-    in.simplify();
+    // Every literal in a guard costs a match or an ALU op downstream
+    in.minimize();
+    fold_constant_guard(in);
     return in;
   }
 }
 
+void IfConversion::releaseMemory() {
+  // Clear out states before releasing the arena they were allocated from
+  out_states_.clear();
+  in_states_.clear();
+  arena_.release();
+  guard_registers_.clear();
+  predicate_dag_ = PredicateDag();
+}
+
+void IfConversion::fold_constant_guard(BoolExpr & guard) {
+  guard.simplify();
+  if (guard.is_literal()) return;
+  if (not guard.is_satisfiable()) {
+    guard = BoolExpr() + Conjunction(Atom::make_literal(false));
+  } else if (guard.is_tautology()) {
+    guard = BoolExpr() + Conjunction(Atom::make_literal(true));
+  }
+}
+
 char IfConversion::ID = 0;
 static RegisterPass<IfConversion> X("if_conversion", "Convert all branches into guarded statements.", false, false);
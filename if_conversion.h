@@ -8,7 +8,9 @@
 #include "llvm/IR/Function.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/InstIterator.h"
+#include "arena.h"
 #include "boolean_algebra.h"
+#include "predicate_dag.h"
 
 struct IfConversion : public llvm::FunctionPass {
  public:
@@ -30,6 +32,21 @@ struct IfConversion : public llvm::FunctionPass {
   /// Virtual function where all the work happens
   bool runOnFunction(llvm::Function & func) override;
 
+  /// Release path conditions for the last function in bulk
+  void releaseMemory() override;
+
+  /// Path condition of a live block of the last function, until releaseMemory()
+  const BoolExpr & in_state(const llvm::BasicBlock * bb) const { return in_states_.at(bb); }
+
+  /// Conditions on the edges out of a live block of the last function, until releaseMemory()
+  const BranchConditions & out_state(const llvm::BasicBlock * bb) const { return out_states_.at(bb); }
+
+  /// Predicate registers computing the guards of the last function
+  const PredicateDag & predicate_dag() const { return predicate_dag_; }
+
+  /// Predicate register holding the guard of a block of the last function
+  PredicateDag::NodeId guard_register(const llvm::BasicBlock * bb) const { return guard_registers_.at(bb); }
+
  private:
   void bb_walk(const llvm::BasicBlock * bb, const llvm::Value * incoming_condition = {});
 
@@ -40,15 +57,45 @@ struct IfConversion : public llvm::FunctionPass {
 
   /// Join function for path condition propagation
   /// Arguments are current basic block bb
-  /// and a vector of outgoing BranchConditions,
+  /// and a vector of pointers to outgoing BranchConditions,
   /// one for each predecessor
-  BoolExpr join_fn(const llvm::BasicBlock * bb, const std::vector<BranchConditions> & outp) const;
+  BoolExpr join_fn(const llvm::BasicBlock * bb, const std::vector<const BranchConditions *> & outp) const;
+
+  /// Serialize in and out states for the analysis cache,
+  /// referring to blocks by their position in func
+  std::string save_states(const llvm::Function & func) const;
+
+  /// Set in and out states from what save_states saved for a function
+  /// with the same fingerprint as func, false if blob doesn't fit func
+  bool load_states(const llvm::Function & func, const std::string & blob);
+
+  /// Replace unsatisfiable guards with false
+  /// and tautological guards with true
+  static void fold_constant_guard(BoolExpr & guard);
+
+  /// Use path conditions to fold branches with an unsatisfiable edge
+  /// and delete blocks that can never execute, returns true if func changed
+  bool remove_dead_blocks(llvm::Function & func);
+
+  /// Compute guards of all blocks as one shared predicate DAG,
+  /// so that common prefixes of path conditions are computed once
+  void emit_guards(const llvm::Function & func);
+
+  /// Arena holding all clauses of in and out states for the current function,
+  /// declared before them so that they are destroyed first
+  Arena arena_ = {};
 
   /// Out states for each block
   std::map<const llvm::BasicBlock *, BranchConditions> out_states_ = {};
 
   /// In states for each block
   std::map<const llvm::BasicBlock *, BoolExpr> in_states_ = {};
+
+  /// Predicate registers shared by the guards of all blocks
+  PredicateDag predicate_dag_ = {};
+
+  /// Predicate register holding the guard for each block
+  std::map<const llvm::BasicBlock *, PredicateDag::NodeId> guard_registers_ = {};
 };
 
 #endif  // IF_CONVERSION_H_
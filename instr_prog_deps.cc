@@ -1,14 +1,49 @@
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <set>
 #include "llvm/Transforms/Utils/UnifyFunctionExitNodes.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
 #include "utility_functions.h"
 #include "instr_prog_deps.h"
 #include "graph.cc"
 #include "dominator_utility.cc"
+#include "instrumentation.h"
+#include "analysis_output.h"
+#include "graph_serialization.h"
+#include "analysis_cache.h"
 
 using namespace llvm;
 
+/// Kind of InstrProgDeps results in the analysis cache, bump when the results change
+static const std::string kCacheKind = "instr_prog_deps.1";
+
+/// Stem of the source file module was compiled from, e.g., "packet" for "tests/packet.c",
+/// so that graph files of functions of the same name in different files don't clash.
+/// Characters other than letters, digits, '-', '_' and '.' become '_'.
+static std::string module_stem(const Module & module) {
+  auto ret = module.getModuleIdentifier();
+  const auto slash = ret.rfind('/');
+  if (slash != std::string::npos) ret.erase(0, slash + 1);
+  const auto dot = ret.rfind('.');
+  if (dot != std::string::npos and dot > 0) ret.erase(dot);
+  for (auto & c : ret) {
+    if (not std::isalnum(static_cast<unsigned char>(c)) and c != '-' and c != '_' and c != '.') c = '_';
+  }
+  return ret.empty() ? "module" : ret;
+}
+
+/// Count the nodes and edges of graph in the running phase
+template <class NodeType>
+static void count_graph(const Graph<NodeType> & graph) {
+  if (not Instrumentation::enabled()) return;
+  PhaseTimer::count("nodes", graph.node_set().size());
+  PhaseTimer::count("edges", graph.num_edges());
+}
+
 auto InstrProgDeps::get_all_non_branch_inst(const Function & func) const {
   std::vector<const Instruction*> ret;
   for(auto instr = inst_begin(func); instr != inst_end(func); ++instr) {
@@ -26,30 +61,69 @@ auto InstrProgDeps::get_all_non_branch_inst(const Function & func) const {
 }
 
 auto InstrProgDeps::get_instr_data_dep(const Function & func) const {
+  PhaseTimer timer("IDDG");
+
   // Instruction-level data dependence graph
-  Graph<const llvm::Instruction*> iddg(instr_printer);
+  Graph<const llvm::Instruction*> iddg(instr_printer_);
 
   for (const auto & instr : get_all_non_branch_inst(func)) {
     iddg.add_node(instr);
   }
 
+  // An edge from each instruction to each of its users, walking the use lists
+  // rather than every pair of instructions, which is quadratic in the function size
+  std::set<const Instruction*> users;
   for (const auto & instr_a : iddg.node_set()) {
-    for (const auto & instr_b : iddg.node_set()) {
-      // if b exists among a's users
-      if (std::find(instr_a->users().begin(), instr_a->users().end(), instr_b) != instr_a->users().end()) {
-        iddg.add_edge(instr_a, instr_b);
-      }
+    // A user may use instr_a more than once, and appear as often among its users
+    users.clear();
+    for (const auto * user : instr_a->users()) {
+      const auto * instr_b = dyn_cast<Instruction>(user);
+      if (instr_b != nullptr and iddg.node_set().find(instr_b) != iddg.node_set().end()) users.insert(instr_b);
     }
+    for (const auto & instr_b : users) iddg.add_edge(instr_a, instr_b);
   }
 
-  std::cout << "iddg is \n" << iddg << "\n";
+  count_graph(iddg);
   return iddg;
 }
 
+auto InstrProgDeps::get_instr_mem_dep(const Function & func) const {
+  PhaseTimer timer("IMDG");
+
+  // Instruction-level memory dependence graph
+  Graph<const llvm::Instruction*> imdg(instr_printer_);
+
+  for (const auto & instr : get_all_non_branch_inst(func)) {
+    imdg.add_node(instr);
+  }
+
+  // Group loads and stores by the global they access
+  std::map<const GlobalVariable *, std::vector<const Instruction *>> accesses;
+  for (const auto & instr : imdg.node_set()) {
+    const auto * global = accessed_global(instr);
+    if (global != nullptr) accesses[global].emplace_back(instr);
+  }
+
+  for (const auto & global : accesses) {
+    for (const auto & instr_a : global.second) {
+      for (const auto & instr_b : global.second) {
+        if (instr_a != instr_b and (isa<StoreInst>(instr_a) or isa<StoreInst>(instr_b))) {
+          imdg.add_edge(instr_a, instr_b);
+        }
+      }
+    }
+  }
+
+  count_graph(imdg);
+  return imdg;
+}
+
 auto InstrProgDeps::augment_cfg(const Graph<const BasicBlock*> & cfg, const BasicBlock * start_node) const {
-  // Step 1: Create entry and exit blocks
-  const auto * entry_block = BasicBlock::Create(getGlobalContext(), "entry");
-  const auto * exit_block  = BasicBlock::Create(getGlobalContext(), "exit");
+  PhaseTimer timer("augment");
+
+  // Step 1: Take the entry and exit blocks runOnFunction created
+  const BasicBlock * entry_block = entry_block_.get();
+  const BasicBlock * exit_block = exit_block_.get();
 
   // Step 1.1: Add these nodes the the augmented cfg
   auto augmented_cfg(cfg);
@@ -77,46 +151,52 @@ auto InstrProgDeps::augment_cfg(const Graph<const BasicBlock*> & cfg, const Basi
   // Step 3.2: Connect return_blocks.front() to exit block
   augmented_cfg.add_edge(return_blocks.front(), exit_block);
 
+  count_graph(augmented_cfg);
   return augmented_cfg;
 }
 
 
 auto InstrProgDeps::get_block_ctrl_dep(const Function & func) const {
   // Setup control flow graph container
-  Graph<const BasicBlock*> cfg(bb_printer);
+  Graph<const BasicBlock*> cfg(bb_printer_);
+  {
+    PhaseTimer timer("CFG build");
 
-  // First pass: Just get nodes alone
-  for (auto it = func.begin(); it != func.end(); it++) {
-    cfg.add_node(it);
-  }
+    // First pass: Just get nodes alone
+    for (auto it = func.begin(); it != func.end(); it++) {
+      cfg.add_node(it);
+    }
 
-  // Second pass: Now add edges
-  for (auto it = func.begin(); it != func.end(); it++) {
-    for (unsigned int i = 0; i < it->getTerminator()->getNumSuccessors(); i++) {
-      cfg.add_edge(it, (it->getTerminator()->getSuccessor(i)));
+    // Second pass: Now add edges
+    for (auto it = func.begin(); it != func.end(); it++) {
+      for (unsigned int i = 0; i < it->getTerminator()->getNumSuccessors(); i++) {
+        cfg.add_edge(it, (it->getTerminator()->getSuccessor(i)));
+      }
     }
+    count_graph(cfg);
   }
 
   // Augment with entry and exit
   auto augmented_cfg = augment_cfg(cfg, func.begin());
 
   // Flip graph
-  auto flipped_cfg = augmented_cfg.transpose();
+  auto flipped_cfg = timed_phase("transpose", [&augmented_cfg] () { return augmented_cfg.transpose(); });
 
-  // Get pointer to exit node
-  const BasicBlock* exit_node = nullptr;
-  for (const auto basic_block : augmented_cfg.node_set()) {
-    if (basic_block->getName() == "exit") {
-      exit_node = basic_block;
-    }
-  }
-  assert(exit_node != nullptr);
+  const BasicBlock* exit_node = exit_block_.get();
 
-  // Get post dominance frontier
-  auto postdom_frontier = DominatorUtility<const BasicBlock*>(flipped_cfg,
-                                                              exit_node).dominance_frontier();
+  // Get post dominance frontier. Blocks are labelled by position for the analysis cache,
+  // so that functions whose CFGs have the same shape share postdominators.
+  std::map<const BasicBlock*, std::string> labels;
+  for (const auto & bb : func) labels.emplace(&bb, std::to_string(labels.size()));
+  const std::function<std::string(const BasicBlock * const &)> label = [&labels] (const BasicBlock * const & bb) {
+    const auto it = labels.find(bb);
+    return it != labels.end() ? it->second : "augmented " + bb->getName().str();
+  };
+  auto postdom_frontier = cached_dominator_utility(AnalysisCache::current(), flipped_cfg,
+                                                   exit_node, label)->dominance_frontier();
 
   // Get control dependence graph
+  PhaseTimer timer("CDG");
   auto cdg = flipped_cfg.copy_and_clear();
   for (const auto & y : postdom_frontier) {
     for (const auto & x : y.second) {
@@ -124,41 +204,150 @@ auto InstrProgDeps::get_block_ctrl_dep(const Function & func) const {
       cdg.add_edge(x, y.first);
     }
   }
-
-  std::cout << "Control dependence graph \n" << cdg << "\n";
+  count_graph(cdg);
   return cdg;
 }
 
 
-auto InstrProgDeps::get_instr_ctrl_dep(const Function & func) const {
+auto InstrProgDeps::get_instr_ctrl_dep(const Function & func, const Graph<const BasicBlock*> & cdg) const {
+  PhaseTimer timer("ICDG");
+
   // Instruction-level control dependence graph
-  Graph<const Instruction*> icdg(instr_printer);
+  Graph<const Instruction*> icdg(instr_printer_);
 
   // Get all non-branch instructions.
   for (const auto & inst : get_all_non_branch_inst(func)) {
     icdg.add_node(inst);
   }
 
-  // Get control dependence graph of basic blocks
-  const auto cdg = get_block_ctrl_dep(func);
-
-  for (const auto instr_a : icdg.node_set()) {
-    for (const auto instr_b : icdg.node_set()) {
-      if (cdg.exists_edge(instr_a->getParent(), instr_b->getParent())) {
-        icdg.add_edge(instr_a, instr_b);
+  // Every instruction of a block depends on every instruction of the blocks it's control dependent on:
+  // walk the CDG's edges rather than every pair of instructions, which is quadratic in the function size
+  std::map<const BasicBlock*, std::vector<const Instruction*>> block_instrs;
+  for (const auto instr : icdg.node_set()) block_instrs[instr->getParent()].emplace_back(instr);
+  for (const auto & block_a : block_instrs) {
+    for (const auto block_b : cdg.succ_map().at(block_a.first)) {
+      const auto instrs_b = block_instrs.find(block_b);
+      if (instrs_b == block_instrs.end()) continue;
+      for (const auto instr_a : block_a.second) {
+        for (const auto instr_b : instrs_b->second) icdg.add_edge(instr_a, instr_b);
       }
     }
   }
 
-  std::cout << "icdg is \n" << icdg << "\n";
+  count_graph(icdg);
   return icdg;
 }
 
+std::string InstrProgDeps::save_results(const Function & func) const {
+  std::map<const BasicBlock*, uint64_t> block_numbers;
+  for (const auto & bb : func) block_numbers.emplace(&bb, block_numbers.size());
+  // The augmented entry and exit blocks come after func's own
+  for (const auto & bb : block_cdg_.node_set()) {
+    if (bb->getParent() == nullptr) block_numbers.emplace(bb, func.size() + (bb == entry_block_.get() ? 0u : 1u));
+  }
+  std::map<const Instruction*, uint64_t> instr_numbers;
+  for (auto instr = inst_begin(func); instr != inst_end(func); ++instr) instr_numbers.emplace(&*instr, instr_numbers.size());
+
+  BlobWriter out;
+  write_edges(out, block_cdg_, block_numbers);
+  write_edges(out, icdg_, instr_numbers);
+  write_edges(out, iddg_, instr_numbers);
+  write_edges(out, imdg_, instr_numbers);
+  return out.blob();
+}
+
+bool InstrProgDeps::load_results(const Function & func, const std::string & blob) {
+  PhaseTimer timer("cache load");
+  std::vector<const BasicBlock*> blocks;
+  for (const auto & bb : func) blocks.emplace_back(&bb);
+  blocks.emplace_back(entry_block_.get());
+  blocks.emplace_back(exit_block_.get());
+  std::vector<const Instruction*> instrs;
+  for (auto instr = inst_begin(func); instr != inst_end(func); ++instr) instrs.emplace_back(&*instr);
+
+  block_cdg_ = Graph<const BasicBlock*>(bb_printer_);
+  for (const auto & bb : blocks) block_cdg_.add_node(bb);
+  Graph<const Instruction*> no_deps(instr_printer_);
+  for (const auto & instr : get_all_non_branch_inst(func)) no_deps.add_node(instr);
+  icdg_ = iddg_ = imdg_ = no_deps;
+  try {
+    BlobReader in(blob);
+    read_edges(in, block_cdg_, blocks);
+    read_edges(in, icdg_, instrs);
+    read_edges(in, iddg_, instrs);
+    read_edges(in, imdg_, instrs);
+    in.finish();
+  } catch (const std::exception &) {
+    return false;
+  }
+  return true;
+}
+
 bool InstrProgDeps::runOnFunction(Function & func) {
-  std::cout <<"Instruction-level prog. dep gh \n" << (get_instr_ctrl_dep(func) + get_instr_data_dep(func)) << "\n";
+  PhaseTimer timer("InstrProgDeps", Instrumentation::enabled() ? func.getName().str() : std::string());
+
+  // Fresh printers for every function: instructions of earlier ones may be gone,
+  // and their addresses reused
+  instr_printer_ = memoized_printer<const Instruction*>(instr_printer);
+  bb_printer_ = memoized_printer<const BasicBlock*>(bb_printer);
+
+  // Blocks augmenting the CFG, reused for every function rather than leaked per function
+  if (not entry_block_) entry_block_.reset(BasicBlock::Create(func.getContext(), "entry"));
+  if (not exit_block_) exit_block_.reset(BasicBlock::Create(func.getContext(), "exit"));
+
+  // Reuse the results for a function with the same body if there are any
+  auto * cache = AnalysisCache::current();
+  const auto key = cache != nullptr ? timed_phase("fingerprint", [&func] () { return function_fingerprint(func); })
+                                    : Fingerprint();
+  std::string blob;
+  const bool cached = cache != nullptr and cache->lookup(kCacheKind, key, blob) and load_results(func, blob);
+  if (not cached) {
+    block_cdg_ = get_block_ctrl_dep(func);
+    icdg_ = get_instr_ctrl_dep(func, block_cdg_);
+    iddg_ = get_instr_data_dep(func);
+    imdg_ = get_instr_mem_dep(func);
+    if (cache != nullptr) cache->store(kCacheKind, key, save_results(func));
+  }
+  {
+    PhaseTimer union_timer("union");
+    pdg_ = icdg_ + iddg_ + imdg_;
+    count_graph(pdg_);
+  }
+
+  if (AnalysisOutput::enabled(Verbosity::kSummary)) {
+    AnalysisOutput::stream() << "InstrProgDeps: " << func.getName().str() << ": " << pdg_.node_set().size()
+                             << " instructions, " << pdg_.num_edges() << " dependences (" << icdg_.num_edges()
+                             << " control, " << iddg_.num_edges() << " data, " << imdg_.num_edges() << " memory)"
+                             << (cached ? ", cached" : "") << "\n";
+  }
+  if (AnalysisOutput::enabled(Verbosity::kTrace)) {
+    AnalysisOutput::stream() << "Control dependence graph \n" << block_cdg_ << "\n"
+                             << "icdg is \n" << icdg_ << "\n"
+                             << "iddg is \n" << iddg_ << "\n"
+                             << "imdg is \n" << imdg_ << "\n";
+  }
+  if (AnalysisOutput::enabled(Verbosity::kResults)) {
+    AnalysisOutput::stream() << "Instruction-level prog. dep gh \n" << pdg_ << "\n";
+  }
+  if (not AnalysisOutput::graph_dir().empty()) {
+    const auto base = AnalysisOutput::graph_dir() + "/" + module_stem(*func.getParent()) + "." + func.getName().str() + ".pdg";
+    save_binary(pdg_, base + ".jhg");
+    std::ofstream dot(base + ".dot");
+    write_dot(pdg_, dot, func.getName().str());
+    if (not dot.flush()) throw std::runtime_error("InstrProgDeps: can't write " + base + ".dot\n");
+  }
+  AnalysisOutput::flush();
   return false;
 }
 
+void InstrProgDeps::releaseMemory() {
+  // Clear out the graphs before deleting the blocks they refer to
+  block_cdg_ = Graph<const BasicBlock*>(bb_printer);
+  icdg_ = iddg_ = imdg_ = pdg_ = Graph<const Instruction*>(instr_printer);
+  entry_block_.reset();
+  exit_block_.reset();
+}
+
 void InstrProgDeps::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
   AU.addRequired<UnifyFunctionExitNodes>();
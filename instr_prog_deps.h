@@ -2,9 +2,13 @@
 #define INSTR_PROG_DEPS_H_
 
 #include <iostream>
+#include <functional>
+#include <memory>
+#include <string>
 #include "llvm/Pass.h"
 #include "llvm/IR/Function.h"
 #include "graph.h"
+#include "utility_functions.h"
 
 /// LLVM pass to unify data dependencies and
 /// control dependencies for a program into one
@@ -26,6 +30,21 @@ struct InstrProgDeps : public llvm::FunctionPass {
   /// get_block_ctrl_dep()
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const;
 
+  /// Release the dependence graphs of the last function and the blocks augmenting its CFG
+  void releaseMemory() override;
+
+  /// Instruction-level program dependence graph of the last function run on:
+  /// control, data and memory dependences
+  const Graph<const llvm::Instruction*> & pdg() const { return pdg_; }
+
+  /// Parts of pdg(): block-level control dependences, and instruction-level
+  /// control, data and memory dependences. These are computed and kept
+  /// whatever the verbosity, see AnalysisOutput for what gets printed.
+  const Graph<const llvm::BasicBlock*> & block_cdg() const { return block_cdg_; }
+  const Graph<const llvm::Instruction*> & icdg() const { return icdg_; }
+  const Graph<const llvm::Instruction*> & iddg() const { return iddg_; }
+  const Graph<const llvm::Instruction*> & imdg() const { return imdg_; }
+
  private:
   /// Get all non-branch instructions in a given
   /// function. (TODO: Check this is ok).
@@ -41,7 +60,15 @@ struct InstrProgDeps : public llvm::FunctionPass {
   /// SSA makes def-use almost trivial
   auto get_instr_data_dep(const llvm::Function & func) const;
 
-  /// 1. Add two fake basic blocks: "entry" and "exit".
+  /// Get instruction-level memory dependence graph.
+  /// Loads and stores of the same global variable depend on each other
+  /// both ways whenever one of them is a store: within a run of the function
+  /// the later one depends on the earlier one, and across runs, i.e., packets,
+  /// the earlier one depends on the later one. Every read-modify-write of a global
+  /// hence ends up in one strongly connected component.
+  auto get_instr_mem_dep(const llvm::Function & func) const;
+
+  /// 1. Add two fake basic blocks: "entry" and "exit", entry_block_ and exit_block_.
   /// 2. Append "exit" block to the block containing the return statement.
   /// We assume there's only one return, because this pass depends on mergereturn
   /// 3. Create dummy branch instruction from "entry" to
@@ -59,12 +86,38 @@ struct InstrProgDeps : public llvm::FunctionPass {
   /// 4. Compute control dependence graph from postdom frontiers
   auto get_block_ctrl_dep(const llvm::Function & func) const;
 
-  /// Lower control dependences to the level of instructions.
+  /// Lower control dependences, cdg, to the level of instructions.
   /// Instruction A is control dependent on Instruction B if its
   /// enclosing basic block BB{A} is control dependent on B's
   /// enclosing basic block BB{B}. This generalization is taken
   /// from Ferrante's paper.
-  auto get_instr_ctrl_dep(const llvm::Function & func) const;
+  auto get_instr_ctrl_dep(const llvm::Function & func, const Graph<const llvm::BasicBlock*> & cdg) const;
+
+  /// Serialize block_cdg_, icdg_, iddg_ and imdg_ for the analysis cache,
+  /// referring to blocks and instructions by their position in func
+  std::string save_results(const llvm::Function & func) const;
+
+  /// Set block_cdg_, icdg_, iddg_ and imdg_ from what save_results saved
+  /// for a function with the same fingerprint as func, false if blob doesn't fit func
+  bool load_results(const llvm::Function & func, const std::string & blob);
+
+  /// Printers for the graphs of the current function, formatting each node at most once
+  std::function<std::string(const llvm::Instruction*)> instr_printer_ = instr_printer;
+  std::function<std::string(const llvm::BasicBlock*)> bb_printer_ = bb_printer;
+
+  /// Fake "entry" and "exit" blocks of augmented CFGs, in no function, created once
+  /// and shared by every function run on until releaseMemory()
+  std::unique_ptr<llvm::BasicBlock> entry_block_ = nullptr;
+  std::unique_ptr<llvm::BasicBlock> exit_block_ = nullptr;
+
+  /// Dependence graphs of the last function
+  Graph<const llvm::BasicBlock*> block_cdg_ = Graph<const llvm::BasicBlock*>(bb_printer);
+  Graph<const llvm::Instruction*> icdg_ = Graph<const llvm::Instruction*>(instr_printer);
+  Graph<const llvm::Instruction*> iddg_ = Graph<const llvm::Instruction*>(instr_printer);
+  Graph<const llvm::Instruction*> imdg_ = Graph<const llvm::Instruction*>(instr_printer);
+
+  /// Program dependence graph of the last function
+  Graph<const llvm::Instruction*> pdg_ = Graph<const llvm::Instruction*>(instr_printer);
 };
 
 #endif  // INSTR_PROG_DEPS_H_
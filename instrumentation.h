@@ -0,0 +1,372 @@
+#ifndef INSTRUMENTATION_H_
+#define INSTRUMENTATION_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/resource.h>
+
+/// Reset the peak resident set size to the current one, where the kernel allows it
+inline void reset_peak_rss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  if (clear_refs) clear_refs << "5";
+}
+
+/// Peak resident set size in kB since the last reset_peak_rss(), or since the start
+inline long peak_rss_kb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) return std::stol(line.substr(6));
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/// One run of a phase of an analysis on one function
+struct PhaseRecord {
+  std::string function = "";
+  std::string phase = "";
+
+  /// Nesting depth, 0 for phases not nested in another one
+  unsigned depth = 0;
+
+  /// Nanoseconds from Instrumentation::enable() to the start of the phase, and its duration
+  uint64_t start_ns = 0;
+  uint64_t duration_ns = 0;
+
+  /// Heap allocations made and bytes allocated during the phase by the thread running it,
+  /// less those of the timers of its sub-phases
+  uint64_t allocations = 0;
+  uint64_t allocated_bytes = 0;
+
+  /// Peak resident set size of the process at the end of the phase, sampled for
+  /// phases not nested in another one only, 0 for the others
+  long peak_rss_kb = 0;
+
+  /// Named counts, e.g., nodes, edges, clauses or atoms
+  std::map<std::string, uint64_t> counters = {};
+};
+
+/// Process-wide switch and sink for PhaseTimers.
+/// While disabled, which is the default, every entry point
+/// costs a single load of a flag and records nothing.
+class Instrumentation {
+ public:
+  /// Start recording, dropping records from earlier runs
+  static void enable() {
+    std::lock_guard<std::mutex> lock(mutex());
+    records().clear();
+    epoch() = std::chrono::steady_clock::now();
+    enabled_flag().store(true, std::memory_order_relaxed);
+  }
+
+  /// Stop recording, records stay around for reports
+  static void disable() { enabled_flag().store(false, std::memory_order_relaxed); }
+
+  static bool enabled() { return enabled_flag().load(std::memory_order_relaxed); }
+
+  /// Count a heap allocation of bytes on this thread, for use by a counting operator new or allocator
+  static void record_allocation(const size_t bytes) {
+    if (not enabled()) return;
+    allocation_count()++;
+    allocation_bytes() += bytes;
+  }
+
+  /// Allocations and bytes recorded on this thread while enabled
+  static uint64_t allocations() { return allocation_count(); }
+  static uint64_t allocated_bytes() { return allocation_bytes(); }
+
+  /// Records of all phases finished so far, in the order they started
+  static std::vector<PhaseRecord> phases() {
+    std::lock_guard<std::mutex> lock(mutex());
+    auto ret = records();
+    std::stable_sort(ret.begin(), ret.end(), [] (const PhaseRecord & a, const PhaseRecord & b)
+                     { return a.start_ns < b.start_ns or (a.start_ns == b.start_ns and a.depth < b.depth); });
+    return ret;
+  }
+
+  /// JSON report: every phase run, followed by per-function totals, slowest function first,
+  /// to find the function in a module that blows up compile time
+  static void write_json(std::ostream & out) {
+    const auto all = phases();
+    out << "{\n  \"phases\": [";
+    for (size_t i = 0; i < all.size(); i++) {
+      const auto & phase = all.at(i);
+      out << (i == 0 ? "\n" : ",\n") << "    {\"function\": " << quoted(phase.function)
+          << ", \"phase\": " << quoted(phase.phase) << ", \"depth\": " << phase.depth
+          << ", \"start_ns\": " << phase.start_ns << ", \"duration_ns\": " << phase.duration_ns
+          << ", \"allocations\": " << phase.allocations << ", \"allocated_bytes\": " << phase.allocated_bytes
+          << ", \"peak_rss_kb\": " << phase.peak_rss_kb << ", \"counters\": " << counters_json(phase.counters) << "}";
+    }
+    out << "\n  ],\n  \"functions\": [";
+
+    // Time spent in each function's outermost phases
+    std::map<std::string, uint64_t> function_ns;
+    for (const auto & phase : all) {
+      if (phase.depth == 0) function_ns[phase.function] += phase.duration_ns;
+    }
+    std::vector<std::pair<std::string, uint64_t>> functions(function_ns.begin(), function_ns.end());
+    std::stable_sort(functions.begin(), functions.end(), [] (const std::pair<std::string, uint64_t> & a,
+                                                             const std::pair<std::string, uint64_t> & b)
+                     { return a.second > b.second; });
+    for (size_t i = 0; i < functions.size(); i++) {
+      out << (i == 0 ? "\n" : ",\n") << "    {\"function\": " << quoted(functions.at(i).first)
+          << ", \"duration_ns\": " << functions.at(i).second << "}";
+    }
+    out << "\n  ]\n}\n";
+  }
+
+  /// Chrome trace event format, for chrome://tracing or Perfetto:
+  /// one complete event per phase, on one track per function
+  static void write_chrome_trace(std::ostream & out) {
+    const auto all = phases();
+    std::map<std::string, size_t> tracks;
+    out << "{\"traceEvents\": [";
+    for (size_t i = 0; i < all.size(); i++) {
+      const auto & phase = all.at(i);
+      const auto track = tracks.emplace(phase.function, tracks.size() + 1).first->second;
+      auto args = phase.counters;
+      args["allocations"] = phase.allocations;
+      args["allocated_bytes"] = phase.allocated_bytes;
+      args["peak_rss_kb"] = static_cast<uint64_t>(phase.peak_rss_kb);
+      out << (i == 0 ? "\n" : ",\n") << "  {\"name\": " << quoted(phase.phase) << ", \"cat\": " << quoted(phase.function)
+          << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << track << ", \"ts\": " << microseconds(phase.start_ns)
+          << ", \"dur\": " << microseconds(phase.duration_ns) << ", \"args\": " << counters_json(args) << "}";
+    }
+    for (const auto & track : tracks) {
+      out << (all.empty() ? "\n" : ",\n") << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << track.second
+          << ", \"args\": {\"name\": " << quoted(track.first) << "}}";
+    }
+    out << "\n]}\n";
+  }
+
+  /// Write the JSON report or, if chrome_trace is set, the Chrome trace to file_name
+  static void write(const std::string & file_name, const bool chrome_trace) {
+    std::ofstream out(file_name);
+    if (not out) throw std::runtime_error("Instrumentation: can't write " + file_name + "\n");
+    if (chrome_trace) write_chrome_trace(out);
+    else write_json(out);
+  }
+
+ private:
+  friend class PhaseTimer;
+
+  /// Function-local statics of trivial types are constant-initialized, so these need no guards.
+  /// Allocations are counted per thread, so that a phase only sees its own thread's,
+  /// and operator new never contends on a shared counter.
+  static std::atomic<bool> & enabled_flag() {
+    static std::atomic<bool> flag(false);
+    return flag;
+  }
+  static uint64_t & allocation_count() {
+    static thread_local uint64_t count = 0;
+    return count;
+  }
+  static uint64_t & allocation_bytes() {
+    static thread_local uint64_t bytes = 0;
+    return bytes;
+  }
+
+  static std::mutex & mutex() {
+    static std::mutex records_mutex;
+    return records_mutex;
+  }
+
+  static std::vector<PhaseRecord> & records() {
+    static std::vector<PhaseRecord> finished;
+    return finished;
+  }
+
+  static std::chrono::steady_clock::time_point & epoch() {
+    static std::chrono::steady_clock::time_point start;
+    return start;
+  }
+
+  static void add(PhaseRecord && record) {
+    std::lock_guard<std::mutex> lock(mutex());
+    records().emplace_back(std::move(record));
+  }
+
+  /// String as a JSON string literal
+  static std::string quoted(const std::string & str) {
+    std::string ret = "\"";
+    for (const auto c : str) {
+      if (c == '"' or c == '\\') {
+        ret += '\\';
+        ret += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        static const char * const kHex = "0123456789abcdef";
+        ret += "\\u00";
+        ret += kHex[(c >> 4) & 0xf];
+        ret += kHex[c & 0xf];
+      } else {
+        ret += c;
+      }
+    }
+    return ret + "\"";
+  }
+
+  static std::string counters_json(const std::map<std::string, uint64_t> & counters) {
+    std::string ret = "{";
+    for (const auto & counter : counters) {
+      ret += (ret.size() == 1 ? "" : ", ") + quoted(counter.first) + ": " + std::to_string(counter.second);
+    }
+    return ret + "}";
+  }
+
+  /// Trace timestamps are in microseconds
+  static std::string microseconds(const uint64_t ns) {
+    std::ostringstream ret;
+    ret << ns / 1000 << "." << (ns % 1000) / 100 << (ns % 100) / 10 << ns % 10;
+    return ret.str();
+  }
+};
+
+/// Times the scope it lives in as one run of a phase, while Instrumentation is enabled.
+/// Timers nest: a timer started while another one is running on the same thread
+/// is a sub-phase of it and, unless given one, takes its function name.
+/// count() adds to the counters of the innermost running timer.
+/// Phase and counter names are literals, so that disabled timers build no strings.
+/// The time and allocations a timer spends on its own bookkeeping, e.g., adding its record,
+/// are left out of the phases it's nested in.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(const char * phase, const std::string & function = std::string())
+      : running_(Instrumentation::enabled()), parent_(running_ ? current() : nullptr),
+        start_(), record_(), own_(), nested_() {
+    if (not running_) return;
+    const auto entered = std::chrono::steady_clock::now();
+    const auto entered_allocations = Instrumentation::allocations();
+    const auto entered_bytes = Instrumentation::allocated_bytes();
+    record_.function = (function.empty() and parent_ != nullptr) ? parent_->record_.function : function;
+    record_.phase = phase;
+    record_.depth = parent_ == nullptr ? 0 : parent_->record_.depth + 1;
+    current() = this;
+    record_.allocations = Instrumentation::allocations();
+    record_.allocated_bytes = Instrumentation::allocated_bytes();
+    own_.allocations = record_.allocations - entered_allocations;
+    own_.allocated_bytes = record_.allocated_bytes - entered_bytes;
+    start_ = std::chrono::steady_clock::now();
+    own_.ns = since(entered, start_);
+  }
+
+  /// Timers are tied to their scope
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer & operator=(const PhaseTimer &) = delete;
+
+  ~PhaseTimer() {
+    if (not running_) return;
+    const auto end = std::chrono::steady_clock::now();
+    const auto end_allocations = Instrumentation::allocations();
+    const auto end_bytes = Instrumentation::allocated_bytes();
+    record_.start_ns = since(Instrumentation::epoch(), start_);
+    record_.duration_ns = since(start_, end) - nested_.ns;
+    record_.allocations = end_allocations - record_.allocations - nested_.allocations;
+    record_.allocated_bytes = end_bytes - record_.allocated_bytes - nested_.allocated_bytes;
+    if (parent_ == nullptr) {
+      // Reading /proc/self/status would cost far more than the phases it measures
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage) == 0) record_.peak_rss_kb = usage.ru_maxrss;
+    }
+    current() = parent_;
+    Instrumentation::add(std::move(record_));
+    if (parent_ == nullptr) return;
+
+    // The parent's run includes this timer's bookkeeping, and that of the timers nested in it
+    parent_->nested_.ns += nested_.ns + own_.ns + since(end, std::chrono::steady_clock::now());
+    parent_->nested_.allocations += nested_.allocations + own_.allocations + Instrumentation::allocations() - end_allocations;
+    parent_->nested_.allocated_bytes += nested_.allocated_bytes + own_.allocated_bytes +
+                                        Instrumentation::allocated_bytes() - end_bytes;
+  }
+
+  /// Add value to counter name of the innermost running timer on this thread, if any
+  static void count(const char * name, const uint64_t value) {
+    if (not Instrumentation::enabled() or current() == nullptr) return;
+    const auto allocations = Instrumentation::allocations();
+    const auto allocated_bytes = Instrumentation::allocated_bytes();
+    current()->record_.counters[name] += value;
+    // A new counter is bookkeeping too
+    current()->nested_.allocations += Instrumentation::allocations() - allocations;
+    current()->nested_.allocated_bytes += Instrumentation::allocated_bytes() - allocated_bytes;
+  }
+
+ private:
+  /// Time and allocations spent on timer bookkeeping rather than on a phase
+  struct Overhead {
+    uint64_t ns = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+  };
+
+  /// Innermost running timer on this thread
+  static PhaseTimer * & current() {
+    static thread_local PhaseTimer * innermost = nullptr;
+    return innermost;
+  }
+
+  static uint64_t since(const std::chrono::steady_clock::time_point & from, const std::chrono::steady_clock::time_point & to) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+  }
+
+  /// Whether this timer is recording, fixed at construction
+  const bool running_;
+
+  /// Timer this one is nested in
+  PhaseTimer * const parent_;
+
+  std::chrono::steady_clock::time_point start_;
+  PhaseRecord record_;
+
+  /// Bookkeeping of this timer's constructor
+  Overhead own_;
+
+  /// Bookkeeping of the timers nested in this one and of its counters, excluded from its record
+  Overhead nested_;
+};
+
+/// Run function as one run of phase and return its result,
+/// for timing the initialization of members
+template <class Function>
+auto timed_phase(const char * phase, const Function & function) {
+  PhaseTimer timer(phase);
+  return function();
+}
+
+/// Standard allocator that counts its allocations in Instrumentation,
+/// for containers whose allocations aren't seen by a counting operator new
+template <class T>
+class CountingAllocator {
+ public:
+  typedef T value_type;
+
+  CountingAllocator() noexcept {}
+  template <class U>
+  CountingAllocator(const CountingAllocator<U> &) noexcept {}
+
+  T * allocate(const size_t n) {
+    Instrumentation::record_allocation(n * sizeof(T));
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T * pointer, const size_t n) noexcept { std::allocator<T>().deallocate(pointer, n); }
+
+  template <class U>
+  bool operator==(const CountingAllocator<U> &) const { return true; }
+  template <class U>
+  bool operator!=(const CountingAllocator<U> &) const { return false; }
+};
+
+#endif  // INSTRUMENTATION_H_
@@ -0,0 +1,126 @@
+#ifndef JAYHAWK_RUNTIME_H_
+#define JAYHAWK_RUNTIME_H_
+
+/* Interface between code generated by transform_driver -harness
+   and the runtime that feeds it packets, e.g., pcap_harness */
+
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Store pointers to the next packets of at least min_length bytes in packets,
+   at most max_packets of them, and return how many. 0 means there are no more.
+   Packets are presented in place, not copied. */
+unsigned jayhawk_next_burst(void ** packets, unsigned max_packets, unsigned long min_length);
+
+/* Run the packet-processing loop until jayhawk_next_burst returns 0 */
+void jayhawk_entry(void);
+
+/* Sharded programs (transform_driver -shards N -flow_key ...) define these instead:
+   the number of shards, the size of a packet on the wire, the shard of a packet,
+   and the packet-processing loop of one shard, which fetches its packets
+   with jayhawk_next_shard_burst and takes the lock around bursts touching shared state */
+extern const unsigned jayhawk_num_shards;
+extern const unsigned long jayhawk_packet_size;
+unsigned jayhawk_flow_shard(const void * packet);
+void jayhawk_shard_entry(unsigned shard);
+
+/* Like jayhawk_next_burst, for the packets steered to shard */
+unsigned jayhawk_next_shard_burst(unsigned shard, void ** packets, unsigned max_packets, unsigned long min_length);
+
+/* Lock serializing shards around state they share */
+void jayhawk_lock(void);
+void jayhawk_unlock(void);
+
+/* Programs whose commutative aggregates AtomicStateLowering replicated per shard
+   (transform_driver -lower_state_dir) define this to fold the replicas into the aggregates;
+   call it with the shards stopped */
+void jayhawk_merge_state(void);
+
+/* Pipelined programs (transform_driver -stages N) define these instead:
+   the number of stages, the size of a packet on the wire, the size of the record
+   each stage but the last passes to the next one, and the stages themselves.
+   Stage 0 takes count packet pointers from in, later stages take count records
+   from in, and every stage but the last writes count records to out. */
+extern const unsigned jayhawk_num_stages;
+extern const unsigned long jayhawk_stage_record_size[];
+void jayhawk_stage(unsigned stage, void * in, void * out, unsigned count);
+
+/* Mix the bytes of value into an FNV-1a flow hash */
+#define JAYHAWK_HASH_SEED 2166136261u
+static inline unsigned jayhawk_hash(unsigned hash, unsigned long long value) {
+  unsigned i;
+  for (i = 0; i < sizeof(value); i++) {
+    hash ^= (unsigned) (value & 0xff);
+    hash *= 16777619u;
+    value >>= 8;
+  }
+  return hash;
+}
+
+/* On the wire, the fields of a packet struct follow each other in declaration order,
+   each at its declared width (bit fields at theirs), without padding,
+   most significant byte and bit first. Load the width-bit field
+   at bit_offset of packet, width at most 64. Packets needn't be aligned. */
+static inline unsigned long long jayhawk_load_field(const unsigned char * packet, unsigned long bit_offset, unsigned width) {
+  const unsigned char * bytes = packet + bit_offset / 8;
+  unsigned long long value = 0;
+  unsigned i;
+  if (bit_offset % 8 == 0) {
+    uint16_t value16;
+    uint32_t value32[2];
+    switch (width) {
+      case 8: return bytes[0];
+      case 16: memcpy(&value16, bytes, sizeof(value16)); return ntohs(value16);
+      case 32: memcpy(value32, bytes, sizeof(value32[0])); return ntohl(value32[0]);
+      case 64: memcpy(value32, bytes, sizeof(value32));
+               return ((unsigned long long) ntohl(value32[0]) << 32) | ntohl(value32[1]);
+      default: break;
+    }
+  }
+  for (i = 0; i < width; i++) {
+    const unsigned long bit = bit_offset + i;
+    value = (value << 1) | (unsigned long long) ((packet[bit / 8] >> (7 - bit % 8)) & 1);
+  }
+  return value;
+}
+
+/* Store the low width bits of value as the field at bit_offset of packet */
+static inline void jayhawk_store_field(unsigned char * packet, unsigned long bit_offset, unsigned width, unsigned long long value) {
+  unsigned char * bytes = packet + bit_offset / 8;
+  unsigned i;
+  if (bit_offset % 8 == 0) {
+    uint16_t value16;
+    uint32_t value32[2];
+    switch (width) {
+      case 8: bytes[0] = (unsigned char) value; return;
+      case 16: value16 = htons((uint16_t) value); memcpy(bytes, &value16, sizeof(value16)); return;
+      case 32: value32[0] = htonl((uint32_t) value); memcpy(bytes, value32, sizeof(value32[0])); return;
+      case 64: value32[0] = htonl((uint32_t) (value >> 32));
+               value32[1] = htonl((uint32_t) value);
+               memcpy(bytes, value32, sizeof(value32)); return;
+      default: break;
+    }
+  }
+  for (i = 0; i < width; i++) {
+    const unsigned long bit = bit_offset + width - 1 - i;
+    const unsigned char mask = (unsigned char) (0x80u >> (bit % 8));
+    packet[bit / 8] = (unsigned char) (((value >> i) & 1) ? (packet[bit / 8] | mask) : (packet[bit / 8] & ~mask));
+  }
+}
+
+/* Value of a signed width-bit field loaded by jayhawk_load_field */
+static inline long long jayhawk_sign_extend(unsigned long long value, unsigned width) {
+  const unsigned long long sign = 1ull << (width - 1);
+  return (long long) ((value ^ sign) - sign);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* JAYHAWK_RUNTIME_H_ */
@@ -0,0 +1,422 @@
+#ifndef MEMBER_EXPR_HANDLER_H_
+#define MEMBER_EXPR_HANDLER_H_
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include "clang/AST/AST.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Tooling/Refactoring.h"
+#include "clang_utility_functions.h"
+#include "field_packing.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+
+/// Place of a packet field on the wire (see jayhawk_load_field() in jayhawk_runtime.h),
+/// and C code moving it between a packet's bytes and a local
+struct WireField {
+  /// Name, e.g., p.x as written or x as a member, and type
+  std::string name = "";
+  std::string type = "";
+
+  /// Bit offset in the packet, and width
+  unsigned offset = 0;
+  unsigned width = 0;
+
+  /// Whether the field is an integer, the only fields with a wire format,
+  /// and whether it's a signed bit field, which needs sign extending
+  bool integer = true;
+  bool signed_bit_field = false;
+
+  /// Expression loading the field from the bytes at packet
+  std::string load(const std::string & packet) const {
+    check();
+    const auto bits = "jayhawk_load_field(" + packet + ", " + std::to_string(offset) + ", " + std::to_string(width) + ")";
+    return "(" + type + ") " + (signed_bit_field ? "jayhawk_sign_extend(" + bits + ", " + std::to_string(width) + ")" : bits);
+  }
+
+  /// Statement storing value as the field in the bytes at packet
+  std::string store(const std::string & packet, const std::string & value) const {
+    check();
+    return "jayhawk_store_field(" + packet + ", " + std::to_string(offset) + ", " + std::to_string(width) +
+           ", (unsigned long long) " + value + ");";
+  }
+
+ private:
+  void check() const {
+    if (not integer or width > 64) throw std::logic_error("Packet field " + name + " isn't an integer, so it can't be parsed\n");
+  }
+};
+
+class MemberExprHandler : public MatchFinder::MatchCallback {
+ public:
+  /// Declarations of the local variables each function needs, keyed by function name.
+  /// A function only gets declarations for fields it accesses itself.
+  /// In functions that run in bursts every local is an array with one element per packet of the burst.
+  auto get_decls() const {
+    std::map<std::string, std::set<std::string>> ret;
+    for (const auto & function : field_accesses_) {
+      for (const auto & field : function.second) {
+        ret[function.first].emplace(field.second.type + " " + field.first +
+                                    (in_bursts(function.first) ? "[" + std::to_string(burst_size_) + "]" : "") + ";\n");
+      }
+    }
+    return ret;
+  }
+
+  /// Parse/deparse manifest: for each function, the header fields
+  /// that must be extracted at ingress because some read may see the
+  /// incoming value, and the fields that must be written back at egress
+  /// because they are modified. Fields in neither list need no PHV space.
+  std::string manifest() const {
+    std::string ret;
+    for (const auto & function : field_accesses_) {
+      ret += function.first + "\n";
+      for (const auto & field : function.second) {
+        if (field.second.needs_parse()) ret += "  parse " + field.second.type + " " + field.second.name + "\n";
+      }
+      for (const auto & field : function.second) {
+        if (field.second.written) ret += "  deparse " + field.second.type + " " + field.second.name + "\n";
+      }
+    }
+    return ret;
+  }
+
+  /// Integer packet fields with their widths and places on the wire and the functions using them.
+  /// Every field here is parsed or deparsed, or both, so none is narrowed
+  /// below its wire width, which would truncate it on the way out.
+  std::vector<PacketField> packet_fields() const {
+    std::map<std::string, PacketField> fields;
+    for (const auto & function : field_accesses_) {
+      for (const auto & field : function.second) {
+        const auto & access = field.second;
+        if (not access.wire.integer) continue;
+        auto & packet_field = fields.emplace(access.name, PacketField{access.name, access.wire.width, {}, access.wire.offset})
+                                    .first->second;
+        packet_field.users.emplace(function.first);
+      }
+    }
+    std::vector<PacketField> ret;
+    for (const auto & field : fields) ret.emplace_back(field.second);
+    return ret;
+  }
+
+  /// Packed PHV layout of the packet fields with accessors, as a C header
+  std::string layout() const { return FieldLayout(packet_fields()).emit_c("PacketLayout"); }
+
+  /// Statements parsing the fields function needs out of the bytes
+  /// of the packet at index of the burst buffer into the struct-of-arrays locals
+  std::string gather(const std::string & function_name, const std::string & index) const {
+    std::string ret;
+    if (field_accesses_.find(function_name) == field_accesses_.end()) return ret;
+    for (const auto & field : field_accesses_.at(function_name)) {
+      if (field.second.needs_parse()) {
+        ret += field.first + "[" + index + "] = " + field.second.wire.load(burst_element(field.second, index)) + ";\n";
+      }
+    }
+    return ret;
+  }
+
+  /// Statements deparsing the fields function writes back into the bytes of the packet at index
+  std::string scatter(const std::string & function_name, const std::string & index) const {
+    std::string ret;
+    if (field_accesses_.find(function_name) == field_accesses_.end()) return ret;
+    for (const auto & field : field_accesses_.at(function_name)) {
+      if (field.second.written) {
+        ret += field.second.wire.store(burst_element(field.second, index), field.first + "[" + index + "]") + "\n";
+      }
+    }
+    return ret;
+  }
+
+  /// Burst buffers of pointers to the bytes of the packets function processes,
+  /// one per struct it accesses, as a map from buffer name to declaration
+  std::map<std::string, std::string> burst_buffers(const std::string & function_name) const {
+    std::map<std::string, std::string> ret;
+    if (field_accesses_.find(function_name) == field_accesses_.end()) return ret;
+    for (const auto & field : field_accesses_.at(function_name)) {
+      ret[burst_buffer(field.second)] = "unsigned char * " + burst_buffer(field.second) + "[" + std::to_string(burst_size_) + "];\n";
+    }
+    return ret;
+  }
+
+  /// Size in bytes on the wire of the packet struct whose fields function accesses, 0 if none
+  unsigned long packet_wire_bytes(const std::string & function_name) const {
+    const auto type = packet_type(function_name);
+    if (packet_wire_fields_.find(type) == packet_wire_fields_.end() or packet_wire_fields_.at(type).empty()) return 0;
+    const auto & last = packet_wire_fields_.at(type).back();
+    return (last.offset + last.width + 7) / 8;
+  }
+
+  /// Statements parsing every integer field of the packet struct whose fields
+  /// function accesses out of the bytes at packet into the members of target
+  std::string parse_packet(const std::string & function_name, const std::string & packet, const std::string & target) const {
+    std::string ret;
+    const auto type = packet_type(function_name);
+    if (packet_wire_fields_.find(type) == packet_wire_fields_.end()) return ret;
+    for (const auto & field : packet_wire_fields_.at(type)) {
+      if (field.integer) ret += target + "." + field.name + " = " + field.load(packet) + ";\n";
+    }
+    return ret;
+  }
+
+  /// Type of the packet struct whose fields function accesses, "" if none
+  std::string packet_type(const std::string & function_name) const {
+    if (field_accesses_.find(function_name) == field_accesses_.end() or field_accesses_.at(function_name).empty()) return "";
+    return field_accesses_.at(function_name).begin()->second.base_type;
+  }
+
+  /// Name of the packet whose fields function accesses, e.g., p, "" if none
+  std::string packet_base(const std::string & function_name) const {
+    if (field_accesses_.find(function_name) == field_accesses_.end() or field_accesses_.at(function_name).empty()) return "";
+    return field_accesses_.at(function_name).begin()->second.base;
+  }
+
+  /// A packet field as a local variable of one function
+  struct LocalField {
+    std::string type;
+    std::string member;
+
+    /// Whether it's parsed at ingress and deparsed at egress, see manifest()
+    bool parsed;
+    bool written;
+
+    /// Place on the wire, to parse it from and deparse it to
+    WireField wire;
+  };
+
+  /// Fields function accesses, keyed by local variable name
+  std::map<std::string, LocalField> local_fields(const std::string & function_name) const {
+    std::map<std::string, LocalField> ret;
+    if (field_accesses_.find(function_name) == field_accesses_.end()) return ret;
+    for (const auto & field : field_accesses_.at(function_name)) {
+      ret[field.first] = LocalField{field.second.type, field.second.member, field.second.needs_parse(), field.second.written,
+                                    field.second.wire};
+    }
+    return ret;
+  }
+
+  /// Names of the members of packet fields written by any function, e.g., x for p.x
+  std::set<std::string> written_members() const {
+    std::set<std::string> ret;
+    for (const auto & function : field_accesses_) {
+      for (const auto & field : function.second) if (field.second.written) ret.emplace(field.second.member);
+    }
+    return ret;
+  }
+
+  /// Index variable of the loop over the packets of a burst
+  static std::string burst_index() { return "pkt__i"; }
+
+  /// Constructor: Pass Refactoring tool as argument,
+  /// the burst size if fields should become struct-of-arrays locals indexed by packet,
+  /// and the only function that runs in bursts, if not all of them do
+  MemberExprHandler(Replacements & t_replace, const unsigned t_burst_size = 0, const std::string & t_burst_function = "")
+    : Replace(t_replace), burst_size_(t_burst_size), burst_function_(t_burst_function) {}
+
+  /// Whether function runs in bursts, with struct-of-arrays locals
+  bool in_bursts(const std::string & function_name) const {
+    return burst_size_ > 0 and (burst_function_.empty() or function_name == burst_function_);
+  }
+
+  /// Callback whenever there's a match
+  virtual void run(const MatchFinder::MatchResult &Result) override {
+    const MemberExpr *member_expr = Result.Nodes.getNodeAs<clang::MemberExpr>("memberExpr");
+    assert(member_expr != nullptr);
+    const auto * base        = member_expr->getBase();
+    const auto * member_decl = member_expr->getMemberDecl();
+
+    // Name of the local variable replacing this field
+    const auto local_name = clang_stmt_printer(base) + "__" + clang_value_decl_printer(member_decl);
+
+    // Record the access against the enclosing function, if any
+    const auto * function_decl = enclosing_function(*Result.Context, member_expr);
+    if (function_decl != nullptr) {
+      const auto function_name = function_decl->getNameAsString();
+      if (functions_with_labels_.find(function_name) == functions_with_labels_.end() and
+          contains_label(function_decl->getBody())) {
+        functions_with_labels_.emplace(function_name);
+      }
+      auto & field = field_accesses_[function_name][local_name];
+      field.type = member_decl->getType().getAsString();
+      field.name = clang_stmt_printer(base) + "." + clang_value_decl_printer(member_decl);
+      field.base = clang_stmt_printer(base);
+      field.member = clang_value_decl_printer(member_decl);
+      field.base_type = member_expr->isArrow() ? base->getType()->getPointeeType().getAsString()
+                                               : base->getType().getAsString();
+      const auto * field_decl = dyn_cast<FieldDecl>(member_decl);
+      if (field_decl != nullptr) {
+        // Every field of the struct on the wire, by member name, each after the ones declared before it
+        auto & packet = packet_wire_fields_[field.base_type];
+        if (packet.empty()) {
+          unsigned offset = 0;
+          for (const auto * other : field_decl->getParent()->fields()) {
+            packet.emplace_back(wire_field(*Result.Context, other->getNameAsString(), other, offset));
+            offset += packet.back().width;
+          }
+        }
+        for (const auto & other : packet) {
+          if (other.name == field.member) field.wire = wire_field(*Result.Context, field.name, field_decl, other.offset);
+        }
+      } else {
+        // A member of an anonymous struct or union has no place of its own
+        field.wire.name = field.name;
+        field.wire.type = field.type;
+        field.wire.width = static_cast<unsigned>(Result.Context->getTypeSize(member_decl->getType()));
+        field.wire.integer = false;
+      }
+      record_access(*Result.Context, *Result.SourceManager, member_expr, function_decl,
+                    functions_with_labels_.find(function_name) != functions_with_labels_.end(), field);
+    }
+
+    // Now, create replacement text
+    const bool burst = function_decl != nullptr and in_bursts(function_decl->getNameAsString());
+    Replacement Rep(*(Result.SourceManager), member_expr, burst ? local_name + "[" + burst_index() + "]" : local_name);
+
+    // Insert into this Replace
+    Replace.insert(Rep);
+  }
+
+ private:
+  /// Reads and writes of one field within one function
+  struct FieldAccess {
+    /// Type of the field and its name as written, e.g., p.x
+    std::string type = "";
+    std::string name = "";
+
+    /// Base and member of the name, and the type of the struct containing the field
+    std::string base = "";
+    std::string member = "";
+    std::string base_type = "";
+
+    /// Whether the field is ever read or written
+    bool read = false;
+    bool written = false;
+
+    /// File offset of the first read, and of the end of the first assignment
+    /// that overwrites the field on every path before any later read can run
+    unsigned first_read = UINT_MAX;
+    unsigned first_kill = UINT_MAX;
+
+    /// Place of the field on the wire
+    WireField wire = WireField();
+
+    /// A field needs parsing unless every read comes after an unconditional kill,
+    /// and a field that is only written conditionally needs its incoming value at egress
+    bool needs_parse() const { return (read and first_read < first_kill) or (written and first_kill == UINT_MAX); }
+  };
+
+  /// Classify member_expr as a read, a write or both, and update field accordingly
+  static void record_access(ASTContext & context, const SourceManager & source_manager,
+                            const MemberExpr * member_expr, const FunctionDecl * function_decl,
+                            const bool has_labels, FieldAccess & field) {
+    // Step out of parentheses to the expression that uses the field
+    const Stmt * child = member_expr;
+    auto parents = context.getParents(*child);
+    while (not parents.empty() and parents[0].get<ParenExpr>() != nullptr) {
+      child = parents[0].get<ParenExpr>();
+      parents = context.getParents(*child);
+    }
+    const auto * binary_op = parents.empty() ? nullptr : parents[0].get<BinaryOperator>();
+    const auto * unary_op  = parents.empty() ? nullptr : parents[0].get<UnaryOperator>();
+
+    bool is_read = true;
+    bool is_written = false;
+    if (binary_op != nullptr and binary_op->getLHS() == child and binary_op->isAssignmentOp()) {
+      // Plain assignment only writes, compound assignment reads first
+      is_written = true;
+      is_read = binary_op->isCompoundAssignmentOp();
+      if (not is_read and not has_labels) {
+        // Assignments directly in the function body run on every path,
+        // so nothing after them sees the incoming value
+        const auto assignment_parents = context.getParents(*binary_op);
+        if (not assignment_parents.empty() and assignment_parents[0].get<Stmt>() == function_decl->getBody()) {
+          field.first_kill = std::min(field.first_kill, file_offset(source_manager, binary_op->getLocEnd()));
+        }
+      }
+    } else if (unary_op != nullptr and (unary_op->isIncrementDecrementOp() or unary_op->getOpcode() == UO_AddrOf)) {
+      // Taking the address lets the field escape, treat it as both
+      is_written = true;
+    }
+
+    field.written = field.written or is_written;
+    if (is_read) {
+      field.read = true;
+      field.first_read = std::min(field.first_read, file_offset(source_manager, member_expr->getLocStart()));
+    }
+  }
+
+  /// Field named name at offset on the wire, as wide as its type, or the bit field
+  static WireField wire_field(const ASTContext & context, const std::string & name, const FieldDecl * field, const unsigned offset) {
+    WireField ret;
+    ret.name = name;
+    ret.type = field->getType().getAsString();
+    ret.offset = offset;
+    ret.width = field->isBitField() ? field->getBitWidthValue(context) : static_cast<unsigned>(context.getTypeSize(field->getType()));
+    ret.integer = field->getType()->isIntegerType();
+    ret.signed_bit_field = field->isBitField() and field->getType()->isSignedIntegerType();
+    return ret;
+  }
+
+  /// Closest function enclosing stmt, nullptr if there is none
+  static const FunctionDecl * enclosing_function(ASTContext & context, const Stmt * stmt) {
+    auto parents = context.getParents(*stmt);
+    while (not parents.empty()) {
+      if (const auto * function_decl = parents[0].get<FunctionDecl>()) return function_decl;
+      if (const auto * parent_stmt = parents[0].get<Stmt>()) parents = context.getParents(*parent_stmt);
+      else if (const auto * parent_decl = parents[0].get<Decl>()) parents = context.getParents(*parent_decl);
+      else return nullptr;
+    }
+    return nullptr;
+  }
+
+  /// Whether stmt contains a label, which a goto could use to jump past an assignment
+  static bool contains_label(const Stmt * stmt) {
+    if (stmt == nullptr) return false;
+    if (isa<LabelStmt>(stmt)) return true;
+    for (auto it = stmt->child_begin(); it != stmt->child_end(); ++it) {
+      if (contains_label(*it)) return true;
+    }
+    return false;
+  }
+
+  /// Name of the buffer holding the burst of packets that field's base stands for
+  static std::string burst_buffer(const FieldAccess & field) { return field.base + "__burst"; }
+
+  /// Bytes of the packet at index in the burst buffer
+  static std::string burst_element(const FieldAccess & field, const std::string & index) {
+    return burst_buffer(field) + "[" + index + "]";
+  }
+
+  /// Offset of loc in its file, after macro expansion
+  static unsigned file_offset(const SourceManager & source_manager, const SourceLocation & loc) {
+    return source_manager.getFileOffset(source_manager.getExpansionLoc(loc));
+  }
+
+  Replacements & Replace;
+
+  /// Number of packets per burst, 0 for one packet at a time
+  unsigned burst_size_;
+
+  /// The only function that runs in bursts, empty if all of them do
+  std::string burst_function_;
+
+  /// Accesses of each field, keyed by function name and then by local variable name
+  std::map<std::string, std::map<std::string, FieldAccess>> field_accesses_ = {};
+
+  /// Functions whose bodies contain labels
+  std::set<std::string> functions_with_labels_ = {};
+
+  /// All fields of each packet struct on the wire, named by member, in declaration order, keyed by struct type
+  std::map<std::string, std::vector<WireField>> packet_wire_fields_ = {};
+};
+
+#endif  // MEMBER_EXPR_HANDLER_H_
@@ -0,0 +1,40 @@
+#ifndef PACKET_PROCESSING_CODE_HANDLER_H_
+#define PACKET_PROCESSING_CODE_HANDLER_H_
+
+#include "clang/Lex/Lexer.h"
+#include "clang/AST/AST.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Tooling/Refactoring.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+
+class PacketProcessingCodeHandler : public MatchFinder::MatchCallback {
+ public:
+  /// Constructor: Pass Refactoring tool as argument
+  PacketProcessingCodeHandler(Replacements & t_replace) : Replace(t_replace) {}
+
+  /// Callback whenever there's a match
+  virtual void run(const MatchFinder::MatchResult &Result) override {
+    const FunctionDecl *function_decl_expr = Result.Nodes.getNodeAs<clang::FunctionDecl>("packetProcessingCode");
+    assert(function_decl_expr != nullptr);
+
+    /// Find location just after opening brace of function body
+    auto start_loc = Lexer::getLocForEndOfToken(function_decl_expr->getBody()->getLocStart(), 0, *Result.SourceManager, Result.Context->getLangOpts());
+    Replacement rep_start(*(Result.SourceManager), start_loc, 0, "\n while(1) {\n");
+    Replace.insert(rep_start);
+
+    /// Find location just before closing brace of function body
+    auto end_loc = Lexer::GetBeginningOfToken(function_decl_expr->getBody()->getLocEnd(), *Result.SourceManager, Result.Context->getLangOpts());
+    Replacement rep_end(*(Result.SourceManager), end_loc, 0, "\n }\n");
+    Replace.insert(rep_end);
+  }
+
+ private:
+  Replacements & Replace;
+};
+
+#endif  // PACKET_PROCESSING_CODE_HANDLER_H_
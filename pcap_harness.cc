@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include "pcap_trace.h"
+#include "spsc_ring.h"
+#include "jayhawk_runtime.h"
+
+/// Runs a program generated with transform_driver -harness over a pcap trace:
+/// packets are handed to the program as pointers into the mapped trace,
+/// whose bytes the program parses and deparses in wire format (see jayhawk_load_field()),
+/// and the trace, with whatever the program wrote into it, is written to the output.
+/// Link with the compiled program, which provides jayhawk_entry(),
+/// or jayhawk_shard_entry() and friends if it was generated with -shards,
+/// plus jayhawk_merge_state() if -lower_state_dir replicated some of its state per shard,
+/// or jayhawk_stage() and friends if it was generated with -stages.
+
+/// Whichever set of entry points the program doesn't define resolves to null
+extern "C" void jayhawk_entry(void) __attribute__((weak));
+extern "C" void jayhawk_shard_entry(unsigned shard) __attribute__((weak));
+extern "C" unsigned jayhawk_flow_shard(const void * packet) __attribute__((weak));
+extern "C" const unsigned jayhawk_num_shards __attribute__((weak));
+extern "C" const unsigned long jayhawk_packet_size __attribute__((weak));
+extern "C" void jayhawk_merge_state(void) __attribute__((weak));
+extern "C" const unsigned jayhawk_num_stages __attribute__((weak));
+extern "C" const unsigned long jayhawk_stage_record_size[] __attribute__((weak));
+extern "C" void jayhawk_stage(unsigned stage, void * in, void * out, unsigned count) __attribute__((weak));
+
+/// Trace being processed and the next record to hand out
+static PcapTrace * trace = nullptr;
+static size_t next_record = 0;
+static size_t packets_processed = 0;
+
+/// Packets steered to one shard, padded so that shards don't share cache lines
+struct ShardQueue {
+  std::vector<uint8_t *> packets = {};
+  size_t next = 0;
+  char padding[64] = {};
+};
+static std::vector<ShardQueue> shard_queues;
+
+/// Lock for state shared between shards
+static std::mutex shared_state_mutex;
+
+/// Packets for a pipelined program, records per ring between stages,
+/// and records a stage moves per batch
+static std::vector<void *> pipeline_packets;
+static const size_t kStageRingCapacity = 4096;
+static const unsigned kStageBatch = 64;
+
+unsigned jayhawk_next_burst(void ** packets, const unsigned max_packets, const unsigned long min_length) {
+  unsigned count = 0;
+  while (count < max_packets and next_record < trace->records().size()) {
+    const auto & record = trace->records().at(next_record++);
+    // Packets too short for the program's fields pass through untouched
+    if (record.cap_len >= min_length) packets[count++] = record.data;
+  }
+  packets_processed += count;
+  return count;
+}
+
+unsigned jayhawk_next_shard_burst(const unsigned shard, void ** packets, const unsigned max_packets, const unsigned long) {
+  auto & queue = shard_queues.at(shard);
+  unsigned count = 0;
+  while (count < max_packets and queue.next < queue.packets.size()) packets[count++] = queue.packets.at(queue.next++);
+  return count;
+}
+
+void jayhawk_lock(void) { shared_state_mutex.lock(); }
+void jayhawk_unlock(void) { shared_state_mutex.unlock(); }
+
+/// Thread pinned to one core from its start: the affinity is in the attributes
+/// it's created with, so it never runs on another core, not even before it's first scheduled
+class PinnedThread {
+ public:
+  /// Run body on the index-th core, wrapping around if there are fewer cores
+  PinnedThread(const std::function<void()> & t_body, const unsigned index) : body_(t_body), thread_() {
+    const unsigned num_cores = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(index % num_cores, &cpu_set);
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    int error = pthread_attr_setaffinity_np(&attributes, sizeof(cpu_set), &cpu_set);
+    if (error == 0) error = pthread_create(&thread_, &attributes, run, this);
+    pthread_attr_destroy(&attributes);
+    if (error != 0) throw std::runtime_error("PinnedThread: cannot start a thread on core " + std::to_string(index % num_cores) + "\n");
+  }
+
+  /// Delete copy constructor and copy assignment, the thread runs body_ in place
+  PinnedThread(const PinnedThread &) = delete;
+  PinnedThread & operator=(const PinnedThread &) = delete;
+
+  /// Wait for body to return
+  ~PinnedThread() { pthread_join(thread_, nullptr); }
+
+ private:
+  static void * run(void * self) {
+    static_cast<PinnedThread *>(self)->body_();
+    return nullptr;
+  }
+
+  std::function<void()> body_;
+  pthread_t thread_;
+};
+
+/// Steer packets to shards by flow hash, as RSS on a NIC would,
+/// then run every shard on its own thread pinned to its own core
+static size_t run_shards() {
+  std::vector<std::unique_ptr<PinnedThread>> threads;
+  for (unsigned shard = 0; shard < jayhawk_num_shards; shard++) {
+    threads.emplace_back(new PinnedThread([shard] () { jayhawk_shard_entry(shard); }, shard));
+  }
+  // Wait for every shard
+  threads.clear();
+
+  size_t ret = 0;
+  for (const auto & queue : shard_queues) ret += queue.packets.size();
+  return ret;
+}
+
+/// One stage of the pipeline: move batches from the ring before it, if any,
+/// through jayhawk_stage() into the ring after it, if any, until the input runs out
+static void run_stage(const unsigned stage, SpscRing * in, SpscRing * out) {
+  size_t next_packet = 0;
+  while (true) {
+    // Input: packet pointers for the first stage, the previous stage's records otherwise
+    uint8_t * in_records = nullptr;
+    size_t count = 0;
+    if (in == nullptr) {
+      count = std::min<size_t>(kStageBatch, pipeline_packets.size() - next_packet);
+      if (count == 0) break;
+    } else {
+      count = in->peek(in_records, kStageBatch);
+      if (count == 0) {
+        if (in->drained()) break;
+        std::this_thread::yield();
+        continue;
+      }
+    }
+
+    // Output: as many records as fit, the rest of the input waits for the next round
+    uint8_t * out_records = nullptr;
+    if (out != nullptr) {
+      count = out->reserve(out_records, count);
+      if (count == 0) {
+        std::this_thread::yield();
+        continue;
+      }
+    }
+
+    jayhawk_stage(stage, in == nullptr ? static_cast<void *>(pipeline_packets.data() + next_packet) : in_records,
+                  out_records, static_cast<unsigned>(count));
+    if (out != nullptr) out->commit(count);
+    if (in == nullptr) next_packet += count;
+    else in->release(count);
+  }
+  if (out != nullptr) out->close();
+}
+
+/// Run every stage of the pipeline on its own thread pinned to its own core,
+/// connected by single-producer/single-consumer rings
+static size_t run_pipeline() {
+  std::vector<std::unique_ptr<SpscRing>> rings;
+  for (unsigned stage = 0; stage + 1 < jayhawk_num_stages; stage++) {
+    rings.emplace_back(new SpscRing(jayhawk_stage_record_size[stage], kStageRingCapacity));
+  }
+  std::vector<std::unique_ptr<PinnedThread>> threads;
+  for (unsigned stage = 0; stage < jayhawk_num_stages; stage++) {
+    auto * in = stage == 0 ? nullptr : rings.at(stage - 1).get();
+    auto * out = stage + 1 == jayhawk_num_stages ? nullptr : rings.at(stage).get();
+    threads.emplace_back(new PinnedThread([stage, in, out] () { run_stage(stage, in, out); }, stage));
+  }
+  // Wait for every stage
+  threads.clear();
+  return pipeline_packets.size();
+}
+
+int main(int argc, const char ** argv) {
+  if (argc < 2 or argc > 3) {
+    std::cerr << "Usage: " << argv[0] << " INPUT.pcap [OUTPUT.pcap]\n";
+    return EXIT_FAILURE;
+  }
+
+  try {
+    PcapTrace input(argv[1]);
+    trace = &input;
+    HarnessStats stats;
+    if (jayhawk_shard_entry != nullptr) {
+      // Steering isn't timed, it's the NIC's job
+      shard_queues.resize(jayhawk_num_shards);
+      for (const auto & record : input.records()) {
+        if (record.cap_len >= jayhawk_packet_size) {
+          shard_queues.at(jayhawk_flow_shard(record.data)).packets.emplace_back(record.data);
+        }
+      }
+      stats = time_run(run_shards);
+      if (jayhawk_merge_state != nullptr) jayhawk_merge_state();
+      for (unsigned shard = 0; shard < jayhawk_num_shards; shard++) {
+        std::cerr << "shard " << shard << ": " << shard_queues.at(shard).packets.size() << " packets\n";
+      }
+    } else if (jayhawk_stage != nullptr) {
+      for (const auto & record : input.records()) {
+        if (record.cap_len >= jayhawk_packet_size) pipeline_packets.emplace_back(record.data);
+      }
+      stats = time_run(run_pipeline);
+    } else if (jayhawk_entry != nullptr) {
+      stats = time_run([] () { jayhawk_entry(); return packets_processed; });
+    } else {
+      std::cerr << "No jayhawk_entry(), jayhawk_shard_entry() or jayhawk_stage() in the program, was it generated with -harness?\n";
+      return EXIT_FAILURE;
+    }
+
+    if (argc == 3) {
+      PcapWriter output(argv[2], input.snap_len(), input.link_type(), input.nanoseconds());
+      for (const auto & record : input.records()) output.write(record);
+    }
+
+    std::cerr << stats.packets << " packets in " << stats.seconds << " s: "
+              << stats.packets_per_second() << " packets/s, "
+              << stats.ns_per_packet() << " ns/packet\n";
+  } catch (const std::exception & e) {
+    std::cerr << e.what();
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
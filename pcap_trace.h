@@ -0,0 +1,200 @@
+#ifndef PCAP_TRACE_H_
+#define PCAP_TRACE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// pcap file format: a 24-byte global header followed by records,
+/// each a 16-byte record header and caplen bytes of packet data.
+/// Header fields are in the byte order of the machine that wrote the file,
+/// which the magic number tells apart.
+namespace pcap {
+  const uint32_t kMagicMicroseconds = 0xa1b2c3d4;
+  const uint32_t kMagicNanoseconds  = 0xa1b23c4d;
+  const size_t kGlobalHeaderSize = 24;
+  const size_t kRecordHeaderSize = 16;
+  const uint32_t kLinkTypeEthernet = 1;
+}
+
+/// One packet in a trace. data points into the trace's mapping,
+/// so reading or modifying a packet never copies it.
+struct PcapRecord {
+  uint32_t ts_sec;
+  uint32_t ts_frac;
+  uint32_t cap_len;
+  uint32_t orig_len;
+  uint8_t * data;
+};
+
+/// pcap trace memory-mapped copy-on-write: packets can be modified in place
+/// without changing the file, and only pages that are written get copied.
+class PcapTrace {
+ public:
+  explicit PcapTrace(const std::string & file_name) {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("PcapTrace: cannot open " + file_name + "\n");
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 or static_cast<size_t>(file_stat.st_size) < pcap::kGlobalHeaderSize) {
+      close(fd);
+      throw std::runtime_error("PcapTrace: " + file_name + " is too short for a pcap file\n");
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+
+    // Populate the mapping up front, so timing doesn't include page faults on reads
+    void * mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) throw std::runtime_error("PcapTrace: cannot map " + file_name + "\n");
+    base_ = static_cast<uint8_t *>(mapping);
+
+    const uint32_t magic = read_u32(base_, false);
+    swapped_ = (magic == byte_swap(pcap::kMagicMicroseconds) or magic == byte_swap(pcap::kMagicNanoseconds));
+    if (not swapped_ and magic != pcap::kMagicMicroseconds and magic != pcap::kMagicNanoseconds) {
+      munmap(base_, size_);
+      throw std::runtime_error("PcapTrace: " + file_name + " is not a pcap file\n");
+    }
+    nanoseconds_ = (read_u32(base_, swapped_) == pcap::kMagicNanoseconds);
+    snap_len_ = read_u32(base_ + 16, swapped_);
+    link_type_ = read_u32(base_ + 20, swapped_);
+
+    // Index records, a truncated last record is dropped
+    for (size_t offset = pcap::kGlobalHeaderSize; offset + pcap::kRecordHeaderSize <= size_;) {
+      const uint8_t * header = base_ + offset;
+      PcapRecord record = {read_u32(header, swapped_), read_u32(header + 4, swapped_),
+                           read_u32(header + 8, swapped_), read_u32(header + 12, swapped_),
+                           base_ + offset + pcap::kRecordHeaderSize};
+      if (offset + pcap::kRecordHeaderSize + record.cap_len > size_) break;
+      records_.emplace_back(record);
+      offset += pcap::kRecordHeaderSize + record.cap_len;
+    }
+  }
+
+  ~PcapTrace() { munmap(base_, size_); }
+
+  /// Delete copy constructor and copy assignment, the mapping is owned by exactly one trace
+  PcapTrace(const PcapTrace &) = delete;
+  PcapTrace & operator=(const PcapTrace &) = delete;
+
+  /// Accessors
+  const std::vector<PcapRecord> & records() const { return records_; }
+  bool nanoseconds() const { return nanoseconds_; }
+  uint32_t snap_len() const { return snap_len_; }
+  uint32_t link_type() const { return link_type_; }
+
+ private:
+  static uint32_t byte_swap(const uint32_t x) {
+    return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+  }
+
+  static uint32_t read_u32(const uint8_t * p, const bool swapped) {
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return swapped ? byte_swap(x) : x;
+  }
+
+  /// Start and size of the mapping
+  uint8_t * base_ = nullptr;
+  size_t size_ = 0;
+
+  /// Whether the file was written with the other byte order, and timestamp resolution
+  bool swapped_ = false;
+  bool nanoseconds_ = false;
+
+  /// From the global header
+  uint32_t snap_len_ = 0;
+  uint32_t link_type_ = 0;
+
+  /// Every complete record in the file, in order
+  std::vector<PcapRecord> records_ = {};
+};
+
+/// Writes a pcap file in this machine's byte order
+class PcapWriter {
+ public:
+  PcapWriter(const std::string & file_name, const uint32_t snap_len = 65535,
+             const uint32_t link_type = pcap::kLinkTypeEthernet, const bool nanoseconds = false)
+    : fd_(open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) {
+    if (fd_ < 0) throw std::runtime_error("PcapWriter: cannot create " + file_name + "\n");
+    const uint32_t magic = nanoseconds ? pcap::kMagicNanoseconds : pcap::kMagicMicroseconds;
+    const uint16_t version[2] = {2, 4};
+    const uint32_t zero[2] = {0, 0};
+    append(&magic, sizeof(magic));
+    append(version, sizeof(version));
+    append(zero, sizeof(zero));
+    append(&snap_len, sizeof(snap_len));
+    append(&link_type, sizeof(link_type));
+  }
+
+  ~PcapWriter() {
+    try {
+      flush();
+    } catch (const std::exception &) {
+      // Nothing sensible to do about a failed write at this point
+    }
+    close(fd_);
+  }
+
+  /// Delete copy constructor and copy assignment, the file is owned by exactly one writer
+  PcapWriter(const PcapWriter &) = delete;
+  PcapWriter & operator=(const PcapWriter &) = delete;
+
+  /// Append a record
+  void write(const PcapRecord & record) {
+    const uint32_t header[4] = {record.ts_sec, record.ts_frac, record.cap_len, record.orig_len};
+    append(header, sizeof(header));
+    append(record.data, record.cap_len);
+  }
+
+  /// Write out everything buffered so far
+  void flush() {
+    size_t written = 0;
+    while (written < buffer_.size()) {
+      const auto ret = ::write(fd_, buffer_.data() + written, buffer_.size() - written);
+      if (ret <= 0) throw std::runtime_error("PcapWriter: write failed\n");
+      written += static_cast<size_t>(ret);
+    }
+    buffer_.clear();
+  }
+
+ private:
+  /// Buffer output to write it in large chunks
+  void append(const void * data, const size_t size) {
+    const auto * bytes = static_cast<const uint8_t *>(data);
+    buffer_.insert(buffer_.end(), bytes, bytes + size);
+    if (buffer_.size() >= kFlushThreshold) flush();
+  }
+
+  enum : size_t { kFlushThreshold = 1 << 20 };
+
+  int fd_;
+  std::vector<uint8_t> buffer_ = {};
+};
+
+/// Throughput of a run over a trace
+struct HarnessStats {
+  size_t packets = 0;
+  double seconds = 0.0;
+
+  double packets_per_second() const { return seconds > 0 ? static_cast<double>(packets) / seconds : 0.0; }
+  double ns_per_packet() const { return packets > 0 ? seconds * 1e9 / static_cast<double>(packets) : 0.0; }
+};
+
+/// Time run(), which returns the number of packets it processed
+template <class Run>
+HarnessStats time_run(Run run) {
+  HarnessStats stats;
+  const auto start = std::chrono::steady_clock::now();
+  stats.packets = run();
+  const auto end = std::chrono::steady_clock::now();
+  stats.seconds = std::chrono::duration<double>(end - start).count();
+  return stats;
+}
+
+#endif  // PCAP_TRACE_H_
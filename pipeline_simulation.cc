@@ -0,0 +1,103 @@
+#include <utility>
+#include <algorithm>
+#include "llvm/IR/Instructions.h"
+#include "utility_functions.h"
+#include "instr_prog_deps.h"
+#include "pipeline_stages.h"
+#include "pipeline_simulation.h"
+#include "analysis_output.h"
+
+using namespace llvm;
+
+bool PipelineSimulation::runOnModule(Module & module) {
+  stages_.clear();
+  reports_.clear();
+
+  std::vector<uint64_t> arrivals;
+  if (trace_file_.empty()) {
+    arrivals.assign(num_packets_, 0);
+  } else {
+    const PcapTrace trace(trace_file_);
+    arrivals = trace_arrivals(trace.records(), trace.nanoseconds(), clock_hz_);
+  }
+
+  for (auto & func : module) {
+    if (func.isDeclaration()) continue;
+    auto stages = map_stages(func);
+    if (stages.empty()) continue;
+    const auto report = PipelineSimulator(stages).run(arrivals);
+    if (AnalysisOutput::enabled(Verbosity::kSummary)) {
+      AnalysisOutput::stream() << "PipelineSimulation: " << func.getName().str() << ": " << stages.size() << " stages\n"
+                               << report.summary();
+    }
+    stages_[func.getName().str()] = std::move(stages);
+    reports_[func.getName().str()] = report;
+  }
+  return false;
+}
+
+std::vector<SimulatedStage> PipelineSimulation::map_stages(Function & func) {
+  const auto & pdg = getAnalysis<InstrProgDeps>(func).pdg();
+  const auto stage_of = asap_stages(pdg);
+  if (stage_of.empty()) return {};
+  unsigned num_stages = 0;
+  for (const auto & node : stage_of) num_stages = std::max(num_stages, node.second + 1);
+
+  // Slowest component, and slowest state update, of each stage
+  std::vector<unsigned> action_latency(num_stages, 0);
+  std::vector<unsigned> update_latency(num_stages, 0);
+  std::vector<SimulatedStage> ret(num_stages);
+  for (const auto & component : pdg.strongly_connected_components()) {
+    const auto stage = stage_of.at(component.front());
+    unsigned component_latency = 0;
+    bool updates_state = false;
+    for (const auto * instruction : component) {
+      component_latency += latency(instruction);
+      const auto * global = accessed_global(instruction);
+      if (global == nullptr) continue;
+      if (isa<StoreInst>(instruction)) {
+        ret.at(stage).writes.emplace(global->getName().str());
+        updates_state = true;
+      } else {
+        ret.at(stage).reads.emplace(global->getName().str());
+      }
+    }
+    action_latency.at(stage) = std::max(action_latency.at(stage), component_latency);
+    if (updates_state) update_latency.at(stage) = std::max(update_latency.at(stage), component_latency);
+  }
+
+  for (unsigned stage = 0; stage < num_stages; stage++) {
+    ret.at(stage).latency = model_.match + action_latency.at(stage);
+    ret.at(stage).initiation_interval = std::max(1u, update_latency.at(stage));
+  }
+  return ret;
+}
+
+unsigned PipelineSimulation::latency(const Instruction * instruction) const {
+  if (isa<LoadInst>(instruction) or isa<StoreInst>(instruction)) {
+    return accessed_global(instruction) != nullptr ? model_.state_access : model_.alu;
+  }
+  switch (instruction->getOpcode()) {
+    case Instruction::Mul:
+    case Instruction::FMul:
+      return model_.multiply;
+    case Instruction::UDiv:
+    case Instruction::SDiv:
+    case Instruction::FDiv:
+    case Instruction::URem:
+    case Instruction::SRem:
+    case Instruction::FRem:
+      return model_.divide;
+    default:
+      // Casts, getelementptrs and phis are wiring, not actions
+      return instruction->isCast() or isa<GetElementPtrInst>(instruction) or isa<PHINode>(instruction) ? 0 : model_.alu;
+  }
+}
+
+void PipelineSimulation::getAnalysisUsage(AnalysisUsage & AU) const {
+  AU.addRequired<InstrProgDeps>();
+  AU.setPreservesAll();
+}
+
+char PipelineSimulation::ID = 0;
+static RegisterPass<PipelineSimulation> X("pipeline_simulation", "Simulate packet-processing functions on a match-action pipeline", false, true);
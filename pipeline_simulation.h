@@ -0,0 +1,57 @@
+#ifndef PIPELINE_SIMULATION_H_
+#define PIPELINE_SIMULATION_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "llvm/Pass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Instruction.h"
+#include "pipeline_simulator.h"
+
+/// LLVM pass to estimate throughput and latency of each packet-processing function
+/// on a match-action pipeline before deploying it.
+/// The if-converted function is mapped to stages as early as InstrProgDeps' PDG allows
+/// (see asap_stages()), each strongly connected component of the PDG, i.e., an atomic
+/// update of state, in one stage. A stage's actions run in parallel, so its latency
+/// is the match latency plus that of its slowest component, and a component that
+/// updates state must finish before the next packet can start it, which sets
+/// the stage's initiation interval. PipelineSimulator then runs a trace through it.
+/// Run after IfConversion. Nothing is modified.
+struct PipelineSimulation : public llvm::ModulePass {
+ public:
+  static char ID;
+
+  /// Simulate as options say, see SimulationOptions
+  explicit PipelineSimulation(const SimulationOptions & t_options = SimulationOptions())
+    : llvm::ModulePass(ID), model_(t_options.model), trace_file_(t_options.trace_file),
+      clock_hz_(t_options.clock_hz), num_packets_(t_options.num_packets) {}
+
+  /// Map and simulate every function, and print a report per function
+  bool runOnModule(llvm::Module & module) override;
+
+  /// Stages come from InstrProgDeps' PDG
+  void getAnalysisUsage(llvm::AnalysisUsage & AU) const override;
+
+  /// Stages and reports of each function of the last module, by function name
+  const std::map<std::string, std::vector<SimulatedStage>> & stages() const { return stages_; }
+  const std::map<std::string, SimulationReport> & reports() const { return reports_; }
+
+ private:
+  /// Map one function's instructions to stages
+  std::vector<SimulatedStage> map_stages(llvm::Function & func);
+
+  /// Cycles instruction takes under model_
+  unsigned latency(const llvm::Instruction * instruction) const;
+
+  StageLatencyModel model_;
+  std::string trace_file_;
+  double clock_hz_;
+  uint64_t num_packets_;
+
+  std::map<std::string, std::vector<SimulatedStage>> stages_ = {};
+  std::map<std::string, SimulationReport> reports_ = {};
+};
+
+#endif  // PIPELINE_SIMULATION_H_
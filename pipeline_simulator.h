@@ -0,0 +1,293 @@
+#ifndef PIPELINE_SIMULATOR_H_
+#define PIPELINE_SIMULATOR_H_
+
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "pcap_trace.h"
+
+/// One stage of a match-action pipeline: cycles from a packet entering it
+/// to its results being available, cycles between two packets entering it,
+/// and the state variables it reads and writes
+struct SimulatedStage {
+  unsigned latency = 1;
+  unsigned initiation_interval = 1;
+  std::set<std::string> reads = {};
+  std::set<std::string> writes = {};
+};
+
+/// Two stages accessing the same state variable, at least one of them writing it.
+/// A packet can't enter first_stage until the packet ahead of it is done with last_stage,
+/// or it would miss that packet's write, or overwrite what that packet is yet to read.
+struct StateHazard {
+  std::string state;
+  unsigned first_stage;
+  unsigned last_stage;
+
+  /// Cycles a packet waited to enter first_stage because of this hazard
+  uint64_t stall_cycles;
+};
+
+/// Outcome of simulating a trace
+struct SimulationReport {
+  uint64_t packets = 0;
+
+  /// Cycles from the first arrival to the last packet leaving the pipeline,
+  /// and the cycles the first and the last packet left in
+  uint64_t cycles = 0;
+  uint64_t first_exit = 0;
+  uint64_t last_exit = 0;
+
+  /// Cycles from arrival to leaving the pipeline, in arrival order
+  std::vector<uint64_t> latencies = {};
+
+  /// Per stage, cycles a packet was ready to enter the stage but had to wait
+  /// for the stage's initiation interval or for room in the stage
+  std::vector<uint64_t> stage_stalls = {};
+
+  /// Hazards on state between stages, with the stalls they caused
+  std::vector<StateHazard> hazards = {};
+
+  /// Sustained throughput: packets per cycle once the pipeline is full,
+  /// measured between the first and the last packet leaving it
+  double packets_per_cycle() const {
+    if (packets < 2) return 0.0;
+    return static_cast<double>(packets - 1) / static_cast<double>(last_exit - first_exit);
+  }
+
+  /// Latency that fraction of the packets, e.g., 0.99, don't exceed (nearest rank)
+  uint64_t latency_percentile(const double fraction) const {
+    if (latencies.empty()) return 0;
+    auto sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+    const auto rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+    return sorted.at(std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1);
+  }
+
+  /// Human-readable summary, one line per item
+  std::string summary() const {
+    std::string ret = std::to_string(packets) + " packets in " + std::to_string(cycles) + " cycles, " +
+                      std::to_string(packets_per_cycle()) + " packets/cycle sustained\n";
+    ret += "latency min " + std::to_string(latency_percentile(0.0)) + " p50 " + std::to_string(latency_percentile(0.5)) +
+           " p99 " + std::to_string(latency_percentile(0.99)) + " max " + std::to_string(latency_percentile(1.0)) + " cycles\n";
+    for (size_t i = 0; i < stage_stalls.size(); i++) {
+      if (stage_stalls.at(i) > 0) ret += "stage " + std::to_string(i) + " stalled " + std::to_string(stage_stalls.at(i)) + " cycles\n";
+    }
+    for (const auto & hazard : hazards) {
+      ret += "hazard on " + hazard.state + " between stages " + std::to_string(hazard.first_stage) + " and " +
+             std::to_string(hazard.last_stage) + " stalled " + std::to_string(hazard.stall_cycles) + " cycles\n";
+    }
+    return ret;
+  }
+};
+
+/// Cycle-by-cycle simulation of packets going through a match-action pipeline in order.
+/// Every cycle, from the last stage to the first, the packet waiting in front of
+/// a stage enters it if no hazard holds it back, the stage's initiation interval
+/// has passed since the last packet entered it, and the stage has room:
+/// a stage holds as many packets as it can start within its latency.
+/// Packets that are done with a stage but can't enter the next one stay in it,
+/// so stalls back up towards the first stage, and arriving packets queue up in front of it.
+class PipelineSimulator {
+ public:
+  explicit PipelineSimulator(const std::vector<SimulatedStage> & t_stages) : stages_(t_stages), hazards_() {
+    if (stages_.empty()) throw std::invalid_argument("PipelineSimulator: need at least one stage\n");
+    for (const auto & stage : stages_) {
+      if (stage.latency == 0 or stage.initiation_interval == 0) {
+        throw std::invalid_argument("PipelineSimulator: stage latencies and initiation intervals must be positive\n");
+      }
+    }
+
+    // Hazards between every two stages accessing a state variable, one of them writing it
+    for (unsigned first = 0; first < stages_.size(); first++) {
+      for (unsigned last = first + 1; last < stages_.size(); last++) {
+        for (const auto & state : accessed(first)) {
+          const auto & later = stages_.at(last);
+          if ((later.reads.count(state) or later.writes.count(state)) and
+              (stages_.at(first).writes.count(state) or later.writes.count(state))) {
+            hazards_.emplace_back(StateHazard{state, first, last, 0});
+          }
+        }
+      }
+    }
+  }
+
+  /// Simulate packets arriving in the given cycles, which must not decrease
+  SimulationReport run(const std::vector<uint64_t> & arrivals) const {
+    if (not std::is_sorted(arrivals.begin(), arrivals.end())) {
+      throw std::invalid_argument("PipelineSimulator: arrival cycles must not decrease\n");
+    }
+    const auto num_stages = stages_.size();
+    SimulationReport report;
+    report.packets = arrivals.size();
+    report.stage_stalls.assign(num_stages, 0);
+    report.hazards = hazards_;
+    if (arrivals.empty()) return report;
+
+    // Packets in each stage, in order, and when each is done with it
+    struct InFlight {
+      uint64_t packet;
+      uint64_t ready;
+    };
+    std::vector<std::deque<InFlight>> in_stage(num_stages);
+
+    // Per stage: packets that entered it, when the last one entered it,
+    // and when the last one is done with it
+    std::vector<uint64_t> entered(num_stages, 0);
+    std::vector<uint64_t> last_entry(num_stages, 0);
+    std::vector<uint64_t> last_ready(num_stages, 0);
+
+    size_t next_arrival = 0;
+    uint64_t exited = 0;
+    uint64_t cycle = arrivals.front();
+    while (exited < arrivals.size()) {
+      // Leave the pipeline
+      auto & last = in_stage.back();
+      if (not last.empty() and last.front().ready <= cycle) {
+        report.latencies.emplace_back(cycle - arrivals.at(last.front().packet));
+        if (exited == 0) report.first_exit = cycle;
+        report.last_exit = cycle;
+        last.pop_front();
+        exited++;
+      }
+
+      // Move packets forward, last stage first, so that a stage emptied this cycle can be refilled
+      for (size_t s = num_stages; s-- > 0;) {
+        uint64_t packet = 0;
+        if (s == 0) {
+          if (next_arrival == arrivals.size() or arrivals.at(next_arrival) > cycle) continue;
+          packet = next_arrival;
+        } else {
+          if (in_stage.at(s - 1).empty() or in_stage.at(s - 1).front().ready > cycle) continue;
+          packet = in_stage.at(s - 1).front().packet;
+        }
+
+        // The packet ahead must be done with every stage this stage has a hazard with
+        auto blocking = std::find_if(report.hazards.begin(), report.hazards.end(), [&] (const StateHazard & hazard) {
+          return hazard.first_stage == s and packet > 0 and
+                 (entered.at(hazard.last_stage) < packet or last_ready.at(hazard.last_stage) > cycle);
+        });
+        if (blocking != report.hazards.end()) {
+          blocking->stall_cycles++;
+          continue;
+        }
+        const auto & stage = stages_.at(s);
+        const bool interval_passed = entered.at(s) == 0 or cycle >= last_entry.at(s) + stage.initiation_interval;
+        if (not interval_passed or in_stage.at(s).size() >= capacity(stage)) {
+          report.stage_stalls.at(s)++;
+          continue;
+        }
+
+        if (s == 0) next_arrival++;
+        else in_stage.at(s - 1).pop_front();
+        in_stage.at(s).push_back(InFlight{packet, cycle + stage.latency});
+        entered.at(s)++;
+        last_entry.at(s) = cycle;
+        last_ready.at(s) = cycle + stage.latency;
+      }
+
+      // Skip idle cycles until the next arrival
+      const bool empty = std::all_of(in_stage.begin(), in_stage.end(), [] (const std::deque<InFlight> & packets)
+                                     { return packets.empty(); });
+      if (empty and next_arrival < arrivals.size() and arrivals.at(next_arrival) > cycle + 1) cycle = arrivals.at(next_arrival);
+      else cycle++;
+    }
+    report.cycles = report.last_exit - arrivals.front();
+    return report;
+  }
+
+  /// Hazards on state between stages, with no stalls counted
+  const std::vector<StateHazard> & hazards() const { return hazards_; }
+
+ private:
+  /// State variables stage reads or writes
+  std::set<std::string> accessed(const unsigned stage) const {
+    std::set<std::string> ret = stages_.at(stage).reads;
+    ret.insert(stages_.at(stage).writes.begin(), stages_.at(stage).writes.end());
+    return ret;
+  }
+
+  /// Packets a stage holds at once
+  static size_t capacity(const SimulatedStage & stage) {
+    return (stage.latency + stage.initiation_interval - 1) / stage.initiation_interval;
+  }
+
+  std::vector<SimulatedStage> stages_;
+  std::vector<StateHazard> hazards_;
+};
+
+/// Arrival cycles of the records of a pcap trace on a pipeline clocked at clock_hz,
+/// counted from the first record's timestamp. nanoseconds tells how to read ts_frac.
+inline std::vector<uint64_t> trace_arrivals(const std::vector<PcapRecord> & records, const bool nanoseconds, const double clock_hz) {
+  if (clock_hz <= 0) throw std::invalid_argument("trace_arrivals: clock frequency must be positive\n");
+  std::vector<uint64_t> ret;
+  if (records.empty()) return ret;
+  const double frac_per_second = nanoseconds ? 1e9 : 1e6;
+  const auto seconds = [frac_per_second] (const PcapRecord & record)
+                       { return static_cast<double>(record.ts_sec) + static_cast<double>(record.ts_frac) / frac_per_second; };
+  const double start = seconds(records.front());
+  uint64_t previous = 0;
+  for (const auto & record : records) {
+    // Out-of-order timestamps arrive right after the packet before them
+    const double offset = std::max(0.0, seconds(record) - start);
+    previous = std::max(previous, static_cast<uint64_t>(std::llround(offset * clock_hz)));
+    ret.emplace_back(previous);
+  }
+  return ret;
+}
+
+/// Cycles an operation takes in a match-action stage
+struct StageLatencyModel {
+  /// Match and crossbar ahead of every stage's actions
+  unsigned match = 1;
+
+  /// Actions: simple ALU operations, multiplies, divides and remainders,
+  /// and loads and stores of state, i.e., the stage's SRAM
+  unsigned alu = 1;
+  unsigned multiply = 3;
+  unsigned divide = 12;
+  unsigned state_access = 1;
+
+  /// Model from a comma-separated list of operation=cycles overriding the defaults,
+  /// e.g., "multiply=4,state=2", with operations match, alu, multiply, divide and state;
+  /// throws std::invalid_argument on anything else
+  static StageLatencyModel parse(const std::string & spec) {
+    StageLatencyModel ret;
+    size_t begin = 0;
+    while (begin < spec.size()) {
+      const auto end = std::min(spec.find(',', begin), spec.size());
+      const auto item = spec.substr(begin, end - begin);
+      const auto equals = item.find('=');
+      const auto cycles = equals == std::string::npos ? std::string() : item.substr(equals + 1);
+      if (cycles.empty() or cycles.size() > 9 or cycles.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::invalid_argument("StageLatencyModel: expected operation=cycles, got " + item + "\n");
+      }
+      const auto operation = item.substr(0, equals);
+      const auto value = static_cast<unsigned>(std::stoul(cycles));
+      if (operation == "match") ret.match = value;
+      else if (operation == "alu") ret.alu = value;
+      else if (operation == "multiply") ret.multiply = value;
+      else if (operation == "divide") ret.divide = value;
+      else if (operation == "state") ret.state_access = value;
+      else throw std::invalid_argument("StageLatencyModel: unknown operation " + operation + "\n");
+      begin = end + 1;
+    }
+    return ret;
+  }
+};
+
+/// What to simulate: the latency model, and the packets of trace_file arriving at their
+/// timestamps on a clock_hz clock, or num_packets packets arriving back to back if there's no trace
+struct SimulationOptions {
+  StageLatencyModel model = StageLatencyModel();
+  std::string trace_file = "";
+  double clock_hz = 1e9;
+  uint64_t num_packets = 10000;
+};
+
+#endif  // PIPELINE_SIMULATOR_H_
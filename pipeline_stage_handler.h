@@ -0,0 +1,337 @@
+#ifndef PIPELINE_STAGE_HANDLER_H_
+#define PIPELINE_STAGE_HANDLER_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "clang/Lex/Lexer.h"
+#include "clang/AST/AST.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "clang_utility_functions.h"
+#include "member_expr_handler.h"
+#include "pipeline_stages.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+
+/// Software pipeline for the harness function: its body is cut into stages,
+/// and each stage becomes a function that the runtime, e.g., pcap_harness,
+/// runs on a thread of its own, passing packets from stage to stage
+/// through single-producer/single-consumer rings (see spsc_ring.h).
+///
+/// The statements of the body are the nodes of a dependence graph, like the
+/// instruction-level PDG of InstrProgDeps one level up: an edge for every
+/// read or write of a packet field or local variable that follows a write,
+/// or a write that follows a read, and edges both ways between statements
+/// accessing the same state variable (global) when one of them writes it,
+/// since a later packet's read depends on an earlier packet's write.
+/// assign_stages() then keeps each state variable within one stage, and
+/// every dependence flows forward, so stages share nothing but the rings.
+///
+/// A ring record carries only what's live across its stage boundary:
+/// the packet pointer, fields and locals written before the boundary and used
+/// after it, and written fields, which the last stage writes back to the packet.
+/// Fields are parsed straight from the packet by the first stage that reads them.
+class PipelineStageHandler : public MatchFinder::MatchCallback {
+ public:
+  /// Constructor: Pass the handler that collected the field accesses and the number of stages
+  PipelineStageHandler(const MemberExprHandler & t_member_expr_handler, const unsigned t_num_stages)
+    : member_expr_handler_(t_member_expr_handler), num_stages_(t_num_stages) {
+    if (num_stages_ < 2) throw std::invalid_argument("A pipeline needs at least two stages\n");
+  }
+
+  /// Callback whenever there's a match
+  virtual void run(const MatchFinder::MatchResult &Result) override {
+    const FunctionDecl *function_decl = Result.Nodes.getNodeAs<clang::FunctionDecl>("pipelineFunction");
+    assert(function_decl != nullptr);
+    if (not function_decl->isThisDeclarationADefinition()) return;
+    function_name_ = function_decl->getNameAsString();
+    fields_ = member_expr_handler_.local_fields(function_name_);
+    packet_type_ = member_expr_handler_.packet_type(function_name_);
+    if (packet_type_.empty()) throw std::logic_error("Pipelined function " + function_name_ + " accesses no packet fields\n");
+
+    const auto & source_manager = *Result.SourceManager;
+    const auto & lang_opts = Result.Context->getLangOpts();
+    function_end_ = function_decl->getBody()->getLocEnd();
+    const auto * body = dyn_cast<CompoundStmt>(function_decl->getBody());
+    assert(body != nullptr);
+
+    // Statements, including their semicolon, and what they access
+    Graph<size_t> deps;
+    for (auto it = body->body_begin(); it != body->body_end(); ++it) {
+      auto end = (*it)->getLocEnd();
+      const auto after_semi = Lexer::findLocationAfterToken(end, tok::semi, source_manager, lang_opts, false);
+      if (after_semi.isValid()) end = after_semi.getLocWithOffset(-1);
+      statements_.emplace_back(Statement{SourceRange((*it)->getLocStart(), end), {}, {}, {}, 0, 0});
+      collect(*it, statements_.back());
+      deps.add_node(statements_.size() - 1);
+    }
+
+    for (size_t i = 0; i < statements_.size(); i++) {
+      for (size_t j = i + 1; j < statements_.size(); j++) {
+        const auto & a = statements_.at(i);
+        const auto & b = statements_.at(j);
+        bool forward = false;
+        bool state = false;
+        for (const auto & name : a.writes) {
+          if (b.reads.count(name) or b.writes.count(name)) {
+            forward = true;
+            state = state or a.state.count(name);
+          }
+        }
+        for (const auto & name : a.reads) {
+          if (b.writes.count(name)) {
+            forward = true;
+            state = state or a.state.count(name);
+          }
+        }
+        if (forward) deps.add_edge(i, j);
+        if (state) deps.add_edge(j, i);
+      }
+    }
+
+    const auto stages = assign_stages<size_t>(deps, num_stages_, [this] (const size_t & i) { return statements_.at(i).cost; });
+    for (const auto & stage : stages) statements_.at(stage.first).stage = stage.second;
+  }
+
+  /// Insert the stage functions and the runtime's entry points after the pipelined function.
+  /// Call after the struct_to_local_vars replacements are applied to rewriter,
+  /// statements are copied as rewritten.
+  void add_stages(Rewriter & rewriter) const {
+    if (function_name_.empty()) return;
+    const auto & source_manager = rewriter.getSourceMgr();
+    rewriter.InsertTextBefore(source_manager.getLocForStartOfFile(source_manager.getMainFileID()), "#include \"jayhawk_runtime.h\"\n");
+
+    // Values each stage uses, and the stage each value is first written in
+    std::vector<std::set<std::string>> used(num_stages_);
+    std::map<std::string, unsigned> first_write;
+    for (const auto & statement : statements_) {
+      used.at(statement.stage).insert(statement.reads.begin(), statement.reads.end());
+      used.at(statement.stage).insert(statement.writes.begin(), statement.writes.end());
+      for (const auto & name : statement.writes) {
+        if (first_write.find(name) == first_write.end() or first_write.at(name) > statement.stage) first_write[name] = statement.stage;
+      }
+    }
+
+    // Live across the boundary after stage b: written by then, and used later or written back at the end
+    std::vector<std::vector<std::string>> live(num_stages_ - 1);
+    for (unsigned b = 0; b + 1 < num_stages_; b++) {
+      for (const auto & write : first_write) {
+        const auto & name = write.first;
+        if (write.second > b or is_state(name)) continue;
+        bool used_later = fields_.find(name) != fields_.end() and fields_.at(name).written;
+        for (unsigned later = b + 1; later < num_stages_; later++) used_later = used_later or used.at(later).count(name);
+        if (used_later) live.at(b).emplace_back(name);
+      }
+    }
+
+    std::string text = "\n";
+    for (unsigned b = 0; b + 1 < num_stages_; b++) {
+      text += "\nstruct " + record(b) + " {\n  unsigned char * pkt__ptr;\n";
+      for (const auto & name : live.at(b)) text += "  " + declaration(name) + ";\n";
+      text += "};\n";
+    }
+
+    const auto index = MemberExprHandler::burst_index();
+    for (unsigned stage = 0; stage < num_stages_; stage++) {
+      text += "\nstatic void " + function_name_ + "__stage" + std::to_string(stage) + "(void * in, void * out, unsigned pkt__n) {\n";
+      text += stage == 0 ? "  void ** pkt__in = (void **) in;\n"
+                         : "  struct " + record(stage - 1) + " * pkt__in = (struct " + record(stage - 1) + " *) in;\n";
+      text += stage + 1 == num_stages_ ? "  (void) out;\n"
+                                       : "  struct " + record(stage) + " * pkt__out = (struct " + record(stage) + " *) out;\n";
+      text += "  for (unsigned " + index + " = 0; " + index + " < pkt__n; " + index + "++) {\n";
+      text += stage == 0 ? "    unsigned char * pkt__ptr = (unsigned char *) pkt__in[" + index + "];\n"
+                         : "    unsigned char * pkt__ptr = pkt__in[" + index + "].pkt__ptr;\n";
+
+      // Values coming in over the ring, fields parsed here, and fields only written from here on
+      const std::set<std::string> incoming(stage == 0 ? std::set<std::string>()
+                                           : std::set<std::string>(live.at(stage - 1).begin(), live.at(stage - 1).end()));
+      std::set<std::string> needed = used.at(stage);
+      if (stage + 1 == num_stages_) for (const auto & field : fields_) if (field.second.written) needed.insert(field.first);
+      for (const auto & name : needed) {
+        if (incoming.count(name)) {
+          text += "    " + declaration(name) + " = pkt__in[" + index + "]." + name + ";\n";
+        } else if (fields_.find(name) != fields_.end()) {
+          text += "    " + declaration(name) + (fields_.at(name).parsed ? " = " + fields_.at(name).wire.load("pkt__ptr") : "") + ";\n";
+        }
+      }
+
+      for (const auto & statement : statements_) {
+        if (statement.stage == stage) text += "    " + rewriter.getRewrittenText(statement.range) + "\n";
+      }
+
+      if (stage + 1 == num_stages_) {
+        for (const auto & field : fields_) {
+          if (field.second.written) text += "    " + field.second.wire.store("pkt__ptr", field.first) + "\n";
+        }
+      } else {
+        text += "    pkt__out[" + index + "].pkt__ptr = pkt__ptr;\n";
+        for (const auto & name : live.at(stage)) text += "    pkt__out[" + index + "]." + name + " = " + name + ";\n";
+      }
+      text += "  }\n}\n";
+    }
+
+    text += "\nconst unsigned jayhawk_num_stages = " + std::to_string(num_stages_) + ";\n"
+            "const unsigned long jayhawk_packet_size = " +
+            std::to_string(member_expr_handler_.packet_wire_bytes(function_name_)) + ";\n"
+            "const unsigned long jayhawk_stage_record_size[] = {";
+    for (unsigned b = 0; b + 1 < num_stages_; b++) text += (b == 0 ? "" : ", ") + std::string("sizeof(struct ") + record(b) + ")";
+    text += "};\n\nvoid jayhawk_stage(unsigned stage, void * in, void * out, unsigned count) {\n  switch (stage) {\n";
+    for (unsigned stage = 0; stage < num_stages_; stage++) {
+      text += "    case " + std::to_string(stage) + ": " + function_name_ + "__stage" + std::to_string(stage) + "(in, out, count); break;\n";
+    }
+    text += "  }\n}\n";
+    rewriter.InsertTextAfterToken(function_end_, text);
+  }
+
+ private:
+  /// A top-level statement of the function body: its extent, the fields
+  /// (by local name), locals and state variables it reads and writes,
+  /// which of those are state, its size in AST nodes, and its stage
+  struct Statement {
+    SourceRange range;
+    std::set<std::string> reads;
+    std::set<std::string> writes;
+    std::set<std::string> state;
+    size_t cost;
+    unsigned stage;
+  };
+
+  /// Stands for any memory a call or a store through a pointer may touch, treated as state
+  static std::string unknown_memory() { return "<memory>"; }
+
+  bool is_state(const std::string & name) const {
+    return name == unknown_memory() or state_vars_.find(name) != state_vars_.end();
+  }
+
+  /// Ring record type leaving stage b
+  std::string record(const unsigned b) const { return function_name_ + "__live" + std::to_string(b); }
+
+  /// Declaration of the local for a field or local variable
+  std::string declaration(const std::string & name) const {
+    if (fields_.find(name) != fields_.end()) return fields_.at(name).type + " " + name;
+    return local_types_.at(name) + " " + name;
+  }
+
+  /// Local variable name of a packet field access, "" if expr isn't one
+  std::string field_local(const Expr * expr) const {
+    const auto * member_expr = dyn_cast<MemberExpr>(expr->IgnoreParenImpCasts());
+    if (member_expr == nullptr) return "";
+    const auto name = clang_stmt_printer(member_expr->getBase()) + "__" + clang_value_decl_printer(member_expr->getMemberDecl());
+    return fields_.find(name) != fields_.end() ? name : "";
+  }
+
+  /// Record reads, writes and size of stmt
+  void collect(const Stmt * stmt, Statement & statement) {
+    if (stmt == nullptr) return;
+    statement.cost++;
+    if (isa<ReturnStmt>(stmt) or isa<GotoStmt>(stmt) or isa<IndirectGotoStmt>(stmt) or isa<LabelStmt>(stmt)) {
+      throw std::logic_error("Pipelined function " + function_name_ + " must run straight through its body, without return or goto\n");
+    }
+    if (const auto * binary_op = dyn_cast<BinaryOperator>(stmt)) {
+      if (binary_op->isAssignmentOp()) {
+        collect_target(binary_op->getLHS(), statement, binary_op->isCompoundAssignmentOp());
+        collect(binary_op->getRHS(), statement);
+        return;
+      }
+    }
+    if (const auto * unary_op = dyn_cast<UnaryOperator>(stmt)) {
+      if (unary_op->isIncrementDecrementOp() or unary_op->getOpcode() == UO_AddrOf) {
+        collect_target(unary_op->getSubExpr(), statement, true);
+        return;
+      }
+    }
+    if (const auto * decl_stmt = dyn_cast<DeclStmt>(stmt)) {
+      for (auto it = decl_stmt->decl_begin(); it != decl_stmt->decl_end(); ++it) {
+        const auto * var_decl = dyn_cast<VarDecl>(*it);
+        if (var_decl == nullptr) continue;
+        if (var_decl->hasGlobalStorage()) {
+          throw std::logic_error("Pipelined function " + function_name_ + " can't have static locals, make " +
+                                 var_decl->getNameAsString() + " a global\n");
+        }
+        local_types_[var_decl->getNameAsString()] = var_decl->getType().getAsString();
+        statement.writes.insert(var_decl->getNameAsString());
+        if (var_decl->hasInit()) collect(var_decl->getInit(), statement);
+      }
+      return;
+    }
+    if (const auto * expr = dyn_cast<Expr>(stmt)) {
+      const auto field = field_local(expr);
+      if (not field.empty()) {
+        statement.reads.insert(field);
+        return;
+      }
+    }
+    if (const auto * decl_ref = dyn_cast<DeclRefExpr>(stmt)) {
+      collect_variable(decl_ref, statement, true, false);
+      return;
+    }
+    if (isa<CallExpr>(stmt)) add_unknown_memory(statement);
+    for (auto it = stmt->child_begin(); it != stmt->child_end(); ++it) collect(*it, statement);
+  }
+
+  /// Record the target of an assignment, increment or address-of as written, and as read if also_read
+  void collect_target(const Expr * expr, Statement & statement, const bool also_read) {
+    statement.cost++;
+    expr = expr->IgnoreParenImpCasts();
+    const auto field = field_local(expr);
+    if (not field.empty()) {
+      statement.writes.insert(field);
+      if (also_read) statement.reads.insert(field);
+    } else if (const auto * decl_ref = dyn_cast<DeclRefExpr>(expr)) {
+      collect_variable(decl_ref, statement, also_read, true);
+    } else if (const auto * subscript = dyn_cast<ArraySubscriptExpr>(expr)) {
+      // Writing one element keeps the others
+      collect_target(subscript->getBase(), statement, true);
+      collect(subscript->getIdx(), statement);
+    } else {
+      // Anything else, e.g., *ptr = ..., may write anywhere
+      collect(expr, statement);
+      add_unknown_memory(statement);
+    }
+  }
+
+  void collect_variable(const DeclRefExpr * decl_ref, Statement & statement, const bool read, const bool written) {
+    const auto * var_decl = dyn_cast<VarDecl>(decl_ref->getDecl());
+    if (var_decl == nullptr) return;
+    const auto name = var_decl->getNameAsString();
+    if (isa<ParmVarDecl>(var_decl)) {
+      throw std::logic_error("Pipelined function " + function_name_ + " may only use its parameter " + name + " through packet fields\n");
+    }
+    if (var_decl->hasGlobalStorage()) {
+      state_vars_.insert(name);
+      statement.state.insert(name);
+    }
+    if (read) statement.reads.insert(name);
+    if (written) statement.writes.insert(name);
+  }
+
+  void add_unknown_memory(Statement & statement) const {
+    statement.reads.insert(unknown_memory());
+    statement.writes.insert(unknown_memory());
+    statement.state.insert(unknown_memory());
+  }
+
+  const MemberExprHandler & member_expr_handler_;
+  unsigned num_stages_;
+
+  /// The pipelined function, its packet type and its fields
+  std::string function_name_ = "";
+  std::string packet_type_ = "";
+  std::map<std::string, MemberExprHandler::LocalField> fields_ = {};
+  SourceLocation function_end_ = SourceLocation();
+
+  /// Top-level statements of the body, in order
+  std::vector<Statement> statements_ = {};
+
+  /// Types of local variables, and names of state variables
+  std::map<std::string, std::string> local_types_ = {};
+  std::set<std::string> state_vars_ = {};
+};
+
+#endif  // PIPELINE_STAGE_HANDLER_H_
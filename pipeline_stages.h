@@ -0,0 +1,115 @@
+#ifndef PIPELINE_STAGES_H_
+#define PIPELINE_STAGES_H_
+
+#include <map>
+#include <set>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include "graph.h"
+
+/// Condensation of a dependence graph: its strongly connected components,
+/// each sorted, the edges between them, and the components in topological order,
+/// ties broken by their smallest node, which keeps independent nodes in their original order
+template <class NodeType>
+struct Condensation {
+  std::vector<std::vector<NodeType>> components;
+  std::vector<std::set<size_t>> succs;
+  std::vector<size_t> order;
+};
+
+/// Graph's member templates are defined in graph.cc, which users include.
+template <class NodeType>
+Condensation<NodeType> condense(const Graph<NodeType> & graph) {
+  Condensation<NodeType> ret = {graph.strongly_connected_components(), {}, {}};
+  const auto & components = ret.components;
+
+  // Component of each node, and edges between components
+  std::map<NodeType, size_t> component_of;
+  for (size_t i = 0; i < components.size(); i++) {
+    for (const auto & node : components.at(i)) component_of[node] = i;
+  }
+  ret.succs.resize(components.size());
+  std::vector<size_t> num_preds(components.size(), 0);
+  for (const auto & node : graph.succ_map()) {
+    for (const auto & neighbor : node.second) {
+      const auto from = component_of.at(node.first);
+      const auto to = component_of.at(neighbor);
+      if (from != to and ret.succs.at(from).insert(to).second) num_preds.at(to)++;
+    }
+  }
+
+  // Kahn's algorithm, ready components ordered by their smallest node (components are sorted)
+  std::set<std::pair<NodeType, size_t>> ready;
+  for (size_t i = 0; i < components.size(); i++) {
+    if (num_preds.at(i) == 0) ready.emplace(components.at(i).front(), i);
+  }
+  while (not ready.empty()) {
+    const auto next = ready.begin()->second;
+    ready.erase(ready.begin());
+    ret.order.emplace_back(next);
+    for (const auto succ : ret.succs.at(next)) {
+      if (--num_preds.at(succ) == 0) ready.emplace(components.at(succ).front(), succ);
+    }
+  }
+  return ret;
+}
+
+/// Assign the nodes of a dependence graph, e.g., the PDG from InstrProgDeps,
+/// to num_stages pipeline stages, each of which runs on its own thread.
+/// Strongly connected components, e.g., all accesses of one state variable,
+/// stay within one stage, so stages share no state, and every dependence goes
+/// from a stage to itself or a later stage.
+/// The topological order of the components is cut into contiguous runs
+/// of roughly equal cost, by default one per node.
+template <class NodeType>
+std::map<NodeType, unsigned> assign_stages(const Graph<NodeType> & graph, const unsigned num_stages,
+                                           const std::function<size_t(const NodeType &)> & cost = {}) {
+  if (num_stages == 0) throw std::invalid_argument("assign_stages: need at least one stage\n");
+  const auto condensation = condense(graph);
+  const auto & components = condensation.components;
+
+  std::vector<size_t> component_costs;
+  size_t total_cost = 0;
+  for (const auto & component : components) {
+    size_t component_cost = 0;
+    for (const auto & node : component) component_cost += cost ? cost(node) : 1;
+    component_costs.emplace_back(component_cost);
+    total_cost += component_cost;
+  }
+
+  // A component goes to the stage its cost midpoint falls into,
+  // which never decreases along the topological order
+  std::map<NodeType, unsigned> ret;
+  size_t cost_so_far = 0;
+  for (const auto i : condensation.order) {
+    const size_t midpoint = 2 * cost_so_far + component_costs.at(i);
+    const auto stage = total_cost == 0 ? 0 : std::min<size_t>(num_stages - 1, midpoint * num_stages / (2 * total_cost));
+    for (const auto & node : components.at(i)) ret[node] = static_cast<unsigned>(stage);
+    cost_so_far += component_costs.at(i);
+  }
+  return ret;
+}
+
+/// Map the nodes of a dependence graph to the stages of a match-action pipeline,
+/// as early as possible: a strongly connected component, i.e., an atomic
+/// update of state, goes one stage after the latest component it depends on.
+/// The number of stages is one more than the largest stage returned.
+template <class NodeType>
+std::map<NodeType, unsigned> asap_stages(const Graph<NodeType> & graph) {
+  const auto condensation = condense(graph);
+  std::vector<unsigned> depth(condensation.components.size(), 0);
+  for (const auto i : condensation.order) {
+    for (const auto succ : condensation.succs.at(i)) depth.at(succ) = std::max(depth.at(succ), depth.at(i) + 1);
+  }
+
+  std::map<NodeType, unsigned> ret;
+  for (size_t i = 0; i < condensation.components.size(); i++) {
+    for (const auto & node : condensation.components.at(i)) ret[node] = depth.at(i);
+  }
+  return ret;
+}
+
+#endif  // PIPELINE_STAGES_H_
@@ -0,0 +1,118 @@
+#ifndef PREDICATE_DAG_H_
+#define PREDICATE_DAG_H_
+
+#include <map>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include "boolean_algebra.h"
+
+/// Shared DAG of predicates for the guards of all blocks in a function.
+/// Every node is hash-consed and computed once into its own predicate register.
+/// Conjunctions are built as left-deep AND chains over atoms in order of first
+/// appearance, which is outermost branch first, so a nested block ANDs one atom
+/// onto the register of its parent's guard instead of recomputing the prefix.
+class PredicateDag {
+ public:
+  /// Index of a node, which is also its predicate register number
+  typedef size_t NodeId;
+
+  /// Add a guard to the DAG and return the node that computes it
+  NodeId add_guard(const Dnf & guard) {
+    if (guard.is_literal()) return add_node(Node{Opcode::kConstant, "", guard.is_literal(true), 0, 0});
+
+    // Rank atoms by first appearance across all guards
+    for (const auto & clause : guard.clauses()) {
+      for (const auto & atom : clause.atoms()) {
+        atom_rank_.emplace(atom.var_name(), atom_rank_.size());
+      }
+    }
+
+    // One AND chain per clause
+    std::vector<NodeId> clause_nodes;
+    for (const auto & clause : guard.clauses()) {
+      std::vector<Atom> atoms(clause.atoms().begin(), clause.atoms().end());
+      std::stable_sort(atoms.begin(), atoms.end(), [this] (const Atom & a, const Atom & b)
+                       { return atom_rank_.at(a.var_name()) < atom_rank_.at(b.var_name()); });
+      NodeId chain = add_node(Node{Opcode::kAtom, atoms.front().var_name(), atoms.front().pristine(), 0, 0});
+      for (size_t i = 1; i < atoms.size(); i++) {
+        const auto atom = add_node(Node{Opcode::kAtom, atoms.at(i).var_name(), atoms.at(i).pristine(), 0, 0});
+        chain = add_node(Node{Opcode::kAnd, "", true, chain, atom});
+      }
+      clause_nodes.emplace_back(chain);
+    }
+
+    // OR the clauses together, in a canonical order so that
+    // the same set of clauses always maps to the same node
+    std::sort(clause_nodes.begin(), clause_nodes.end());
+    clause_nodes.erase(std::unique(clause_nodes.begin(), clause_nodes.end()), clause_nodes.end());
+    NodeId ret = clause_nodes.front();
+    for (size_t i = 1; i < clause_nodes.size(); i++) {
+      ret = add_node(Node{Opcode::kOr, "", true, ret, clause_nodes.at(i)});
+    }
+    return ret;
+  }
+
+  /// Number of two-input AND and OR operations needed to compute all guards,
+  /// atoms and their negations are free: they're condition bits feeding the ALUs
+  size_t num_operations() const {
+    return static_cast<size_t>(std::count_if(nodes_.begin(), nodes_.end(), [] (const Node & node)
+                                             { return node.opcode == Opcode::kAnd or node.opcode == Opcode::kOr; }));
+  }
+
+  /// Number of nodes, i.e., predicate registers
+  size_t size() const { return nodes_.size(); }
+
+  /// Print one predicate register assignment per line, in evaluation order
+  friend std::ostream & operator<< (std::ostream & out, const PredicateDag & dag) {
+    for (NodeId i = 0; i < dag.nodes_.size(); i++) {
+      const auto & node = dag.nodes_.at(i);
+      out << "p" << i << " = ";
+      switch (node.opcode) {
+        case Opcode::kConstant: out << (node.pristine ? "true" : "false"); break;
+        case Opcode::kAtom:     out << (node.pristine ? "" : "~") << node.atom; break;
+        case Opcode::kAnd:      out << "p" << node.left << " and p" << node.right; break;
+        case Opcode::kOr:       out << "p" << node.left << " or p" << node.right; break;
+      }
+      out << "\n";
+    }
+    return out;
+  }
+
+ private:
+  enum class Opcode { kConstant, kAtom, kAnd, kOr };
+
+  /// A node is a constant (value in pristine), a possibly negated atom,
+  /// or an operation on two earlier nodes
+  struct Node {
+    Opcode opcode;
+    std::string atom;
+    bool pristine;
+    NodeId left;
+    NodeId right;
+  };
+
+  /// Return existing node if there's a structurally identical one,
+  /// otherwise append it to nodes_
+  NodeId add_node(const Node & node) {
+    const auto key = std::make_tuple(static_cast<int>(node.opcode), node.atom, node.pristine, node.left, node.right);
+    const auto it = index_.find(key);
+    if (it != index_.end()) return it->second;
+    nodes_.emplace_back(node);
+    index_[key] = nodes_.size() - 1;
+    return nodes_.size() - 1;
+  }
+
+  /// All nodes, operands always precede their users
+  std::vector<Node> nodes_ = {};
+
+  /// Hash-consing table from node contents to node
+  std::map<std::tuple<int, std::string, bool, NodeId, NodeId>, NodeId> index_ = {};
+
+  /// Rank of each atom by first appearance
+  std::map<std::string, size_t> atom_rank_ = {};
+};
+
+#endif  // PREDICATE_DAG_H_
@@ -0,0 +1,123 @@
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include "clang/AST/AST.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Tooling/Refactoring.h"
+#include "llvm/Support/raw_ostream.h"
+#include "burst_loop_handler.h"
+#include "function_decl_handler.h"
+#include "member_expr_handler.h"
+#include "packet_processing_code_handler.h"
+#include "pipeline_stage_handler.h"
+#include "state_var_handler.h"
+#include "source_transforms.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+
+/// Run struct_to_local_vars and then add_pkt_processing_loop on a parsed
+/// translation unit and return the rewritten main file. Both transforms
+/// match on the same in-memory AST and edit the same rewrite buffer.
+std::string transform_translation_unit(ASTUnit & ast_unit, const TransformOptions & options, TransformArtifacts * artifacts) {
+  // A pipeline's stages loop over their packets themselves, the harness function keeps scalar locals.
+  // Otherwise the harness entry fetches packets in bursts, of one packet if no burst size is given,
+  // and then only the harness function runs in bursts, every other function is transformed as usual.
+  const bool pipelined = options.num_stages > 0;
+  const bool harness_only_bursts = options.burst_size == 0 and not options.harness_function.empty() and not pipelined;
+  const unsigned burst_size = harness_only_bursts ? 1 : options.burst_size;
+  if (options.num_shards > 0 and (options.harness_function.empty() or options.flow_key.empty())) {
+    throw std::invalid_argument("Sharding needs a harness function and a flow key\n");
+  }
+  if (pipelined and (options.harness_function.empty() or options.num_shards > 0 or options.burst_size > 0)) {
+    throw std::invalid_argument("A pipeline needs a harness function, and no shards or bursts\n");
+  }
+  auto & ast_context = ast_unit.getASTContext();
+  auto & source_manager = ast_unit.getSourceManager();
+
+  // One traversal for member expressions and packet-processing functions
+  Replacements struct_replacements;
+  Replacements loop_replacements;
+  MemberExprHandler member_expr_handler(struct_replacements, burst_size, harness_only_bursts ? options.harness_function : "");
+  PacketProcessingCodeHandler packet_processing_code_handler(loop_replacements);
+  StateVarHandler state_var_handler(struct_replacements, std::set<std::string>(options.flow_key.begin(), options.flow_key.end()),
+                                    options.harness_function);
+  MatchFinder finder;
+  finder.addMatcher(memberExpr().bind("memberExpr"), &member_expr_handler);
+  if (pipelined or harness_only_bursts) {
+    finder.addMatcher(functionDecl(unless(hasName(options.harness_function))).bind("packetProcessingCode"), &packet_processing_code_handler);
+  } else if (burst_size == 0) {
+    finder.addMatcher(functionDecl().bind("packetProcessingCode"), &packet_processing_code_handler);
+  }
+  if (options.num_shards > 0) {
+    finder.addMatcher(declRefExpr(to(varDecl(hasGlobalStorage()).bind("stateVar")),
+                                  hasAncestor(functionDecl())).bind("stateVarRef"), &state_var_handler);
+  }
+  finder.matchAST(ast_context);
+
+  // A flow that rewrites its own key could move to another flow's state
+  if (options.num_shards > 0) {
+    state_var_handler.finalize();
+    const auto written = member_expr_handler.written_members();
+    if (std::any_of(options.flow_key.begin(), options.flow_key.end(), [&written] (const std::string & field)
+                    { return written.find(field) != written.end(); })) {
+      state_var_handler.share_all();
+    }
+    state_var_handler.add_shard_replacements(source_manager, options.num_shards, BurstLoopHandler::shard_id());
+  }
+
+  // Declarations go in once all member expressions are known,
+  // this is a second walk over the same AST, not a second parse.
+  // In burst mode, the burst loop and its declarations depend on
+  // which fields are parsed and written, so it's built in this walk too.
+  FunctionDeclHandler function_decl_handler(struct_replacements, member_expr_handler.get_decls());
+  BurstLoopHandler burst_loop_handler(loop_replacements, member_expr_handler, burst_size, options.harness_function,
+                                      options.num_shards, options.flow_key, state_var_handler.shard_expression(),
+                                      not state_var_handler.shared_state().empty());
+  std::unique_ptr<PipelineStageHandler> pipeline_stage_handler(pipelined ? new PipelineStageHandler(member_expr_handler, options.num_stages)
+                                                                         : nullptr);
+  MatchFinder find_function_decl;
+  if (pipelined) {
+    find_function_decl.addMatcher(functionDecl(hasName(options.harness_function)).bind("pipelineFunction"), pipeline_stage_handler.get());
+  }
+  if (harness_only_bursts) {
+    find_function_decl.addMatcher(functionDecl(unless(hasName(options.harness_function))).bind("functionDecl"), &function_decl_handler);
+    find_function_decl.addMatcher(functionDecl(hasName(options.harness_function)).bind("packetProcessingCode"), &burst_loop_handler);
+  } else if (burst_size == 0) {
+    find_function_decl.addMatcher(functionDecl().bind("functionDecl"), &function_decl_handler);
+  } else {
+    find_function_decl.addMatcher(functionDecl().bind("packetProcessingCode"), &burst_loop_handler);
+  }
+  find_function_decl.matchAST(ast_context);
+  if (artifacts != nullptr) {
+    artifacts->manifest = member_expr_handler.manifest();
+    artifacts->layout = member_expr_handler.layout();
+    artifacts->per_flow_state = state_var_handler.per_flow_state();
+    artifacts->shared_state = state_var_handler.shared_state();
+  }
+
+  // Apply struct_to_local_vars first
+  Rewriter rewriter(source_manager, ast_unit.getLangOpts());
+  applyAllReplacements(struct_replacements, rewriter);
+
+  // Stages copy the harness function's statements as struct_to_local_vars left them
+  if (pipelined) pipeline_stage_handler->add_stages(rewriter);
+
+  // add_pkt_processing_loop runs on the output of struct_to_local_vars,
+  // so its text goes before anything the first stage inserted at the same spot
+  const auto file_start = source_manager.getLocForStartOfFile(source_manager.getMainFileID());
+  for (const auto & replacement : loop_replacements) {
+    rewriter.InsertTextBefore(file_start.getLocWithOffset(static_cast<int>(replacement.getOffset())),
+                              replacement.getReplacementText());
+  }
+
+  std::string ret;
+  llvm::raw_string_ostream rso(ret);
+  rewriter.getEditBuffer(source_manager.getMainFileID()).write(rso);
+  return rso.str();
+}
@@ -0,0 +1,50 @@
+#ifndef SOURCE_TRANSFORMS_H_
+#define SOURCE_TRANSFORMS_H_
+
+#include <set>
+#include <string>
+#include <vector>
+#include "clang/Frontend/ASTUnit.h"
+
+/// How to generate the packet-processing loop
+struct TransformOptions {
+  /// A non-zero burst size processes that many packets per loop iteration,
+  /// with packet fields in struct-of-arrays locals (see BurstLoopHandler)
+  unsigned burst_size = 0;
+
+  /// Function to drive from the runtime in jayhawk_runtime.h, e.g., pcap_harness,
+  /// instead of looping forever. Implies a burst size of at least 1.
+  std::string harness_function = "";
+
+  /// Run the harness function on this many cores, steering packets by a hash
+  /// of the flow key fields (member names, e.g., src). Requires a harness function.
+  unsigned num_shards = 0;
+  std::vector<std::string> flow_key = {};
+
+  /// Split the harness function into this many pipeline stages, each running on its own core
+  /// (see PipelineStageHandler). Requires a harness function, and excludes shards and bursts.
+  unsigned num_stages = 0;
+};
+
+/// Side outputs of transforming a translation unit, besides the rewritten source
+struct TransformArtifacts {
+  /// Parse/deparse manifest of the packet fields
+  std::string manifest = "";
+
+  /// Packed PHV layout of the packet fields with accessors, as a C header
+  std::string layout = "";
+
+  /// When sharding, state variables that each shard has its own copy of,
+  /// and state variables shared between shards, which serialize them
+  std::set<std::string> per_flow_state = {};
+  std::set<std::string> shared_state = {};
+};
+
+/// Run struct_to_local_vars and then add_pkt_processing_loop on a parsed
+/// translation unit and return the rewritten main file. Both transforms
+/// match on the same in-memory AST and edit the same rewrite buffer.
+/// If artifacts isn't null, the manifest and layout of the packet fields are stored there.
+std::string transform_translation_unit(clang::ASTUnit & ast_unit, const TransformOptions & options = TransformOptions(),
+                                       TransformArtifacts * artifacts = nullptr);
+
+#endif  // SOURCE_TRANSFORMS_H_
@@ -0,0 +1,101 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+/// Lock-free ring of fixed-size records between exactly one producer thread
+/// and one consumer thread, e.g., two stages of a software pipeline.
+/// Records live in the ring and are handed out as contiguous runs,
+/// so the producer writes them in place and the consumer reads them in place.
+/// The producer's and the consumer's indices sit on cache lines of their own,
+/// next to each side's cached copy of the other's index, so that a side only
+/// touches the other's line when its cached copy says the ring is full or empty.
+/// Reserving, committing, peeking and releasing a batch of records at a time
+/// amortizes the index updates over the batch.
+class SpscRing {
+ public:
+  /// Ring of capacity records of record_size bytes each, capacity a power of 2
+  SpscRing(const size_t record_size, const size_t capacity)
+    : record_size_(record_size), capacity_(capacity), mask_(capacity - 1), storage_(record_size * capacity) {
+    if (record_size == 0) throw std::invalid_argument("SpscRing: record size must be positive\n");
+    if (capacity == 0 or (capacity & (capacity - 1)) != 0) throw std::invalid_argument("SpscRing: capacity must be a power of 2\n");
+  }
+
+  /// Delete copy constructor and copy assignment, the ring is shared by reference
+  SpscRing(const SpscRing &) = delete;
+  SpscRing & operator=(const SpscRing &) = delete;
+
+  /// Producer: point records to free records to write, at most max of them,
+  /// and return how many, 0 if the ring is full.
+  /// Fewer than max come back if the free space wraps around the end of the ring.
+  size_t reserve(uint8_t * & records, const size_t max) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (capacity_ - (tail - cached_head_) < max) cached_head_ = head_.load(std::memory_order_acquire);
+    const size_t offset = tail & mask_;
+    records = storage_.data() + offset * record_size_;
+    return std::min(std::min(max, capacity_ - (tail - cached_head_)), capacity_ - offset);
+  }
+
+  /// Producer: publish the first count records of the last reservation
+  void commit(const size_t count) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  /// Producer: no more records will be committed
+  void close() { closed_.store(true, std::memory_order_release); }
+
+  /// Consumer: point records to published records to read, at most max of them,
+  /// and return how many, 0 if the ring is empty.
+  size_t peek(uint8_t * & records, const size_t max) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (cached_tail_ - head < max) cached_tail_ = tail_.load(std::memory_order_acquire);
+    const size_t offset = head & mask_;
+    records = storage_.data() + offset * record_size_;
+    return std::min(std::min(max, cached_tail_ - head), capacity_ - offset);
+  }
+
+  /// Consumer: hand the first count records of the last peek back to the producer
+  void release(const size_t count) {
+    head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  /// Consumer: whether the producer closed the ring and every record was released
+  bool drained() const {
+    // Everything committed before close() is visible once closed_ is
+    return closed_.load(std::memory_order_acquire) and
+           head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+  }
+
+  /// Accessors
+  size_t record_size() const { return record_size_; }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  enum : size_t { kCacheLineBytes = 64 };
+
+  const size_t record_size_;
+  const size_t capacity_;
+  const size_t mask_;
+  std::vector<uint8_t> storage_;
+
+  /// Producer's line: records committed so far, and records released as of the last look
+  char producer_padding_[kCacheLineBytes] = {};
+  std::atomic<size_t> tail_ = {0};
+  size_t cached_head_ = 0;
+
+  /// Consumer's line: records released so far, and records committed as of the last look
+  char consumer_padding_[kCacheLineBytes] = {};
+  std::atomic<size_t> head_ = {0};
+  size_t cached_tail_ = 0;
+
+  /// Written once by the producer
+  char closed_padding_[kCacheLineBytes] = {};
+  std::atomic<bool> closed_ = {false};
+  char end_padding_[kCacheLineBytes] = {};
+};
+
+#endif  // SPSC_RING_H_
@@ -0,0 +1,171 @@
+#ifndef STATE_VAR_HANDLER_H_
+#define STATE_VAR_HANDLER_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "clang/Lex/Lexer.h"
+#include "clang/AST/AST.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Tooling/Refactoring.h"
+#include "clang_utility_functions.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+
+/// Classifies the state variables (globals) used by packet-processing functions
+/// for sharding packets across cores by flow.
+/// A state variable is per-flow if it's an array declared in the main file without
+/// an initializer, and every use of it is a subscript with the same index expression,
+/// computed only from flow key fields of the harness function's packet parameter and constants.
+/// Packets are then steered by a hash of that index expression, the shard expression,
+/// so all packets that touch an element land on the same shard, even if the index
+/// is itself a hash that maps several flows to one element, and each shard can own
+/// a private copy of the array and run without locks.
+/// Arrays indexed by a different expression than the shard expression,
+/// and everything else, e.g., a global packet counter, are shared between shards.
+class StateVarHandler : public MatchFinder::MatchCallback {
+ public:
+  /// Constructor: Pass Refactoring tool, the names of the flow key fields, e.g., {"src", "dst"},
+  /// and the harness function, whose packet parameter they're fields of
+  StateVarHandler(Replacements & t_replace, const std::set<std::string> & t_flow_key, const std::string & t_harness_function)
+    : Replace(t_replace), flow_key_(t_flow_key), harness_function_(t_harness_function) {}
+
+  /// Callback whenever there's a match
+  virtual void run(const MatchFinder::MatchResult &Result) override {
+    const DeclRefExpr *decl_ref = Result.Nodes.getNodeAs<clang::DeclRefExpr>("stateVarRef");
+    const VarDecl *var_decl = Result.Nodes.getNodeAs<clang::VarDecl>("stateVar");
+    assert(decl_ref != nullptr and var_decl != nullptr);
+    const auto name = var_decl->getNameAsString();
+    auto & state_var = state_vars_[name];
+    auto & source_manager = *Result.SourceManager;
+
+    if (not state_var.seen) {
+      state_var.seen = true;
+      const auto * definition = var_decl->getDefinition();
+      state_var.per_flow = definition != nullptr and
+                           definition->getType()->isConstantArrayType() and
+                           not definition->hasInit() and
+                           source_manager.getFileID(source_manager.getExpansionLoc(definition->getLocation())) == source_manager.getMainFileID();
+      if (state_var.per_flow) {
+        state_var.name_end = Lexer::getLocForEndOfToken(definition->getLocation(), 0, source_manager, Result.Context->getLangOpts());
+      }
+    }
+
+    // Array to pointer decay sits between the reference and the subscript
+    const auto parents = Result.Context->getParents(*decl_ref);
+    const auto * cast = parents.empty() ? nullptr : parents[0].get<ImplicitCastExpr>();
+    const auto cast_parents = cast == nullptr ? parents : Result.Context->getParents(*cast);
+    const auto * subscript = cast_parents.empty() ? nullptr : cast_parents[0].get<ArraySubscriptExpr>();
+    if (subscript == nullptr or subscript->getBase()->IgnoreImpCasts() != decl_ref or
+        not depends_only_on_flow_key(subscript->getIdx())) {
+      state_var.per_flow = false;
+      return;
+    }
+    state_var.indices.emplace(clang_stmt_printer(subscript->getIdx()));
+    state_var.uses.emplace_back(Lexer::getLocForEndOfToken(decl_ref->getLocEnd(), 0, source_manager, Result.Context->getLangOpts()));
+  }
+
+  /// Pick the shard expression: the index shared by most per-flow arrays.
+  /// Call once all state variables have been matched.
+  void finalize() {
+    std::map<std::string, size_t> votes;
+    for (const auto & state_var : state_vars_) {
+      if (state_var.second.per_flow and state_var.second.indices.size() == 1) votes[*state_var.second.indices.begin()]++;
+    }
+    for (const auto & vote : votes) {
+      if (shard_expression_.empty() or vote.second > votes.at(shard_expression_)) shard_expression_ = vote.first;
+    }
+    for (auto & state_var : state_vars_) {
+      const auto & indices = state_var.second.indices;
+      if (indices.size() != 1 or *indices.begin() != shard_expression_) state_var.second.per_flow = false;
+    }
+  }
+
+  /// Expression of the packet to steer packets by, "" if there's no per-flow state
+  const std::string & shard_expression() const { return shard_expression_; }
+
+  /// Give every per-flow state variable one copy per shard,
+  /// indexed by the thread-local shard id, in declarations and uses
+  void add_shard_replacements(const SourceManager & source_manager, const unsigned num_shards, const std::string & shard_id) const {
+    for (const auto & state_var : state_vars_) {
+      if (not state_var.second.per_flow) continue;
+      Replace.insert(Replacement(source_manager, state_var.second.name_end, 0, "[" + std::to_string(num_shards) + "]"));
+      for (const auto & use : state_var.second.uses) {
+        Replace.insert(Replacement(source_manager, use, 0, "[" + shard_id + "]"));
+      }
+    }
+  }
+
+  /// Names of per-flow and shared state variables
+  std::set<std::string> per_flow_state() const { return state_names(true); }
+  std::set<std::string> shared_state() const { return state_names(false); }
+
+  /// Demote every state variable to shared, e.g., because the program writes a flow key field
+  void share_all() {
+    for (auto & state_var : state_vars_) state_var.second.per_flow = false;
+    shard_expression_ = "";
+  }
+
+ private:
+  /// What's known about one state variable
+  struct StateVar {
+    bool seen = false;
+    bool per_flow = false;
+
+    /// Location right after the name in the definition, and after the name in each use
+    SourceLocation name_end = SourceLocation();
+    std::vector<SourceLocation> uses = {};
+
+    /// Distinct index expressions it's subscripted with
+    std::set<std::string> indices = {};
+  };
+
+  /// Whether expr is computed from flow key fields of the harness function's packet parameter
+  /// and constants only; the same fields of any other struct, e.g., other.src, don't identify the flow
+  bool depends_only_on_flow_key(const Expr * expr) const {
+    expr = expr->IgnoreParenImpCasts();
+    if (const auto * member_expr = dyn_cast<MemberExpr>(expr)) {
+      const auto * base = dyn_cast<DeclRefExpr>(member_expr->getBase()->IgnoreParenImpCasts());
+      const auto * param = base == nullptr ? nullptr : dyn_cast<ParmVarDecl>(base->getDecl());
+      const auto * function = param == nullptr ? nullptr : dyn_cast<FunctionDecl>(param->getDeclContext());
+      return function != nullptr and function->getNameAsString() == harness_function_ and
+             flow_key_.find(clang_value_decl_printer(member_expr->getMemberDecl())) != flow_key_.end();
+    }
+    if (isa<IntegerLiteral>(expr)) return true;
+    if (const auto * binary_op = dyn_cast<BinaryOperator>(expr)) {
+      return not binary_op->isAssignmentOp() and
+             depends_only_on_flow_key(binary_op->getLHS()) and depends_only_on_flow_key(binary_op->getRHS());
+    }
+    if (const auto * unary_op = dyn_cast<UnaryOperator>(expr)) {
+      return not unary_op->isIncrementDecrementOp() and depends_only_on_flow_key(unary_op->getSubExpr());
+    }
+    return false;
+  }
+
+  std::set<std::string> state_names(const bool per_flow) const {
+    std::set<std::string> ret;
+    for (const auto & state_var : state_vars_) if (state_var.second.per_flow == per_flow) ret.emplace(state_var.first);
+    return ret;
+  }
+
+  Replacements & Replace;
+
+  /// Names of the packet fields that make up the flow key
+  std::set<std::string> flow_key_;
+
+  /// Function whose packet parameter the flow key fields are read from
+  std::string harness_function_;
+
+  /// State variables by name
+  std::map<std::string, StateVar> state_vars_ = {};
+
+  /// Index expression of the per-flow state
+  std::string shard_expression_ = "";
+};
+
+#endif  // STATE_VAR_HANDLER_H_
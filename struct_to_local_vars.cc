@@ -1,5 +1,6 @@
 #include <string>
 #include <iostream>
+#include <fstream>
 #include <set>
 
 #include "clang/AST/AST.h"
@@ -15,6 +16,7 @@
 #include "llvm/Support/YAMLTraits.h"
 #include "clang_utility_functions.h"
 #include "function_decl_handler.h"
+#include "member_expr_handler.h"
 
 using namespace clang;
 using namespace clang::ast_matchers;
@@ -23,39 +25,8 @@ using namespace clang::tooling;
 
 static llvm::cl::OptionCategory StructToLocalVars("Replace structs with local variables");
 
-class MemberExprHandler : public MatchFinder::MatchCallback {
- public:
-  /// Get all declarations
-  auto get_decls() const { return decl_strings_; }
-
-  /// Constructor: Pass Refactoring tool as argument
-  MemberExprHandler(Replacements & t_replace) : Replace(t_replace) {}
-
-  /// Callback whenever there's a match
-  virtual void run(const MatchFinder::MatchResult &Result) override {
-    const MemberExpr *member_expr = Result.Nodes.getNodeAs<clang::MemberExpr>("memberExpr");
-    assert(member_expr != nullptr);
-    const auto * base        = member_expr->getBase();
-    const auto * member_decl = member_expr->getMemberDecl();
-
-    // Get type name of member_decl
-    auto type_name = member_decl->getType().getAsString();
-
-    // Create declaration as a string, TODO: there's probably a more hygeinic approach
-    decl_strings_.emplace(type_name + " " + clang_stmt_printer(base) + "__" + clang_value_decl_printer(member_decl)+ ";\n");
-
-    // Now, create replacement text
-    Replacement Rep(*(Result.SourceManager), member_expr,
-                    clang_stmt_printer(base) + "__" + clang_value_decl_printer(member_decl));
-
-    // Insert into this Replace
-    Replace.insert(Rep);
-  }
-
- private:
-  Replacements & Replace;
-  std::set<std::string> decl_strings_;
-};
+static llvm::cl::opt<std::string> Manifest("manifest", llvm::cl::init(""), llvm::cl::cat(StructToLocalVars),
+                                           llvm::cl::desc("Write the parse/deparse manifest of the packet fields to this file"));
 
 int main(int argc, const char **argv) {
   CommonOptionsParser op(argc, argv, StructToLocalVars);
@@ -73,6 +44,12 @@ int main(int argc, const char **argv) {
   find_function_decl.addMatcher(functionDecl().bind("functionDecl"), &function_decl_handler);
   Tool.run(newFrontendActionFactory(&find_function_decl).get());
 
+  // Fields to extract at ingress and write back at egress
+  if (not Manifest.empty()) {
+    std::ofstream manifest_stream(Manifest);
+    manifest_stream << member_expr_handler.manifest();
+  }
+
   // Write into YAML object
   TranslationUnitReplacements replace_yaml;
   replace_yaml.MainSourceFile = argv[1];
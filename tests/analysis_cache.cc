@@ -0,0 +1,210 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <dirent.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "graph.cc"
+#include "dominator_utility.cc"
+#include "cfg_generators.h"
+#include "analysis_cache.h"
+
+/// Temporary directory, removed with its files when the test is done
+class TempDir {
+ public:
+  TempDir() : name_("/tmp/analysis_cache_XXXXXX") {
+    if (mkdtemp(&name_[0]) == nullptr) name_.clear();
+  }
+  TempDir(const TempDir &) = delete;
+  TempDir & operator=(const TempDir &) = delete;
+  ~TempDir() {
+    for (const auto & file : files()) std::remove((name_ + "/" + file).c_str());
+    rmdir(name_.c_str());
+  }
+  const std::string & name() const { return name_; }
+
+  std::vector<std::string> files() const {
+    std::vector<std::string> ret;
+    DIR * dir = opendir(name_.c_str());
+    if (dir == nullptr) return ret;
+    for (auto * entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+      const std::string file = entry->d_name;
+      if (file != "." and file != "..") ret.emplace_back(file);
+    }
+    closedir(dir);
+    return ret;
+  }
+
+ private:
+  std::string name_;
+};
+
+/// Graph<int> whose node n prints as "b" followed by n / scale,
+/// so graphs of different ints can have the same labels
+static Graph<int> scaled(const Graph<int> & graph, const int scale) {
+  Graph<int> ret([scale] (const int node) { return "b" + std::to_string(node / scale); });
+  for (const auto & node : graph.node_set()) ret.add_node(node * scale);
+  for (const auto & node : graph.succ_map()) {
+    for (const auto & succ : node.second) ret.add_edge(node.first * scale, succ * scale);
+  }
+  return ret;
+}
+
+TEST(FingerprintTests, StringsAreDelimited) {
+  EXPECT_NE(FingerprintBuilder().add_string("ab").add_string("c").finish(),
+            FingerprintBuilder().add_string("a").add_string("bc").finish());
+  EXPECT_EQ(FingerprintBuilder().add_string("ab").add_u64(7).finish(),
+            FingerprintBuilder().add_string("ab").add_u64(7).finish());
+  EXPECT_EQ(32u, FingerprintBuilder().finish().hex().size());
+}
+
+TEST(FingerprintTests, IndependentOfNodeValuesAndInsertionOrder) {
+  const auto cfg = random_reducible_cfg(300, 5).graph;
+  EXPECT_EQ(graph_fingerprint(scaled(cfg, 1)), graph_fingerprint(scaled(cfg, 7)));
+
+  // The same edges added in reverse order
+  Graph<int> reversed;
+  for (const auto & node : cfg.node_set()) reversed.add_node(node);
+  for (auto node = cfg.succ_map().rbegin(); node != cfg.succ_map().rend(); node++) {
+    for (auto succ = node->second.rbegin(); succ != node->second.rend(); succ++) reversed.add_edge(node->first, *succ);
+  }
+  EXPECT_EQ(graph_fingerprint(cfg), graph_fingerprint(reversed));
+}
+
+TEST(FingerprintTests, SensitiveToEdgesAndLabels) {
+  const auto cfg = diamond_chain(10).graph;
+  const auto fingerprint = graph_fingerprint(cfg);
+
+  auto extra_edge = cfg;
+  extra_edge.add_edge(0, 30);
+  EXPECT_NE(fingerprint, graph_fingerprint(extra_edge));
+
+  // Same shape, one edge pointing the other way
+  auto flipped = cfg.copy_and_clear();
+  for (const auto & node : cfg.succ_map()) {
+    for (const auto & succ : node.second) {
+      if (node.first == 0 and succ == 1) flipped.add_edge(succ, node.first);
+      else flipped.add_edge(node.first, succ);
+    }
+  }
+  EXPECT_NE(fingerprint, graph_fingerprint(flipped));
+
+  const std::function<std::string(const int &)> relabel = [] (const int & node) { return std::to_string(node == 5 ? 500 : node); };
+  EXPECT_NE(fingerprint, graph_fingerprint(cfg, relabel));
+  EXPECT_NE(graph_fingerprint(diamond_chain(10).graph), graph_fingerprint(diamond_chain(11).graph));
+}
+
+TEST(AnalysisCacheTests, StoreAndLookupAcrossInstances) {
+  TempDir dir;
+  const auto key = FingerprintBuilder().add_string("key").finish();
+  const std::string blob("result\0with nul", 15);
+  {
+    AnalysisCache cache(dir.name());
+    std::string found;
+    EXPECT_FALSE(cache.lookup("kind", key, found));
+    EXPECT_TRUE(cache.store("kind", key, blob));
+    EXPECT_EQ(1u, cache.misses());
+  }
+
+  AnalysisCache cache(dir.name());
+  std::string found;
+  ASSERT_TRUE(cache.lookup("kind", key, found));
+  EXPECT_EQ(blob, found);
+  EXPECT_FALSE(cache.lookup("other_kind", key, found));
+  EXPECT_FALSE(cache.lookup("kind", FingerprintBuilder().add_string("other key").finish(), found));
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(2u, cache.misses());
+  EXPECT_EQ(1u, dir.files().size());
+}
+
+TEST(AnalysisCacheTests, TruncatedEntryIsAMiss) {
+  TempDir dir;
+  AnalysisCache cache(dir.name());
+  const auto key = FingerprintBuilder().add_string("key").finish();
+  cache.store("kind", key, std::string(100, 'x'));
+  ASSERT_EQ(1u, dir.files().size());
+  const auto file_name = dir.name() + "/" + dir.files().front();
+  std::ifstream in(file_name, std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::ofstream(file_name, std::ios::binary) << contents.substr(0, contents.size() - 1);
+
+  std::string found;
+  EXPECT_FALSE(cache.lookup("kind", key, found));
+}
+
+TEST(AnalysisCacheTests, BlobRoundTrip) {
+  BlobWriter out;
+  out.u64(0);
+  out.u64(1ull << 63);
+  out.string("label");
+  BlobReader in(out.blob());
+  EXPECT_EQ(0u, in.u64());
+  EXPECT_EQ(1ull << 63, in.u64());
+  EXPECT_EQ("label", in.string());
+  EXPECT_NO_THROW(in.finish());
+  EXPECT_THROW(in.u64(), std::runtime_error);
+}
+
+/// Check that two DominatorUtility results agree, given the node of b for each node of a
+static void expect_same_dominators(const DominatorUtility<int> & a, const DominatorUtility<int> & b, const int scale) {
+  ASSERT_EQ(a.immediate_dominators().size(), b.immediate_dominators().size());
+  for (const auto & idom : a.immediate_dominators()) {
+    EXPECT_EQ(idom.second * scale, b.immediate_dominator(idom.first * scale));
+  }
+  const auto frontiers = a.dominance_frontier();
+  const auto other_frontiers = b.dominance_frontier();
+  for (const auto & frontier : frontiers) {
+    std::set<int> expected;
+    for (const auto & node : frontier.second) expected.insert(node * scale);
+    EXPECT_EQ(expected, other_frontiers.at(frontier.first * scale));
+  }
+}
+
+TEST(AnalysisCacheTests, DominatorsReusedAcrossGraphsWithTheSameLabels) {
+  TempDir dir;
+  AnalysisCache cache(dir.name());
+  const auto cfg = random_reducible_cfg(500, 11);
+  const auto graph = scaled(cfg.graph, 1);
+  const DominatorUtility<int> expected(graph, cfg.entry);
+
+  const auto first = cached_dominator_utility(&cache, graph, cfg.entry);
+  EXPECT_EQ(0u, cache.hits());
+  expect_same_dominators(expected, *first, 1);
+
+  // Different nodes, same labels: the same result, mapped onto the new nodes
+  const auto second = cached_dominator_utility(&cache, scaled(cfg.graph, 3), cfg.entry * 3);
+  EXPECT_EQ(1u, cache.hits());
+  expect_same_dominators(expected, *second, 3);
+  EXPECT_TRUE(second->dominator_tree() == scaled(expected.dominator_tree(), 3));
+
+  // Another start node is another key
+  cached_dominator_utility(&cache, graph, cfg.exit);
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(2u, dir.files().size());
+}
+
+TEST(AnalysisCacheTests, RepeatedLabelsAreNotCached) {
+  TempDir dir;
+  AnalysisCache cache(dir.name());
+  const auto cfg = diamond_chain(4);
+  Graph<int> graph([] (const int node) { return std::to_string(node % 2); });
+  for (const auto & node : cfg.graph.node_set()) graph.add_node(node);
+  for (const auto & node : cfg.graph.succ_map()) {
+    for (const auto & succ : node.second) graph.add_edge(node.first, succ);
+  }
+  const auto result = cached_dominator_utility(&cache, graph, cfg.entry);
+  expect_same_dominators(DominatorUtility<int>(cfg.graph, cfg.entry), *result, 1);
+  EXPECT_EQ(0u, cache.hits() + cache.misses());
+  EXPECT_TRUE(dir.files().empty());
+}
+
+TEST(AnalysisCacheTests, ProcessWideCache) {
+  EXPECT_EQ(nullptr, AnalysisCache::current());
+  TempDir dir;
+  AnalysisCache::open(dir.name());
+  ASSERT_NE(nullptr, AnalysisCache::current());
+  EXPECT_EQ(dir.name(), AnalysisCache::current()->dir());
+  AnalysisCache::open("");
+  EXPECT_EQ(nullptr, AnalysisCache::current());
+}
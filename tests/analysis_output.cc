@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "gtest/gtest.h"
+#include "graph.cc"
+#include "analysis_output.h"
+
+/// Contents of file_name
+static std::string read_file(const std::string & file_name) {
+  std::ifstream in(file_name);
+  std::stringstream ret;
+  ret << in.rdbuf();
+  return ret.str();
+}
+
+TEST(JayhawkTests, AnalysisOutputVerbosity) {
+  ASSERT_EQ(AnalysisOutput::verbosity(), Verbosity::kSummary);
+  ASSERT_TRUE(AnalysisOutput::enabled(Verbosity::kSummary));
+  ASSERT_FALSE(AnalysisOutput::enabled(Verbosity::kResults));
+
+  AnalysisOutput::set_verbosity(Verbosity::kTrace);
+  ASSERT_TRUE(AnalysisOutput::enabled(Verbosity::kResults));
+  ASSERT_TRUE(AnalysisOutput::enabled(Verbosity::kTrace));
+
+  // Silent output is never wanted, even when silent
+  AnalysisOutput::set_verbosity(Verbosity::kSilent);
+  ASSERT_FALSE(AnalysisOutput::enabled(Verbosity::kSummary));
+  ASSERT_FALSE(AnalysisOutput::enabled(Verbosity::kSilent));
+  AnalysisOutput::set_verbosity(Verbosity::kSummary);
+}
+
+TEST(JayhawkTests, AnalysisOutputFile) {
+  char file_name[] = "/tmp/analysis_output_XXXXXX";
+  const int fd = mkstemp(file_name);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  // Small writes, one larger than the buffer, and single characters
+  const std::string large(200 * 1024, 'x');
+  AnalysisOutput::open(file_name);
+  AnalysisOutput::stream() << "first line\n" << large << 'y' << 42 << "\n";
+  AnalysisOutput::flush();
+  ASSERT_EQ(read_file(file_name), "first line\n" + large + "y42\n");
+
+  // Reopening writes out what's left
+  AnalysisOutput::stream() << "not flushed";
+  AnalysisOutput::open("");
+  ASSERT_EQ(read_file(file_name), "first line\n" + large + "y42\nnot flushed");
+  std::remove(file_name);
+
+  ASSERT_THROW(AnalysisOutput::open("/nonexistent/directory/file"), std::runtime_error);
+  AnalysisOutput::open("-");
+}
+
+TEST(JayhawkTests, AnalysisOutputMemoizedPrinter) {
+  // Printing a graph formats every node once, not once per edge
+  int calls = 0;
+  const auto printer = memoized_printer<int>([&calls] (const int node) { calls++; return "n" + std::to_string(node); });
+  Graph<int> graph(printer);
+  for (int i = 0; i < 10; i++) graph.add_node(i);
+  for (int i = 0; i < 10; i++) {
+    for (int j = 0; j < 10; j++) graph.add_edge(i, j);
+  }
+  std::ostringstream once;
+  once << graph;
+  ASSERT_EQ(calls, 10);
+
+  // Copies of the graph share the cache
+  std::ostringstream twice;
+  twice << graph.transpose();
+  ASSERT_EQ(calls, 10);
+  ASSERT_EQ(once.str(), twice.str());
+  ASSERT_NE(once.str().find("n3 --->  { n0 } "), std::string::npos);
+}
@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include "gtest/gtest.h"
+#include "graph.cc"
+#include "dominator_utility.cc"
+#include "cfg_generators.h"
+
+/// Node that counts the comparisons made on it. The analyses do their work
+/// through maps, sets and sorted edge lists of nodes, so comparisons count
+/// their operations, the same in every run, unlike wall-clock time
+/// (see bench/analysis_scaling_bench.cc for that).
+struct CountedNode {
+  int value;
+
+  bool operator<(const CountedNode & other) const {
+    comparisons()++;
+    return value < other.value;
+  }
+  bool operator==(const CountedNode & other) const {
+    comparisons()++;
+    return value == other.value;
+  }
+  bool operator!=(const CountedNode & other) const { return not (*this == other); }
+
+  static uint64_t & comparisons() {
+    static uint64_t count = 0;
+    return count;
+  }
+};
+
+std::ostream & operator<<(std::ostream & out, const CountedNode & node) { return out << node.value; }
+
+/// A SyntheticCfg on CountedNodes
+struct CountedCfg {
+  Graph<CountedNode> graph;
+  CountedNode entry;
+  CountedNode exit;
+};
+
+static CountedCfg counted(const SyntheticCfg & cfg) {
+  CountedCfg ret = {Graph<CountedNode>(), {cfg.entry}, {cfg.exit}};
+  for (const auto & node : cfg.graph.node_set()) ret.graph.add_node({node});
+  for (const auto & node : cfg.graph.succ_map()) {
+    for (const auto & succ : node.second) ret.graph.add_edge({node.first}, {succ});
+  }
+  return ret;
+}
+
+/// Comparisons analysis makes on cfg
+static uint64_t count_analysis(const SyntheticCfg & cfg, const std::function<size_t(const CountedCfg &)> & analysis) {
+  const auto counted_cfg = counted(cfg);
+  CountedNode::comparisons() = 0;
+  EXPECT_GT(analysis(counted_cfg), 0);
+  return CountedNode::comparisons();
+}
+
+/// Analysis work must grow sub-quadratically: on an input 8 times larger it may make
+/// at most half of the 64 times more comparisons a quadratic analysis would.
+static void expect_subquadratic(const std::function<SyntheticCfg(int)> & generator,
+                                const std::function<size_t(const CountedCfg &)> & analysis,
+                                const int small_size) {
+  const auto small = count_analysis(generator(small_size), analysis);
+  const auto large = count_analysis(generator(8 * small_size), analysis);
+  EXPECT_LT(large, 32 * small) << "size " << small_size << ": " << small << " comparisons, size "
+                               << 8 * small_size << ": " << large << " comparisons";
+}
+
+/// Dominator tree and dominance frontiers
+static size_t dominators(const CountedCfg & cfg) {
+  const DominatorUtility<CountedNode> dominator_utility(cfg.graph, cfg.entry);
+  return dominator_utility.dominance_frontier().size() + dominator_utility.dominator_tree().node_set().size();
+}
+
+/// Control dependence graph, as in InstrProgDeps: post-dominance frontiers
+/// of a CFG with an entry node branching to the entry and the exit
+static size_t control_dependences(const CountedCfg & cfg) {
+  auto augmented = cfg.graph;
+  const CountedNode entry = {static_cast<int>(augmented.node_set().size())};
+  augmented.add_node(entry);
+  augmented.add_edge(entry, cfg.entry);
+  augmented.add_edge(entry, cfg.exit);
+  Graph<CountedNode> cdg = augmented.copy_and_clear();
+  for (const auto & y : DominatorUtility<CountedNode>(augmented.transpose(), cfg.exit).dominance_frontier()) {
+    for (const auto & x : y.second) cdg.add_edge(x, y.first);
+  }
+  return cdg.node_set().size();
+}
+
+/// Strongly connected components, as for the PDG
+static size_t components(const CountedCfg & cfg) { return cfg.graph.strongly_connected_components().size(); }
+
+static const std::vector<std::pair<std::string, std::function<SyntheticCfg(int)>>> & shapes() {
+  static const std::vector<std::pair<std::string, std::function<SyntheticCfg(int)>>> ret = {
+    {"if_else_ladder", if_else_ladder},
+    {"diamond_chain", diamond_chain},
+    {"switch_fanout", switch_fanout},
+    {"irreducible_regions", irreducible_regions},
+    {"loop_nest", loop_nest},
+    {"random_reducible_cfg", [] (const int size) { return random_reducible_cfg(size, 1); }}};
+  return ret;
+}
+
+TEST(JayhawkTests, AnalysisScalingDominators) {
+  for (const auto & shape : shapes()) {
+    SCOPED_TRACE(shape.first);
+    expect_subquadratic(shape.second, dominators, 1000);
+  }
+}
+
+TEST(JayhawkTests, AnalysisScalingControlDependences) {
+  for (const auto & shape : shapes()) {
+    SCOPED_TRACE(shape.first);
+    expect_subquadratic(shape.second, control_dependences, 1000);
+  }
+}
+
+TEST(JayhawkTests, AnalysisScalingStronglyConnectedComponents) {
+  for (const auto & shape : shapes()) {
+    SCOPED_TRACE(shape.first);
+    expect_subquadratic(shape.second, components, 1000);
+  }
+}
+
+TEST(JayhawkTests, AnalysisScalingLargeInputs) {
+  // Deep graphs mustn't overflow the stack
+  ASSERT_GT(dominators(counted(diamond_chain(50000))), 0);
+  ASSERT_GT(control_dependences(counted(loop_nest(50000))), 0);
+  ASSERT_GT(dominators(counted(random_reducible_cfg(50000, 2))), 0);
+}
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "arena.h"
+#include "boolean_algebra.h"
+
+/// Heap allocations through scalar new while counting; the arena's blocks
+/// come from new[], which isn't counted
+static bool counting = false;
+static size_t heap_allocations = 0;
+
+void * operator new(const size_t size) {
+  if (counting) heap_allocations++;
+  void * ret = std::malloc(size == 0 ? 1 : size);
+  if (ret == nullptr) throw std::bad_alloc();
+  return ret;
+}
+
+void * operator new[](const size_t size) {
+  void * ret = std::malloc(size == 0 ? 1 : size);
+  if (ret == nullptr) throw std::bad_alloc();
+  return ret;
+}
+
+void operator delete(void * pointer) noexcept { std::free(pointer); }
+void operator delete(void * pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void * pointer) noexcept { std::free(pointer); }
+void operator delete[](void * pointer, size_t) noexcept { std::free(pointer); }
+
+TEST(JayhawkTests, Arena) {
+  Arena arena;
+  std::string outside_arena;
+  {
+    ArenaScope arena_scope(arena);
+    Dnf guard = Dnf() + Conjunction(Atom("a", true));
+    for (int i = 0; i < 1000; i++) {
+      guard += Conjunction(Atom("b" + std::to_string(i), true)) * Conjunction(Atom("c", false));
+    }
+    guard *= Conjunction(Atom("d", true));
+    ASSERT_EQ(guard.clauses().size(), 1001);
+    ASSERT_GT(arena.bytes_allocated(), 1001 * sizeof(Conjunction));
+
+    // A copy made outside the scope lives on the heap
+    Arena * previous = Arena::current();
+    Arena::current() = nullptr;
+    Dnf copy(guard);
+    Arena::current() = previous;
+    std::stringstream ss;
+    ss << copy;
+    outside_arena = ss.str();
+
+    // Releasing in bulk requires that nothing from the arena is alive
+    guard = Dnf();
+  }
+  arena.release();
+  ASSERT_EQ(arena.bytes_allocated(), 0);
+  ASSERT_EQ(outside_arena.find(" (a and d) "), 2);
+  ASSERT_EQ(Arena::current(), nullptr);
+}
+
+TEST(JayhawkTests, ArenaHoldsAllClauseStorage) {
+  Arena arena;
+  ArenaScope arena_scope(arena);
+  Dnf guard;
+  for (int i = 0; i < 100; i++) {
+    guard += Conjunction(Atom("a_long_variable_name_" + std::to_string(i), true)) * Conjunction(Atom("c", false));
+  }
+
+  // Variable names are interned, so copying and combining 400 atoms allocates
+  // nothing on the heap per atom: only the arena's list of blocks may grow
+  counting = true;
+  Dnf copy(guard);
+  copy *= Conjunction(Atom::make_literal(true));
+  copy += guard;
+  counting = false;
+  ASSERT_LT(heap_allocations, 4u);
+  ASSERT_EQ(200u, copy.clauses().size());
+  ASSERT_EQ(guard.clauses().front().atoms().front().var_name(), copy.clauses().front().atoms().front().var_name());
+}
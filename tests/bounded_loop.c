@@ -0,0 +1,12 @@
+int func(int a) {
+  int i = 0;
+  int k = 0;
+  for (i = 0; i < 4; i++) {
+    if (a > i) {
+      k = k + a;
+    } else {
+      k = k - 1;
+    }
+  }
+  return k;
+}
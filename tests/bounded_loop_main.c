@@ -0,0 +1,6 @@
+int func(int a);
+
+// func(3) is 3 + 3 + 3 - 1 = 8
+int main(void) {
+  return func(3);
+}
@@ -0,0 +1,102 @@
+#include <map>
+#include <set>
+#include <vector>
+#include "gtest/gtest.h"
+#include "graph.cc"
+#include "dominator_utility.cc"
+#include "cfg_generators.h"
+
+/// Nodes reachable from node along graph's edges
+static std::set<int> reachable(const Graph<int> & graph, const int node) {
+  std::set<int> ret = {node};
+  std::vector<int> stack = {node};
+  while (not stack.empty()) {
+    const auto next = stack.back();
+    stack.pop_back();
+    for (const auto & succ : graph.succ_map().at(next)) if (ret.insert(succ).second) stack.emplace_back(succ);
+  }
+  return ret;
+}
+
+/// Whether every node is reachable from entry and reaches exit, which has no successors
+static bool well_formed(const SyntheticCfg & cfg) {
+  return cfg.graph.succ_map().at(cfg.exit).empty() and cfg.graph.pred_map().at(cfg.entry).empty() and
+         reachable(cfg.graph, cfg.entry) == cfg.graph.node_set() and
+         reachable(cfg.graph.transpose(), cfg.exit) == cfg.graph.node_set();
+}
+
+/// Whether the graph is acyclic once back edges, edges to a node dominating
+/// their source, are removed, i.e., every cycle is a natural loop
+static bool reducible(const SyntheticCfg & cfg) {
+  const DominatorUtility<int> dominators(cfg.graph, cfg.entry);
+  const auto dominates = [&dominators, &cfg] (const int a, int b) {
+    while (b != a and b != cfg.entry) b = dominators.immediate_dominator(b);
+    return b == a;
+  };
+
+  // Topological sort of the forward edges
+  std::map<int, size_t> in_degree;
+  for (const auto & node : cfg.graph.succ_map()) {
+    in_degree[node.first];
+    for (const auto & succ : node.second) if (not dominates(succ, node.first)) in_degree[succ]++;
+  }
+  std::vector<int> ready = {cfg.entry};
+  size_t sorted = 0;
+  while (not ready.empty()) {
+    const auto node = ready.back();
+    ready.pop_back();
+    sorted++;
+    for (const auto & succ : cfg.graph.succ_map().at(node)) {
+      if (not dominates(succ, node) and --in_degree.at(succ) == 0) ready.emplace_back(succ);
+    }
+  }
+  return sorted == cfg.graph.node_set().size();
+}
+
+/// Braces balance and func is defined
+static bool plausible_program(const std::string & program) {
+  int depth = 0;
+  for (const auto c : program) {
+    depth += (c == '{') - (c == '}');
+    if (depth < 0) return false;
+  }
+  return depth == 0 and program.find("void func(Packet p)") != std::string::npos;
+}
+
+TEST(JayhawkTests, CfgGeneratorsShapes) {
+  for (const int size : {1, 2, 5, 50}) {
+    ASSERT_TRUE(well_formed(if_else_ladder(size)));
+    ASSERT_TRUE(well_formed(diamond_chain(size)));
+    ASSERT_TRUE(well_formed(switch_fanout(size)));
+    ASSERT_TRUE(well_formed(irreducible_regions(size)));
+    ASSERT_TRUE(well_formed(loop_nest(size)));
+    ASSERT_TRUE(reducible(if_else_ladder(size)));
+    ASSERT_TRUE(reducible(loop_nest(size)));
+    ASSERT_FALSE(reducible(irreducible_regions(size)));
+  }
+  ASSERT_EQ(switch_fanout(10).graph.succ_map().at(0).size(), 11);
+  ASSERT_EQ(if_else_ladder(10).graph.pred_map().at(if_else_ladder(10).exit).size(), 11);
+  ASSERT_THROW(diamond_chain(0), std::invalid_argument);
+}
+
+TEST(JayhawkTests, CfgGeneratorsRandomReducible) {
+  for (unsigned seed = 0; seed < 20; seed++) {
+    const auto cfg = random_reducible_cfg(200, seed);
+    ASSERT_GE(cfg.graph.node_set().size(), 200);
+    ASSERT_TRUE(well_formed(cfg));
+    ASSERT_TRUE(reducible(cfg));
+  }
+  ASSERT_EQ(random_reducible_cfg(300, 7).graph, random_reducible_cfg(300, 7).graph);
+}
+
+TEST(JayhawkTests, CfgGeneratorsPrograms) {
+  for (const int size : {1, 10}) {
+    ASSERT_TRUE(plausible_program(if_else_ladder_program(size)));
+    ASSERT_TRUE(plausible_program(diamond_chain_program(size)));
+    ASSERT_TRUE(plausible_program(switch_fanout_program(size)));
+    ASSERT_TRUE(plausible_program(irreducible_regions_program(size)));
+    ASSERT_TRUE(plausible_program(loop_nest_program(size)));
+    ASSERT_TRUE(plausible_program(random_program(size * 20, 3)));
+  }
+  ASSERT_EQ(random_program(100, 5), random_program(100, 5));
+}
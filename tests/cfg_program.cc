@@ -0,0 +1,27 @@
+#include <iostream>
+#include <string>
+#include "graph.cc"
+#include "cfg_generators.h"
+
+/// Print a synthetic packet program of cfg_generators.h, for pass_tests.sh to stress-test the passes on.
+/// Usage: cfg_program SHAPE SIZE, where SHAPE is one of if_else_ladder, diamond_chain, switch_fanout,
+/// irreducible_regions, loop_nest and random_program
+int main(int argc, const char ** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " SHAPE SIZE\n";
+    return 1;
+  }
+  const std::string shape = argv[1];
+  const int size = std::stoi(argv[2]);
+  if (shape == "if_else_ladder") std::cout << if_else_ladder_program(size);
+  else if (shape == "diamond_chain") std::cout << diamond_chain_program(size);
+  else if (shape == "switch_fanout") std::cout << switch_fanout_program(size);
+  else if (shape == "irreducible_regions") std::cout << irreducible_regions_program(size);
+  else if (shape == "loop_nest") std::cout << loop_nest_program(size);
+  else if (shape == "random_program") std::cout << random_program(size, 1);
+  else {
+    std::cerr << "Unknown shape " << shape << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "compile_protocol.h"
+
+TEST(JayhawkTests, CompileProtocolRoundTrip) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  // Fields can contain newlines, digits and embedded NULs
+  CompileRequest request;
+  request.file_name = "packet.c";
+  request.analyze = true;
+  request.args = {"-I", "include dir", "", "-DX=1\n2"};
+  request.source = std::string("int x = 12;\n\0int y;\n", 21);
+  write_request(fds[0], request);
+  close(fds[0]);
+
+  const auto received = read_request(fds[1]);
+  ASSERT_EQ(received.file_name, request.file_name);
+  ASSERT_EQ(received.analyze, request.analyze);
+  ASSERT_EQ(received.args, request.args);
+  ASSERT_EQ(received.source, request.source);
+  close(fds[1]);
+}
+
+TEST(JayhawkTests, CompileProtocolTruncatedRequest) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  const std::string truncated = "8\npacket.c" "1\n1" "1\n1" "2\n-O" "100\nint x";
+  ASSERT_EQ(write(fds[0], truncated.data(), truncated.size()), static_cast<ssize_t>(truncated.size()));
+  close(fds[0]);
+  ASSERT_THROW(read_request(fds[1]), std::runtime_error);
+  close(fds[1]);
+}
+
+TEST(JayhawkTests, CompileProtocolStatusTrailer) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  const std::string output = "int main() { return 0; }";
+  ASSERT_EQ(write(fds[0], output.data(), output.size()), static_cast<ssize_t>(output.size()));
+  write_status(fds[0], 3);
+  close(fds[0]);
+
+  auto response = read_all(fds[1]);
+  int status = 0;
+  ASSERT_TRUE(split_response(response, status));
+  ASSERT_EQ(status, 3);
+  ASSERT_EQ(response, output);
+  close(fds[1]);
+
+  // A server that crashed before writing the trailer
+  std::string crashed = "partial output\n";
+  ASSERT_FALSE(split_response(crashed, status));
+  ASSERT_EQ(crashed, "partial output\n");
+}
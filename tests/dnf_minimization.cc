@@ -0,0 +1,139 @@
+#include <sstream>
+#include <random>
+#include "gtest/gtest.h"
+#include "boolean_algebra.h"
+
+static std::string to_string(const Dnf & dnf) {
+  std::stringstream ss;
+  ss << dnf;
+  return ss.str();
+}
+
+static Dnf make_dnf(const std::vector<std::vector<std::pair<std::string, bool>>> & clauses) {
+  Dnf ret;
+  for (const auto & clause : clauses) {
+    std::vector<Atom> atoms;
+    for (const auto & atom : clause) atoms.emplace_back(atom.first, atom.second);
+    ret = ret + Conjunction(atoms);
+  }
+  return ret;
+}
+
+TEST(JayhawkTests, DnfMinimization) {
+  // Duplicates are removed
+  auto duplicates = make_dnf({{{"a", true}, {"b", true}}, {{"a", true}, {"b", true}}});
+  duplicates.minimize();
+  ASSERT_EQ(to_string(duplicates), to_string(make_dnf({{{"a", true}, {"b", true}}})));
+
+  // Complementary clauses are merged: (a and b) or (a and ~b) is a
+  auto complement = make_dnf({{{"a", true}, {"b", true}}, {{"a", true}, {"b", false}}});
+  complement.minimize();
+  ASSERT_EQ(to_string(complement), to_string(make_dnf({{{"a", true}}})));
+
+  // Subsumed clauses are dropped: a or (a and b) is a
+  auto subsumed = make_dnf({{{"a", true}, {"b", true}}, {{"a", true}}});
+  subsumed.minimize();
+  ASSERT_EQ(to_string(subsumed), to_string(make_dnf({{{"a", true}}})));
+
+  // Contradictions fold to false, complements to true
+  auto contradiction = make_dnf({{{"a", true}, {"a", false}}});
+  contradiction.minimize();
+  ASSERT_EQ(to_string(contradiction), to_string(Dnf() + Conjunction(Atom::make_literal(false))));
+  auto tautology = make_dnf({{{"a", true}}, {{"a", false}}});
+  tautology.minimize();
+  ASSERT_EQ(to_string(tautology), to_string(Dnf() + Conjunction(Atom::make_literal(true))));
+
+  // Consensus: (a and b) or (~a and c) or (b and c) is (a and b) or (~a and c)
+  auto consensus = make_dnf({{{"a", true}, {"b", true}}, {{"a", false}, {"c", true}}, {{"b", true}, {"c", true}}});
+  consensus.minimize();
+  ASSERT_EQ(to_string(consensus), to_string(make_dnf({{{"a", false}, {"c", true}}, {{"a", true}, {"b", true}}})));
+}
+
+TEST(JayhawkTests, DnfMinimizationHeuristic) {
+  // Nested path conditions over more variables than the exact minimizer handles:
+  // (c0 and ... and c9 and d) or (c0 and ... and c9 and ~d) or (c0 and ... and c9 and e)
+  std::vector<std::pair<std::string, bool>> prefix;
+  for (int i = 0; i < 10; i++) prefix.emplace_back("c" + std::to_string(i), true);
+  auto with = [&prefix] (const std::string & var, const bool value) {
+    auto ret = prefix;
+    ret.emplace_back(var, value);
+    return ret;
+  };
+  auto nested = make_dnf({with("d", true), with("d", false), with("e", true)});
+  nested.minimize();
+  ASSERT_EQ(to_string(nested), to_string(make_dnf({prefix})));
+}
+
+/// Value of dnf over variables v0, v1, ... given by the bits of assignment
+static bool evaluate(const Dnf & dnf, const uint32_t assignment) {
+  for (const auto & clause : dnf.clauses()) {
+    bool value = true;
+    for (const auto & atom : clause.atoms()) {
+      if (atom.is_literal()) value = value and atom.is_literal(true);
+      else value = value and (((assignment >> std::stoi(atom.var_name().substr(1))) & 1u) == atom.pristine());
+    }
+    if (value) return true;
+  }
+  return false;
+}
+
+/// Fewest cubes covering exactly the on-set of num_vars variables, by brute force:
+/// the smallest set of prime implicants covering the on-set
+static size_t minimum_cover_size(const std::vector<bool> & on_set, const uint32_t num_vars) {
+  // A cube is a (value, mask) pair, set bits in mask are don't cares
+  const auto is_implicant = [&on_set] (const uint32_t value, const uint32_t mask) {
+    for (uint32_t m = 0; m < on_set.size(); m++) {
+      if ((m & ~mask) == value and not on_set.at(m)) return false;
+    }
+    return true;
+  };
+  std::vector<std::pair<uint32_t, uint32_t>> primes;
+  for (uint32_t mask = 0; mask < (1u << num_vars); mask++) {
+    for (uint32_t value = 0; value < (1u << num_vars); value++) {
+      if ((value & mask) != 0 or not is_implicant(value, mask)) continue;
+      bool prime = true;
+      for (uint32_t i = 0; i < num_vars; i++) {
+        const uint32_t bit = 1u << i;
+        if ((mask & bit) == 0 and is_implicant(value & ~bit, mask | bit)) prime = false;
+      }
+      if (prime) primes.emplace_back(value, mask);
+    }
+  }
+  size_t best = primes.size();
+  for (uint64_t subset = 0; subset < (uint64_t(1) << primes.size()); subset++) {
+    if (static_cast<size_t>(__builtin_popcountll(subset)) >= best) continue;
+    bool covered = true;
+    for (uint32_t m = 0; m < on_set.size() and covered; m++) {
+      if (not on_set.at(m)) continue;
+      covered = false;
+      for (size_t i = 0; i < primes.size(); i++) {
+        if (((subset >> i) & 1u) and (m & ~primes.at(i).second) == primes.at(i).first) covered = true;
+      }
+    }
+    if (covered) best = static_cast<size_t>(__builtin_popcountll(subset));
+  }
+  return best;
+}
+
+TEST(JayhawkTests, DnfMinimizationIsExact) {
+  // Random functions of 4 variables, given as their minterms,
+  // minimize to the fewest clauses any equivalent Dnf has
+  const uint32_t num_vars = 4;
+  std::mt19937 generator(26);
+  for (int trial = 0; trial < 200; trial++) {
+    std::vector<bool> on_set(1u << num_vars);
+    Dnf dnf;
+    for (uint32_t m = 0; m < on_set.size(); m++) {
+      on_set.at(m) = generator() % 2 == 0;
+      if (not on_set.at(m)) continue;
+      std::vector<Atom> atoms;
+      for (uint32_t i = 0; i < num_vars; i++) atoms.emplace_back("v" + std::to_string(i), ((m >> i) & 1u) != 0);
+      dnf += Conjunction(atoms);
+    }
+    if (dnf.clauses().empty() or std::all_of(on_set.begin(), on_set.end(), [] (const bool b) { return b; })) continue;
+
+    dnf.minimize();
+    for (uint32_t m = 0; m < on_set.size(); m++) ASSERT_EQ(on_set.at(m), evaluate(dnf, m));
+    ASSERT_EQ(minimum_cover_size(on_set, num_vars), dnf.clauses().size()) << "trial " << trial << ": " << dnf;
+  }
+}
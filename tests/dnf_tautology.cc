@@ -0,0 +1,31 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "boolean_algebra.h"
+
+TEST(JayhawkTests, DnfTautology) {
+  const Atom a("a", true), not_a("a", false), b("b", true), not_b("b", false);
+
+  // a or ~a is a tautology
+  const auto excluded_middle = Dnf() + Conjunction(a) + Conjunction(not_a);
+  ASSERT_EQ(excluded_middle.is_tautology(), true);
+  ASSERT_EQ(excluded_middle.is_satisfiable(), true);
+
+  // (a and b) or (a and ~b) or ~a is a tautology,
+  // but needs a split on both atoms to see it
+  const auto split = Dnf() + Conjunction({a, b}) + Conjunction({a, not_b}) + Conjunction(not_a);
+  ASSERT_EQ(split.is_tautology(), true);
+
+  // (a and ~a) or (b and ~b) is unsatisfiable
+  const auto contradiction = Dnf() + Conjunction({a, not_a}) + Conjunction({b, not_b});
+  ASSERT_EQ(contradiction.is_satisfiable(), false);
+  ASSERT_EQ(contradiction.is_tautology(), false);
+
+  // (a and b) or ~a is neither
+  const auto contingent = Dnf() + Conjunction({a, b}) + Conjunction(not_a);
+  ASSERT_EQ(contingent.is_satisfiable(), true);
+  ASSERT_EQ(contingent.is_tautology(), false);
+
+  // Literals
+  ASSERT_EQ((Dnf() + Conjunction(Atom::make_literal(true))).is_tautology(), true);
+  ASSERT_EQ((Dnf() + Conjunction(Atom::make_literal(false))).is_satisfiable(), false);
+}
@@ -35,3 +35,35 @@ TEST(JayhawkTests, DominatorTree) {
   std::cout << "Dominator Tree \n" << DominatorUtility<int>(cfg, 1).dominator_tree() << "\n";
   ASSERT_EQ(DominatorUtility<int>(cfg, 1).dominator_tree() == dominator_tree, true);
 }
+
+TEST(JayhawkTests, DominatorTreeUnreachableNodes) {
+  // 1 -> 2 -> 3, and 4 -> 5 -> 3, 5 -> 4 unreachable from 1
+  Graph<int> cfg;
+  for (int i = 1; i <= 5; i++) {
+    cfg.add_node(i);
+  }
+  cfg.add_edge(1, 2);
+  cfg.add_edge(2, 3);
+  cfg.add_edge(4, 5);
+  cfg.add_edge(5, 3);
+  cfg.add_edge(5, 4);
+
+  Graph<int> dominator_tree;
+  for (int i = 1; i <= 3; i++) {
+    dominator_tree.add_node(i);
+  }
+  dominator_tree.add_edge(1, 2);
+  dominator_tree.add_edge(2, 3);
+
+  // Unreachable nodes have no idoms, aren't in the dominator tree,
+  // and neither they nor their edges into reachable nodes make dominance frontiers
+  const DominatorUtility<int> dominator_utility(cfg, 1);
+  ASSERT_EQ(dominator_utility.dominator_tree() == dominator_tree, true);
+  ASSERT_EQ(dominator_utility.immediate_dominators().size(), 3u);
+  ASSERT_EQ(dominator_utility.immediate_dominators().count(4), 0u);
+  ASSERT_EQ(dominator_utility.immediate_dominators().count(5), 0u);
+  ASSERT_EQ(dominator_utility.immediate_dominator(3), 2);
+  for (const auto & frontier : dominator_utility.dominance_frontier()) {
+    ASSERT_EQ(frontier.second.empty(), true) << frontier.first;
+  }
+}
@@ -0,0 +1,141 @@
+#!/bin/sh
+# Run transform_driver end to end on small packet programs
+# and check what it prints and writes.
+
+srcdir=${srcdir:-.}
+TRANSFORM_DRIVER=../transform_driver
+. "$srcdir/test_helpers.sh"
+out=$(mktemp)
+dir=$(mktemp -d)
+trap 'rm -rf "$out" "$dir"' EXIT
+
+# -analyze compiles programs as written, so the packet-processing loop
+# the transforms add doesn't reach the passes, and a bounded loop is unrolled
+"$TRANSFORM_DRIVER" -analyze "$srcdir/bounded_loop.c" "$srcdir/packet.c" -- > "$out" 2>&1
+check_status "-analyze succeeds" 0 $?
+check "-analyze builds the PDG" "InstrProgDeps: func: " "$out"
+check "-analyze unrolls the loop" "fully unrolling loop at .* with trip count 4" "$out"
+check "-analyze if-converts" "IfConversion: func: " "$out"
+check_not "-analyze sees no packet-processing loop" "has a loop" "$out"
+
+# Workers parse in parallel on a cold AST cache, and write what a serial run writes
+programs="$srcdir/packet.c $srcdir/bounded_loop.c $srcdir/field_liveness.c $srcdir/harness_program.c $srcdir/sharded_program.c"
+"$TRANSFORM_DRIVER" -output_dir "$dir/serial" $programs -- > "$out" 2>&1
+check_status "serial transform succeeds" 0 $?
+"$TRANSFORM_DRIVER" -j 4 -ast_cache_dir "$dir/ast_cache" -output_dir "$dir/parallel" $programs -- > "$out" 2>&1
+check_status "-j 4 on a cold AST cache succeeds" 0 $?
+check "-j 4 parses every file" "^AST cache: 0 hits, 5 misses$" "$out"
+diff -r "$dir/serial" "$dir/parallel" > "$out" 2>&1
+check_status "-j 4 writes what a serial run writes" 0 $?
+"$TRANSFORM_DRIVER" -j 4 -ast_cache_dir "$dir/ast_cache" -output_dir "$dir/cached" $programs -- > "$out" 2>&1
+check "-j 4 reuses the cached ASTs" "^AST cache: 5 hits, 0 misses$" "$out"
+diff -r "$dir/serial" "$dir/cached" > "$out" 2>&1
+check_status "-j 4 from cached ASTs writes what a serial run writes" 0 $?
+
+# Both files define func, each gets its own graph files
+mkdir "$dir/graphs"
+"$TRANSFORM_DRIVER" -analyze -verbosity 0 -graph_dir "$dir/graphs" "$srcdir/bounded_loop.c" "$srcdir/packet.c" -- > "$out" 2>&1
+check_status "-analyze -graph_dir succeeds" 0 $?
+ls "$dir/graphs" > "$out"
+check "-graph_dir saves the PDG of bounded_loop.c" "^bounded_loop\.func\.pdg\.dot$" "$out"
+check "-graph_dir saves the PDG of packet.c" "^packet\.func\.pdg\.jhg$" "$out"
+"$TRANSFORM_DRIVER" -analyze -verbosity 0 -graph_dir "$dir/no_such_dir" "$srcdir/packet.c" -- > "$out" 2>&1
+check_status "-graph_dir into a missing directory fails" 1 $?
+
+# The pipeline simulation replays a trace at its timestamps, here 0, 0 and 1 s on a 1 kHz clock,
+# with the latency model given
+{
+  printf '\324\303\262\241\002\000\004\000\000\000\000\000\000\000\000\000\377\377\000\000\001\000\000\000'
+  for second in '\000' '\000' '\001'; do
+    printf "$second"
+    printf '\000\000\000\000\000\000\000\010\000\000\000\010\000\000\000\000\000\000\000\000\000\000\000'
+  done
+} > "$dir/simulation.pcap"
+"$TRANSFORM_DRIVER" -analyze -simulation_trace "$dir/simulation.pcap" -clock_hz 1000 -latency_model match=100 \
+  "$srcdir/packet.c" -- > "$out" 2>&1
+check_status "-analyze with a trace succeeds" 0 $?
+check "the simulation replays the trace" "^3 packets in [0-9]* cycles" "$out"
+check "the simulation uses the latency model" "^latency min [1-9][0-9][0-9][0-9]* " "$out"
+"$TRANSFORM_DRIVER" -analyze -latency_model fma=3 "$srcdir/packet.c" -- > "$out" 2>&1
+check_status "an unknown operation in -latency_model fails" 1 $?
+check "an unknown operation in -latency_model is reported" "unknown operation fma" "$out"
+
+# Fields overwritten before any read aren't parsed, unaccessed fields are in neither list,
+# and a field written on only some paths is parsed so that egress writes back the incoming value otherwise
+"$TRANSFORM_DRIVER" -manifest_dir "$dir" "$srcdir/field_liveness.c" -- > /dev/null 2> "$out"
+check_status "-manifest_dir succeeds" 0 $?
+manifest=$(find "$dir" -name field_liveness.c.manifest)
+if diff -u "$srcdir/field_liveness.expected_manifest" "$manifest" > "$out"; then
+  echo "PASS manifest of field_liveness.c"
+else
+  echo "FAIL manifest of field_liveness.c:"
+  cat "$out"
+  failures=$((failures + 1))
+fi
+
+# A harness program reads and writes its packets in wire format, 7 bytes here, unpadded and big-endian,
+# even where a record starts at an odd offset of the trace, and passes shorter packets through untouched
+"$TRANSFORM_DRIVER" -harness func "$srcdir/harness_program.c" -- > "$dir/harness_program.c" 2> "$out"
+check_status "-harness succeeds" 0 $?
+$CC -I"$srcdir/.." -c "$dir/harness_program.c" -o "$dir/harness_program.o" &&
+  $CXX "$dir/harness_program.o" ../libjayhawk_harness.a -pthread -o "$dir/harness_program"
+check_status "harness program builds" 0 $?
+{
+  printf '\324\303\262\241\002\000\004\000\000\000\000\000\000\000\000\000\377\377\000\000\001\000\000\000'
+  printf '\000\000\000\000\000\000\000\000\007\000\000\000\007\000\000\000\001\002\003\000\000\000\000'
+  printf '\000\000\000\000\000\000\000\000\007\000\000\000\007\000\000\000\020\000\377\252\252\252\252'
+  printf '\000\000\000\000\000\000\000\000\003\000\000\000\003\000\000\000\005\006\007'
+} > "$dir/input.pcap"
+"$dir/harness_program" "$dir/input.pcap" "$dir/output.pcap" 2> "$out"
+check_status "harness program runs" 0 $?
+check "harness program processes the long packets" "^2 packets in" "$out"
+od -An -tx1 -v "$dir/output.pcap" | tr -d '\n' > "$out"
+check "harness program writes c = a + b" "01 02 03 00 00 01 05 .* 10 00 ff 00 00 10 ff .* 05 06 07$" "$out"
+
+# Only state indexed by flow key fields of the harness function's packet is per flow,
+# packets are steered by a hash of that index, and each flow's count lives on one shard
+"$TRANSFORM_DRIVER" -harness func -shards 2 -flow_key=src,dst "$srcdir/sharded_program.c" -- > "$dir/sharded_program.c" 2> "$out"
+check_status "-shards succeeds" 0 $?
+check "a global counter is shared" "state variable total is shared" "$out"
+check "state indexed by another function's struct is shared" "state variable by_other is shared" "$out"
+check_not "state indexed by the flow is per flow" "state variable flows is shared" "$out"
+check "flows gets a copy per shard" "flows\[2\]\[1024\]" "$dir/sharded_program.c"
+check "packets are steered by the index of flows" "jayhawk_hash(hash, (unsigned long long) (.*p\.src \* 31 + p\.dst.*));" "$dir/sharded_program.c"
+check "the flow hash parses the packet" "p\.src = .*jayhawk_load_field((const unsigned char \*) packet, 0, 32);" "$dir/sharded_program.c"
+$CC -I"$srcdir/.." -c "$dir/sharded_program.c" -o "$dir/sharded_program.o" &&
+  $CXX "$dir/sharded_program.o" ../libjayhawk_harness.a -pthread -o "$dir/sharded_program"
+check_status "sharded program builds" 0 $?
+{
+  printf '\324\303\262\241\002\000\004\000\000\000\000\000\000\000\000\000\377\377\000\000\001\000\000\000'
+  for flow in '\001\000\000\000\002' '\001\000\000\000\002' '\003\000\000\000\004' '\001\000\000\000\002'; do
+    printf '\000\000\000\000\000\000\000\000\014\000\000\000\014\000\000\000\000\000\000'
+    printf "$flow"
+    printf '\000\000\000\000'
+  done
+} > "$dir/input.pcap"
+"$dir/sharded_program" "$dir/input.pcap" "$dir/output.pcap" 2> "$out"
+check_status "sharded program runs" 0 $?
+od -An -tx1 -v "$dir/output.pcap" | tr -d '\n' > "$out"
+check "sharded program counts packets per flow" \
+  "00 00 00 01 00 00 00 02 00 00 00 01 .* 00 00 00 01 00 00 00 02 00 00 00 02 .* 00 00 00 03 00 00 00 04 00 00 00 01 .* 00 00 00 01 00 00 00 02 00 00 00 03$" "$out"
+
+# -lower_state_dir compiles the sharded program with the global counter in per-shard replicas,
+# merged after the run, so the lock around bursts goes; other() never returns and is left alone
+"$TRANSFORM_DRIVER" -harness func -shards 2 -flow_key=src,dst -lower_state_dir "$dir/lowered" -output_dir "$dir/lowered" \
+  "$srcdir/sharded_program.c" -- -I"$srcdir/.." > "$out" 2>&1
+check_status "-lower_state_dir succeeds" 0 $?
+check "the counter is replicated" "AtomicStateLowering: total replicated across 2 shards" "$out"
+check "the harness function drops its lock" "AtomicStateLowering: func no longer needs its lock" "$out"
+check "functions that never return are left alone" "AtomicStateLowering: other never returns" "$out"
+lowered=$(find "$dir/lowered" -name sharded_program.c.ll)
+check "the lowered program merges the replicas" "define void @jayhawk_merge_state()" "$lowered"
+check_not "the lowered program takes no lock" "call void @jayhawk_lock" "$lowered"
+$CLANG -c "$lowered" -o "$dir/lowered.o" && $CXX "$dir/lowered.o" ../libjayhawk_harness.a -pthread -o "$dir/lowered_program"
+check_status "lowered program builds" 0 $?
+"$dir/lowered_program" "$dir/input.pcap" "$dir/output.pcap" 2> "$out"
+check_status "lowered program runs" 0 $?
+od -An -tx1 -v "$dir/output.pcap" | tr -d '\n' > "$out"
+check "lowered program counts packets per flow" \
+  "00 00 00 01 00 00 00 02 00 00 00 01 .* 00 00 00 01 00 00 00 02 00 00 00 02 .* 00 00 00 03 00 00 00 04 00 00 00 01 .* 00 00 00 01 00 00 00 02 00 00 00 03$" "$out"
+
+exit $failures
@@ -0,0 +1,20 @@
+typedef struct Packet {
+  int x;
+  int y;
+  int z;
+  int w;
+  int v;
+  int unused;
+} Packet;
+
+int counter = 0;
+
+void func(Packet p) {
+  p.x = 1;
+  p.y = p.y + p.x;
+  if (p.z > 0) {
+    p.w = counter;
+    p.v = 3;
+  }
+  counter = p.w;
+}
@@ -0,0 +1,70 @@
+#include <map>
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "field_packing.h"
+
+TEST(JayhawkTests, FieldPacking) {
+  // Five fields declared as 32-bit ints that actually need 1 to 12 bits,
+  // four of them co-accessed by f and one accessed only by g
+  const std::vector<PacketField> fields = {{"p.valid", 1, {"f"}},
+                                           {"p.ttl", 8, {"f"}},
+                                           {"p.port", 9, {"f"}},
+                                           {"p.id", 12, {"f"}},
+                                           {"p.flag", 3, {"g"}}};
+  const FieldLayout layout(fields);
+
+  // f's fields fit in one 32-bit container, g's in an 8-bit one,
+  // instead of five 32-bit containers
+  ASSERT_EQ(layout.container_sizes(), std::vector<unsigned>({32, 8}));
+  ASSERT_EQ(layout.total_bits(), 40);
+
+  // Every field gets exactly its width, and slots in a container don't overlap
+  std::map<size_t, unsigned> used;
+  for (const auto & slot : layout.slots()) {
+    ASSERT_LE(slot.offset + slot.width, layout.container_sizes().at(slot.container));
+    ASSERT_GE(slot.offset, used[slot.container]);
+    used[slot.container] = slot.offset + slot.width;
+  }
+  ASSERT_EQ(layout.slots().size(), fields.size());
+  for (const auto & slot : layout.slots()) {
+    if (slot.name == "p.flag") ASSERT_EQ(slot.container, 1);
+    else ASSERT_EQ(slot.container, 0);
+  }
+
+  const auto code = layout.emit_c("PacketLayout");
+  ASSERT_NE(code.find("uint32_t c0;"), std::string::npos);
+  ASSERT_NE(code.find("uint8_t c1;"), std::string::npos);
+  ASSERT_NE(code.find("get_p_ttl"), std::string::npos);
+  ASSERT_NE(code.find("set_p_flag"), std::string::npos);
+}
+
+TEST(JayhawkTests, FieldPackingWideFields) {
+  // A 48-bit address takes a whole 32-bit container and 16 bits of another,
+  // which it shares with a co-accessed 8-bit field
+  const FieldLayout layout({{"p.mac", 48, {"f"}}, {"p.type", 8, {"f"}}});
+  ASSERT_EQ(layout.container_sizes(), std::vector<unsigned>({32, 32}));
+  ASSERT_EQ(layout.slots().size(), 3);
+  const auto code = layout.emit_c("PacketLayout");
+  ASSERT_NE(code.find("get_p_mac_0"), std::string::npos);
+  ASSERT_NE(code.find("get_p_mac_1"), std::string::npos);
+
+  ASSERT_THROW(FieldLayout({{"p.x", 0, {"f"}}}), std::invalid_argument);
+}
+
+TEST(JayhawkTests, FieldPackingParseDeparse) {
+  // Wire: 48-bit mac at bit 0, a 16-bit type at bit 48, then a 3-bit flag
+  // after 5 bits of a field no function accesses
+  const FieldLayout layout({{"p.mac", 48, {"f"}, 0}, {"p.type", 16, {"f"}, 48}, {"p.flag", 3, {"g"}, 69}});
+  const auto code = layout.emit_c("PacketLayout");
+  ASSERT_NE(code.find("#include \"jayhawk_runtime.h\""), std::string::npos);
+
+  // Every slot moves at the field's full width, most significant slot first on the wire
+  ASSERT_NE(code.find("set_p_mac_0(h, (uint32_t) jayhawk_load_field(packet, 16, 32));"), std::string::npos);
+  ASSERT_NE(code.find("set_p_mac_1(h, (uint32_t) jayhawk_load_field(packet, 0, 16));"), std::string::npos);
+  ASSERT_NE(code.find("set_p_type(h, (uint32_t) jayhawk_load_field(packet, 48, 16));"), std::string::npos);
+  ASSERT_NE(code.find("set_p_flag(h, (uint32_t) jayhawk_load_field(packet, 69, 3));"), std::string::npos);
+  ASSERT_NE(code.find("jayhawk_store_field(packet, 16, 32, get_p_mac_0(h));"), std::string::npos);
+  ASSERT_NE(code.find("jayhawk_store_field(packet, 69, 3, get_p_flag(h));"), std::string::npos);
+  ASSERT_NE(code.find("static inline void deparse_PacketLayout(const struct PacketLayout * h, unsigned char * packet)"),
+            std::string::npos);
+}
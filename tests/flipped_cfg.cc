@@ -36,3 +36,20 @@ TEST(JayhawkTests, FlippedCfg) {
 
   ASSERT_EQ(cfg.transpose() == flipped_cfg, true);
 }
+
+TEST(JayhawkTests, GraphUnionWithSharedEdges) {
+  // An edge in both operands, e.g., a data and a memory dependence, is added once, silently
+  Graph<int> a;
+  for (int i = 1; i <= 3; i++) a.add_node(i);
+  auto b = a;
+  a.add_edge(1, 2);
+  a.add_edge(2, 3);
+  b.add_edge(2, 3);
+  b.add_edge(3, 1);
+  testing::internal::CaptureStdout();
+  const auto both = a + b;
+  b.add_edge(3, 1);
+  ASSERT_EQ(testing::internal::GetCapturedStdout(), "");
+  ASSERT_EQ(both.num_edges(), 3);
+  ASSERT_TRUE(both.exists_edge(2, 3));
+}
@@ -0,0 +1,131 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "graph.cc"
+#include "graph_serialization.h"
+
+/// Temporary file, removed when the test is done
+class TempFile {
+ public:
+  TempFile() : name_("/tmp/graph_serialization_XXXXXX") {
+    const int fd = mkstemp(&name_[0]);
+    if (fd >= 0) close(fd);
+  }
+  TempFile(const TempFile &) = delete;
+  TempFile & operator=(const TempFile &) = delete;
+  ~TempFile() { std::remove(name_.c_str()); }
+  const std::string & name() const { return name_; }
+
+ private:
+  std::string name_;
+};
+
+static Graph<int> random_graph(const int n, const unsigned seed) {
+  std::mt19937 generator(seed);
+  Graph<int> graph;
+  for (int i = 0; i < n; i++) graph.add_node(i * 1000);
+  for (int i = 0; i < 4 * n; i++) {
+    const int from = static_cast<int>(generator() % static_cast<unsigned>(n)) * 1000;
+    const int to = static_cast<int>(generator() % static_cast<unsigned>(n)) * 1000;
+    if (not graph.exists_edge(from, to)) graph.add_edge(from, to);
+  }
+  return graph;
+}
+
+static const std::function<int(const std::string &)> parse_int = [] (const std::string & label) { return std::stoi(label); };
+
+TEST(JayhawkTests, GraphSerializationRoundTrip) {
+  for (const int n : {1, 10, 1000}) {
+    const auto graph = random_graph(n, static_cast<unsigned>(n));
+    TempFile file;
+    save_binary(graph, file.name());
+
+    const GraphView view(file.name());
+    ASSERT_EQ(view.num_nodes(), graph.node_set().size());
+    ASSERT_EQ(view.num_edges(), graph.num_edges());
+    ASSERT_EQ(view.label(1 % view.num_nodes()), std::to_string((1 % n) * 1000));
+    ASSERT_EQ(view.to_graph(parse_int), graph);
+  }
+}
+
+TEST(JayhawkTests, GraphSerializationView) {
+  // Labels come from the node printer, successors are node numbers
+  Graph<int> graph([] (const int node) { return "node " + std::to_string(node); });
+  for (const int node : {5, 7, 300, 100000}) graph.add_node(node);
+  graph.add_edge(5, 7);
+  graph.add_edge(5, 100000);
+  graph.add_edge(100000, 5);
+  graph.add_edge(100000, 300);
+  TempFile file;
+  save_binary(graph, file.name());
+
+  const GraphView view(file.name());
+  ASSERT_EQ(view.label(3), "node 100000");
+  const std::vector<uint64_t> succs_of_5 = {1, 3};
+  const std::vector<uint64_t> succs_of_100000 = {0, 2};
+  ASSERT_EQ(view.successors(0), succs_of_5);
+  ASSERT_TRUE(view.successors(2).empty());
+  ASSERT_EQ(view.successors(3), succs_of_100000);
+  ASSERT_EQ(view.num_edges(), 4);
+}
+
+TEST(JayhawkTests, GraphSerializationEmpty) {
+  TempFile file;
+  save_binary(Graph<int>(), file.name());
+  const GraphView view(file.name());
+  ASSERT_EQ(view.num_nodes(), 0);
+  ASSERT_EQ(view.to_graph(parse_int), Graph<int>());
+}
+
+TEST(JayhawkTests, GraphSerializationCorrupt) {
+  TempFile file;
+  ASSERT_THROW(GraphView view(file.name()), std::runtime_error);
+  ASSERT_THROW(GraphView view("/nonexistent/file"), std::runtime_error);
+
+  std::ostringstream serialized;
+  write_binary(random_graph(20, 1), serialized);
+  const auto bytes = serialized.str();
+  const auto write = [&file] (const std::string & contents) {
+    std::ofstream out(file.name(), std::ios::binary);
+    out << contents;
+  };
+
+  write("not a graph file at all, but long enough");
+  ASSERT_THROW(GraphView view(file.name()), std::runtime_error);
+
+  // Truncated edge stream
+  write(bytes.substr(0, bytes.size() - 1));
+  ASSERT_THROW(GraphView view(file.name()), std::runtime_error);
+
+  // Absurd node count
+  auto huge = bytes;
+  huge.at(15) = '\x7f';
+  write(huge);
+  ASSERT_THROW(GraphView view(file.name()), std::runtime_error);
+
+  write(bytes);
+  ASSERT_NO_THROW(GraphView view(file.name()));
+}
+
+TEST(JayhawkTests, GraphSerializationDot) {
+  Graph<int> graph([] (const int node) { return node == 2 ? std::string("say \"hi\"\n") : std::to_string(node); });
+  for (const int node : {1, 2, 3}) graph.add_node(node);
+  graph.add_edge(1, 2);
+  graph.add_edge(1, 3);
+  graph.add_edge(3, 1);
+  std::ostringstream dot;
+  write_dot(graph, dot, "pdg");
+  ASSERT_EQ(dot.str(), "digraph \"pdg\" {\n"
+                       "  n0 [label=\"1\"];\n"
+                       "  n1 [label=\"say \\\"hi\\\"\\n\"];\n"
+                       "  n2 [label=\"3\"];\n"
+                       "  n0 -> n1;\n"
+                       "  n0 -> n2;\n"
+                       "  n2 -> n0;\n"
+                       "}\n");
+}
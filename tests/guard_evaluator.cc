@@ -0,0 +1,49 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "guard_evaluator.h"
+
+TEST(JayhawkTests, GuardEvaluator) {
+  const std::vector<std::string> conditions = {"%a", "%b", "%c", "%d"};
+  std::mt19937 generator(42);
+
+  // (a and ~b) or (c and d and ~a) or ~d
+  const auto guard = Dnf() + Conjunction({Atom("%a", true), Atom("%b", false)})
+                           + Conjunction({Atom("%c", true), Atom("%d", true), Atom("%a", false)})
+                           + Conjunction(Atom("%d", false));
+
+  // Batch sizes around the 64 and 256 packet boundaries
+  for (const size_t num_packets : std::vector<size_t>{1, 63, 64, 65, 255, 256, 257, 1000}) {
+    ConditionBatch batch(conditions, num_packets);
+    for (size_t column = 0; column < conditions.size(); column++) {
+      for (size_t packet = 0; packet < num_packets; packet++) {
+        batch.set(column, packet, generator() % 2 == 1);
+      }
+    }
+
+    const GuardEvaluator evaluator(guard, conditions);
+    std::vector<uint64_t> masks;
+    evaluator.evaluate(batch, masks);
+    ASSERT_EQ(masks.size(), batch.num_words());
+    for (size_t packet = 0; packet < batch.num_words() * 64; packet++) {
+      const bool expected = packet < num_packets ? evaluator.evaluate(batch, packet) : false;
+      ASSERT_EQ(((masks.at(packet / 64) >> (packet % 64)) & 1) == 1, expected);
+    }
+
+    // Constant guards
+    GuardEvaluator(Dnf() + Conjunction(Atom::make_literal(true)), conditions).evaluate(batch, masks);
+    ASSERT_EQ(masks.size(), batch.num_words());
+    size_t ones = 0;
+    for (const auto & word : masks) ones += static_cast<size_t>(__builtin_popcountll(word));
+    ASSERT_EQ(ones, num_packets);
+  }
+
+  // Atoms without a column are rejected
+  ASSERT_THROW(GuardEvaluator(Dnf() + Conjunction(Atom("%e", true)), conditions), std::logic_error);
+}
+
+#ifdef EXPECT_AVX2
+// guard_evaluator_avx2 is built with -mavx2, so the test above checks the vector path against evaluate(batch, packet)
+TEST(JayhawkTests, GuardEvaluatorUsesAvx2) {
+  ASSERT_TRUE(GuardEvaluator::uses_avx2());
+}
+#endif
@@ -0,0 +1,9 @@
+struct Packet {
+  unsigned short a;
+  unsigned char b;
+  unsigned int c;
+};
+
+void func(struct Packet p) {
+  p.c = p.a + p.b;
+}
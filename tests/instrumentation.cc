@@ -0,0 +1,197 @@
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "graph.cc"
+#include "dominator_utility.cc"
+#include "instrumentation.h"
+
+/// Whether operator new counts allocations in Instrumentation, as transform_driver's does;
+/// off by default, so that tests of CountingAllocator only see its own counts
+static bool count_new = false;
+
+/// Not inlined, so that the compiler doesn't see malloc() paired with operator delete
+__attribute__((noinline)) void * operator new(const size_t size) {
+  if (count_new) Instrumentation::record_allocation(size);
+  void * ret = std::malloc(size == 0 ? 1 : size);
+  if (ret == nullptr) throw std::bad_alloc();
+  return ret;
+}
+
+__attribute__((noinline)) void operator delete(void * pointer) noexcept { std::free(pointer); }
+__attribute__((noinline)) void operator delete(void * pointer, size_t) noexcept { std::free(pointer); }
+
+TEST(JayhawkTests, InstrumentationDisabled) {
+  Instrumentation::enable();
+  Instrumentation::disable();
+  {
+    PhaseTimer timer("ignored", "func");
+    PhaseTimer::count("nodes", 5);
+    Instrumentation::record_allocation(100);
+  }
+  ASSERT_TRUE(Instrumentation::phases().empty());
+}
+
+TEST(JayhawkTests, InstrumentationNestedPhases) {
+  Instrumentation::enable();
+  {
+    PhaseTimer outer("InstrProgDeps", "func");
+    PhaseTimer::count("nodes", 3);
+    {
+      PhaseTimer inner("CFG build");
+      PhaseTimer::count("nodes", 5);
+      PhaseTimer::count("nodes", 2);
+      PhaseTimer::count("edges", 4);
+    }
+    PhaseTimer other("IDDG", "other_func");
+  }
+  Instrumentation::disable();
+
+  const auto phases = Instrumentation::phases();
+  ASSERT_EQ(phases.size(), 3);
+  ASSERT_EQ(phases.at(0).phase, "InstrProgDeps");
+  ASSERT_EQ(phases.at(0).depth, 0);
+  ASSERT_EQ(phases.at(0).counters.at("nodes"), 3);
+  ASSERT_EQ(phases.at(1).phase, "CFG build");
+  ASSERT_EQ(phases.at(1).function, "func");
+  ASSERT_EQ(phases.at(1).depth, 1);
+  ASSERT_EQ(phases.at(1).counters.at("nodes"), 7);
+  ASSERT_EQ(phases.at(1).counters.at("edges"), 4);
+  ASSERT_EQ(phases.at(2).function, "other_func");
+  ASSERT_LE(phases.at(1).duration_ns, phases.at(0).duration_ns);
+  // Peak RSS is only sampled for outermost phases
+  ASSERT_GT(phases.at(0).peak_rss_kb, 0);
+  ASSERT_EQ(phases.at(1).peak_rss_kb, 0);
+}
+
+TEST(JayhawkTests, InstrumentationAllocations) {
+  Instrumentation::enable();
+  {
+    PhaseTimer timer("allocate", "func");
+    std::vector<int, CountingAllocator<int>> numbers;
+    numbers.reserve(100);
+  }
+  Instrumentation::disable();
+  const auto phases = Instrumentation::phases();
+  ASSERT_EQ(phases.size(), 1);
+  ASSERT_EQ(phases.front().allocations, 1);
+  ASSERT_EQ(phases.front().allocated_bytes, 100 * sizeof(int));
+}
+
+TEST(JayhawkTests, InstrumentationAllocationsPerThread) {
+  // Another thread's allocations during a phase aren't the phase's
+  Instrumentation::enable();
+  {
+    PhaseTimer timer("allocate", "func");
+    Instrumentation::record_allocation(8);
+    std::thread([] () { Instrumentation::record_allocation(100); }).join();
+  }
+  Instrumentation::disable();
+  const auto phases = Instrumentation::phases();
+  ASSERT_EQ(phases.size(), 1);
+  ASSERT_EQ(phases.front().allocations, 1);
+  ASSERT_EQ(phases.front().allocated_bytes, 8);
+}
+
+TEST(JayhawkTests, InstrumentationExcludesTimerOverhead) {
+  // Nested timers and counters allocate their records, which mustn't count against their phases
+  std::vector<std::unique_ptr<int>> ints;
+  ints.reserve(100);
+  Instrumentation::enable();
+  count_new = true;
+  {
+    PhaseTimer outer("outer", "a function name too long to be stored in place");
+    for (int i = 0; i < 100; i++) {
+      PhaseTimer inner("inner");
+      PhaseTimer::count("runs", 1);
+      ints.emplace_back(new int(i));
+    }
+  }
+  count_new = false;
+  Instrumentation::disable();
+  const auto phases = Instrumentation::phases();
+  ASSERT_EQ(phases.size(), 101);
+  ASSERT_EQ(phases.front().phase, "outer");
+  // Only the int each inner phase allocates
+  ASSERT_EQ(phases.front().allocations, 100);
+  ASSERT_EQ(phases.front().allocated_bytes, 100 * sizeof(int));
+  uint64_t inner_ns = 0;
+  for (size_t i = 1; i < phases.size(); i++) {
+    ASSERT_EQ(phases.at(i).allocations, 1);
+    ASSERT_EQ(phases.at(i).allocated_bytes, sizeof(int));
+    inner_ns += phases.at(i).duration_ns;
+  }
+  ASSERT_LE(inner_ns, phases.front().duration_ns);
+}
+
+TEST(JayhawkTests, InstrumentationThreads) {
+  // Each thread nests its own timers
+  Instrumentation::enable();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([i] () {
+      PhaseTimer outer("transform", "file" + std::to_string(i));
+      PhaseTimer inner("inner");
+      PhaseTimer::count("runs", 1);
+    });
+  }
+  for (auto & thread : threads) thread.join();
+  Instrumentation::disable();
+  const auto phases = Instrumentation::phases();
+  ASSERT_EQ(phases.size(), 8);
+  for (const auto & phase : phases) {
+    ASSERT_EQ(phase.depth, phase.phase == "inner" ? 1 : 0);
+    ASSERT_EQ(phase.counters.count("runs"), phase.phase == "inner" ? 1 : 0);
+  }
+}
+
+TEST(JayhawkTests, InstrumentationDominatorPhases) {
+  Graph<int> graph;
+  for (int i = 0; i < 4; i++) graph.add_node(i);
+  graph.add_edge(0, 1);
+  graph.add_edge(0, 2);
+  graph.add_edge(1, 3);
+  graph.add_edge(2, 3);
+  Instrumentation::enable();
+  {
+    PhaseTimer timer("CDG", "diamond");
+    DominatorUtility<int>(graph, 0);
+  }
+  Instrumentation::disable();
+  std::vector<std::string> names;
+  for (const auto & phase : Instrumentation::phases()) names.emplace_back(phase.phase);
+  const std::vector<std::string> expected = {"CDG", "dominators", "dominator tree", "frontiers"};
+  ASSERT_EQ(names, expected);
+}
+
+TEST(JayhawkTests, InstrumentationReports) {
+  Instrumentation::enable();
+  {
+    PhaseTimer slow("IfConversion", "slow \"func\"");
+    PhaseTimer::count("clauses", 12);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  { PhaseTimer fast("IfConversion", "fast"); }
+  Instrumentation::disable();
+
+  std::ostringstream json;
+  Instrumentation::write_json(json);
+  ASSERT_NE(json.str().find("\"phase\": \"IfConversion\""), std::string::npos);
+  ASSERT_NE(json.str().find("\"counters\": {\"clauses\": 12}"), std::string::npos);
+  // Slowest function first, with quotes escaped
+  const auto slow = json.str().find("{\"function\": \"slow \\\"func\\\"\", \"duration_ns\"");
+  const auto fast = json.str().find("{\"function\": \"fast\", \"duration_ns\"");
+  ASSERT_NE(slow, std::string::npos);
+  ASSERT_NE(fast, std::string::npos);
+  ASSERT_LT(slow, fast);
+
+  std::ostringstream trace;
+  Instrumentation::write_chrome_trace(trace);
+  ASSERT_EQ(trace.str().find("{\"traceEvents\": ["), 0);
+  ASSERT_NE(trace.str().find("\"ph\": \"X\""), std::string::npos);
+  ASSERT_NE(trace.str().find("\"name\": \"thread_name\""), std::string::npos);
+  ASSERT_NE(trace.str().find("\"clauses\": 12"), std::string::npos);
+}
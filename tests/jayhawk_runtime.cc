@@ -0,0 +1,45 @@
+#include <cstring>
+#include <random>
+#include "gtest/gtest.h"
+#include "jayhawk_runtime.h"
+
+TEST(JayhawkRuntimeTests, FieldsAreBigEndian) {
+  const unsigned char packet[] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x0f};
+  ASSERT_EQ(0x12u, jayhawk_load_field(packet, 0, 8));
+  ASSERT_EQ(0x3456u, jayhawk_load_field(packet, 8, 16));
+  ASSERT_EQ(0x3456789au, jayhawk_load_field(packet, 8, 32));
+  ASSERT_EQ(0x123456789abcdef0ull, jayhawk_load_field(packet, 0, 64));
+  ASSERT_EQ(0x23456789abcdef00ull, jayhawk_load_field(packet, 4, 64));
+
+  // Bit fields, most significant bit first
+  ASSERT_EQ(0x0u, jayhawk_load_field(packet, 0, 3));
+  ASSERT_EQ(0x2u, jayhawk_load_field(packet, 3, 2));
+  ASSERT_EQ(0x234u, jayhawk_load_field(packet, 4, 12));
+  ASSERT_EQ(0x1u, jayhawk_load_field(packet, 71, 1));
+
+  ASSERT_EQ(-1, jayhawk_sign_extend(0x7, 3));
+  ASSERT_EQ(3, jayhawk_sign_extend(0x3, 3));
+  ASSERT_EQ(-2, jayhawk_sign_extend(0xfffffffeull, 32));
+}
+
+TEST(JayhawkRuntimeTests, StoreOnlyTouchesTheField) {
+  std::mt19937 generator(1);
+  for (int i = 0; i < 2000; i++) {
+    unsigned char packet[16];
+    for (auto & byte : packet) byte = static_cast<unsigned char>(generator());
+    unsigned char before[sizeof(packet)];
+    std::memcpy(before, packet, sizeof(packet));
+
+    // Aligned and unaligned fields of every width, at unaligned addresses too
+    const unsigned width = 1 + generator() % 64;
+    const unsigned long offset = generator() % (8 * sizeof(packet) - width + 1);
+    const unsigned long long value = (static_cast<unsigned long long>(generator()) << 32 | generator()) &
+                                     (width == 64 ? ~0ull : (1ull << width) - 1);
+    jayhawk_store_field(packet, offset, width, value);
+    ASSERT_EQ(value, jayhawk_load_field(packet, offset, width));
+    for (unsigned long bit = 0; bit < 8 * sizeof(packet); bit++) {
+      if (bit >= offset and bit < offset + width) continue;
+      ASSERT_EQ((before[bit / 8] >> (7 - bit % 8)) & 1, (packet[bit / 8] >> (7 - bit % 8)) & 1);
+    }
+  }
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Run the analysis passes in libjayhawk through opt on small programs
+# and check what they print and the IR they leave behind.
+# make check sets OPT and CLANG to the tools configure found.
+
+OPT=${OPT:-opt}
+CLANG=${CLANG:-clang}
+LLVM_BIN=$(dirname "$OPT")
+srcdir=${srcdir:-.}
+LIB=../.libs/libjayhawk.so
+. "$srcdir/test_helpers.sh"
+
+# IR of a C test program, with locals promoted to registers and a single return
+c_to_ir() {
+  "$CLANG" -O0 -S -emit-llvm -o - "$srcdir/$1" | "$OPT" -S -mem2reg -mergereturn
+}
+
+out=$(mktemp)
+trap 'rm -f "$out"' EXIT
+
+# IfConversion on a function with an unreachable block
+"$OPT" -load "$LIB" -S -if_conversion "$srcdir/unreachable_block.ll" > "$out" 2>&1
+check "unreachable block is if-converted" "IfConversion: func: 3 live blocks" "$out"
+check_not "unreachable block is removed" "^dead:" "$out"
+
+# BoundedLoopUnroll fully unrolls a loop of 4 iterations, and the result still computes func(3) = 8
+ir=$(mktemp)
+trap 'rm -f "$out" "$ir"' EXIT
+c_to_ir bounded_loop.c | "$OPT" -load "$LIB" -S -bounded_loop_unroll -if_conversion > "$ir" 2> "$out"
+check "loop is fully unrolled" "fully unrolling loop at .* with trip count 4" "$out"
+check_not "no residual guard for a known trip count" "unroll.residual" "$ir"
+c_to_ir bounded_loop_main.c | "$LLVM_BIN/llvm-link" -S - "$ir" | "$LLVM_BIN/lli" -
+check_status "unrolled loop computes the same result" 8 $?
+
+# A known trip count above the bound leaves the loop alone, and IfConversion refuses it
+c_to_ir bounded_loop.c | "$OPT" -load "$LIB" -S -bounded_loop_unroll -unroll_bound 2 > "$ir" 2> "$out"
+check "trip count above the bound is reported" "has trip count 4, more than -unroll_bound 2" "$out"
+check_not "no partial unroll above the bound" "unroll.residual" "$ir"
+
+# Stress tests: InstrProgDeps and IfConversion on generated programs of 100 and 800 branches
+# (cfg_generators.h). The dependences and predicate operations they build, which bound their work,
+# must grow sub-quadratically: at most half of the 64 times more a quadratic analysis would build.
+program=$(mktemp)
+trap 'rm -f "$out" "$ir" "$program"' EXIT
+stress() {
+  ./cfg_program "$1" "$2" > "$program"
+  "$CLANG" -O0 -S -emit-llvm -o - -x c "$program" | "$OPT" -S -mem2reg -lowerswitch -mergereturn |
+    "$OPT" -load "$LIB" -disable-output -instr_prog_deps -if_conversion > "$out" 2>&1
+  dependences=$(sed -n 's/^InstrProgDeps: func: [0-9]* instructions, \([0-9]*\) dependences.*/\1/p' "$out")
+  operations=$(sed -n 's/^IfConversion: func: [0-9]* live blocks, \([0-9]*\) predicate operations.*/\1/p' "$out")
+}
+for shape in if_else_ladder diamond_chain switch_fanout; do
+  stress $shape 100
+  small_dependences=${dependences:-0}
+  small_operations=${operations:-0}
+  stress $shape 800
+  check "InstrProgDeps finishes on $shape 800" "^InstrProgDeps: func: " "$out"
+  check "IfConversion finishes on $shape 800" "^IfConversion: func: " "$out"
+  [ "$small_dependences" -gt 0 ] && [ "${dependences:-0}" -lt $((32 * small_dependences)) ]
+  check_status "PDG of $shape grows sub-quadratically ($small_dependences, then ${dependences:-none} dependences)" 0 $?
+  [ "$small_operations" -gt 0 ] && [ "${operations:-0}" -lt $((32 * small_operations)) ]
+  check_status "IfConversion of $shape grows sub-quadratically ($small_operations, then ${operations:-none} operations)" 0 $?
+done
+
+exit $failures
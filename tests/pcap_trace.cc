@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "pcap_trace.h"
+
+TEST(JayhawkTests, PcapTrace) {
+  char input_name[] = "/tmp/jayhawk_pcap_in_XXXXXX";
+  char output_name[] = "/tmp/jayhawk_pcap_out_XXXXXX";
+  close(mkstemp(input_name));
+  close(mkstemp(output_name));
+
+  // Three packets of 60, 1 and 100 bytes, each filled with its index
+  std::vector<std::vector<uint8_t>> payloads = {std::vector<uint8_t>(60, 0),
+                                                std::vector<uint8_t>(1, 1),
+                                                std::vector<uint8_t>(100, 2)};
+  {
+    PcapWriter writer(input_name);
+    for (uint32_t i = 0; i < payloads.size(); i++) {
+      writer.write(PcapRecord{i, 10 * i, static_cast<uint32_t>(payloads.at(i).size()),
+                              static_cast<uint32_t>(payloads.at(i).size() + 4), payloads.at(i).data()});
+    }
+  }
+
+  // Packets are presented in place, in order, and modifying them leaves the file alone
+  {
+    PcapTrace trace(input_name);
+    ASSERT_EQ(trace.records().size(), 3);
+    ASSERT_EQ(trace.link_type(), pcap::kLinkTypeEthernet);
+    ASSERT_FALSE(trace.nanoseconds());
+    for (size_t i = 0; i < payloads.size(); i++) {
+      const auto & record = trace.records().at(i);
+      ASSERT_EQ(record.ts_sec, i);
+      ASSERT_EQ(record.ts_frac, 10 * i);
+      ASSERT_EQ(record.cap_len, payloads.at(i).size());
+      ASSERT_EQ(record.orig_len, payloads.at(i).size() + 4);
+      ASSERT_EQ(std::vector<uint8_t>(record.data, record.data + record.cap_len), payloads.at(i));
+      record.data[0] = 42;
+    }
+    PcapWriter writer(output_name, trace.snap_len(), trace.link_type(), trace.nanoseconds());
+    for (const auto & record : trace.records()) writer.write(record);
+  }
+  ASSERT_EQ(PcapTrace(input_name).records().at(0).data[0], 0);
+  const PcapTrace output(output_name);
+  ASSERT_EQ(output.records().size(), 3);
+  for (const auto & record : output.records()) ASSERT_EQ(record.data[0], 42);
+
+  // A truncated last record is dropped
+  ASSERT_EQ(truncate(input_name, 24 + 16 + 60 + 16 + 1 + 16 + 50), 0);
+  ASSERT_EQ(PcapTrace(input_name).records().size(), 2);
+
+  // Anything that isn't pcap is rejected
+  ASSERT_THROW(PcapTrace("/nonexistent.pcap"), std::runtime_error);
+  FILE * garbage = fopen(input_name, "w");
+  fputs("this is not a pcap file, it's just text", garbage);
+  fclose(garbage);
+  ASSERT_THROW(PcapTrace trace(input_name), std::runtime_error);
+
+  unlink(input_name);
+  unlink(output_name);
+}
+
+TEST(JayhawkTests, HarnessStats) {
+  const auto stats = time_run([] () { return size_t(1000); });
+  ASSERT_EQ(stats.packets, 1000);
+  ASSERT_GE(stats.seconds, 0.0);
+  HarnessStats fixed;
+  fixed.packets = 2000000;
+  fixed.seconds = 0.5;
+  ASSERT_DOUBLE_EQ(fixed.packets_per_second(), 4e6);
+  ASSERT_DOUBLE_EQ(fixed.ns_per_packet(), 250.0);
+}
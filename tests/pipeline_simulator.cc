@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+#include "pipeline_simulator.h"
+
+/// Arrival cycles of num_packets packets, one every gap cycles
+static std::vector<uint64_t> arrivals_every(const uint64_t num_packets, const uint64_t gap) {
+  std::vector<uint64_t> ret;
+  for (uint64_t i = 0; i < num_packets; i++) ret.emplace_back(i * gap);
+  return ret;
+}
+
+TEST(JayhawkTests, PipelineSimulatorLineRate) {
+  // Stateless stages run at one packet per cycle, no packet waits
+  const PipelineSimulator simulator({SimulatedStage(), SimulatedStage(), SimulatedStage()});
+  const auto report = simulator.run(arrivals_every(100, 1));
+  ASSERT_EQ(report.packets, 100);
+  ASSERT_DOUBLE_EQ(report.packets_per_cycle(), 1.0);
+  ASSERT_EQ(report.latency_percentile(0.0), 3);
+  ASSERT_EQ(report.latency_percentile(1.0), 3);
+  ASSERT_EQ(report.cycles, 99 + 3);
+  for (const auto stalls : report.stage_stalls) ASSERT_EQ(stalls, 0);
+}
+
+TEST(JayhawkTests, PipelineSimulatorInitiationInterval) {
+  // A stage taking a packet every other cycle halves throughput and backs up the stage before it
+  SimulatedStage slow;
+  slow.latency = 2;
+  slow.initiation_interval = 2;
+  const PipelineSimulator simulator({SimulatedStage(), slow, SimulatedStage()});
+  const auto report = simulator.run(arrivals_every(100, 1));
+  ASSERT_DOUBLE_EQ(report.packets_per_cycle(), 0.5);
+  ASSERT_GT(report.stage_stalls.at(1), 0);
+  ASSERT_GT(report.latency_percentile(1.0), report.latency_percentile(0.0));
+}
+
+TEST(JayhawkTests, PipelineSimulatorStateHazard) {
+  // count is read in stage 0 and written in stage 2:
+  // a packet can't read it until the packet ahead has written it
+  std::vector<SimulatedStage> stages(3);
+  stages.at(0).reads = {"count"};
+  stages.at(2).writes = {"count"};
+  const PipelineSimulator simulator(stages);
+  ASSERT_EQ(simulator.hazards().size(), 1);
+
+  const auto report = simulator.run(arrivals_every(100, 1));
+  ASSERT_NEAR(report.packets_per_cycle(), 1.0 / 3.0, 1e-9);
+  ASSERT_EQ(report.hazards.size(), 1);
+  ASSERT_EQ(report.hazards.front().state, "count");
+  ASSERT_EQ(report.hazards.front().first_stage, 0);
+  ASSERT_EQ(report.hazards.front().last_stage, 2);
+  ASSERT_GT(report.hazards.front().stall_cycles, 0);
+}
+
+TEST(JayhawkTests, PipelineSimulatorAtomicUpdate) {
+  // Reading and writing count in one stage is an atomic update, no hazard
+  std::vector<SimulatedStage> stages(3);
+  stages.at(1).reads = {"count"};
+  stages.at(1).writes = {"count"};
+  stages.at(2).reads = {"other"};
+  const PipelineSimulator simulator(stages);
+  ASSERT_TRUE(simulator.hazards().empty());
+  ASSERT_DOUBLE_EQ(simulator.run(arrivals_every(100, 1)).packets_per_cycle(), 1.0);
+}
+
+TEST(JayhawkTests, PipelineSimulatorIdleGaps) {
+  // Sparse arrivals never queue, and idle cycles are skipped
+  const PipelineSimulator simulator({SimulatedStage(), SimulatedStage()});
+  const auto report = simulator.run(arrivals_every(1000, 1000000));
+  ASSERT_EQ(report.latency_percentile(1.0), 2);
+  ASSERT_EQ(report.cycles, 999 * 1000000 + 2);
+}
+
+TEST(JayhawkTests, PipelineSimulatorTraceArrivals) {
+  const std::vector<PcapRecord> records = {{10, 0, 0, 0, nullptr}, {10, 500, 0, 0, nullptr},
+                                           {10, 400, 0, 0, nullptr}, {11, 0, 0, 0, nullptr}};
+  const std::vector<uint64_t> expected = {0, 500, 500, 1000000};
+  ASSERT_EQ(trace_arrivals(records, false, 1e6), expected);
+  ASSERT_EQ(trace_arrivals(records, true, 1e9).at(1), 500);
+}
+
+TEST(JayhawkTests, PipelineSimulatorInvalid) {
+  SimulatedStage broken;
+  broken.latency = 0;
+  ASSERT_THROW(PipelineSimulator({broken}), std::invalid_argument);
+  ASSERT_THROW(PipelineSimulator({}), std::invalid_argument);
+  const PipelineSimulator simulator({SimulatedStage()});
+  ASSERT_THROW(simulator.run({5, 3}), std::invalid_argument);
+  ASSERT_EQ(simulator.run({}).packets, 0);
+}
+
+TEST(JayhawkTests, StageLatencyModelParse) {
+  const auto defaults = StageLatencyModel::parse("");
+  ASSERT_EQ(defaults.multiply, 3);
+  ASSERT_EQ(defaults.divide, 12);
+  const auto model = StageLatencyModel::parse("match=2,multiply=4,state=7");
+  ASSERT_EQ(model.match, 2);
+  ASSERT_EQ(model.alu, 1);
+  ASSERT_EQ(model.multiply, 4);
+  ASSERT_EQ(model.divide, 12);
+  ASSERT_EQ(model.state_access, 7);
+  ASSERT_THROW(StageLatencyModel::parse("multiply"), std::invalid_argument);
+  ASSERT_THROW(StageLatencyModel::parse("multiply=-1"), std::invalid_argument);
+  ASSERT_THROW(StageLatencyModel::parse("fma=3"), std::invalid_argument);
+}
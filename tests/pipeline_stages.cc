@@ -0,0 +1,98 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "graph.cc"
+#include "pipeline_stages.h"
+
+TEST(JayhawkTests, PipelineStagesChain) {
+  Graph<int> graph;
+  for (int i = 1; i <= 4; i++) graph.add_node(i);
+  graph.add_edge(1, 2);
+  graph.add_edge(2, 3);
+  graph.add_edge(3, 4);
+
+  const auto stages = assign_stages(graph, 2);
+  const std::map<int, unsigned> expected = {{1, 0}, {2, 0}, {3, 1}, {4, 1}};
+  ASSERT_EQ(stages, expected);
+}
+
+TEST(JayhawkTests, PipelineStagesIndependent) {
+  // Without dependences, nodes keep their order
+  Graph<int> graph;
+  for (int i = 1; i <= 6; i++) graph.add_node(i);
+
+  const auto stages = assign_stages(graph, 3);
+  const std::map<int, unsigned> expected = {{1, 0}, {2, 0}, {3, 1}, {4, 1}, {5, 2}, {6, 2}};
+  ASSERT_EQ(stages, expected);
+}
+
+TEST(JayhawkTests, PipelineStagesStateStaysTogether) {
+  // 2 and 3 read and write the same state, so they form a cycle
+  Graph<int> graph;
+  for (int i = 1; i <= 5; i++) graph.add_node(i);
+  graph.add_edge(1, 2);
+  graph.add_edge(2, 3);
+  graph.add_edge(3, 2);
+  graph.add_edge(3, 4);
+  graph.add_edge(4, 5);
+
+  const auto stages = assign_stages(graph, 5);
+  ASSERT_EQ(stages.at(2), stages.at(3));
+  for (const auto & node : graph.succ_map()) {
+    for (const auto & neighbor : node.second) ASSERT_LE(stages.at(node.first), stages.at(neighbor));
+  }
+  for (const auto & stage : stages) ASSERT_LT(stage.second, 5);
+}
+
+TEST(JayhawkTests, PipelineStagesCost) {
+  // One expensive node gets a stage to itself
+  Graph<int> graph;
+  for (int i = 1; i <= 4; i++) graph.add_node(i);
+  graph.add_edge(1, 2);
+  graph.add_edge(2, 3);
+  graph.add_edge(3, 4);
+
+  const auto stages = assign_stages<int>(graph, 2, [] (const int & node) { return node == 1 ? size_t(10) : size_t(1); });
+  const std::map<int, unsigned> expected = {{1, 0}, {2, 1}, {3, 1}, {4, 1}};
+  ASSERT_EQ(stages, expected);
+}
+
+TEST(JayhawkTests, PipelineStagesRespectDependences) {
+  // Pseudo-random graph with forward edges and a few back edges
+  Graph<int> graph;
+  const int num_nodes = 60;
+  for (int i = 0; i < num_nodes; i++) graph.add_node(i);
+  unsigned seed = 12345;
+  for (int i = 0; i < 150; i++) {
+    seed = seed * 1103515245u + 12345u;
+    const int a = static_cast<int>((seed >> 8) % num_nodes);
+    seed = seed * 1103515245u + 12345u;
+    const int b = static_cast<int>((seed >> 8) % num_nodes);
+    if (a != b and (a < b or i % 10 == 0) and not graph.exists_edge(a, b)) graph.add_edge(a, b);
+  }
+
+  for (unsigned num_stages = 1; num_stages <= 8; num_stages++) {
+    const auto stages = assign_stages(graph, num_stages);
+    ASSERT_EQ(stages.size(), static_cast<size_t>(num_nodes));
+    for (const auto & node : graph.succ_map()) {
+      for (const auto & neighbor : node.second) ASSERT_LE(stages.at(node.first), stages.at(neighbor));
+    }
+    for (const auto & stage : stages) ASSERT_LT(stage.second, num_stages);
+  }
+  ASSERT_THROW(assign_stages(graph, 0), std::invalid_argument);
+}
+
+TEST(JayhawkTests, PipelineStagesAsap) {
+  // 1 -> 2 <-> 3 -> 5, 1 -> 4 -> 5, 6 independent
+  Graph<int> graph;
+  for (int i = 1; i <= 6; i++) graph.add_node(i);
+  graph.add_edge(1, 2);
+  graph.add_edge(2, 3);
+  graph.add_edge(3, 2);
+  graph.add_edge(3, 5);
+  graph.add_edge(1, 4);
+  graph.add_edge(4, 5);
+
+  const auto stages = asap_stages(graph);
+  const std::map<int, unsigned> expected = {{1, 0}, {2, 1}, {3, 1}, {4, 1}, {5, 2}, {6, 0}};
+  ASSERT_EQ(stages, expected);
+}
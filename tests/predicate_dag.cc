@@ -0,0 +1,39 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "predicate_dag.h"
+
+TEST(JayhawkTests, PredicateDag) {
+  // Guards for blocks nested 1 through 20 deep: c1, c1 and c2, ... 
+  // Computed independently these need 0 + 1 + ... + 19 ANDs,
+  // sharing prefixes needs one AND per level
+  const int depth = 20;
+  PredicateDag dag;
+  Dnf guard = Dnf() + Conjunction(Atom::make_literal(true));
+  std::vector<PredicateDag::NodeId> registers;
+  for (int i = 1; i <= depth; i++) {
+    guard *= Conjunction(Atom("c" + std::to_string(i), true));
+    guard.simplify();
+    registers.emplace_back(dag.add_guard(guard));
+  }
+  ASSERT_EQ(dag.num_operations(), depth - 1);
+
+  // Else branch at the innermost level shares the whole prefix
+  Dnf else_guard = Dnf();
+  std::vector<Atom> atoms;
+  for (int i = 1; i < depth; i++) atoms.emplace_back("c" + std::to_string(i), true);
+  atoms.emplace_back("c" + std::to_string(depth), false);
+  else_guard += Conjunction(atoms);
+  dag.add_guard(else_guard);
+  ASSERT_EQ(dag.num_operations(), depth);
+
+  // Join of then and else is one OR, and adding the same guard twice is free
+  const auto join = dag.add_guard(guard + else_guard);
+  ASSERT_EQ(dag.add_guard(guard + else_guard), join);
+  ASSERT_EQ(dag.num_operations(), depth + 1);
+
+  // Atoms in a different order still share the chain
+  Dnf reordered = Dnf() + Conjunction({Atom("c2", true), Atom("c1", true)});
+  ASSERT_EQ(dag.add_guard(reordered), registers.at(1));
+
+  std::cout << dag;
+}
@@ -0,0 +1,21 @@
+struct Packet {
+  unsigned int src;
+  unsigned int dst;
+  unsigned int count;
+};
+
+unsigned int flows[1024];
+unsigned int by_other[1024];
+unsigned int by_other_too[1024];
+unsigned int total;
+
+void func(struct Packet p) {
+  flows[(p.src * 31 + p.dst) % 1024] = flows[(p.src * 31 + p.dst) % 1024] + 1;
+  total = total + 1;
+  p.count = flows[(p.src * 31 + p.dst) % 1024];
+}
+
+void other(struct Packet q) {
+  by_other[q.src % 1024] = by_other[q.src % 1024] + 1;
+  by_other_too[q.src % 1024] = by_other_too[q.src % 1024] + 1;
+}
@@ -0,0 +1,119 @@
+#include <cstring>
+#include <thread>
+#include "gtest/gtest.h"
+#include "spsc_ring.h"
+
+static void write_u64(uint8_t * record, const uint64_t value) { memcpy(record, &value, sizeof(value)); }
+
+static uint64_t read_u64(const uint8_t * record) {
+  uint64_t value;
+  memcpy(&value, record, sizeof(value));
+  return value;
+}
+
+TEST(JayhawkTests, SpscRingBatches) {
+  SpscRing ring(sizeof(uint64_t), 8);
+  uint8_t * records = nullptr;
+
+  // Nothing to read yet
+  ASSERT_EQ(ring.peek(records, 4), 0);
+
+  // Fill the ring in two batches
+  ASSERT_EQ(ring.reserve(records, 5), 5);
+  for (uint64_t i = 0; i < 5; i++) write_u64(records + i * sizeof(uint64_t), i);
+  ring.commit(5);
+  ASSERT_EQ(ring.reserve(records, 5), 3);
+  for (uint64_t i = 0; i < 3; i++) write_u64(records + i * sizeof(uint64_t), 5 + i);
+  ring.commit(3);
+  ASSERT_EQ(ring.reserve(records, 1), 0);
+
+  // Read part of it back
+  ASSERT_EQ(ring.peek(records, 6), 6);
+  for (uint64_t i = 0; i < 6; i++) ASSERT_EQ(read_u64(records + i * sizeof(uint64_t)), i);
+  ring.release(6);
+
+  ASSERT_EQ(ring.peek(records, 8), 2);
+  ASSERT_EQ(read_u64(records), 6);
+  ring.release(2);
+  ASSERT_EQ(ring.peek(records, 8), 0);
+}
+
+TEST(JayhawkTests, SpscRingWrapAround) {
+  SpscRing ring(sizeof(uint64_t), 8);
+  uint8_t * records = nullptr;
+  ASSERT_EQ(ring.reserve(records, 5), 5);
+  ring.commit(5);
+  ASSERT_EQ(ring.peek(records, 5), 5);
+  ring.release(5);
+
+  // Free space wraps around: only the run up to the end of the ring comes back contiguous
+  ASSERT_EQ(ring.reserve(records, 6), 3);
+  for (uint64_t i = 0; i < 3; i++) write_u64(records + i * sizeof(uint64_t), 100 + i);
+  ring.commit(3);
+  uint8_t * wrapped = nullptr;
+  ASSERT_EQ(ring.reserve(wrapped, 6), 5);
+  ASSERT_LT(wrapped, records);
+  for (uint64_t i = 0; i < 5; i++) write_u64(wrapped + i * sizeof(uint64_t), 103 + i);
+  ring.commit(5);
+
+  // Same on the way out
+  ASSERT_EQ(ring.peek(records, 8), 3);
+  ASSERT_EQ(read_u64(records + 2 * sizeof(uint64_t)), 102);
+  ring.release(3);
+  ASSERT_EQ(ring.peek(records, 8), 5);
+  ASSERT_EQ(read_u64(records), 103);
+  ring.release(5);
+}
+
+TEST(JayhawkTests, SpscRingClose) {
+  SpscRing ring(4, 4);
+  uint8_t * records = nullptr;
+  ASSERT_FALSE(ring.drained());
+  ASSERT_EQ(ring.reserve(records, 1), 1);
+  ring.commit(1);
+  ring.close();
+
+  // Closed, but a record is still unread
+  ASSERT_FALSE(ring.drained());
+  ASSERT_EQ(ring.peek(records, 4), 1);
+  ring.release(1);
+  ASSERT_TRUE(ring.drained());
+}
+
+TEST(JayhawkTests, SpscRingInvalid) {
+  ASSERT_THROW(SpscRing(8, 6), std::invalid_argument);
+  ASSERT_THROW(SpscRing(8, 0), std::invalid_argument);
+  ASSERT_THROW(SpscRing(0, 8), std::invalid_argument);
+}
+
+TEST(JayhawkTests, SpscRingThreads) {
+  // Producer and consumer on different threads, with batch sizes that don't divide the capacity
+  const uint64_t num_records = 1000000;
+  SpscRing ring(sizeof(uint64_t), 1024);
+
+  std::thread producer([&ring, num_records] () {
+    uint64_t next = 0;
+    while (next < num_records) {
+      uint8_t * records = nullptr;
+      const size_t count = ring.reserve(records, std::min<uint64_t>(37, num_records - next));
+      for (size_t i = 0; i < count; i++) write_u64(records + i * sizeof(uint64_t), next++);
+      ring.commit(count);
+      if (count == 0) std::this_thread::yield();
+    }
+    ring.close();
+  });
+
+  uint64_t expected = 0;
+  bool in_order = true;
+  while (not ring.drained()) {
+    uint8_t * records = nullptr;
+    const size_t count = ring.peek(records, 53);
+    for (size_t i = 0; i < count; i++) in_order = in_order and read_u64(records + i * sizeof(uint64_t)) == expected++;
+    ring.release(count);
+    if (count == 0) std::this_thread::yield();
+  }
+  producer.join();
+
+  ASSERT_TRUE(in_order);
+  ASSERT_EQ(expected, num_records);
+}
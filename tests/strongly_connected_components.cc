@@ -0,0 +1,72 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "graph.cc"
+
+TEST(JayhawkTests, StronglyConnectedComponents) {
+  // Example from Fig. 22.9 of CLRS
+  Graph<char> graph;
+  for (char node = 'a'; node <= 'h'; node++) {
+    graph.add_node(node);
+  }
+  graph.add_edge('a', 'b');
+  graph.add_edge('b', 'c');
+  graph.add_edge('b', 'e');
+  graph.add_edge('b', 'f');
+  graph.add_edge('c', 'd');
+  graph.add_edge('c', 'g');
+  graph.add_edge('d', 'c');
+  graph.add_edge('d', 'h');
+  graph.add_edge('e', 'a');
+  graph.add_edge('e', 'f');
+  graph.add_edge('f', 'g');
+  graph.add_edge('g', 'f');
+  graph.add_edge('g', 'h');
+  graph.add_edge('h', 'h');
+
+  const auto components = graph.strongly_connected_components();
+  ASSERT_EQ(components.size(), 4);
+
+  // Reverse topological order: sinks first
+  const std::vector<std::vector<char>> expected = {{'h'}, {'f', 'g'}, {'c', 'd'}, {'a', 'b', 'e'}};
+  ASSERT_EQ(components, expected);
+}
+
+TEST(JayhawkTests, StronglyConnectedComponentsAcyclic) {
+  // Every node of a DAG is its own component
+  Graph<int> graph;
+  for (int i = 1; i <= 5; i++) {
+    graph.add_node(i);
+  }
+  graph.add_edge(1, 2);
+  graph.add_edge(1, 3);
+  graph.add_edge(2, 4);
+  graph.add_edge(3, 4);
+
+  const auto components = graph.strongly_connected_components();
+  ASSERT_EQ(components.size(), 5);
+  for (const auto & component : components) ASSERT_EQ(component.size(), 1);
+
+  // 4 is reached from 2 and 3, so it comes before them, and both come before 1
+  std::map<int, size_t> position;
+  for (size_t i = 0; i < components.size(); i++) position[components.at(i).front()] = i;
+  ASSERT_LT(position.at(4), position.at(2));
+  ASSERT_LT(position.at(4), position.at(3));
+  ASSERT_LT(position.at(2), position.at(1));
+  ASSERT_LT(position.at(3), position.at(1));
+}
+
+TEST(JayhawkTests, StronglyConnectedComponentsLongCycle) {
+  // A cycle long enough to overflow a recursive DFS
+  const int length = 200000;
+  Graph<int> graph;
+  for (int i = 0; i < length; i++) {
+    graph.add_node(i);
+  }
+  for (int i = 0; i < length; i++) {
+    graph.add_edge(i, (i + 1) % length);
+  }
+
+  const auto components = graph.strongly_connected_components();
+  ASSERT_EQ(components.size(), 1);
+  ASSERT_EQ(components.front().size(), static_cast<size_t>(length));
+}
@@ -0,0 +1,35 @@
+# Checks shared by pass_tests.sh and driver_tests.sh, which count failures in $failures
+
+failures=0
+
+# check NAME PATTERN FILE: fail NAME unless FILE has a line matching PATTERN
+check() {
+  if ! grep -q -e "$2" "$3"; then
+    echo "FAIL $1: no line matching '$2' in"
+    cat "$3"
+    failures=$((failures + 1))
+  else
+    echo "PASS $1"
+  fi
+}
+
+# check_not NAME PATTERN FILE: fail NAME if FILE has a line matching PATTERN
+check_not() {
+  if grep -q -e "$2" "$3"; then
+    echo "FAIL $1: unexpected line matching '$2' in"
+    cat "$3"
+    failures=$((failures + 1))
+  else
+    echo "PASS $1"
+  fi
+}
+
+# check_status NAME EXPECTED ACTUAL
+check_status() {
+  if [ "$2" != "$3" ]; then
+    echo "FAIL $1: expected $2, got $3"
+    failures=$((failures + 1))
+  else
+    echo "PASS $1"
+  fi
+}
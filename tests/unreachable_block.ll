@@ -0,0 +1,16 @@
+; Block %dead has no predecessors: valid IR that reverse post order never visits
+define i32 @func(i32 %a) {
+entry:
+  %cmp = icmp sgt i32 %a, 0
+  br i1 %cmp, label %then, label %join
+
+then:
+  br label %join
+
+dead:
+  br label %join
+
+join:
+  %r = phi i32 [ 1, %then ], [ 0, %entry ], [ 2, %dead ]
+  ret i32 %r
+}
@@ -0,0 +1,382 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "analysis_cache.h"
+#include "analysis_output.h"
+#include "analysis_pipeline.h"
+#include "instrumentation.h"
+#include "source_transforms.h"
+
+using namespace clang;
+using namespace clang::tooling;
+
+static llvm::cl::OptionCategory TransformDriver("Parse each packet program once and run all source transforms on it");
+
+static llvm::cl::opt<unsigned> NumJobs("j", llvm::cl::init(1), llvm::cl::cat(TransformDriver),
+                                       llvm::cl::desc("Number of files to transform in parallel"));
+
+static llvm::cl::opt<std::string> AstCacheDir("ast_cache_dir", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                              llvm::cl::desc("Directory to cache serialized ASTs in, keyed by file contents and flags"));
+
+static llvm::cl::opt<bool> Analyze("analyze", llvm::cl::init(false), llvm::cl::cat(TransformDriver),
+                                   llvm::cl::desc("Compile each file as written in process and run the analysis passes on it, "
+                                                                 "instead of printing the transformed file"));
+
+static llvm::cl::opt<std::string> OutputDir("output_dir", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                            llvm::cl::desc("Write each transformed file here instead of to stdout"));
+
+static llvm::cl::opt<std::string> ManifestDir("manifest_dir", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                              llvm::cl::desc("Write the parse/deparse manifest of each file here"));
+
+static llvm::cl::opt<std::string> LayoutDir("layout_dir", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                            llvm::cl::desc("Write the packed PHV layout of each file's packet fields here, as a C header"));
+
+static llvm::cl::opt<unsigned> Burst("burst", llvm::cl::init(0), llvm::cl::cat(TransformDriver),
+                                     llvm::cl::desc("Process bursts of this many packets per loop iteration, with fields in struct-of-arrays locals"));
+
+static llvm::cl::opt<std::string> Harness("harness", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                           llvm::cl::desc("Drive this function from jayhawk_runtime.h (e.g., pcap_harness) instead of looping forever"));
+
+static llvm::cl::opt<unsigned> Shards("shards", llvm::cl::init(0), llvm::cl::cat(TransformDriver),
+                                      llvm::cl::desc("Run the -harness function on this many cores, one shard of flows each"));
+
+static llvm::cl::list<std::string> FlowKey("flow_key", llvm::cl::CommaSeparated, llvm::cl::cat(TransformDriver),
+                                           llvm::cl::desc("Packet fields hashed to pick a packet's shard, e.g., -flow_key=src,dst"));
+
+static llvm::cl::opt<std::string> LowerStateDir("lower_state_dir", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                                llvm::cl::desc("Also compile each -shards program with its updates of shared state "
+                                                               "lowered to atomics or per-shard replicas, to LLVM IR (.ll) here"));
+
+static llvm::cl::opt<unsigned> Stages("stages", llvm::cl::init(0), llvm::cl::cat(TransformDriver),
+                                      llvm::cl::desc("Split the -harness function into this many pipeline stages, one core each"));
+
+static llvm::cl::opt<std::string> Instrument("instrument", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                            llvm::cl::desc("Time each phase of the transforms and analyses and write a report to this file"));
+
+static llvm::cl::opt<std::string> InstrumentFormat("instrument_format", llvm::cl::init("json"), llvm::cl::cat(TransformDriver),
+                                                  llvm::cl::desc("Format of the -instrument report: json or chrome (trace event format)"));
+
+static llvm::cl::opt<unsigned> AnalysisVerbosity("verbosity", llvm::cl::init(static_cast<unsigned>(Verbosity::kSummary)),
+                                                 llvm::cl::cat(TransformDriver),
+                                                 llvm::cl::desc("What -analyze prints: 0 nothing, 1 a line per function, "
+                                                                "2 results, 3 every intermediate graph and condition"));
+
+static llvm::cl::opt<std::string> AnalysisOutputFile("analysis_output", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                                     llvm::cl::desc("Write what -analyze prints here instead of to stdout"));
+
+static llvm::cl::opt<std::string> GraphDir("graph_dir", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                           llvm::cl::desc("Save each function's program dependence graph from -analyze here, "
+                                                          "as <file>.<function>.pdg.jhg (binary) and .pdg.dot (DOT)"));
+
+static llvm::cl::opt<std::string> AnalysisCacheDir("analysis_cache_dir", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                                   llvm::cl::desc("Reuse -analyze results of functions whose bodies "
+                                                                  "haven't changed, cached in this directory"));
+
+static llvm::cl::opt<std::string> SimulationTrace("simulation_trace", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                                  llvm::cl::desc("Replay this pcap trace through -analyze's pipeline simulation "
+                                                                 "at its timestamps instead of back-to-back packets"));
+
+static llvm::cl::opt<double> ClockHz("clock_hz", llvm::cl::init(1e9), llvm::cl::cat(TransformDriver),
+                                     llvm::cl::desc("Clock of the simulated pipeline, which turns trace timestamps into cycles"));
+
+static llvm::cl::opt<std::string> LatencyModel("latency_model", llvm::cl::init(""), llvm::cl::cat(TransformDriver),
+                                               llvm::cl::desc("Cycles per operation of the simulated pipeline, e.g., multiply=4,state=2 "
+                                                              "(operations: match, alu, multiply, divide, state)"));
+
+/// Heap allocations counted for -instrument.
+/// Not inlined, so that the compiler doesn't see malloc() paired with operator delete
+__attribute__((noinline)) void * operator new(const size_t size) {
+  Instrumentation::record_allocation(size);
+  void * ret = std::malloc(size == 0 ? 1 : size);
+  if (ret == nullptr) throw std::bad_alloc();
+  return ret;
+}
+
+__attribute__((noinline)) void operator delete(void * pointer) noexcept { std::free(pointer); }
+__attribute__((noinline)) void operator delete(void * pointer, size_t) noexcept { std::free(pointer); }
+
+/// AST cache statistics
+static std::atomic<unsigned> cache_hits(0);
+static std::atomic<unsigned> cache_misses(0);
+
+/// 64-bit FNV-1a hash, stable across runs unlike std::hash
+static uint64_t fnv1a_hash(const llvm::StringRef data, uint64_t hash = 14695981039346656037ull) {
+  for (const auto c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/// Path of the cached AST for file: hash of the clang version,
+/// the file's contents and its compile command. Returns "" if caching is off
+/// or file can't be read.
+static std::string ast_cache_path(const CompilationDatabase & compilations, const std::string & file) {
+  if (AstCacheDir.empty()) return "";
+  auto buffer = llvm::MemoryBuffer::getFile(file);
+  if (not buffer) return "";
+
+  uint64_t hash = fnv1a_hash(CLANG_VERSION_STRING);
+  hash = fnv1a_hash((*buffer)->getBuffer(), hash);
+  for (const auto & command : compilations.getCompileCommands(file)) {
+    for (const auto & arg : command.CommandLine) hash = fnv1a_hash(arg + '\0', hash);
+  }
+  return AstCacheDir + "/" + llvm::sys::path::filename(file).str() + "." + llvm::utohexstr(hash) + ".ast";
+}
+
+/// Flags from the compile command for file, without the compiler,
+/// the input file and output options
+static std::vector<std::string> compiler_flags(const CompilationDatabase & compilations, const std::string & file) {
+  std::vector<std::string> ret;
+  for (const auto & command : compilations.getCompileCommands(file)) {
+    for (size_t i = 1; i < command.CommandLine.size(); i++) {
+      const auto & arg = command.CommandLine.at(i);
+      if (arg == "-o") i++;
+      else if (arg != "-c" and llvm::sys::path::filename(arg) != llvm::sys::path::filename(file)) ret.emplace_back(arg);
+    }
+  }
+  return ret;
+}
+
+/// Path of file's output under dir, with suffix: file's path relative to the
+/// working directory, or its absolute path without the root if file is outside it,
+/// so that inputs with the same name in different directories don't collide
+static std::string output_path(const std::string & dir, const std::string & file, const std::string & suffix) {
+  // Components of path made absolute, with . and .. resolved
+  const auto components = [] (const std::string & path) {
+    llvm::SmallString<256> absolute(path);
+    llvm::sys::fs::make_absolute(absolute);
+    const auto relative = llvm::sys::path::relative_path(absolute.str());
+    std::vector<std::string> ret;
+    for (auto it = llvm::sys::path::begin(relative); it != llvm::sys::path::end(relative); ++it) {
+      if (*it == "..") {
+        if (not ret.empty()) ret.pop_back();
+      } else if (*it != ".") {
+        ret.emplace_back(it->str());
+      }
+    }
+    return ret;
+  };
+  const auto file_components = components(file);
+  const auto working_dir_components = components(".");
+  const bool in_working_dir = file_components.size() > working_dir_components.size() and
+                              std::equal(working_dir_components.begin(), working_dir_components.end(), file_components.begin());
+  std::string ret = dir;
+  for (size_t i = in_working_dir ? working_dir_components.size() : 0; i < file_components.size(); i++) {
+    ret += "/" + file_components.at(i);
+  }
+  return ret + suffix;
+}
+
+/// Write contents to file_name, creating its directory if need be.
+/// Returns false, saying why, if that fails.
+static bool write_output(const std::string & file_name, const std::string & contents) {
+  const auto dir = llvm::sys::path::parent_path(file_name);
+  if (const auto error = llvm::sys::fs::create_directories(dir)) {
+    llvm::errs() << "Could not create " << dir << ": " << error.message() << "\n";
+    return false;
+  }
+  std::ofstream out(file_name);
+  out << contents;
+  out.close();
+  if (not out) {
+    llvm::errs() << "Could not write " << file_name << "\n";
+    return false;
+  }
+  return true;
+}
+
+/// Parse file exactly once, or not at all if its AST is cached, and transform it.
+/// Everything with per-file state (AST, matchers, handlers) is local to this call,
+/// so calls for different files can run on different threads.
+static int transform_file(const CompilationDatabase & compilations, const std::string & file,
+                          std::string & output, TransformArtifacts & artifacts) {
+  TransformOptions options;
+  options.burst_size = Burst;
+  options.harness_function = Harness;
+  options.num_shards = Shards;
+  options.flow_key.assign(FlowKey.begin(), FlowKey.end());
+  options.num_stages = Stages;
+
+  const auto cache_file = ast_cache_path(compilations, file);
+
+  // Loading fails if any header the AST depends on changed since it was saved
+  if (not cache_file.empty() and llvm::sys::fs::exists(cache_file)) {
+    IntrusiveRefCntPtr<DiagnosticsEngine> diagnostics(CompilerInstance::createDiagnostics(new DiagnosticOptions()));
+    std::unique_ptr<ASTUnit> ast_unit(ASTUnit::LoadFromASTFile(cache_file, diagnostics, FileSystemOptions()));
+    if (ast_unit) {
+      cache_hits++;
+      output = transform_translation_unit(*ast_unit, options, &artifacts);
+      return 0;
+    }
+  }
+
+  // Parse from the file's contents, as compile_server does, rather than with a ClangTool,
+  // which changes the process-wide working directory and so would serialize the workers.
+  // Relative paths in the compile command resolve against its directory through -working-directory.
+  auto source = llvm::MemoryBuffer::getFile(file);
+  if (not source) {
+    llvm::errs() << "Could not read " << file << "\n";
+    return 1;
+  }
+  auto args = compiler_flags(compilations, file);
+  const auto commands = compilations.getCompileCommands(file);
+  if (not commands.empty() and not commands.front().Directory.empty()) {
+    args.insert(args.begin(), {"-working-directory", commands.front().Directory});
+  }
+  std::unique_ptr<ASTUnit> ast_unit(buildASTFromCodeWithArgs((*source)->getBuffer(), args, file));
+  if (not ast_unit or ast_unit->getDiagnostics().hasErrorOccurred()) {
+    llvm::errs() << "Could not parse " << file << "\n";
+    return 1;
+  }
+  if (not cache_file.empty()) {
+    cache_misses++;
+    // Save() writes to a temporary file and renames it, so concurrent workers are ok
+    if (ast_unit->Save(cache_file)) {
+      llvm::errs() << "Warning: could not cache AST for " << file << " in " << cache_file << "\n";
+    }
+  }
+  output = transform_translation_unit(*ast_unit, options, &artifacts);
+  return 0;
+}
+
+int main(int argc, const char **argv) {
+  CommonOptionsParser op(argc, argv, TransformDriver);
+  const auto & files = op.getSourcePathList();
+  if (InstrumentFormat != "json" and InstrumentFormat != "chrome") {
+    llvm::errs() << "-instrument_format must be json or chrome\n";
+    return 1;
+  }
+  if (not LowerStateDir.empty() and Shards == 0) {
+    llvm::errs() << "-lower_state_dir needs -shards\n";
+    return 1;
+  }
+  SimulationOptions simulation;
+  try {
+    simulation.model = StageLatencyModel::parse(LatencyModel);
+  } catch (const std::exception & e) {
+    llvm::errs() << "-latency_model: " << e.what();
+    return 1;
+  }
+  simulation.trace_file = SimulationTrace;
+  simulation.clock_hz = ClockHz;
+  if (not Instrument.empty()) Instrumentation::enable();
+  AnalysisOutput::set_verbosity(static_cast<Verbosity>(std::min(AnalysisVerbosity.getValue(), 3u)));
+  if (not AnalysisOutputFile.empty()) AnalysisOutput::open(AnalysisOutputFile);
+  AnalysisOutput::set_graph_dir(GraphDir);
+  try {
+    AnalysisCache::open(AnalysisCacheDir);
+  } catch (const std::exception & e) {
+    llvm::errs() << e.what();
+    return 1;
+  }
+  const auto write_instrumentation = [] () {
+    if (not Instrument.empty()) Instrumentation::write(Instrument, InstrumentFormat == "chrome");
+  };
+
+  // Workers only use absolute paths, so that the working directory doesn't matter to them
+  std::vector<std::string> absolute_files;
+  for (const auto & file : files) absolute_files.emplace_back(getAbsolutePath(file));
+  if (not AstCacheDir.empty()) AstCacheDir = getAbsolutePath(AstCacheDir.getValue());
+
+  // Workers pull the next file off a shared counter,
+  // and each one writes only to its own slot in outputs and statuses
+  std::vector<std::string> outputs(files.size());
+  std::vector<TransformArtifacts> artifacts(files.size());
+  std::vector<int> statuses(files.size(), 0);
+  std::atomic<size_t> next_file(0);
+  auto worker = [&] () {
+    for (size_t i = next_file++; i < files.size(); i = next_file++) {
+      try {
+        PhaseTimer timer("transform", Instrumentation::enabled() ? files.at(i) : std::string());
+        statuses.at(i) = transform_file(op.getCompilations(), absolute_files.at(i), outputs.at(i), artifacts.at(i));
+      } catch (const std::exception & e) {
+        llvm::errs() << files.at(i) << ": " << e.what();
+        statuses.at(i) = 1;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < std::max(1u, static_cast<unsigned>(NumJobs)); i++) workers.emplace_back(worker);
+  worker();
+  for (auto & thread : workers) thread.join();
+
+  if (not AstCacheDir.empty()) {
+    llvm::errs() << "AST cache: " << cache_hits << " hits, " << cache_misses << " misses\n";
+  }
+
+  // Emit results in input order, independent of scheduling,
+  // carrying on past files that fail so that all failures are reported
+  std::vector<std::string> failed;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (statuses.at(i) != 0) {
+      failed.emplace_back(files.at(i));
+      continue;
+    }
+    for (const auto & state_var : artifacts.at(i).shared_state) {
+      llvm::errs() << files.at(i) << ": state variable " << state_var << " is shared between shards, "
+                   << "bursts touching it are serialized\n";
+    }
+    bool ok = true;
+    if (not ManifestDir.empty()) {
+      ok = write_output(output_path(ManifestDir, files.at(i), ".manifest"), artifacts.at(i).manifest) and ok;
+    }
+    if (not LayoutDir.empty()) {
+      ok = write_output(output_path(LayoutDir, files.at(i), ".layout.h"), artifacts.at(i).layout) and ok;
+    }
+    if (Analyze) {
+      // Passes share the global LLVMContext, so this runs one file at a time
+      auto source = llvm::MemoryBuffer::getFile(absolute_files.at(i));
+      if (not source) {
+        llvm::errs() << "Could not read " << files.at(i) << "\n";
+        ok = false;
+      } else {
+        ok = run_analysis_pipeline(files.at(i), (*source)->getBuffer().str(),
+                                   compiler_flags(op.getCompilations(), files.at(i)), simulation) and ok;
+      }
+    } else if (OutputDir.empty()) {
+      llvm::outs() << outputs.at(i);
+    } else {
+      ok = write_output(output_path(OutputDir, files.at(i), ""), outputs.at(i)) and ok;
+    }
+    if (not LowerStateDir.empty()) {
+      // Like -analyze, one file at a time
+      std::string ir;
+      ok = lower_shared_state(files.at(i), outputs.at(i), compiler_flags(op.getCompilations(), files.at(i)), ir) and
+           write_output(output_path(LowerStateDir, files.at(i), ".ll"), ir) and ok;
+    }
+    if (not ok) failed.emplace_back(files.at(i));
+  }
+
+  if (AnalysisCache::current() != nullptr) {
+    llvm::errs() << "Analysis cache: " << AnalysisCache::current()->hits() << " hits, "
+                 << AnalysisCache::current()->misses() << " misses\n";
+  }
+  write_instrumentation();
+  if (not failed.empty()) {
+    llvm::errs() << failed.size() << " of " << files.size() << " files failed:";
+    for (const auto & file : failed) llvm::errs() << " " << file;
+    llvm::errs() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -1,3 +1,6 @@
+#include <map>
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
 #include "utility_functions.h"
 
 std::string value_printer(const llvm::Value * value) {
@@ -20,3 +23,60 @@ std::string bb_printer(const llvm::BasicBlock * basic_block) {
   basic_block->printAsOperand(rso);
   return str;
 }
+
+const llvm::GlobalVariable * accessed_global(const llvm::Instruction * instruction) {
+  const llvm::Value * pointer = nullptr;
+  if (const auto * load = llvm::dyn_cast<llvm::LoadInst>(instruction)) pointer = load->getPointerOperand();
+  else if (const auto * store = llvm::dyn_cast<llvm::StoreInst>(instruction)) pointer = store->getPointerOperand();
+  else return nullptr;
+
+  pointer = pointer->stripPointerCasts();
+  while (const auto * gep = llvm::dyn_cast<llvm::GEPOperator>(pointer)) {
+    pointer = gep->getPointerOperand()->stripPointerCasts();
+  }
+  return llvm::dyn_cast<llvm::GlobalVariable>(pointer);
+}
+
+Fingerprint function_fingerprint(const llvm::Function & func) {
+  const auto type_printer = [] (const llvm::Type * type) {
+    std::string str;
+    llvm::raw_string_ostream rso(str);
+    type->print(rso);
+    return rso.str();
+  };
+
+  // Number arguments, blocks and instructions first, phis can use later ones
+  std::map<const llvm::Value *, uint64_t> numbers;
+  for (const auto & arg : func.getArgumentList()) numbers.emplace(&arg, numbers.size());
+  for (const auto & bb : func) {
+    numbers.emplace(&bb, numbers.size());
+    for (const auto & instr : bb) numbers.emplace(&instr, numbers.size());
+  }
+  const auto operand = [&numbers] (const llvm::Value * value) {
+    const auto it = numbers.find(value);
+    return it != numbers.end() ? "%" + std::to_string(it->second) : value_printer(value);
+  };
+
+  FingerprintBuilder ret;
+  ret.add_string(type_printer(func.getFunctionType()));
+  for (const auto & arg : func.getArgumentList()) ret.add_string(arg.getName().str());
+  for (const auto & bb : func) {
+    FingerprintBuilder block;
+    block.add_string(bb.getName().str());
+    for (const auto & instr : bb) {
+      block.add_string(instr.getOpcodeName()).add_string(type_printer(instr.getType()))
+           .add_string(instr.getName().str()).add_u64(instr.getRawSubclassOptionalData());
+      if (const auto * cmp = llvm::dyn_cast<llvm::CmpInst>(&instr)) block.add_u64(static_cast<uint64_t>(cmp->getPredicate()));
+      if (const auto * load = llvm::dyn_cast<llvm::LoadInst>(&instr)) block.add_u64(load->isVolatile());
+      if (const auto * store = llvm::dyn_cast<llvm::StoreInst>(&instr)) block.add_u64(store->isVolatile());
+      block.add_u64(instr.getNumOperands());
+      for (auto op = instr.op_begin(); op != instr.op_end(); op++) block.add_string(operand(op->get()));
+      // Incoming blocks of phis aren't operands
+      if (const auto * phi = llvm::dyn_cast<llvm::PHINode>(&instr)) {
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); i++) block.add_string(operand(phi->getIncomingBlock(i)));
+      }
+    }
+    ret.add_fingerprint(block.finish());
+  }
+  return ret.finish();
+}
@@ -4,7 +4,9 @@
 #include <string>
 #include "llvm/Pass.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
 #include "llvm/Support/raw_ostream.h"
+#include "fingerprint.h"
 
 std::string value_printer(const llvm::Value * value);
 
@@ -12,4 +14,17 @@ std::string instr_printer(const llvm::Instruction * instruction);
 
 std::string bb_printer(const llvm::BasicBlock * basic_block);
 
+/// Global variable a load or store accesses, looking through
+/// pointer casts and getelementptrs, nullptr if it isn't a global
+/// or instruction isn't a load or store
+const llvm::GlobalVariable * accessed_global(const llvm::Instruction * instruction);
+
+/// Merkle-style fingerprint of func, for caching analysis results:
+/// each block hashes its name and its instructions' opcodes, types, names, flags
+/// and operands, the function hashes its type, argument names and its blocks' hashes in order.
+/// Arguments, blocks and instructions used as operands hash by position in func,
+/// other operands as printed, so identical bodies hash alike in every run,
+/// whatever the function is called, without printing (and numbering) every instruction.
+Fingerprint function_fingerprint(const llvm::Function & func);
+
 #endif  // UTILITY_FUNCTIONS_H_